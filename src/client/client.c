@@ -34,6 +34,7 @@ chimera_client_config_init(void)
     config->cache_ttl                = 60;
     config->attr_cache_enabled       = 1;
     config->umount_timeout_ms        = CHIMERA_COMMON_UMOUNT_TIMEOUT_MS_DEFAULT;
+    config->data_cache_size          = 0;
     config->name_cache_enabled       = 1;
     config->rcu_reclaim_threads      = 4; /* 4 = cap RCU reclaim workers to avoid thread exhaustion on many-core hosts */
     config->max_fds                  = 1024;
@@ -218,6 +219,8 @@ chimera_client_init(
 
     chimera_vfs_set_umount_timeout(client->vfs, config->umount_timeout_ms);
 
+    chimera_vfs_set_data_cache_size(client->vfs, config->data_cache_size);
+
     /* Initialize the root file handle after VFS is initialized */
     chimera_vfs_get_root_fh(client->root_fh, &client->root_fh_len);
 
@@ -363,6 +366,10 @@ chimera_client_init_json(
      * shared with the server. */
     config->umount_timeout_ms = chimera_common_umount_timeout_ms(root);
 
+    /* The VFS data cache (common.data_cache_size) is shared with the server;
+     * off by default. */
+    config->data_cache_size = chimera_common_data_cache_size(root);
+
     /* The VFS name (lookup) cache (common.name_cache) is likewise shared with
      * the server; on by default. */
     config->name_cache_enabled = chimera_common_name_cache_enabled(root);
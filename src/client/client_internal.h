@@ -448,6 +448,7 @@ struct chimera_client_config {
     int                           cache_ttl;
     int                           attr_cache_enabled;
     int                           umount_timeout_ms;
+    uint64_t                      data_cache_size;
     int                           name_cache_enabled;
     int                           rcu_reclaim_threads;
     int                           max_fds;
@@ -379,6 +379,37 @@ chimera_common_umount_timeout_ms(json_t *root)
     return CHIMERA_COMMON_UMOUNT_TIMEOUT_MS_DEFAULT;
 } /* chimera_common_umount_timeout_ms */
 
+/*
+ * Size of the shared VFS file data cache, from the shared "common" section's
+ * "data_cache_size" key (a size, e.g. "1G").  Like the attr and name caches it
+ * is a VFS-level facility honored identically by the server and the client.
+ * Pages are validated against the attr cache, so the data cache stays off
+ * when that is disabled.  Defaults to 0 (disabled) when the section or key is
+ * absent; `root` may be NULL.
+ */
+static inline uint64_t
+chimera_common_data_cache_size(json_t *root)
+{
+    json_t  *common, *val;
+    uint64_t size;
+
+    if (!root) {
+        return 0;
+    }
+
+    common = json_object_get(root, "common");
+    if (!json_is_object(common)) {
+        return 0;
+    }
+
+    val = json_object_get(common, "data_cache_size");
+    if (val && chimera_parse_size(val, &size) == 0) {
+        return size;
+    }
+
+    return 0;
+} /* chimera_common_data_cache_size */
+
 /*
  * Whether the VFS name (lookup) cache is enabled, from the shared "common"
  * section's "name_cache" boolean key.  Like the attr cache it is a VFS-level
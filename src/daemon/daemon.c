@@ -255,6 +255,7 @@ main(
     json_t                              *mounts, *mount, *exports, *export;
     json_t                              *json_value;
     int                                  int_value;
+    uint64_t                             size_value;
     const char                          *str_value;
     json_error_t                         error;
     struct chimera_server               *server;
@@ -498,6 +499,11 @@ main(
     chimera_server_config_set_umount_timeout(server_config,
                                              chimera_common_umount_timeout_ms(config));
 
+    /* The VFS data cache (common.data_cache_size) is shared with the client;
+     * off by default. */
+    chimera_server_config_set_data_cache_size(server_config,
+                                              chimera_common_data_cache_size(config));
+
     json_value = json_object_get(server_params, "smb_persistent_handles");
     if (json_is_boolean(json_value)) {
         chimera_server_config_set_smb_persistent_handles(server_config, json_is_true(json_value));
@@ -626,6 +632,11 @@ main(
         chimera_server_config_set_nfs3_drc(server_config, json_is_true(json_value));
     }
 
+    json_value = json_object_get(server_params, "write_behind_size");
+    if (json_value && chimera_parse_size(json_value, &size_value) == 0) {
+        chimera_server_config_set_write_behind_size(server_config, size_value);
+    }
+
     json_value = json_object_get(server_params, "nfs4_lease_time");
     if (json_is_integer(json_value)) {
         int_value = json_integer_value(json_value);
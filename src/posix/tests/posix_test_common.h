@@ -405,6 +405,11 @@ posix_test_emit_ext_module_config(
 static const char *posix_test_diskfs_extra_cfg = NULL;
 static int         posix_test_diskfs_reuse_devices __attribute__ ((unused)) = 0;
 
+/* When set (before posix_test_init), the client's common.data_cache_size, e.g.
+ * "64M".  The VFS data cache is off by default; tests of its coherence turn it
+ * on here. */
+static const char *posix_test_data_cache_size __attribute__ ((unused)) = NULL;
+
 /* When non-zero (set before posix_test_init), posix_test_start_nfs_server also
  * mounts the SAME NFS backend a second time, read-only, under a subdirectory
  * and exposes it via a second export "/share_ro".  The read-write export
@@ -962,10 +967,16 @@ posix_test_init(
 
         /* Match the server (see posix_test_start_nfs_server).  Read from the
          * top-level "common" section, not from "config". */
-        if (posix_test_transport_is_inproc()) {
+        if (posix_test_transport_is_inproc() || posix_test_data_cache_size) {
             json_t *common = json_object();
 
-            json_object_set_new(common, "tcp_flavor", json_string("inproc"));
+            if (posix_test_transport_is_inproc()) {
+                json_object_set_new(common, "tcp_flavor", json_string("inproc"));
+            }
+            if (posix_test_data_cache_size) {
+                json_object_set_new(common, "data_cache_size",
+                                    json_string(posix_test_data_cache_size));
+            }
             json_object_set_new(posix_json_root, "common", common);
         }
 
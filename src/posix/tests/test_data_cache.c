@@ -0,0 +1,261 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * VFS data cache and read-ahead coherence test.
+ *
+ * Runs with common.data_cache_size set, so sequential reads fill the cache and
+ * drive read-ahead.  After each kind of mutation -- an overwrite through a
+ * second descriptor, a truncate, an extend across a hole, an append -- the
+ * file is read again through the descriptor that warmed the cache and must
+ * match an in-memory model: a stale page or read-ahead fill is a failure.
+ * memfs opts out of the cache, so there the test just checks plain I/O.
+ */
+
+#include <inttypes.h>
+
+#include "common/platform.h"
+
+#include "posix_test_common.h"
+
+#define FILE_BYTES  (8 * 1024 * 1024)
+#define MODEL_BYTES (12 * 1024 * 1024)
+#define PAGE_BYTES  (32 * 1024)
+#define READ_CHUNK  (64 * 1024)
+
+static uint8_t  model[MODEL_BYTES];
+static uint64_t model_size;
+static uint8_t  rbuf[MODEL_BYTES];
+
+static void
+fill(
+    uint8_t *p,
+    uint64_t off,
+    uint64_t len,
+    int      seed)
+{
+    uint64_t i;
+
+    for (i = 0; i < len; i++) {
+        p[i] = (uint8_t) (((off + i) * 131 + seed * 17 + ((off + i) >> 12)) & 0xff);
+    }
+} /* fill */
+
+static void
+do_pwrite(
+    struct posix_test_env *env,
+    int                    fd,
+    uint64_t               off,
+    uint64_t               len,
+    int                    seed)
+{
+    fill(model + off, off, len, seed);
+    if (off + len > model_size) {
+        model_size = off + len;
+    }
+
+    if (chimera_posix_pwrite(fd, model + off, len, (off_t) off) != (ssize_t) len) {
+        fprintf(stderr, "pwrite [%" PRIu64 ", +%" PRIu64 ") failed: %s\n",
+                off, len, strerror(errno));
+        posix_test_fail(env);
+    }
+} /* do_pwrite */
+
+static void
+do_ftruncate(
+    struct posix_test_env *env,
+    int                    fd,
+    uint64_t               size)
+{
+    if (chimera_posix_ftruncate(fd, (off_t) size) != 0) {
+        fprintf(stderr, "ftruncate to %" PRIu64 " failed: %s\n", size,
+                strerror(errno));
+        posix_test_fail(env);
+    }
+    if (size < model_size) {
+        memset(model + size, 0, model_size - size);
+    }
+    model_size = size;
+} /* do_ftruncate */
+
+/* Read the whole file front to back in READ_CHUNK pieces (the sequential
+ * pattern that grows the read-ahead window) and compare against the model. */
+static void
+verify_sequential(
+    struct posix_test_env *env,
+    int                    fd,
+    const char            *phase)
+{
+    uint64_t off = 0;
+    ssize_t  rc;
+
+    for (;;) {
+        rc = chimera_posix_pread(fd, rbuf + off, READ_CHUNK, (off_t) off);
+        if (rc < 0) {
+            fprintf(stderr, "%s: pread at %" PRIu64 " failed: %s\n", phase, off,
+                    strerror(errno));
+            posix_test_fail(env);
+        }
+        if (rc == 0) {
+            break;
+        }
+        off += rc;
+        if (off > model_size) {
+            break;
+        }
+    }
+
+    if (off != model_size) {
+        fprintf(stderr, "%s: read %" PRIu64 " bytes, want %" PRIu64 "\n", phase,
+                off, model_size);
+        posix_test_fail(env);
+    }
+
+    for (off = 0; off < model_size; off++) {
+        if (rbuf[off] != model[off]) {
+            fprintf(stderr, "%s: mismatch at %" PRIu64 " (page %" PRIu64 ")\n",
+                    phase, off, off / PAGE_BYTES);
+            posix_test_fail(env);
+        }
+    }
+} /* verify_sequential */
+
+/* Read pages back to front at an unaligned offset within each, so every read
+ * straddles a page boundary and none of them looks sequential. */
+static void
+verify_backward(
+    struct posix_test_env *env,
+    int                    fd,
+    const char            *phase)
+{
+    uint64_t off, len;
+    ssize_t  rc;
+    int64_t  page;
+
+    for (page = (int64_t) (model_size / PAGE_BYTES); page >= 0; page--) {
+        off = page * PAGE_BYTES + PAGE_BYTES / 2 + 7;
+        if (off >= model_size) {
+            continue;
+        }
+        len = PAGE_BYTES;
+        if (off + len > model_size) {
+            len = model_size - off;
+        }
+
+        rc = chimera_posix_pread(fd, rbuf, PAGE_BYTES, (off_t) off);
+        if (rc != (ssize_t) len || memcmp(rbuf, model + off, len) != 0) {
+            fprintf(stderr, "%s: backward read at %" PRIu64 " wrong (rc=%zd, want %"
+                    PRIu64 ")\n", phase, off, rc, len);
+            posix_test_fail(env);
+        }
+    }
+} /* verify_backward */
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    struct posix_test_env env;
+    const char           *path = "/test/data_cache";
+    int                   rfd, wfd, rc, i;
+
+    posix_test_data_cache_size = "64M";
+
+    posix_test_init(&env, argv, argc);
+
+    rc = posix_test_mount(&env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to mount test module: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    wfd = chimera_posix_open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (wfd < 0) {
+        fprintf(stderr, "create failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    for (i = 0; i < FILE_BYTES / (1024 * 1024); i++) {
+        do_pwrite(&env, wfd, (uint64_t) i * 1024 * 1024, 1024 * 1024, 1);
+    }
+    if (chimera_posix_fsync(wfd) != 0) {
+        fprintf(stderr, "fsync failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rfd = chimera_posix_open(path, O_RDONLY, 0);
+    if (rfd < 0) {
+        fprintf(stderr, "open for read failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    /* Cold, then warm: the second pass is served from the cache. */
+    verify_sequential(&env, rfd, "cold read");
+    verify_sequential(&env, rfd, "warm read");
+    verify_backward(&env, rfd, "warm backward");
+
+    /* Overwrites through the other descriptor: a few bytes inside one page,
+     * one straddling a page boundary, and one whole page. */
+    do_pwrite(&env, wfd, 100000, 5000, 2);
+    do_pwrite(&env, wfd, 7 * PAGE_BYTES - 100, 200, 3);
+    do_pwrite(&env, wfd, 40 * PAGE_BYTES, PAGE_BYTES, 4);
+    verify_backward(&env, rfd, "after overwrite (backward)");
+    verify_sequential(&env, rfd, "after overwrite");
+
+    /* Truncate into the middle of a cached page: nothing past the new EOF
+     * may come back, even from a page that was cached whole. */
+    do_ftruncate(&env, wfd, 3 * 1024 * 1024 + 123);
+    verify_sequential(&env, rfd, "after truncate");
+
+    /* Extend across a hole: the range that used to hold cached data must now
+     * read as zeros. */
+    do_pwrite(&env, wfd, 6 * 1024 * 1024, 100, 5);
+    verify_sequential(&env, rfd, "after extend");
+    verify_backward(&env, rfd, "after extend (backward)");
+
+    /* Warm the cache again, then append past EOF and grow the tail page. */
+    verify_sequential(&env, rfd, "before append");
+    for (i = 0; i < 8; i++) {
+        do_pwrite(&env, wfd, model_size, 777, 6 + i);
+    }
+    do_pwrite(&env, wfd, 11 * 1024 * 1024, 3 * PAGE_BYTES, 20);
+    verify_sequential(&env, rfd, "after append");
+
+    /* Interleave small writes with sequential reads of the same range, so a
+     * read-ahead issued before a write cannot publish the old data after it. */
+    for (i = 0; i < 16; i++) {
+        uint64_t off = (uint64_t) i * 512 * 1024 + 4096;
+
+        verify_sequential(&env, rfd, "interleaved read");
+        do_pwrite(&env, wfd, off, 512, 30 + i);
+    }
+    verify_sequential(&env, rfd, "after interleave");
+
+    chimera_posix_close(rfd);
+    chimera_posix_close(wfd);
+
+    /* A fresh open must see the same bytes. */
+    rfd = chimera_posix_open(path, O_RDONLY, 0);
+    if (rfd < 0) {
+        fprintf(stderr, "reopen failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+    verify_sequential(&env, rfd, "after reopen");
+    chimera_posix_close(rfd);
+
+    if (chimera_posix_unlink(path) != 0) {
+        fprintf(stderr, "unlink failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    posix_test_success(&env);
+    return 0;
+} /* main */
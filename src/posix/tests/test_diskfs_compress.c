@@ -0,0 +1,393 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * diskfs per-extent compression test.
+ *
+ * A compressible file and an incompressible one are written in whole 64 KiB
+ * chunks on a compressed pool; the compressible one must take well under its
+ * logical size.  Both are then edited against an in-memory model: sub-chunk
+ * overwrites inside and across compressed chunks (which rewrite the chunk
+ * uncompressed first), a truncate to a mid-chunk size and an extending write
+ * past a hole.  Every file is compared with its model after the edits and
+ * again after a cold remount, and unlinking them must return the space.
+ *
+ * The algorithm defaults to lz4; COMPRESS_ALGO=zstd selects the other one.
+ */
+
+#include <inttypes.h>
+
+#include "common/platform.h"
+
+#include "posix_test_common.h"
+
+#define COMPRESS_ALGO \
+        (getenv("COMPRESS_ALGO") ? getenv("COMPRESS_ALGO") : "lz4")
+#define Z_CHUNK      (64 * 1024)
+#define TEXT_BYTES   (8 * 1024 * 1024)
+#define RAND_BYTES   (4 * 1024 * 1024)
+#define MODEL_BYTES  (16 * 1024 * 1024)
+
+/* Free-space slack: directory and extent-tree metadata, AG-log churn and
+ * per-worker allocator reservations stay far below this. */
+#define Z_SLACK      (8ULL << 20)
+
+struct model {
+    const char *path;
+    uint8_t    *data;
+    uint64_t    size;
+};
+
+static uint64_t
+free_bytes(struct posix_test_env *env)
+{
+    struct statfs sf;
+
+    if (chimera_posix_statfs("/test", &sf) != 0) {
+        fprintf(stderr, "statfs failed: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+    return (uint64_t) sf.f_bfree * (uint64_t) sf.f_bsize;
+} /* free_bytes */
+
+/* Reclaim is asynchronous: poll until free space is within slack of the
+ * baseline (or time out). */
+static void
+expect_convergence(
+    struct posix_test_env *env,
+    uint64_t               baseline,
+    const char            *phase)
+{
+    uint64_t now_free = 0;
+    int      i;
+
+    for (i = 0; i < 600; i++) {
+        now_free = free_bytes(env);
+        if (now_free + Z_SLACK >= baseline) {
+            fprintf(stderr, "%s: converged (baseline=%" PRIu64 " free=%" PRIu64 ")\n",
+                    phase, baseline, now_free);
+            return;
+        }
+        usleep(100000);
+    }
+
+    fprintf(stderr, "%s: space did not converge: baseline=%" PRIu64 " free=%" PRIu64 " "
+            "(leaked ~%" PRIu64 " bytes)\n",
+            phase, baseline, now_free, baseline - now_free);
+    posix_test_fail(env);
+} /* expect_convergence */
+
+static void
+fill_text(
+    uint8_t *buf,
+    uint64_t len)
+{
+    char     line[64];
+    uint64_t off = 0;
+    int      n, i = 0;
+
+    while (off < len) {
+        n = snprintf(line, sizeof(line), "line %08d of a compressible file\n", i++);
+        if ((uint64_t) n > len - off) {
+            n = (int) (len - off);
+        }
+        memcpy(buf + off, line, n);
+        off += n;
+    }
+} /* fill_text */
+
+static void
+fill_random(
+    uint8_t *buf,
+    uint64_t len)
+{
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    uint64_t off;
+
+    for (off = 0; off + sizeof(x) <= len; off += sizeof(x)) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        memcpy(buf + off, &x, sizeof(x));
+    }
+} /* fill_random */
+
+/* Write the model's bytes [off, off + len) to the file. */
+static void
+write_range(
+    struct posix_test_env *env,
+    struct model          *m,
+    uint64_t               off,
+    uint64_t               len)
+{
+    ssize_t rc;
+    int     fd;
+
+    fd = chimera_posix_open(m->path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open %s failed: %s\n", m->path, strerror(errno));
+        posix_test_fail(env);
+    }
+
+    while (len) {
+        uint64_t n = len < Z_CHUNK ? len : Z_CHUNK;
+
+        rc = chimera_posix_pwrite(fd, m->data + off, n, (off_t) off);
+        if (rc != (ssize_t) n) {
+            fprintf(stderr, "write %s at %" PRIu64 " failed: %s\n", m->path, off,
+                    strerror(errno));
+            posix_test_fail(env);
+        }
+        off += n;
+        len -= n;
+        if (off > m->size) {
+            m->size = off;
+        }
+    }
+
+    chimera_posix_close(fd);
+} /* write_range */
+
+/* Change `len` model bytes at `off` and write them. */
+static void
+edit_range(
+    struct posix_test_env *env,
+    struct model          *m,
+    uint64_t               off,
+    uint64_t               len,
+    uint8_t                byte)
+{
+    memset(m->data + off, byte, len);
+    write_range(env, m, off, len);
+} /* edit_range */
+
+static void
+truncate_model(
+    struct posix_test_env *env,
+    struct model          *m,
+    uint64_t               size)
+{
+    if (chimera_posix_truncate(m->path, (off_t) size) != 0) {
+        fprintf(stderr, "truncate %s failed: %s\n", m->path, strerror(errno));
+        posix_test_fail(env);
+    }
+    if (size < m->size) {
+        memset(m->data + size, 0, m->size - size);
+    }
+    m->size = size;
+} /* truncate_model */
+
+static void
+verify_model(
+    struct posix_test_env *env,
+    struct model          *m,
+    const char            *phase)
+{
+    static uint8_t buf[Z_CHUNK];
+    struct stat    st;
+    uint64_t       off, n;
+    ssize_t        rc;
+    int            fd;
+
+    if (chimera_posix_stat(m->path, &st) != 0 || (uint64_t) st.st_size != m->size) {
+        fprintf(stderr, "%s: %s size %lld, want %" PRIu64 "\n", phase, m->path,
+                (long long) st.st_size, m->size);
+        posix_test_fail(env);
+    }
+
+    fd = chimera_posix_open(m->path, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "open %s failed: %s\n", m->path, strerror(errno));
+        posix_test_fail(env);
+    }
+
+    for (off = 0; off < m->size; off += n) {
+        n  = m->size - off < Z_CHUNK ? m->size - off : Z_CHUNK;
+        rc = chimera_posix_pread(fd, buf, n, (off_t) off);
+        if (rc != (ssize_t) n || memcmp(buf, m->data + off, n) != 0) {
+            fprintf(stderr, "%s: %s differs in [%" PRIu64 ", +%" PRIu64 ") (rc=%zd)\n",
+                    phase, m->path, off, n, rc);
+            posix_test_fail(env);
+        }
+    }
+
+    chimera_posix_close(fd);
+} /* verify_model */
+
+/* Cold remount on the same device images. */
+static void
+remount(struct posix_test_env *env)
+{
+    char                       diskfs_cfg[4096];
+    char                       posix_json_path[300];
+    json_t                    *root, *config, *vfs, *vfs_entry;
+    struct prometheus_metrics *metrics2;
+    int                        rc;
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+
+    chimera_posix_shutdown();
+
+    posix_test_diskfs_reuse_devices = 1;
+    posix_test_configure_diskfs(env->session_dir,
+                                posix_test_diskfs_device_type(env->backend),
+                                diskfs_cfg, sizeof(diskfs_cfg));
+
+    root      = json_object();
+    config    = json_object();
+    vfs       = json_object();
+    vfs_entry = json_object();
+    json_object_set_new(vfs_entry, "path", json_string("/build/test/diskfs"));
+    json_object_set_new(vfs_entry, "config", json_string(diskfs_cfg));
+    json_object_set_new(vfs, "diskfs", vfs_entry);
+    json_object_set_new(config, "vfs", vfs);
+    json_object_set_new(root, "config", config);
+    chimera_test_write_users_json(root);
+
+    snprintf(posix_json_path, sizeof(posix_json_path),
+             "%s/posix_remount.json", env->session_dir);
+    json_dump_file(root, posix_json_path, 0);
+    json_decref(root);
+
+    metrics2   = prometheus_metrics_create(NULL, NULL, 0);
+    env->posix = chimera_posix_init_json(posix_json_path, &env->cred, metrics2);
+    if (!env->posix) {
+        fprintf(stderr, "Failed to re-initialize POSIX client\n");
+        posix_test_fail(env);
+    }
+    prometheus_metrics_destroy(env->metrics);
+    env->metrics = metrics2;
+
+    rc = posix_test_mount(env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to re-mount: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+} /* remount */
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    struct posix_test_env env;
+    static char           extra_cfg[64];
+    struct model          text = { "/test/d/text", NULL, 0 };
+    struct model          rnd  = { "/test/d/rand", NULL, 0 };
+    uint64_t              baseline, now_free;
+    int                   rc;
+
+    snprintf(extra_cfg, sizeof(extra_cfg), "{\"compression\":\"%s\"}",
+             COMPRESS_ALGO);
+    posix_test_diskfs_extra_cfg = extra_cfg;
+
+    posix_test_init(&env, argv, argc);
+    ChimeraLogLevel = CHIMERA_LOG_INFO;
+
+    if (!posix_test_is_diskfs(env.backend)) {
+        fprintf(stderr, "diskfs-only test, nothing to do for %s\n", env.backend);
+        posix_test_success(&env);
+        return 0;
+    }
+
+    text.data = calloc(1, MODEL_BYTES);
+    rnd.data  = calloc(1, MODEL_BYTES);
+    if (!text.data || !rnd.data) {
+        fprintf(stderr, "model allocation failed\n");
+        posix_test_fail(&env);
+    }
+    fill_text(text.data, TEXT_BYTES);
+    fill_random(rnd.data, RAND_BYTES);
+
+    rc = posix_test_mount(&env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to mount test module: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = chimera_posix_mkdir("/test/d", 0755);
+    if (rc != 0) {
+        fprintf(stderr, "mkdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    /* Warm-up: prime the per-worker allocator reservations (see
+     * test_diskfs_reclaim) so the baseline is steady. */
+    write_range(&env, &rnd, 0, RAND_BYTES);
+    if (chimera_posix_unlink(rnd.path) != 0) {
+        fprintf(stderr, "unlink %s failed: %s\n", rnd.path, strerror(errno));
+        posix_test_fail(&env);
+    }
+    rnd.size = 0;
+    sleep(3);
+
+    baseline = free_bytes(&env);
+    fprintf(stderr, "baseline free: %" PRIu64 " bytes (%s)\n", baseline,
+            COMPRESS_ALGO);
+
+    /* Phase 1: whole-chunk writes.  The text compresses to a fraction of its
+     * size; the random data is stored as is. */
+    fprintf(stderr, "phase 1: whole-chunk writes...\n");
+    write_range(&env, &text, 0, TEXT_BYTES);
+    now_free = free_bytes(&env);
+    if (now_free + TEXT_BYTES / 2 < baseline) {
+        fprintf(stderr, "phase 1: %d bytes of text used %" PRIu64 " bytes\n",
+                TEXT_BYTES, baseline - now_free);
+        posix_test_fail(&env);
+    }
+    write_range(&env, &rnd, 0, RAND_BYTES);
+    verify_model(&env, &text, "phase 1");
+    verify_model(&env, &rnd, "phase 1");
+
+    /* Phase 2: sub-chunk edits -- inside one compressed chunk, across a chunk
+     * boundary, a whole chunk at an unaligned offset -- then a mid-chunk
+     * truncate and an extending write past a hole. */
+    fprintf(stderr, "phase 2: partial overwrites, truncate, extend...\n");
+    edit_range(&env, &text, 3 * Z_CHUNK + 1234, 100, 'x');
+    edit_range(&env, &text, 5 * Z_CHUNK - 300, 600, 'y');
+    edit_range(&env, &text, 9 * Z_CHUNK + 4095, Z_CHUNK, 'z');
+    edit_range(&env, &rnd, 2 * Z_CHUNK + 17, 5000, 'r');
+    truncate_model(&env, &text, 5 * 1024 * 1024 + 777);
+    truncate_model(&env, &rnd, 3 * 1024 * 1024 + 4096 + 12);
+    fill_text(text.data + 10 * 1024 * 1024, 2 * Z_CHUNK);
+    write_range(&env, &text, 10 * 1024 * 1024, 2 * Z_CHUNK);
+    verify_model(&env, &text, "phase 2");
+    verify_model(&env, &rnd, "phase 2");
+
+    /* Phase 3: everything reads back the same from disk. */
+    fprintf(stderr, "phase 3: cold remount...\n");
+    remount(&env);
+    verify_model(&env, &text, "phase 3");
+    verify_model(&env, &rnd, "phase 3");
+
+    /* Phase 4: compressed and raw extents free their actual blocks. */
+    fprintf(stderr, "phase 4: unlink...\n");
+    if (chimera_posix_unlink(text.path) != 0 ||
+        chimera_posix_unlink(rnd.path) != 0) {
+        fprintf(stderr, "unlink failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+    expect_convergence(&env, baseline, "phase 4 (unlink)");
+
+    if (chimera_posix_rmdir("/test/d") != 0) {
+        fprintf(stderr, "rmdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    free(text.data);
+    free(rnd.data);
+
+    posix_test_success(&env);
+    return 0;
+} /* main */
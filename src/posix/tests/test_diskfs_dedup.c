@@ -0,0 +1,365 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * diskfs inline-dedup refcount test.
+ *
+ * Several files are written with the same chunk-aligned content, so every
+ * 64 KiB chunk after the first copy is a reference to the stored one.  The
+ * test checks that the copies cost one file's worth of space, that a
+ * rewrite of a shared chunk leaves the other referents alone, that
+ * unlinking referents keeps the chunks alive for the survivors (a scratch
+ * file written in between would take over any blocks freed early), that
+ * the references survive a cold remount, and that dropping the last
+ * reference returns the space and retires the fingerprints: content written
+ * again afterwards must be stored afresh, not matched against a stale index
+ * entry that points at reused blocks.
+ */
+
+#include <inttypes.h>
+
+#include "common/platform.h"
+
+#include "posix_test_common.h"
+
+#define DEDUP_CHUNK      (64 * 1024)
+#define DEDUP_CHUNKS     256
+#define DEDUP_FILE_BYTES ((uint64_t) DEDUP_CHUNK * DEDUP_CHUNKS)
+#define DEDUP_COPIES     4
+
+/* Free-space slack: directory and extent-tree metadata, AG-log churn and
+ * per-worker allocator reservations stay far below this. */
+#define DEDUP_SLACK      (8ULL << 20)
+
+static uint64_t
+free_bytes(struct posix_test_env *env)
+{
+    struct statfs sf;
+
+    if (chimera_posix_statfs("/test", &sf) != 0) {
+        fprintf(stderr, "statfs failed: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+    return (uint64_t) sf.f_bfree * (uint64_t) sf.f_bsize;
+} /* free_bytes */
+
+/* Reclaim is asynchronous: poll until free space is within slack of the
+ * baseline (or time out). */
+static void
+expect_convergence(
+    struct posix_test_env *env,
+    uint64_t               baseline,
+    const char            *phase)
+{
+    uint64_t now_free = 0;
+    int      i;
+
+    for (i = 0; i < 600; i++) {
+        now_free = free_bytes(env);
+        if (now_free + DEDUP_SLACK >= baseline) {
+            fprintf(stderr, "%s: converged (baseline=%" PRIu64 " free=%" PRIu64 ")\n",
+                    phase, baseline, now_free);
+            return;
+        }
+        usleep(100000);
+    }
+
+    fprintf(stderr, "%s: space did not converge: baseline=%" PRIu64 " free=%" PRIu64 " "
+            "(leaked ~%" PRIu64 " bytes)\n",
+            phase, baseline, now_free, baseline - now_free);
+    posix_test_fail(env);
+} /* expect_convergence */
+
+/* Every chunk of a given seed is distinct (so dedup within one write does
+ * not blur the count) and never all zero. */
+static void
+fill_chunk(
+    uint8_t *buf,
+    int      chunk,
+    int      seed)
+{
+    uint64_t tag[2] = { (uint64_t) chunk, (uint64_t) seed };
+
+    memset(buf, 0x11 + ((chunk + seed * 7) & 0x7f), DEDUP_CHUNK);
+    memcpy(buf, tag, sizeof(tag));
+} /* fill_chunk */
+
+static void
+write_chunk(
+    struct posix_test_env *env,
+    int                    fd,
+    const char            *path,
+    int                    chunk,
+    int                    seed)
+{
+    static uint8_t buf[DEDUP_CHUNK];
+    ssize_t        rc;
+
+    fill_chunk(buf, chunk, seed);
+    rc = chimera_posix_pwrite(fd, buf, DEDUP_CHUNK, (off_t) chunk * DEDUP_CHUNK);
+    if (rc != DEDUP_CHUNK) {
+        fprintf(stderr, "write %s chunk %d failed: %s\n", path, chunk,
+                strerror(errno));
+        posix_test_fail(env);
+    }
+} /* write_chunk */
+
+static void
+write_file(
+    struct posix_test_env *env,
+    const char            *path,
+    int                    seed)
+{
+    int fd, i;
+
+    fd = chimera_posix_open(path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "create %s failed: %s\n", path, strerror(errno));
+        posix_test_fail(env);
+    }
+
+    for (i = 0; i < DEDUP_CHUNKS; i++) {
+        write_chunk(env, fd, path, i, seed);
+    }
+
+    chimera_posix_close(fd);
+} /* write_file */
+
+/* Read the whole file back; chunk `odd_chunk` (if >= 0) is expected to carry
+ * `odd_seed`, every other chunk `seed`. */
+static void
+verify_file(
+    struct posix_test_env *env,
+    const char            *path,
+    int                    seed,
+    int                    odd_chunk,
+    int                    odd_seed)
+{
+    static uint8_t want[DEDUP_CHUNK];
+    static uint8_t got[DEDUP_CHUNK];
+    ssize_t        rc;
+    int            fd, i;
+
+    fd = chimera_posix_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "open %s failed: %s\n", path, strerror(errno));
+        posix_test_fail(env);
+    }
+
+    for (i = 0; i < DEDUP_CHUNKS; i++) {
+        fill_chunk(want, i, i == odd_chunk ? odd_seed : seed);
+        rc = chimera_posix_pread(fd, got, DEDUP_CHUNK, (off_t) i * DEDUP_CHUNK);
+        if (rc != DEDUP_CHUNK || memcmp(want, got, DEDUP_CHUNK) != 0) {
+            fprintf(stderr, "%s: chunk %d reads back wrong (rc=%zd)\n",
+                    path, i, rc);
+            posix_test_fail(env);
+        }
+    }
+
+    chimera_posix_close(fd);
+} /* verify_file */
+
+static void
+unlink_file(
+    struct posix_test_env *env,
+    const char            *path)
+{
+    if (chimera_posix_unlink(path) != 0) {
+        fprintf(stderr, "unlink %s failed: %s\n", path, strerror(errno));
+        posix_test_fail(env);
+    }
+} /* unlink_file */
+
+/* Cold remount on the same device images. */
+static void
+remount(struct posix_test_env *env)
+{
+    char                       diskfs_cfg[4096];
+    char                       posix_json_path[300];
+    json_t                    *root, *config, *vfs, *vfs_entry;
+    struct prometheus_metrics *metrics2;
+    int                        rc;
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+
+    chimera_posix_shutdown();
+
+    posix_test_diskfs_reuse_devices = 1;
+    posix_test_configure_diskfs(env->session_dir,
+                                posix_test_diskfs_device_type(env->backend),
+                                diskfs_cfg, sizeof(diskfs_cfg));
+
+    root      = json_object();
+    config    = json_object();
+    vfs       = json_object();
+    vfs_entry = json_object();
+    json_object_set_new(vfs_entry, "path", json_string("/build/test/diskfs"));
+    json_object_set_new(vfs_entry, "config", json_string(diskfs_cfg));
+    json_object_set_new(vfs, "diskfs", vfs_entry);
+    json_object_set_new(config, "vfs", vfs);
+    json_object_set_new(root, "config", config);
+    chimera_test_write_users_json(root);
+
+    snprintf(posix_json_path, sizeof(posix_json_path),
+             "%s/posix_remount.json", env->session_dir);
+    json_dump_file(root, posix_json_path, 0);
+    json_decref(root);
+
+    metrics2   = prometheus_metrics_create(NULL, NULL, 0);
+    env->posix = chimera_posix_init_json(posix_json_path, &env->cred, metrics2);
+    if (!env->posix) {
+        fprintf(stderr, "Failed to re-initialize POSIX client\n");
+        posix_test_fail(env);
+    }
+    prometheus_metrics_destroy(env->metrics);
+    env->metrics = metrics2;
+
+    rc = posix_test_mount(env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to re-mount: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+} /* remount */
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    struct posix_test_env env;
+    char                  path[128];
+    uint64_t              baseline, now_free;
+    int                   rc, i;
+
+    posix_test_diskfs_extra_cfg = "{\"dedup\":true}";
+
+    posix_test_init(&env, argv, argc);
+    ChimeraLogLevel = CHIMERA_LOG_INFO;
+
+    if (!posix_test_is_diskfs(env.backend)) {
+        fprintf(stderr, "diskfs-only test, nothing to do for %s\n", env.backend);
+        posix_test_success(&env);
+        return 0;
+    }
+
+    rc = posix_test_mount(&env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to mount test module: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = chimera_posix_mkdir("/test/d", 0755);
+    if (rc != 0) {
+        fprintf(stderr, "mkdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    /* Warm-up: prime the per-worker allocator reservations (see
+     * test_diskfs_reclaim) so the baseline is steady. */
+    write_file(&env, "/test/d/warm", 99);
+    unlink_file(&env, "/test/d/warm");
+    sleep(3);
+
+    baseline = free_bytes(&env);
+    fprintf(stderr, "baseline free: %" PRIu64 " bytes\n", baseline);
+
+    /* Phase 1: identical copies share their chunks. */
+    fprintf(stderr, "phase 1: %d identical copies...\n", DEDUP_COPIES);
+    for (i = 0; i < DEDUP_COPIES; i++) {
+        snprintf(path, sizeof(path), "/test/d/f%d", i);
+        write_file(&env, path, 1);
+    }
+    for (i = 0; i < DEDUP_COPIES; i++) {
+        snprintf(path, sizeof(path), "/test/d/f%d", i);
+        verify_file(&env, path, 1, -1, 0);
+    }
+    now_free = free_bytes(&env);
+    if (now_free + DEDUP_FILE_BYTES + DEDUP_SLACK < baseline) {
+        fprintf(stderr, "phase 1: %d copies used %" PRIu64 " bytes, "
+                "expected about %" PRIu64 "\n",
+                DEDUP_COPIES, baseline - now_free, DEDUP_FILE_BYTES);
+        posix_test_fail(&env);
+    }
+
+    /* Phase 2: rewriting a shared chunk in one file must not show through
+     * the others. */
+    fprintf(stderr, "phase 2: rewrite a shared chunk...\n");
+    {
+        int fd = chimera_posix_open("/test/d/f1", O_RDWR, 0);
+
+        if (fd < 0) {
+            fprintf(stderr, "open f1 failed: %s\n", strerror(errno));
+            posix_test_fail(&env);
+        }
+        write_chunk(&env, fd, "/test/d/f1", 3, 2);
+        chimera_posix_close(fd);
+    }
+    verify_file(&env, "/test/d/f0", 1, -1, 0);
+    verify_file(&env, "/test/d/f1", 1, 3, 2);
+    verify_file(&env, "/test/d/f2", 1, -1, 0);
+
+    /* Phase 3: drop all but the last referent, then churn a scratch file
+     * through the free space.  Chunks freed while still referenced would be
+     * handed to the scratch file and the survivor would read its data. */
+    fprintf(stderr, "phase 3: unlink all but one referent...\n");
+    for (i = 0; i < DEDUP_COPIES - 1; i++) {
+        snprintf(path, sizeof(path), "/test/d/f%d", i);
+        unlink_file(&env, path);
+    }
+    sleep(3);
+    write_file(&env, "/test/d/scratch", 3);
+    unlink_file(&env, "/test/d/scratch");
+    snprintf(path, sizeof(path), "/test/d/f%d", DEDUP_COPIES - 1);
+    verify_file(&env, path, 1, -1, 0);
+
+    /* Phase 4: the references and fingerprints survive a cold remount.  A
+     * fresh copy written after it shares the survivor's chunks and must
+     * outlive it. */
+    fprintf(stderr, "phase 4: cold remount...\n");
+    remount(&env);
+    verify_file(&env, path, 1, -1, 0);
+    write_file(&env, "/test/d/g", 1);
+    unlink_file(&env, path);
+    sleep(3);
+    write_file(&env, "/test/d/scratch", 4);
+    unlink_file(&env, "/test/d/scratch");
+    verify_file(&env, "/test/d/g", 1, -1, 0);
+
+    /* Phase 5: the last reference frees the chunks. */
+    fprintf(stderr, "phase 5: unlink the last referent...\n");
+    unlink_file(&env, "/test/d/g");
+    expect_convergence(&env, baseline, "phase 5 (last reference)");
+
+    /* Phase 6: the fingerprints went with the chunks.  Reuse the freed
+     * blocks for other data, then write the old content again: it must be
+     * stored afresh and read back intact. */
+    fprintf(stderr, "phase 6: rewrite after reclaim...\n");
+    write_file(&env, "/test/d/scratch", 5);
+    write_file(&env, "/test/d/h", 1);
+    unlink_file(&env, "/test/d/scratch");
+    sleep(3);
+    write_file(&env, "/test/d/scratch", 6);
+    unlink_file(&env, "/test/d/scratch");
+    verify_file(&env, "/test/d/h", 1, -1, 0);
+    unlink_file(&env, "/test/d/h");
+    expect_convergence(&env, baseline, "phase 6 (rewrite after reclaim)");
+
+    if (chimera_posix_rmdir("/test/d") != 0) {
+        fprintf(stderr, "rmdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    posix_test_success(&env);
+    return 0;
+} /* main */
@@ -0,0 +1,324 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * diskfs inline small-file data test.
+ *
+ * Files of up to 3 KiB keep their data in the inode block and move to extents
+ * when they grow past it.  Each case below drives one file across that
+ * boundary -- exact-limit and one-past writes, appends that convert midway,
+ * holes before inline data, a write far past an inline EOF, truncates both
+ * ways -- against an in-memory model, then every file is compared again after
+ * a cold remount.
+ */
+
+#include <inttypes.h>
+
+#include "common/platform.h"
+
+#include "posix_test_common.h"
+
+#define INLINE_MAX  3072
+#define MODEL_BYTES (64 * 1024)
+
+struct model {
+    char     path[64];
+    uint8_t  data[MODEL_BYTES];
+    uint64_t size;
+};
+
+static void
+model_init(
+    struct model *m,
+    const char   *name)
+{
+    snprintf(m->path, sizeof(m->path), "/test/i/%s", name);
+    memset(m->data, 0, sizeof(m->data));
+    m->size = 0;
+} /* model_init */
+
+/* Write `len` bytes of a pattern unique to (off, seed) at `off`. */
+static void
+model_write(
+    struct posix_test_env *env,
+    struct model          *m,
+    uint64_t               off,
+    uint64_t               len,
+    int                    seed)
+{
+    ssize_t  rc;
+    uint64_t i;
+    int      fd;
+
+    for (i = 0; i < len; i++) {
+        m->data[off + i] = (uint8_t) ('A' + (off + i + seed * 7) % 53);
+    }
+    if (off + len > m->size) {
+        m->size = off + len;
+    }
+
+    fd = chimera_posix_open(m->path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "open %s failed: %s\n", m->path, strerror(errno));
+        posix_test_fail(env);
+    }
+    rc = chimera_posix_pwrite(fd, m->data + off, len, (off_t) off);
+    if (rc != (ssize_t) len) {
+        fprintf(stderr, "write %s [%" PRIu64 ", +%" PRIu64 ") failed: %s\n",
+                m->path, off, len, strerror(errno));
+        posix_test_fail(env);
+    }
+    chimera_posix_close(fd);
+} /* model_write */
+
+static void
+model_truncate(
+    struct posix_test_env *env,
+    struct model          *m,
+    uint64_t               size)
+{
+    if (chimera_posix_truncate(m->path, (off_t) size) != 0) {
+        fprintf(stderr, "truncate %s to %" PRIu64 " failed: %s\n", m->path, size,
+                strerror(errno));
+        posix_test_fail(env);
+    }
+    if (size < m->size) {
+        memset(m->data + size, 0, m->size - size);
+    }
+    m->size = size;
+} /* model_truncate */
+
+static void
+model_verify(
+    struct posix_test_env *env,
+    struct model          *m,
+    const char            *phase)
+{
+    static uint8_t buf[MODEL_BYTES + 1];
+    struct stat    st;
+    ssize_t        rc;
+    int            fd;
+
+    if (chimera_posix_stat(m->path, &st) != 0 || (uint64_t) st.st_size != m->size) {
+        fprintf(stderr, "%s: %s size %lld, want %" PRIu64 "\n", phase, m->path,
+                (long long) st.st_size, m->size);
+        posix_test_fail(env);
+    }
+
+    fd = chimera_posix_open(m->path, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "open %s failed: %s\n", m->path, strerror(errno));
+        posix_test_fail(env);
+    }
+
+    /* One read past EOF: it must stop at the size. */
+    rc = chimera_posix_pread(fd, buf, sizeof(buf), 0);
+    if (rc != (ssize_t) m->size || memcmp(buf, m->data, m->size) != 0) {
+        fprintf(stderr, "%s: %s reads back wrong (rc=%zd, size %" PRIu64 ")\n",
+                phase, m->path, rc, m->size);
+        posix_test_fail(env);
+    }
+
+    /* And one unaligned read from the middle. */
+    if (m->size > 10) {
+        rc = chimera_posix_pread(fd, buf, 7, (off_t) (m->size / 2 - 3));
+        if (rc != 7 || memcmp(buf, m->data + m->size / 2 - 3, 7) != 0) {
+            fprintf(stderr, "%s: %s mid-file read wrong (rc=%zd)\n", phase,
+                    m->path, rc);
+            posix_test_fail(env);
+        }
+    }
+
+    chimera_posix_close(fd);
+} /* model_verify */
+
+/* Cold remount on the same device images. */
+static void
+remount(struct posix_test_env *env)
+{
+    char                       diskfs_cfg[4096];
+    char                       posix_json_path[300];
+    json_t                    *root, *config, *vfs, *vfs_entry;
+    struct prometheus_metrics *metrics2;
+    int                        rc;
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+
+    chimera_posix_shutdown();
+
+    posix_test_diskfs_reuse_devices = 1;
+    posix_test_configure_diskfs(env->session_dir,
+                                posix_test_diskfs_device_type(env->backend),
+                                diskfs_cfg, sizeof(diskfs_cfg));
+
+    root      = json_object();
+    config    = json_object();
+    vfs       = json_object();
+    vfs_entry = json_object();
+    json_object_set_new(vfs_entry, "path", json_string("/build/test/diskfs"));
+    json_object_set_new(vfs_entry, "config", json_string(diskfs_cfg));
+    json_object_set_new(vfs, "diskfs", vfs_entry);
+    json_object_set_new(config, "vfs", vfs);
+    json_object_set_new(root, "config", config);
+    chimera_test_write_users_json(root);
+
+    snprintf(posix_json_path, sizeof(posix_json_path),
+             "%s/posix_remount.json", env->session_dir);
+    json_dump_file(root, posix_json_path, 0);
+    json_decref(root);
+
+    metrics2   = prometheus_metrics_create(NULL, NULL, 0);
+    env->posix = chimera_posix_init_json(posix_json_path, &env->cred, metrics2);
+    if (!env->posix) {
+        fprintf(stderr, "Failed to re-initialize POSIX client\n");
+        posix_test_fail(env);
+    }
+    prometheus_metrics_destroy(env->metrics);
+    env->metrics = metrics2;
+
+    rc = posix_test_mount(env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to re-mount: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+} /* remount */
+
+enum {
+    F_EMPTY,
+    F_ONE,
+    F_LIMIT,
+    F_PAST,
+    F_APPEND,
+    F_HOLE,
+    F_FAR,
+    F_SHRINK,
+    F_GROW,
+    F_REWRITE,
+    NUM_FILES
+};
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    struct posix_test_env env;
+    static struct model   m[NUM_FILES];
+    uint64_t              off;
+    int                   rc, i;
+
+    posix_test_init(&env, argv, argc);
+    ChimeraLogLevel = CHIMERA_LOG_INFO;
+
+    if (!posix_test_is_diskfs(env.backend)) {
+        fprintf(stderr, "diskfs-only test, nothing to do for %s\n", env.backend);
+        posix_test_success(&env);
+        return 0;
+    }
+
+    rc = posix_test_mount(&env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to mount test module: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = chimera_posix_mkdir("/test/i", 0755);
+    if (rc != 0) {
+        fprintf(stderr, "mkdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    model_init(&m[F_EMPTY], "empty");
+    model_init(&m[F_ONE], "one");
+    model_init(&m[F_LIMIT], "limit");
+    model_init(&m[F_PAST], "past");
+    model_init(&m[F_APPEND], "append");
+    model_init(&m[F_HOLE], "hole");
+    model_init(&m[F_FAR], "far");
+    model_init(&m[F_SHRINK], "shrink");
+    model_init(&m[F_GROW], "grow");
+    model_init(&m[F_REWRITE], "rewrite");
+
+    /* Sizes around the limit, each in one write. */
+    {
+        int fd = chimera_posix_open(m[F_EMPTY].path, O_CREAT | O_RDWR, 0644);
+
+        if (fd < 0) {
+            fprintf(stderr, "create empty failed: %s\n", strerror(errno));
+            posix_test_fail(&env);
+        }
+        chimera_posix_close(fd);
+    }
+    model_write(&env, &m[F_ONE], 0, 1, 1);
+    model_write(&env, &m[F_LIMIT], 0, INLINE_MAX, 1);
+    model_write(&env, &m[F_PAST], 0, INLINE_MAX + 1, 1);
+
+    /* Small appends that cross the limit partway through a write. */
+    for (off = 0; off < 3 * INLINE_MAX; off += 1000) {
+        model_write(&env, &m[F_APPEND], off, 1000, 2);
+    }
+
+    /* Inline data behind a hole, then filling the hole. */
+    model_write(&env, &m[F_HOLE], 2000, 500, 3);
+    model_verify(&env, &m[F_HOLE], "hole (sparse inline)");
+    model_write(&env, &m[F_HOLE], 100, 50, 4);
+
+    /* A write far past an inline EOF converts with a hole between. */
+    model_write(&env, &m[F_FAR], 0, 100, 5);
+    model_write(&env, &m[F_FAR], 40000, 4096, 6);
+
+    /* An extent file cut back below the limit, then written again. */
+    model_write(&env, &m[F_SHRINK], 0, 20000, 7);
+    model_truncate(&env, &m[F_SHRINK], 1000);
+    model_verify(&env, &m[F_SHRINK], "shrink (truncated)");
+    model_write(&env, &m[F_SHRINK], 900, 300, 8);
+
+    /* An inline file extended by truncate, inside and past the limit. */
+    model_write(&env, &m[F_GROW], 0, 300, 9);
+    model_truncate(&env, &m[F_GROW], 2500);
+    model_verify(&env, &m[F_GROW], "grow (inside the limit)");
+    model_truncate(&env, &m[F_GROW], 10000);
+    model_write(&env, &m[F_GROW], 9990, 10, 10);
+
+    /* Overwrites in place, at the start, middle and the last inline byte. */
+    model_write(&env, &m[F_REWRITE], 0, 2048, 11);
+    model_write(&env, &m[F_REWRITE], 0, 10, 12);
+    model_write(&env, &m[F_REWRITE], 1000, 33, 13);
+    model_write(&env, &m[F_REWRITE], INLINE_MAX - 1, 1, 14);
+
+    for (i = 0; i < NUM_FILES; i++) {
+        model_verify(&env, &m[i], "after edits");
+    }
+
+    fprintf(stderr, "cold remount...\n");
+    remount(&env);
+
+    for (i = 0; i < NUM_FILES; i++) {
+        model_verify(&env, &m[i], "after remount");
+    }
+
+    for (i = 0; i < NUM_FILES; i++) {
+        if (chimera_posix_unlink(m[i].path) != 0) {
+            fprintf(stderr, "unlink %s failed: %s\n", m[i].path, strerror(errno));
+            posix_test_fail(&env);
+        }
+    }
+    if (chimera_posix_rmdir("/test/i") != 0) {
+        fprintf(stderr, "rmdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    posix_test_success(&env);
+    return 0;
+} /* main */
@@ -0,0 +1,408 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * diskfs intent-log replay test for delta redo records.
+ *
+ * Small files are created and the pool is left to settle, so every inode and
+ * directory block is clean at home.  Two further rounds of small changes
+ * (chmod, a few inline bytes, renames, an inline shrink), each followed by a
+ * settle, are then logged as byte-range deltas against those home images.
+ * The device images are copied while the pool is still mounted (its
+ * superblock is not CLEAN) and put back after the unmount, so the next mount
+ * runs crash recovery over the whole log: the full images from the create
+ * round and both rounds of deltas on top of them, in order.  Every file must
+ * come back with the last round's state -- a delta applied to the wrong base,
+ * or skipped when it should apply, leaves an earlier mode, name or content.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <inttypes.h>
+
+#include "common/platform.h"
+
+#include "posix_test_common.h"
+
+#define REDO_FILES      64
+#define REDO_FILE_BYTES 200
+#define REDO_SHORT      100
+#define REDO_DEVICES    10
+
+static mode_t
+mode_b(int i)
+{
+    return 0400 | (i & 0177);
+} /* mode_b */
+
+static mode_t
+mode_c(int i)
+{
+    return 0700 | (i & 077);
+} /* mode_c */
+
+/* Renamed files live under their round-B name. */
+static void
+file_path(
+    char  *path,
+    size_t size,
+    int    i,
+    int    renamed)
+{
+    if (renamed && i % 4 == 0) {
+        snprintf(path, size, "/test/r/n%03d", i);
+    } else {
+        snprintf(path, size, "/test/r/f%03d", i);
+    }
+} /* file_path */
+
+/* The content file i should hold after `round` (0 = created, 1 = B, 2 = C). */
+static size_t
+expected_content(
+    uint8_t *buf,
+    int      i,
+    int      round)
+{
+    size_t len = REDO_FILE_BYTES;
+
+    memset(buf, 'a' + (i % 26), REDO_FILE_BYTES);
+    if (round >= 1) {
+        snprintf((char *) buf + 16, 9, "B%07d", i);
+        buf[24] = 'b';
+    }
+    if (round >= 2) {
+        snprintf((char *) buf + 32, 9, "C%07d", i);
+        buf[40] = 'c';
+        if (i % 2) {
+            len = REDO_SHORT;
+        }
+    }
+    return len;
+} /* expected_content */
+
+static void
+settle(void)
+{
+    /* Let the tail-pusher write every logged block home and the AG
+     * checkpoints it kicks finish, so the next round logs deltas and no
+     * device write is in flight when the images are copied. */
+    sleep(3);
+} /* settle */
+
+static void
+copy_image(
+    struct posix_test_env *env,
+    const char            *src,
+    const char            *dst)
+{
+    static char buf[1024 * 1024];
+    struct stat st;
+    off_t       data, hole, off;
+    ssize_t     n, len;
+    int         sfd, dfd;
+
+    sfd = open(src, O_RDONLY);
+    dfd = open(dst, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (sfd < 0 || dfd < 0 || fstat(sfd, &st) != 0 ||
+        ftruncate(dfd, st.st_size) != 0) {
+        fprintf(stderr, "copy %s -> %s failed: %s\n", src, dst, strerror(errno));
+        posix_test_fail(env);
+    }
+
+    /* The images are sparse: copy only the allocated ranges. */
+    for (data = lseek(sfd, 0, SEEK_DATA); data >= 0 && data < st.st_size;
+         data = lseek(sfd, hole, SEEK_DATA)) {
+        hole = lseek(sfd, data, SEEK_HOLE);
+        for (off = data; off < hole; off += n) {
+            len = hole - off < (off_t) sizeof(buf) ? hole - off : (ssize_t) sizeof(buf);
+            n   = pread(sfd, buf, len, off);
+            if (n <= 0 || pwrite(dfd, buf, n, off) != n) {
+                fprintf(stderr, "copy %s -> %s failed at %lld: %s\n",
+                        src, dst, (long long) off, strerror(errno));
+                posix_test_fail(env);
+            }
+        }
+    }
+
+    close(sfd);
+    close(dfd);
+} /* copy_image */
+
+static void
+snapshot_devices(
+    struct posix_test_env *env,
+    int                    restore)
+{
+    char dev[300], snap[320];
+    int  i;
+
+    for (i = 0; i < REDO_DEVICES; i++) {
+        snprintf(dev, sizeof(dev), "%s/device-%d.img", env->session_dir, i);
+        snprintf(snap, sizeof(snap), "%s.crash", dev);
+        if (!restore) {
+            copy_image(env, dev, snap);
+        } else if (rename(snap, dev) != 0) {
+            fprintf(stderr, "restore %s failed: %s\n", dev, strerror(errno));
+            posix_test_fail(env);
+        }
+    }
+} /* snapshot_devices */
+
+/* Unmount, put the crash images back and mount them again. */
+static void
+crash_remount(struct posix_test_env *env)
+{
+    char                       diskfs_cfg[4096];
+    char                       posix_json_path[300];
+    json_t                    *root, *config, *vfs, *vfs_entry;
+    struct prometheus_metrics *metrics2;
+    int                        rc;
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+
+    chimera_posix_shutdown();
+
+    snapshot_devices(env, 1);
+
+    posix_test_diskfs_reuse_devices = 1;
+    posix_test_configure_diskfs(env->session_dir,
+                                posix_test_diskfs_device_type(env->backend),
+                                diskfs_cfg, sizeof(diskfs_cfg));
+
+    root      = json_object();
+    config    = json_object();
+    vfs       = json_object();
+    vfs_entry = json_object();
+    json_object_set_new(vfs_entry, "path", json_string("/build/test/diskfs"));
+    json_object_set_new(vfs_entry, "config", json_string(diskfs_cfg));
+    json_object_set_new(vfs, "diskfs", vfs_entry);
+    json_object_set_new(config, "vfs", vfs);
+    json_object_set_new(root, "config", config);
+    chimera_test_write_users_json(root);
+
+    snprintf(posix_json_path, sizeof(posix_json_path),
+             "%s/posix_remount.json", env->session_dir);
+    json_dump_file(root, posix_json_path, 0);
+    json_decref(root);
+
+    metrics2   = prometheus_metrics_create(NULL, NULL, 0);
+    env->posix = chimera_posix_init_json(posix_json_path, &env->cred, metrics2);
+    if (!env->posix) {
+        fprintf(stderr, "Failed to re-initialize POSIX client\n");
+        posix_test_fail(env);
+    }
+    prometheus_metrics_destroy(env->metrics);
+    env->metrics = metrics2;
+
+    rc = posix_test_mount(env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to re-mount: %s\n", strerror(errno));
+        posix_test_fail(env);
+    }
+} /* crash_remount */
+
+static void
+pwrite_at(
+    struct posix_test_env *env,
+    const char            *path,
+    const uint8_t         *buf,
+    size_t                 len,
+    off_t                  off)
+{
+    int fd = chimera_posix_open(path, O_RDWR, 0);
+
+    if (fd < 0 || chimera_posix_pwrite(fd, buf, len, off) != (ssize_t) len) {
+        fprintf(stderr, "write %s failed: %s\n", path, strerror(errno));
+        posix_test_fail(env);
+    }
+    chimera_posix_close(fd);
+} /* pwrite_at */
+
+static void
+round_b(struct posix_test_env *env)
+{
+    uint8_t buf[REDO_FILE_BYTES];
+    char    path[128], newpath[128];
+    int     i;
+
+    for (i = 0; i < REDO_FILES; i++) {
+        file_path(path, sizeof(path), i, 0);
+        expected_content(buf, i, 1);
+        pwrite_at(env, path, buf + 16, 9, 16);
+        if (chimera_posix_chmod(path, mode_b(i)) != 0) {
+            fprintf(stderr, "chmod %s failed: %s\n", path, strerror(errno));
+            posix_test_fail(env);
+        }
+        file_path(newpath, sizeof(newpath), i, 1);
+        if (strcmp(path, newpath) != 0 &&
+            chimera_posix_rename(path, newpath) != 0) {
+            fprintf(stderr, "rename %s failed: %s\n", path, strerror(errno));
+            posix_test_fail(env);
+        }
+    }
+} /* round_b */
+
+static void
+round_c(struct posix_test_env *env)
+{
+    uint8_t buf[REDO_FILE_BYTES];
+    char    path[128];
+    int     i;
+
+    for (i = 0; i < REDO_FILES; i++) {
+        file_path(path, sizeof(path), i, 1);
+        expected_content(buf, i, 2);
+        /* Round B dropped the owner write bit: restore it before writing. */
+        if (chimera_posix_chmod(path, mode_c(i)) != 0) {
+            fprintf(stderr, "chmod %s failed: %s\n", path, strerror(errno));
+            posix_test_fail(env);
+        }
+        pwrite_at(env, path, buf + 32, 9, 32);
+        if (i % 2 && chimera_posix_truncate(path, REDO_SHORT) != 0) {
+            fprintf(stderr, "truncate %s failed: %s\n", path, strerror(errno));
+            posix_test_fail(env);
+        }
+    }
+} /* round_c */
+
+static void
+verify_files(struct posix_test_env *env)
+{
+    uint8_t     want[REDO_FILE_BYTES], got[REDO_FILE_BYTES + 1];
+    char        path[128], oldpath[128];
+    struct stat st;
+    size_t      len;
+    ssize_t     n;
+    int         i, fd;
+
+    for (i = 0; i < REDO_FILES; i++) {
+        file_path(path, sizeof(path), i, 1);
+        file_path(oldpath, sizeof(oldpath), i, 0);
+        len = expected_content(want, i, 2);
+
+        if (chimera_posix_stat(path, &st) != 0) {
+            fprintf(stderr, "stat %s failed after replay: %s\n", path,
+                    strerror(errno));
+            posix_test_fail(env);
+        }
+        if ((st.st_mode & 07777) != mode_c(i) || (size_t) st.st_size != len) {
+            fprintf(stderr, "%s after replay: mode %o size %lld, want %o %zu\n",
+                    path, st.st_mode & 07777, (long long) st.st_size,
+                    mode_c(i), len);
+            posix_test_fail(env);
+        }
+        if (strcmp(path, oldpath) != 0 &&
+            chimera_posix_stat(oldpath, &st) == 0) {
+            fprintf(stderr, "%s still exists after replay\n", oldpath);
+            posix_test_fail(env);
+        }
+
+        fd = chimera_posix_open(path, O_RDONLY, 0);
+        if (fd < 0) {
+            fprintf(stderr, "open %s failed after replay: %s\n", path,
+                    strerror(errno));
+            posix_test_fail(env);
+        }
+        n = chimera_posix_pread(fd, got, sizeof(got), 0);
+        if (n != (ssize_t) len || memcmp(want, got, len) != 0) {
+            fprintf(stderr, "%s reads back wrong after replay (n=%zd)\n",
+                    path, n);
+            posix_test_fail(env);
+        }
+        chimera_posix_close(fd);
+    }
+} /* verify_files */
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    struct posix_test_env env;
+    uint8_t               buf[REDO_FILE_BYTES];
+    char                  path[128];
+    int                   rc, i, fd;
+
+    /* Nothing may write after the last settle: no atime, no deferred
+     * mtime. */
+    posix_test_diskfs_extra_cfg =
+        "{\"redo_delta\":true,\"noatime\":true,\"mtime_defer_ms\":0}";
+
+    posix_test_init(&env, argv, argc);
+    ChimeraLogLevel = CHIMERA_LOG_INFO;
+
+    if (!posix_test_is_diskfs(env.backend)) {
+        fprintf(stderr, "diskfs-only test, nothing to do for %s\n", env.backend);
+        posix_test_success(&env);
+        return 0;
+    }
+
+    rc = posix_test_mount(&env);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to mount test module: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = chimera_posix_mkdir("/test/r", 0755);
+    if (rc != 0) {
+        fprintf(stderr, "mkdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    fprintf(stderr, "create %d inline files...\n", REDO_FILES);
+    for (i = 0; i < REDO_FILES; i++) {
+        file_path(path, sizeof(path), i, 0);
+        expected_content(buf, i, 0);
+        fd = chimera_posix_open(path, O_CREAT | O_RDWR, 0600);
+        if (fd < 0 ||
+            chimera_posix_write(fd, buf, REDO_FILE_BYTES) != REDO_FILE_BYTES) {
+            fprintf(stderr, "create %s failed: %s\n", path, strerror(errno));
+            posix_test_fail(&env);
+        }
+        chimera_posix_close(fd);
+    }
+    settle();
+
+    fprintf(stderr, "round B: chmod, inline bytes, renames...\n");
+    round_b(&env);
+    settle();
+
+    fprintf(stderr, "round C: chmod, inline bytes, inline shrink...\n");
+    round_c(&env);
+    settle();
+
+    /* Still mounted: the copied superblock is not CLEAN. */
+    fprintf(stderr, "copy crash images...\n");
+    snapshot_devices(&env, 0);
+
+    fprintf(stderr, "remount the crash images (replay)...\n");
+    crash_remount(&env);
+    verify_files(&env);
+
+    /* The recovered pool takes new work. */
+    for (i = 0; i < REDO_FILES; i++) {
+        file_path(path, sizeof(path), i, 1);
+        if (chimera_posix_unlink(path) != 0) {
+            fprintf(stderr, "unlink %s failed: %s\n", path, strerror(errno));
+            posix_test_fail(&env);
+        }
+    }
+    if (chimera_posix_rmdir("/test/r") != 0) {
+        fprintf(stderr, "rmdir failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    rc = posix_test_umount();
+    if (rc != 0) {
+        fprintf(stderr, "umount failed: %s\n", strerror(errno));
+        posix_test_fail(&env);
+    }
+
+    posix_test_success(&env);
+    return 0;
+} /* main */
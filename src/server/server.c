@@ -75,6 +75,8 @@ struct chimera_server_config {
     int                                   cache_ttl;
     int                                   attr_cache_enabled;
     int                                   umount_timeout_ms;
+    uint64_t                              data_cache_size;
+    uint64_t                              write_behind_size;
     int                                   name_cache_enabled;
     int                                   rcu_reclaim_threads;
     int                                   nfs4_session_slots;
@@ -332,6 +334,12 @@ chimera_server_config_init(void)
     config->attr_cache_enabled = 1;
     config->umount_timeout_ms  = CHIMERA_COMMON_UMOUNT_TIMEOUT_MS_DEFAULT;
 
+    /* The VFS data cache is off by default (common.data_cache_size). */
+    config->data_cache_size = 0;
+
+    /* UNSTABLE write-behind is off by default (server.write_behind_size). */
+    config->write_behind_size = 0;
+
     /* The VFS name (lookup) cache is on by default (common.name_cache). */
     config->name_cache_enabled = 1;
 
@@ -727,6 +735,22 @@ chimera_server_config_set_umount_timeout(
     config->umount_timeout_ms = timeout_ms;
 } /* chimera_server_config_set_umount_timeout */
 
+SYMBOL_EXPORT void
+chimera_server_config_set_data_cache_size(
+    struct chimera_server_config *config,
+    uint64_t                      size)
+{
+    config->data_cache_size = size;
+} /* chimera_server_config_set_data_cache_size */
+
+SYMBOL_EXPORT void
+chimera_server_config_set_write_behind_size(
+    struct chimera_server_config *config,
+    uint64_t                      size)
+{
+    config->write_behind_size = size;
+} /* chimera_server_config_set_write_behind_size */
+
 SYMBOL_EXPORT void
 chimera_server_config_set_attr_cache_enabled(
     struct chimera_server_config *config,
@@ -2664,6 +2688,10 @@ chimera_server_init(
      * chimera_vfs_remove_at).  When none are enabled the lookup is skipped. */
     chimera_vfs_set_umount_timeout(server->vfs, config->umount_timeout_ms);
 
+    chimera_vfs_set_data_cache_size(server->vfs, config->data_cache_size);
+
+    chimera_vfs_set_write_behind_size(server->vfs, config->write_behind_size);
+
     chimera_vfs_set_caching_enabled(server->vfs,
                                     config->nfs4_delegations ||
                                     config->smb_leases ||
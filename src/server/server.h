@@ -226,6 +226,19 @@ chimera_server_config_set_umount_timeout(
     struct chimera_server_config *config,
     int                           timeout_ms);
 
+/* Size of the shared VFS file data cache in bytes; 0 disables it. */
+void
+chimera_server_config_set_data_cache_size(
+    struct chimera_server_config *config,
+    uint64_t                      size);
+
+/* Size of the VFS write-behind buffer for UNSTABLE writes in bytes; 0
+ * disables it. */
+void
+chimera_server_config_set_write_behind_size(
+    struct chimera_server_config *config,
+    uint64_t                      size);
+
 void
 chimera_server_config_set_attr_cache_enabled(
     struct chimera_server_config *config,
@@ -54,10 +54,18 @@ void rocksdb_flush_wal(
 /*
  * Storage layout:
  *   metadb at <path>/meta : inode/dirent/symlink/super/kv keys. WriteBatchWithIndex,
- *                          committed with sync=true so metadata ops are durable on reply.
+ *                          synced before reply so metadata ops are durable on reply
+ *                          (per commit, or one WAL fsync per group under group_commit).
  *   datadb at <path>/data : extent keys. WriteBatchWithIndex, sync flag selected per batch
  *                          (sync iff any pending op requested durable data).
  *
+ * Extent values at or above blob_min_size are written by datadb's flush into
+ * append-only blob files (RocksDB integrated BlobDB) and only a blob index
+ * lands in the SSTs, so compaction rewrites pointers rather than file bytes.
+ * Blob GC relocates live blobs out of the oldest files as compaction passes
+ * over them, and forces that compaction once their garbage ratio crosses
+ * blob_gc_ratio.
+ *
  * Multi-DB ordering invariant: when a thread commits a cycle's batches, the data batch
  * is written first and the metadata batch second.  This ensures that a recovered metadb
  * never claims a file size that points at extent data still missing from datadb.
@@ -65,13 +73,29 @@ void rocksdb_flush_wal(
 #define CAIRN_INODE_LOCK_STRIPES 1024
 
 /*
- * Upper bound on requests batched into a single commit.  Natural batching
+ * Bounds on requests batched into a single commit.  Natural batching
  * already happens because a delegation thread is blocked in rocksdb_write
- * while its inbox fills up; this cap is purely to bound tail latency when
+ * while its inbox fills up; the cap is purely to bound tail latency when
  * load is high and commits are slow — the inbox could otherwise accumulate
- * far more requests than any single op would tolerate waiting on.
+ * far more requests than any single op would tolerate waiting on.  Each
+ * thread's cap starts at CAIRN_BATCH_MAX_OPS and adapts (see
+ * cairn_batch_adapt) up to CAIRN_BATCH_MAX_OPS_CEIL.
  */
 #define CAIRN_BATCH_MAX_OPS      16
+#define CAIRN_BATCH_MAX_OPS_CEIL 256
+
+/*
+ * Most inode keys resolved by one MultiGet: a readdir page's worth of child
+ * inodes, or the components of a path walk.  Also bounds the on-stack key and
+ * dirent arrays those callers keep.
+ */
+#define CAIRN_MULTI_GET_MAX      64
+
+/* datadb blob-file defaults; see the storage layout note above. */
+#define CAIRN_BLOB_MIN_SIZE      4096
+#define CAIRN_BLOB_FILE_MB       256
+#define CAIRN_BLOB_GC_AGE        0.25
+#define CAIRN_BLOB_GC_RATIO      0.5
 
 #define chimera_cairn_debug(...) chimera_debug("cairn", \
                                                __FILE__, \
@@ -245,11 +269,15 @@ struct cairn_shared {
     rocksdb_optimistictransactiondb_t       *meta_otxn_db;
     rocksdb_t                               *meta_base_db;
     rocksdb_t                               *datadb;
+#ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET
+    rocksdb_column_family_handle_t          *meta_default_cf;
+#endif /* ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET */
     rocksdb_cache_t                         *meta_cache;
     rocksdb_cache_t                         *data_cache;
     rocksdb_options_t                       *meta_options;
     rocksdb_options_t                       *data_options;
     rocksdb_writeoptions_t                  *meta_write_opts;       /* sync=1 */
+    rocksdb_writeoptions_t                  *meta_write_opts_group; /* sync=0 */
     rocksdb_writeoptions_t                  *data_write_opts_async; /* sync=0 */
     rocksdb_writeoptions_t                  *data_write_opts_sync;  /* sync=1 */
     rocksdb_readoptions_t                   *read_options;
@@ -278,6 +306,37 @@ struct cairn_shared {
     pthread_mutex_t                          multi_inode_lock;
     pthread_mutex_t                          inode_mutexes[CAIRN_INODE_LOCK_STRIPES];
     int                                      noatime;
+    /*
+     * Cross-thread group commit (cairn_group_sync).  With group_commit set,
+     * metadata transactions commit to the WAL unsynced and each committer
+     * takes a ticket; one thread at a time fsyncs the metadb WAL on behalf
+     * of every ticket issued before it started, the rest wait on gc_cond.
+     * sync_ns is an EWMA of metadb durability latency (the group fsync, or
+     * the synced commit without group commit) used to size batches.
+     * meta_poisoned is set for good once a group sync fails (see
+     * cairn_group_sync); from then on cairn_dispatch rejects every mutation.
+     */
+    int                                      group_commit;
+    int                                      meta_poisoned;
+    pthread_mutex_t                          gc_lock;
+    pthread_cond_t                           gc_cond;
+    uint64_t                                 gc_written;
+    uint64_t                                 gc_synced;
+    int                                      gc_syncing;
+    uint64_t                                 sync_ns;
+    struct prometheus_metrics               *metrics;
+    struct prometheus_histogram             *commit_latency;
+    struct prometheus_histogram_series      *commit_latency_series;
+    struct prometheus_histogram             *commit_ops;
+    struct prometheus_histogram_series      *commit_ops_series;
+    struct prometheus_histogram             *group_sync_commits;
+    struct prometheus_histogram_series      *group_sync_commits_series;
+};
+
+struct cairn_thread_metrics {
+    struct prometheus_histogram_instance *commit_latency;
+    struct prometheus_histogram_instance *commit_ops;
+    struct prometheus_histogram_instance *group_sync_commits;
 };
 
 struct cairn_thread {
@@ -307,12 +366,16 @@ struct cairn_thread {
      * forgot to schedule the deferral those requests would hang forever. */
     int                          commit_scheduled;
     /* Set while cairn_thread_commit is running (including during replay).
-     * Suppresses the CAIRN_BATCH_MAX_OPS force-commit in cairn_dispatch so
+     * Suppresses the batch_max force-commit in cairn_dispatch so
      * a replay can't recurse into cairn_thread_commit. */
     int                          in_commit;
     /* Count of requests queued into txn_requests since the last commit.
-     * Used to bound batch size via CAIRN_BATCH_MAX_OPS. */
+     * cairn_dispatch force-commits once it reaches batch_max, this thread's
+     * adaptive cap; batch_start times how long the batch took to fill. */
     int                          request_count;
+    int                          batch_max;
+    struct prometheus_stopwatch  batch_start;
+    struct cairn_thread_metrics  metrics;
     /*
      * Read view for the currently-executing read-only op.  When non-NULL,
      * metadata/extent reads hit the committed base DB at a consistent
@@ -685,6 +748,61 @@ cairn_inode_get_inum(
     return 0;
 } /* cairn_inode_get_inum */
 
+/*
+ * Resolve n inodes at once.  Reader ops go through one batched MultiGet on
+ * the pinned snapshot (one superversion/snapshot acquisition, sorted block
+ * lookups and shared filter probes) instead of n point gets.  Writer ops
+ * keep per-key gets through meta_txn so they still see their own pending
+ * writes.  A missing inode leaves ihs[i].inode NULL; the caller releases
+ * every present handle.
+ */
+static inline void
+cairn_inode_get_inums(
+    struct cairn_thread       *thread,
+    int                        n,
+    const uint64_t            *inums,
+    struct cairn_inode_handle *ihs)
+{
+    int i;
+
+#ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET
+    if (thread->read_meta_opts && n > 1) {
+        struct cairn_shared     *shared = thread->shared;
+        struct cairn_inode_key   keys[CAIRN_MULTI_GET_MAX];
+        const char              *key_ptrs[CAIRN_MULTI_GET_MAX];
+        size_t                   key_lens[CAIRN_MULTI_GET_MAX];
+        rocksdb_pinnableslice_t *slices[CAIRN_MULTI_GET_MAX];
+        char                    *errs[CAIRN_MULTI_GET_MAX];
+        size_t                   len;
+
+        for (i = 0; i < n; i++) {
+            keys[i].keytype = CAIRN_KEY_INODE;
+            keys[i].inum    = inums[i];
+            key_ptrs[i]     = (const char *) &keys[i];
+            key_lens[i]     = sizeof(keys[i]);
+        }
+
+        rocksdb_batched_multi_get_cf(shared->meta_base_db, thread->read_meta_opts,
+                                     shared->meta_default_cf, n, key_ptrs, key_lens,
+                                     slices, errs, 0);
+
+        for (i = 0; i < n; i++) {
+            chimera_cairn_abort_if(errs[i], "Error getting inode: %s\n", errs[i]);
+
+            ihs[i].slice = slices[i];
+            ihs[i].inode = slices[i]
+                ? (struct cairn_inode *) rocksdb_pinnableslice_value(slices[i], &len)
+                : NULL;
+        }
+        return;
+    }
+#endif /* ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET */
+
+    for (i = 0; i < n; i++) {
+        cairn_inode_get_inum(thread, inums[i], &ihs[i]);
+    }
+} /* cairn_inode_get_inums */
+
 static inline int
 cairn_inode_get_fh(
     struct cairn_thread       *thread,
@@ -1075,7 +1193,6 @@ cairn_init(
     const char                *cfgdata,
     struct prometheus_metrics *metrics)
 {
-    (void) metrics;
     struct cairn_shared *shared = calloc(1, sizeof(*shared));
     json_t              *cfg;
     json_error_t         json_error;
@@ -1088,6 +1205,11 @@ cairn_init(
     int                  compression  = 1; // Default to enabled
     int                  bloom_filter = 1; // Default to enabled
     int                  statistics   = 0; // Opt-in for diagnostics
+    int                  blob_files   = 1;
+    size_t               blob_min     = CAIRN_BLOB_MIN_SIZE;
+    size_t               blob_file_mb = CAIRN_BLOB_FILE_MB;
+    double               blob_gc_age  = CAIRN_BLOB_GC_AGE;
+    double               blob_gc      = CAIRN_BLOB_GC_RATIO;
     int                  i;
 
     cfg = json_loads(cfgdata, 0, &json_error);
@@ -1122,6 +1244,37 @@ cairn_init(
         statistics = json_boolean_value(statistics_obj);
     }
 
+    json_t *blob_files_obj = json_object_get(cfg, "blob_files");
+    if (blob_files_obj && json_is_boolean(blob_files_obj)) {
+        blob_files = json_boolean_value(blob_files_obj);
+    }
+
+    json_t *blob_min_obj = json_object_get(cfg, "blob_min_size");
+    if (blob_min_obj && json_is_integer(blob_min_obj) &&
+        json_integer_value(blob_min_obj) >= 0) {
+        blob_min = json_integer_value(blob_min_obj);
+    }
+
+    json_t *blob_file_obj = json_object_get(cfg, "blob_file_size");
+    if (blob_file_obj && json_is_integer(blob_file_obj) &&
+        json_integer_value(blob_file_obj) > 0) {
+        blob_file_mb = json_integer_value(blob_file_obj);
+    }
+
+    json_t *blob_gc_age_obj = json_object_get(cfg, "blob_gc_age");
+    if (blob_gc_age_obj && json_is_number(blob_gc_age_obj) &&
+        json_number_value(blob_gc_age_obj) >= 0.0 &&
+        json_number_value(blob_gc_age_obj) <= 1.0) {
+        blob_gc_age = json_number_value(blob_gc_age_obj);
+    }
+
+    json_t *blob_gc_obj = json_object_get(cfg, "blob_gc_ratio");
+    if (blob_gc_obj && json_is_number(blob_gc_obj) &&
+        json_number_value(blob_gc_obj) >= 0.0 &&
+        json_number_value(blob_gc_obj) <= 1.0) {
+        blob_gc = json_number_value(blob_gc_obj);
+    }
+
     // Get noatime setting from config
     json_t *noatime_obj = json_object_get(cfg, "noatime");
     if (noatime_obj && json_is_boolean(noatime_obj)) {
@@ -1130,11 +1283,42 @@ cairn_init(
         shared->noatime = 0; // Default to false
     }
 
+    json_t *group_commit_obj = json_object_get(cfg, "group_commit");
+    if (group_commit_obj && json_is_boolean(group_commit_obj)) {
+        shared->group_commit = json_boolean_value(group_commit_obj);
+    } else {
+        shared->group_commit = 1;
+    }
+
+#ifndef CHIMERA_HAVE_ROCKSDB_FLUSH_WAL
+    /* Group commit syncs the metadb WAL with rocksdb_flush_wal. */
+    shared->group_commit = 0;
+#endif /* ifndef CHIMERA_HAVE_ROCKSDB_FLUSH_WAL */
+
     pthread_mutex_init(&shared->lock, NULL);
     pthread_mutex_init(&shared->multi_inode_lock, NULL);
     for (i = 0; i < CAIRN_INODE_LOCK_STRIPES; i++) {
         pthread_mutex_init(&shared->inode_mutexes[i], NULL);
     }
+    pthread_mutex_init(&shared->gc_lock, NULL);
+    pthread_cond_init(&shared->gc_cond, NULL);
+
+    if (metrics) {
+        shared->metrics        = metrics;
+        shared->commit_latency = prometheus_metrics_create_histogram_time(
+            metrics, "chimera_cairn_commit_latency_nanoseconds",
+            "Cairn commit cycle latency in nanoseconds, including the metadb sync", 34);
+        shared->commit_ops = prometheus_metrics_create_histogram_exponential(
+            metrics, "chimera_cairn_commit_ops",
+            "Cairn requests committed per commit cycle", 16);
+        shared->group_sync_commits = prometheus_metrics_create_histogram_exponential(
+            metrics, "chimera_cairn_group_sync_commits",
+            "Cairn commit cycles made durable by one metadb WAL sync", 16);
+        shared->commit_latency_series     = prometheus_histogram_create_series(shared->commit_latency, NULL, NULL, 0);
+        shared->commit_ops_series         = prometheus_histogram_create_series(shared->commit_ops, NULL, NULL, 0);
+        shared->group_sync_commits_series = prometheus_histogram_create_series(shared->group_sync_commits,
+                                                                               NULL, NULL, 0);
+    }
 
     /*
      * Two independent RocksDB instances:
@@ -1202,6 +1386,33 @@ cairn_init(
     rocksdb_block_based_options_set_block_size(shared->data_table_options, 64 * 1024);
     rocksdb_options_set_block_based_table_factory(shared->data_options, shared->data_table_options);
 
+#ifdef CHIMERA_HAVE_ROCKSDB_BLOB_FILES
+    /* Key-value separation: large extents go to blob files at flush, so
+     * compaction only moves blob indexes.  GC is age-driven (blobs in the
+     * oldest blob_gc_age fraction of files are relocated when compaction
+     * touches their SSTs) with a forced compaction of those SSTs once their
+     * blob files are blob_gc_ratio garbage.  A datadb written with this off
+     * stays readable; existing inline extents migrate as they are rewritten. */
+    if (blob_files) {
+        rocksdb_options_set_enable_blob_files(shared->data_options, 1);
+        rocksdb_options_set_min_blob_size(shared->data_options, blob_min);
+        rocksdb_options_set_blob_file_size(shared->data_options, blob_file_mb * 1024 * 1024);
+        rocksdb_options_set_blob_compression_type(shared->data_options,
+                                                  compression ? rocksdb_lz4_compression : rocksdb_no_compression);
+        rocksdb_options_set_enable_blob_gc(shared->data_options, 1);
+        rocksdb_options_set_blob_gc_age_cutoff(shared->data_options, blob_gc_age);
+        rocksdb_options_set_blob_gc_force_threshold(shared->data_options, blob_gc);
+    }
+#else  /* ifdef CHIMERA_HAVE_ROCKSDB_BLOB_FILES */
+    if (blob_files) {
+        chimera_cairn_info("RocksDB lacks blob files; extents stay inline in datadb");
+    }
+    (void) blob_min;
+    (void) blob_file_mb;
+    (void) blob_gc_age;
+    (void) blob_gc;
+#endif /* ifdef CHIMERA_HAVE_ROCKSDB_BLOB_FILES */
+
     initialize = json_boolean_value(json_object_get(cfg, "initialize"));
 
     if (initialize) {
@@ -1216,12 +1427,19 @@ cairn_init(
 
     /* Write options:
      *   meta_write_opts: always sync (metadata durability == POSIX expectation).
+     *   meta_write_opts_group: no sync; metadata transactions under group
+     *     commit, made durable by cairn_group_sync before replies.
      *   data_write_opts_async: no sync (used for NFS UNSTABLE writes).
      *   data_write_opts_sync: sync (used for FILE_SYNC writes or NFS COMMIT).
      */
     shared->meta_write_opts = rocksdb_writeoptions_create();
     rocksdb_writeoptions_set_sync(shared->meta_write_opts, 1);
 
+    /* Metadata transactions under group commit: WAL append only, the
+     * covering fsync is issued by cairn_group_sync before any reply. */
+    shared->meta_write_opts_group = rocksdb_writeoptions_create();
+    rocksdb_writeoptions_set_sync(shared->meta_write_opts_group, 0);
+
     shared->data_write_opts_async = rocksdb_writeoptions_create();
 #ifdef CHIMERA_HAVE_ROCKSDB_FLUSH_WAL
     rocksdb_writeoptions_set_sync(shared->data_write_opts_async, 0);
@@ -1245,6 +1463,10 @@ cairn_init(
 
     shared->meta_base_db = rocksdb_optimistictransactiondb_get_base_db(shared->meta_otxn_db);
 
+#ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET
+    shared->meta_default_cf = rocksdb_get_default_column_family_handle(shared->meta_base_db);
+#endif /* ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET */
+
     shared->datadb = rocksdb_open(shared->data_options, data_path, &err);
     chimera_cairn_abort_if(err, "Failed to open datadb at %s: %s\n", data_path, err);
 
@@ -1340,11 +1562,15 @@ cairn_destroy(void *private_data)
         fs = tmp;
     }
 
+#ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET
+    rocksdb_column_family_handle_destroy(shared->meta_default_cf);
+#endif /* ifdef CHIMERA_HAVE_ROCKSDB_BATCHED_MULTI_GET */
 
     rocksdb_optimistictransactiondb_close_base_db(shared->meta_base_db);
     rocksdb_optimistictransactiondb_close(shared->meta_otxn_db);
     rocksdb_close(shared->datadb);
     rocksdb_writeoptions_destroy(shared->meta_write_opts);
+    rocksdb_writeoptions_destroy(shared->meta_write_opts_group);
     rocksdb_writeoptions_destroy(shared->data_write_opts_async);
     rocksdb_writeoptions_destroy(shared->data_write_opts_sync);
     rocksdb_readoptions_destroy(shared->read_options);
@@ -1360,6 +1586,17 @@ cairn_destroy(void *private_data)
     }
     pthread_mutex_destroy(&shared->multi_inode_lock);
     pthread_mutex_destroy(&shared->lock);
+    pthread_mutex_destroy(&shared->gc_lock);
+    pthread_cond_destroy(&shared->gc_cond);
+
+    if (shared->metrics) {
+        prometheus_histogram_destroy_series(shared->commit_latency, shared->commit_latency_series);
+        prometheus_histogram_destroy_series(shared->commit_ops, shared->commit_ops_series);
+        prometheus_histogram_destroy_series(shared->group_sync_commits, shared->group_sync_commits_series);
+        prometheus_histogram_destroy(shared->metrics, shared->commit_latency);
+        prometheus_histogram_destroy(shared->metrics, shared->commit_ops);
+        prometheus_histogram_destroy(shared->metrics, shared->group_sync_commits);
+    }
     free(shared);
 } /* cairn_destroy */
 
@@ -1395,13 +1632,16 @@ cairn_queue_request(
      * scheduled.  (Read-only ops complete inline and never come here.) */
     cairn_ensure_commit_scheduled(thread);
     DL_APPEND(thread->txn_requests, request);
-    thread->request_count++;
+    if (thread->request_count++ == 0) {
+        prometheus_stopwatch_start(&thread->batch_start);
+    }
 } /* cairn_queue_request */
 
 /*
  * Ordered two-stage commit:
  *   1. datadb batch (sync iff any pending op requested durable data)
- *   2. metadb batch (always sync)
+ *   2. metadb batch (always synced before replies; under group commit the
+ *      sync is one shared WAL fsync, see cairn_group_sync)
  *   3. complete all batched requests
  *
  * Step ordering preserves the invariant that durable metadata never refers to
@@ -1425,11 +1665,129 @@ cairn_meta_txn_begin(
 {
     return rocksdb_optimistictransaction_begin(
         shared->meta_otxn_db,
-        shared->meta_write_opts,
+        shared->group_commit ? shared->meta_write_opts_group : shared->meta_write_opts,
         shared->meta_otxn_opts,
         old);
 } /* cairn_meta_txn_begin */
 
+static inline void
+cairn_sync_ns_update(
+    struct cairn_shared *shared,
+    uint64_t             ns)
+{
+    uint64_t avg = __atomic_load_n(&shared->sync_ns, __ATOMIC_RELAXED);
+
+    /* EWMA, 1/8 weight.  Concurrent updates may drop a sample; harmless. */
+    avg = avg ? avg - (avg >> 3) + (ns >> 3) : ns;
+
+    __atomic_store_n(&shared->sync_ns, avg, __ATOMIC_RELAXED);
+} /* cairn_sync_ns_update */
+
+/*
+ * Make this thread's unsynced metadata commit durable.  Takes a ticket and
+ * waits until a WAL sync that started after the ticket was issued has
+ * completed.  If no sync is running, this thread becomes the leader: it
+ * claims every ticket issued so far and fsyncs the metadb WAL once for all
+ * of them.  Commits that land while a sync is in flight pile up and are
+ * covered by the next one, so the group grows with fsync latency and
+ * cross-thread load without any timer.
+ *
+ * A failed sync poisons the metadb instead of being retried.  The commits
+ * it covered are already visible to every reader, and a second fsync can
+ * report success after the kernel has dropped the pages the first one failed
+ * to write back, so there is no way to make them durable or to take them
+ * back.  Every waiter, present and future, returns at once and the metadb
+ * turns read-only (cairn_dispatch) until a restart recovers from the WAL.
+ */
+static void
+cairn_group_sync(struct cairn_thread *thread)
+{
+#ifdef CHIMERA_HAVE_ROCKSDB_FLUSH_WAL
+    struct cairn_shared        *shared = thread->shared;
+    struct prometheus_stopwatch sw;
+    uint64_t                    ticket, target, group;
+    char                       *err = NULL;
+
+    pthread_mutex_lock(&shared->gc_lock);
+
+    ticket = ++shared->gc_written;
+
+    while (shared->gc_synced < ticket) {
+
+        if (__atomic_load_n(&shared->meta_poisoned, __ATOMIC_RELAXED)) {
+            break;
+        }
+
+        if (shared->gc_syncing) {
+            pthread_cond_wait(&shared->gc_cond, &shared->gc_lock);
+            continue;
+        }
+
+        shared->gc_syncing = 1;
+        target             = shared->gc_written;
+        group              = target - shared->gc_synced;
+
+        pthread_mutex_unlock(&shared->gc_lock);
+
+        prometheus_stopwatch_start(&sw);
+
+        rocksdb_flush_wal(shared->meta_base_db, 1, &err);
+
+        cairn_sync_ns_update(shared, prometheus_stopwatch_elapsed_ns(&sw));
+
+        if (thread->metrics.group_sync_commits) {
+            prometheus_histogram_sample(thread->metrics.group_sync_commits, group);
+        }
+
+        pthread_mutex_lock(&shared->gc_lock);
+
+        shared->gc_syncing = 0;
+
+        if (err) {
+            chimera_cairn_error("Error syncing metadb WAL, metadata is now read-only: %s",
+                                err);
+            free(err);
+            err = NULL;
+            __atomic_store_n(&shared->meta_poisoned, 1, __ATOMIC_RELAXED);
+        } else {
+            shared->gc_synced = target;
+        }
+
+        pthread_cond_broadcast(&shared->gc_cond);
+    }
+
+    pthread_mutex_unlock(&shared->gc_lock);
+#else  /* ifdef CHIMERA_HAVE_ROCKSDB_FLUSH_WAL */
+    /* group_commit is forced off at init; metadata commits are synced. */
+    (void) thread;
+#endif /* ifdef CHIMERA_HAVE_ROCKSDB_FLUSH_WAL */
+} /* cairn_group_sync */
+
+/*
+ * Size this thread's next batch from the one just committed.  A batch that
+ * hit batch_max in less time than a metadb sync takes means requests queue
+ * faster than syncs complete, so the cap doubles and each sync covers more
+ * of them.  A batch committed well short of the cap (the event loop went
+ * idle first) halves it back toward CAIRN_BATCH_MAX_OPS, restoring the
+ * short-queue tail latency once load drops.
+ */
+static inline void
+cairn_batch_adapt(
+    struct cairn_thread *thread,
+    int                  ops,
+    uint64_t             fill_ns)
+{
+    uint64_t sync_ns = __atomic_load_n(&thread->shared->sync_ns, __ATOMIC_RELAXED);
+
+    if (ops >= thread->batch_max) {
+        if (fill_ns < sync_ns && thread->batch_max < CAIRN_BATCH_MAX_OPS_CEIL) {
+            thread->batch_max *= 2;
+        }
+    } else if (ops < thread->batch_max / 4 && thread->batch_max > CAIRN_BATCH_MAX_OPS) {
+        thread->batch_max /= 2;
+    }
+} /* cairn_batch_adapt */
+
 /*
  * Ordered two-stage commit with optimistic-retry on the metadata side.
  *
@@ -1442,7 +1800,7 @@ cairn_meta_txn_begin(
  *      state, and retry.
  *   3. complete all batched requests.
  *
- * in_commit is set across the whole function so the CAIRN_BATCH_MAX_OPS
+ * in_commit is set across the whole function so the batch_max
  * force-commit in cairn_dispatch doesn't recurse into us during replay.
  *
  * Error handling:
@@ -1470,13 +1828,23 @@ cairn_thread_commit(
     struct cairn_shared        *shared = thread->shared;
     struct chimera_vfs_request *request;
     struct chimera_vfs_request *replay_head;
-    char                       *err     = NULL;
-    int                         retries = 0;
+    struct prometheus_stopwatch commit_start, meta_start;
+    char                       *err            = NULL;
+    int                         retries        = 0;
+    int                         ops            = thread->request_count;
+    int                         meta_committed = 0;
+    uint64_t                    fill_ns        = 0;
 
     (void) evpl;
 
     thread->in_commit = 1;
 
+    if (ops) {
+        fill_ns = prometheus_stopwatch_elapsed_ns(&thread->batch_start);
+    }
+
+    prometheus_stopwatch_start(&commit_start);
+
     /*
      * Retry loop.  Each pass:
      *   1. commits the data WriteBatch (if any) — extent puts/deletes are
@@ -1530,10 +1898,16 @@ cairn_thread_commit(
             break;
         }
 
+        prometheus_stopwatch_start(&meta_start);
+
         rocksdb_transaction_commit(thread->meta_txn, &err);
         if (!err) {
             rocksdb_transaction_destroy(thread->meta_txn);
             thread->meta_txn = NULL;
+            meta_committed   = 1;
+            if (!shared->group_commit) {
+                cairn_sync_ns_update(shared, prometheus_stopwatch_elapsed_ns(&meta_start));
+            }
             break;
         }
 
@@ -1602,6 +1976,22 @@ cairn_thread_commit(
         }
     }
 
+    /*
+     * Under group commit the metadata transaction went to the WAL unsynced;
+     * nothing is acknowledged until a group sync covers it.  Other threads'
+     * readers can observe the commit before then, as they could observe any
+     * committed-but-unreplied update — only replies imply durability.
+     *
+     * A failed sync does not turn into a per-op EIO: the changes are
+     * committed and visible, and an error reply would have the client retry
+     * an op that already happened (a second create failing EEXIST, say).
+     * The sync poisons the metadb instead, so no later mutation is accepted
+     * on top of state that may not survive a crash.
+     */
+    if (meta_committed && shared->group_commit) {
+        cairn_group_sync(thread);
+    }
+
     /*
      * NFS COMMIT semantics: explicitly fsync datadb's WAL so prior cycles'
      * UNSTABLE writes (sync=0 then) become durable.  In-cycle data writes
@@ -1628,6 +2018,14 @@ cairn_thread_commit(
     }
     thread->needs_data_wal_flush = 0;
 
+    if (ops) {
+        if (thread->metrics.commit_latency) {
+            prometheus_time_histogram_sample(thread->metrics.commit_latency, &commit_start);
+            prometheus_histogram_sample(thread->metrics.commit_ops, ops);
+        }
+        cairn_batch_adapt(thread, ops, fill_ns);
+    }
+
     while (thread->txn_requests) {
         request = thread->txn_requests;
         DL_DELETE(thread->txn_requests, request);
@@ -1709,6 +2107,16 @@ cairn_thread_init(
     pthread_mutex_unlock(&shared->lock);
 
     thread->next_inum = 3;
+    thread->batch_max = CAIRN_BATCH_MAX_OPS;
+
+    if (shared->metrics) {
+        thread->metrics.commit_latency =
+            prometheus_histogram_series_create_instance(shared->commit_latency_series);
+        thread->metrics.commit_ops =
+            prometheus_histogram_series_create_instance(shared->commit_ops_series);
+        thread->metrics.group_sync_commits =
+            prometheus_histogram_series_create_instance(shared->group_sync_commits_series);
+    }
 
     return thread;
 } /* cairn_thread_init */
@@ -1717,9 +2125,19 @@ static void
 cairn_thread_destroy(void *private_data)
 {
     struct cairn_thread *thread = private_data;
+    struct cairn_shared *shared = thread->shared;
 
     cairn_thread_commit(thread->evpl, thread);
 
+    if (shared->metrics) {
+        prometheus_histogram_series_destroy_instance(shared->commit_latency_series,
+                                                     thread->metrics.commit_latency);
+        prometheus_histogram_series_destroy_instance(shared->commit_ops_series,
+                                                     thread->metrics.commit_ops);
+        prometheus_histogram_series_destroy_instance(shared->group_sync_commits_series,
+                                                     thread->metrics.group_sync_commits);
+    }
+
     free(thread);
 } /* cairn_thread_destroy */
 
@@ -2120,30 +2538,48 @@ cairn_lookup_path(
     int                        pathlen,
     struct cairn_inode_handle *ih)
 {
-    struct cairn_inode_handle  parent_ih;
-    struct cairn_inode        *inode;
+    struct cairn_inode_handle  ihs[CAIRN_MULTI_GET_MAX];
+    uint64_t                   inums[CAIRN_MULTI_GET_MAX];
     struct cairn_dirent_key    dirent_key;
-    struct cairn_dirent_value *dirent_value;
     struct cairn_dirent_handle dh;
     const char                *name;
     const char                *pathc = path;
     const char                *slash;
     int                        namelen;
-    uint64_t                   hash;
+    int                        i, n = 0, last;
+    uint64_t                   inum;
     int                        rc;
 
-    rc = cairn_inode_get_fh(thread, fs->root_fh, fs->root_fhlen, &parent_ih);
+    rc = cairn_inode_get_fh(thread, fs->root_fh, fs->root_fhlen, ih);
 
     if (unlikely(rc)) {
         return -1;
     }
 
-    inode = parent_ih.inode;
-
     while (*pathc == '/') {
         pathc++;
     }
 
+    if (pathc >= (path + pathlen)) {
+        return 0;
+    }
+
+    if (!S_ISDIR(ih->inode->mode)) {
+        cairn_inode_handle_release(ih);
+        return -1;
+    }
+
+    inum = ih->inode->inum;
+
+    cairn_inode_handle_release(ih);
+
+    /*
+     * Each component's dirent key needs only its parent's inum, which the
+     * parent's dirent already carries, so walk the dirents first and check
+     * the component inodes (exist, and are directories where traversed) with
+     * one MultiGet per CAIRN_MULTI_GET_MAX components.  A non-directory in the
+     * middle of the path has no dirents, so the walk stops at it regardless.
+     */
     while (pathc < (path + pathlen)) {
 
         slash = strchr(pathc, '/');
@@ -2162,43 +2598,57 @@ cairn_lookup_path(
             pathc++;
         }
 
-        if (!S_ISDIR(inode->mode)) {
-            cairn_inode_handle_release(&parent_ih);
-            return -1;
-        }
-
-        hash = chimera_vfs_hash(name, namelen);
-
         dirent_key.keytype = CAIRN_KEY_DIRENT;
-        dirent_key.inum    = inode->inum;
-        dirent_key.hash    = hash;
+        dirent_key.inum    = inum;
+        dirent_key.hash    = chimera_vfs_hash(name, namelen);
 
         rc = cairn_dirent_get(thread, &dirent_key, &dh);
 
         if (rc) {
-            cairn_inode_handle_release(&parent_ih);
             return -1;
         }
 
-        dirent_value = dh.dirent;
+        inum = dh.dirent->inum;
 
-        cairn_inode_handle_release(&parent_ih);
+        cairn_dirent_handle_release(&dh);
 
-        rc = cairn_inode_get_inum(thread, dirent_value->inum, &parent_ih);
+        inums[n++] = inum;
+        last       = pathc >= (path + pathlen);
 
-        cairn_dirent_handle_release(&dh);
+        if (n < CAIRN_MULTI_GET_MAX && !last) {
+            continue;
+        }
+
+        cairn_inode_get_inums(thread, n, inums, ihs);
+
+        rc = 0;
+
+        for (i = 0; i < n; i++) {
+            if (!ihs[i].inode ||
+                (!(last && i == n - 1) && !S_ISDIR(ihs[i].inode->mode))) {
+                rc = -1;
+            }
+        }
+
+        for (i = 0; i < n; i++) {
+            if (ihs[i].inode && !(rc == 0 && last && i == n - 1)) {
+                cairn_inode_handle_release(&ihs[i]);
+            }
+        }
 
         if (rc) {
             return -1;
         }
 
-        inode = parent_ih.inode;
+        if (last) {
+            *ih = ihs[n - 1];
+            return 0;
+        }
 
+        n = 0;
     }
 
-    *ih = parent_ih;
-
-    return 0;
+    return -1;
 
 } /* cairn_lookup_path */
 
@@ -3193,11 +3643,16 @@ cairn_readdir(
     struct chimera_vfs_request *request,
     void                       *private_data)
 {
-    struct cairn_inode_handle  ih, dirent_ih, parent_ih;
+    struct cairn_inode_handle  ih, parent_ih;
+    struct cairn_inode_handle  dirent_ihs[CAIRN_MULTI_GET_MAX];
     struct cairn_inode        *inode, *dirent_inode, *parent_inode;
+    struct cairn_dirent_value  dirents[CAIRN_MULTI_GET_MAX];
+    uint64_t                   hashes[CAIRN_MULTI_GET_MAX];
+    uint64_t                   inums[CAIRN_MULTI_GET_MAX];
     uint64_t                   cookie      = request->readdir.cookie;
     uint64_t                   next_cookie = 0;
     int                        rc, eof = 1;
+    int                        i, n, batch, more = 1;
     struct chimera_vfs_attrs   attr;
     rocksdb_iterator_t        *iter = NULL;
     struct cairn_dirent_key    start_key, *dirent_key;
@@ -3305,47 +3760,83 @@ cairn_readdir(
         rocksdb_iter_next(iter);
     }
 
-    while (rocksdb_iter_valid(iter)) {
+    /*
+     * Collect a page of dirents, resolve their inodes with one MultiGet, then
+     * emit.  The first page is small since many callers stop after a few
+     * entries; each following page doubles up to CAIRN_MULTI_GET_MAX.  The
+     * iterator may run ahead of the last emitted entry; resume is by cookie.
+     */
+    batch = 8;
 
-        dirent_key = (struct cairn_dirent_key *) rocksdb_iter_key(iter, &len);
+    while (more) {
 
-        if (dirent_key->keytype != CAIRN_KEY_DIRENT || dirent_key->inum != inode->inum) {
-            break;
-        }
+        n = 0;
 
-        dirent_value = (struct cairn_dirent_value *) rocksdb_iter_value(iter, &len);
+        while (n < batch) {
 
-        rc = cairn_inode_get_inum(thread, dirent_value->inum, &dirent_ih);
+            if (!rocksdb_iter_valid(iter)) {
+                more = 0;
+                break;
+            }
+
+            dirent_key = (struct cairn_dirent_key *) rocksdb_iter_key(iter, &len);
+
+            if (dirent_key->keytype != CAIRN_KEY_DIRENT || dirent_key->inum != inode->inum) {
+                more = 0;
+                break;
+            }
+
+            dirent_value = (struct cairn_dirent_value *) rocksdb_iter_value(iter, &len);
+
+            hashes[n] = dirent_key->hash;
+            inums[n]  = dirent_value->inum;
+            memcpy(&dirents[n], dirent_value, len < sizeof(dirents[n]) ? len : sizeof(dirents[n]));
+            n++;
 
-        if (rc) {
             rocksdb_iter_next(iter);
-            continue;
         }
 
-        dirent_inode = dirent_ih.inode;
+        cairn_inode_get_inums(thread, n, inums, dirent_ihs);
 
-        cairn_map_attrs(fs, &attr, dirent_inode);
-        cairn_map_ea_size(thread, dirent_inode, &attr);
-        cairn_map_acl(thread, &attr, dirent_inode);
+        for (i = 0; i < n; i++) {
 
-        cairn_inode_handle_release(&dirent_ih);
+            dirent_inode = dirent_ihs[i].inode;
 
-        rc = request->readdir.callback(
-            dirent_value->inum,
-            dirent_key->hash + CAIRN_COOKIE_FIRST,
-            dirent_value->name,
-            dirent_value->name_len,
-            &attr,
-            request->proto_private_data);
+            if (!dirent_inode) {
+                continue;
+            }
 
-        next_cookie = dirent_key->hash + CAIRN_COOKIE_FIRST;
+            cairn_map_attrs(fs, &attr, dirent_inode);
+            cairn_map_ea_size(thread, dirent_inode, &attr);
+            cairn_map_acl(thread, &attr, dirent_inode);
 
-        if (rc) {
-            eof = 0;
-            break;
+            cairn_inode_handle_release(&dirent_ihs[i]);
+
+            rc = request->readdir.callback(
+                dirents[i].inum,
+                hashes[i] + CAIRN_COOKIE_FIRST,
+                dirents[i].name,
+                dirents[i].name_len,
+                &attr,
+                request->proto_private_data);
+
+            next_cookie = hashes[i] + CAIRN_COOKIE_FIRST;
+
+            if (rc) {
+                eof = 0;
+                for (i = i + 1; i < n; i++) {
+                    if (dirent_ihs[i].inode) {
+                        cairn_inode_handle_release(&dirent_ihs[i]);
+                    }
+                }
+                more = 0;
+                break;
+            }
         }
 
-        rocksdb_iter_next(iter);
+        if (batch < CAIRN_MULTI_GET_MAX) {
+            batch *= 2;
+        }
 
     } /* cairn_readdir */
 
@@ -5612,6 +6103,17 @@ cairn_dispatch(
             break;
     } /* switch */
 
+    /* A failed metadb group sync left committed changes that may not be on
+     * disk (cairn_group_sync): accept nothing more that would build on them. */
+    if (unlikely(__atomic_load_n(&shared->meta_poisoned, __ATOMIC_RELAXED)) &&
+        (chimera_vfs_op_is_mutating(request) ||
+         request->opcode == CHIMERA_VFS_OP_MKFS ||
+         request->opcode == CHIMERA_VFS_OP_RMFS)) {
+        request->status = CHIMERA_VFS_EROFS;
+        request->complete(request);
+        return;
+    }
+
     /*
      * Read-only ops run under a snapshot view (cairn_read_begin/end) and
      * complete inline; they never touch the write transaction or get queued,
@@ -5749,12 +6251,12 @@ cairn_dispatch(
      * the next event-loop wake processes them as one batch.  But under high
      * load with slow commits that batch can grow arbitrarily large, and a
      * request near the tail would wait for every commit ahead of it.
-     * Force an early commit once the queue reaches CAIRN_BATCH_MAX_OPS so
-     * tail latency stays bounded.  Suppressed while in_commit is set so a
-     * replay (which re-dispatches queued requests) can't recurse into
-     * cairn_thread_commit.
+     * Force an early commit once the queue reaches this thread's adaptive
+     * batch_max so tail latency stays bounded.  Suppressed while in_commit
+     * is set so a replay (which re-dispatches queued requests) can't recurse
+     * into cairn_thread_commit.
      */
-    if (!thread->in_commit && thread->request_count >= CAIRN_BATCH_MAX_OPS) {
+    if (!thread->in_commit && thread->request_count >= thread->batch_max) {
         cairn_thread_commit(thread->evpl, thread);
     }
 } /* cairn_dispatch */
@@ -5767,12 +6269,15 @@ SYMBOL_EXPORT struct chimera_vfs_module vfs_cairn = {
      * release is safe).  TODO: drop this cap and convert cairn_read to scatter
      * its RocksDB extent fill across VFS-core-provided buffers via an
      * append-blob cursor, like diskfs/linux/io_uring, so it can use cheaper
-     * non-SHARED connection-thread buffers. */
+     * non-SHARED connection-thread buffers.
+     * CAP_FH_AFFINITY: extent writes are batched per thread and rely on the
+     * fh-hash routing to serialize them per file (see cairn_shared). */
     .capabilities   = CHIMERA_VFS_CAP_BLOCKING | CHIMERA_VFS_CAP_FS | CHIMERA_VFS_CAP_KV |
         CHIMERA_VFS_CAP_FS_RELATIVE_OP | CHIMERA_VFS_CAP_ACL_NATIVE |
         CHIMERA_VFS_CAP_ATOMIC_HANDLE_STATE |
         CHIMERA_VFS_CAP_XATTR | CHIMERA_VFS_CAP_READ_PROVIDES_BUFFERS |
-        CHIMERA_VFS_CAP_FS_LOCK | CHIMERA_VFS_CAP_CHANGE | CHIMERA_VFS_CAP_MKFS,
+        CHIMERA_VFS_CAP_FS_LOCK | CHIMERA_VFS_CAP_CHANGE | CHIMERA_VFS_CAP_MKFS |
+        CHIMERA_VFS_CAP_FH_AFFINITY,
     .init           = cairn_init,
     .destroy        = cairn_destroy,
     .thread_init    = cairn_thread_init,
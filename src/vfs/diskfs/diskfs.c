@@ -116,7 +116,7 @@ diskfs_dispatch(
             diskfs_close(thread, shared, request, private_data);
             break;
         case CHIMERA_VFS_OP_READ:
-            diskfs_read(thread, shared, request, private_data);
+            diskfs_read(thread, request, private_data);
             break;
         case CHIMERA_VFS_OP_WRITE:
             diskfs_write(thread, shared, request, private_data);
@@ -623,6 +623,39 @@ diskfs_setattr_trunc_removed_cb(
 } /* diskfs_setattr_trunc_removed_cb */
 
 
+/* Both the full-remove and trim cases start by removing the slot. */
+static void
+diskfs_setattr_trunc_remove(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_bt_op           *op     = diskfs_bt_op_alloc(thread);
+    struct diskfs_bt_key           key    = diskfs_extent_key(p->ext_iter.file_offset);
+
+    if (diskfs_bt_remove_async(op, thread, p->txn, p->inode_stash[0], &key,
+                               diskfs_setattr_trunc_removed_cb, request)) {
+        diskfs_setattr_trunc_removed_cb(op, op->result, request);
+    }
+} /* diskfs_setattr_trunc_remove */
+
+
+static void
+diskfs_setattr_trunc_freed(
+    void *priv,
+    int   status)
+{
+    struct chimera_vfs_request    *request = priv;
+    struct diskfs_request_private *p       = request->plugin_data;
+
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    diskfs_setattr_trunc_remove(request);
+} /* diskfs_setattr_trunc_freed */
+
+
 static void
 diskfs_setattr_trunc_process(struct chimera_vfs_request *request)
 {
@@ -630,7 +663,6 @@ diskfs_setattr_trunc_process(struct chimera_vfs_request *request)
     struct diskfs_thread          *thread   = p->thread;
     uint64_t                       new_size = p->loop_off;
     uint64_t                       extent_start, extent_end;
-    struct diskfs_bt_op           *op;
 
     if (!p->loop_have) {
         diskfs_setattr_trunc_done(request);
@@ -641,15 +673,19 @@ diskfs_setattr_trunc_process(struct chimera_vfs_request *request)
     extent_end   = extent_start + p->ext_iter.length;
 
     if (extent_start >= new_size) {
-        diskfs_thread_free_space(thread, p->txn, p->ext_iter.device_id,
-                                 p->ext_iter.device_offset,
-                                 SM_ALIGN_UP(p->ext_iter.length));
+        /* A shared chunk's blocks go only with its last reference. */
+        diskfs_ext_free_backing(thread, p->txn, &p->ext_iter,
+                                diskfs_setattr_trunc_freed, request);
+        return;
     } else if (extent_end > new_size) {
         uint64_t old_aligned = SM_ALIGN_UP(p->ext_iter.length);
         uint64_t new_logical = new_size - extent_start;
         uint64_t new_aligned = SM_ALIGN_UP(new_logical);
 
-        if (old_aligned > new_aligned) {
+        /* A compressed or shared chunk keeps all its blocks; only its
+         * logical length shrinks (the tail past it reads as zeros). */
+        if (old_aligned > new_aligned &&
+            !(p->ext_iter.flags & DISKFS_EXT_WHOLE)) {
             diskfs_thread_free_space(thread, p->txn, p->ext_iter.device_id,
                                      p->ext_iter.device_offset + new_aligned,
                                      old_aligned - new_aligned);
@@ -660,16 +696,7 @@ diskfs_setattr_trunc_process(struct chimera_vfs_request *request)
         return;
     }
 
-    /* Both the full-remove and trim cases start by removing the slot. */
-    op = diskfs_bt_op_alloc(thread);
-    {
-        struct diskfs_bt_key key = diskfs_extent_key(extent_start);
-
-        if (diskfs_bt_remove_async(op, thread, p->txn, p->inode_stash[0], &key,
-                                   diskfs_setattr_trunc_removed_cb, request)) {
-            diskfs_setattr_trunc_removed_cb(op, op->result, request);
-        }
-    }
+    diskfs_setattr_trunc_remove(request);
 } /* diskfs_setattr_trunc_process */
 
 
@@ -886,6 +913,19 @@ diskfs_setattr_inode_cb(
         p->inode_stash[0] = inode;
         p->loop_off       = request->setattr.set_attr->va_size;
 
+        /* Inline file: no extents, just cut the INLINE record. */
+        if (inode->inline_data) {
+            if (p->loop_off < inode->inline_len) {
+                diskfs_inline_store(request, 1,
+                                    p->loop_off ?
+                                    diskfs_inline_stage(inode, (uint32_t) p->loop_off) : NULL,
+                                    (uint32_t) p->loop_off, diskfs_setattr_trunc_done);
+            } else {
+                diskfs_setattr_trunc_done(request);
+            }
+            return;
+        }
+
         op = diskfs_bt_op_alloc(thread);
         if (diskfs_ext_floor_async(op, thread, inode, p->loop_off, p->rec_scratch,
                                    sizeof(p->rec_scratch), diskfs_setattr_trunc_first_cb,
@@ -1316,7 +1356,7 @@ diskfs_sb_write_prepare(
     evpl_iovec_alloc(thread->evpl, SM_SUPERBLOCK_SIZE, SM_SUPERBLOCK_SIZE, 1,
                      0, &sw->iov);
     space_map_fill_superblock(shared->space_map, sw->iov.data, shared->fsid,
-                              0 /* dirty */, 0, 0, 0, sw->new_floor,
+                              diskfs_sb_flags(shared), 0, 0, 0, sw->new_floor,
                               shared->fs_table);
     return sw;
 } /* diskfs_sb_write_prepare */
@@ -2946,7 +2986,9 @@ diskfs_get_layout_inode_cb(
     request->get_layout.r_num_segments = 0;
     request->get_layout.r_num_devices  = 0;
 
-    if (off >= end) {
+    /* An inline file has no device blocks to hand out: answer with no
+     * segments so the client falls back to I/O through the server. */
+    if (off >= end || inode->inline_data) {
         diskfs_get_layout_finish(request);
         return;
     }
@@ -198,6 +198,17 @@ diskfs_block_lru_unlink(
     struct diskfs_block_shard *shard,
     struct diskfs_block       *blk);
 
+static inline void
+diskfs_block_lru_touch(
+    struct diskfs_block_shard *shard,
+    struct diskfs_block       *blk);
+
+static inline void
+diskfs_block_lru_admit(
+    struct diskfs_thread      *thread,
+    struct diskfs_block_shard *shard,
+    struct diskfs_block       *blk);
+
 static struct diskfs_block *
 diskfs_block_recycle(
     struct diskfs_thread      *thread,
@@ -248,25 +259,96 @@ diskfs_block_lru_unlink(
     struct diskfs_block_shard *shard,
     struct diskfs_block       *blk)
 {
+    struct diskfs_block **head = blk->hot ? &shard->hot_head : &shard->lru_head;
+    struct diskfs_block **tail = blk->hot ? &shard->hot_tail : &shard->lru_tail;
+
     if (!blk->on_lru) {
         return;
     }
     if (blk->lru_prev) {
         blk->lru_prev->lru_next = blk->lru_next;
     } else {
-        shard->lru_head = blk->lru_next;
+        *head = blk->lru_next;
     }
     if (blk->lru_next) {
         blk->lru_next->lru_prev = blk->lru_prev;
     } else {
-        shard->lru_tail = blk->lru_prev;
+        *tail = blk->lru_prev;
     }
     blk->lru_prev = blk->lru_next = NULL;
     blk->on_lru   = 0;
     shard->lru_count--;
+    if (blk->hot) {
+        shard->hot_count--;
+    }
 } /* diskfs_block_lru_unlink */
 
 
+/* Re-link blk on the segment named by hot, then demote protected LRU blocks
+ * to probation's MRU end until the protected segment is back under its cap. */
+static inline void
+diskfs_block_lru_move(
+    struct diskfs_block_shard *shard,
+    struct diskfs_block       *blk,
+    int                        hot)
+{
+    diskfs_block_lru_unlink(shard, blk);
+    blk->hot = hot;
+    diskfs_block_lru_push_tail(shard, blk);
+
+    while (shard->hot_count > shard->hot_cap) {
+        struct diskfs_block *old = shard->hot_head;
+
+        diskfs_block_lru_unlink(shard, old);
+        old->hot = 0;
+        diskfs_block_lru_push_tail(shard, old);
+    }
+} /* diskfs_block_lru_move */
+
+
+/* A resident hit: move blk to the MRU end, promoting it to the protected
+ * segment -- unless this is the first touch after its own fault (the re-driven
+ * get that the load woke), which is the same reference, not a second one. */
+static inline void
+diskfs_block_lru_touch(
+    struct diskfs_block_shard *shard,
+    struct diskfs_block       *blk)
+{
+    int hot = blk->hot || !blk->fresh;
+
+    blk->fresh = 0;
+    diskfs_block_lru_move(shard, blk, hot);
+} /* diskfs_block_lru_touch */
+
+
+/* A miss just keyed the recycled blk (on probation's tail) for a read: mark it
+ * fresh, and admit it straight to protected if the shard evicted this key
+ * recently -- it is part of a working set larger than probation. */
+static inline void
+diskfs_block_lru_admit(
+    struct diskfs_thread      *thread,
+    struct diskfs_block_shard *shard,
+    struct diskfs_block       *blk)
+{
+    blk->fresh = 1;
+    if (diskfs_cache_ghost_take(shard->ghost, shard->ghost_mask,
+                                diskfs_block_hash(blk->device_id, blk->device_offset))) {
+        diskfs_metric_block_cache(thread, DISKFS_METRIC_BLOCK_CACHE_GHOST_HIT);
+        diskfs_block_lru_move(shard, blk, 1);
+    }
+} /* diskfs_block_lru_admit */
+
+
+/* A recycle victim: CLEAN and unreferenced. */
+static inline int
+diskfs_block_recyclable(const struct diskfs_block *blk)
+{
+    return blk &&
+           __atomic_load_n(&blk->pin_count, __ATOMIC_ACQUIRE) == 0 &&
+           __atomic_load_n(&blk->state, __ATOMIC_ACQUIRE) == DISKFS_BLOCK_CLEAN;
+} /* diskfs_block_recyclable */
+
+
 static void
 diskfs_block_drain_returned_locked(struct diskfs_block_shard *shard)
 {
@@ -331,7 +413,6 @@ diskfs_block_recycle(
 
     diskfs_block_drain_returned_locked(shard);
     diskfs_block_drain_clean_locked(shard);
-    blk = shard->lru_head;
 
     /*
      * Block-swap model: every block lives on the LRU all the time -- clean,
@@ -344,11 +425,18 @@ diskfs_block_recycle(
      * the whole shard is genuinely busy -- return NULL so the caller parks
      * (async) or treats it as a provisioning violation (sync).  No scan: by
      * drain order the head is the best (and effectively the only) candidate.
+     *
+     * The LRU is split in two segments (scan resistance, see
+     * DISKFS_CACHE_PROTECTED_PCT): try the probationary head first, so blocks
+     * touched once -- a find(1) or backup walk -- go before re-referenced ones,
+     * and fall back to the protected head only when probation's is busy.
      */
-    if (!blk ||
-        __atomic_load_n(&blk->pin_count, __ATOMIC_ACQUIRE) != 0 ||
-        __atomic_load_n(&blk->state, __ATOMIC_ACQUIRE) != DISKFS_BLOCK_CLEAN) {
-        return NULL;
+    blk = shard->lru_head;
+    if (!diskfs_block_recyclable(blk)) {
+        blk = shard->hot_head;
+        if (!diskfs_block_recyclable(blk)) {
+            return NULL;
+        }
     }
 
     diskfs_metric_block_cache(thread, DISKFS_METRIC_BLOCK_CACHE_RECYCLE);
@@ -357,14 +445,18 @@ diskfs_block_recycle(
         diskfs_block_recycle_waiter_trace(blk);
     }
 
-    /* Move the victim to the MRU end: it is about to become a fresh live block,
-     * so it must not be reconsidered until it ages back to the head.  It never
-     * leaves the LRU (block-swap: a block and its buffer are paired for life). */
+    /* Move the victim to probation's MRU end: it is about to become a fresh
+     * live block, so it must not be reconsidered until it ages back to the
+     * head.  It never leaves the LRU (block-swap: a block and its buffer are
+     * paired for life). */
     diskfs_block_lru_unlink(shard, blk);
+    blk->hot   = 0;
+    blk->fresh = 0;
     diskfs_block_lru_push_tail(shard, blk);
 
     /* Unhook from its current bucket (no-op for a retired/never-keyed block:
-     * it is in no chain, so the pointer search simply finds nothing). */
+     * it is in no chain, so the pointer search simply finds nothing).  A keyed
+     * victim leaves a ghost so a prompt re-fault is admitted as hot. */
     ob   = diskfs_block_bucket(blk->device_id, blk->device_offset);
     prev = NULL;
     for (cur = shard->buckets[ob]; cur; prev = cur, cur = cur->hash_next) {
@@ -374,10 +466,16 @@ diskfs_block_recycle(
             } else {
                 shard->buckets[ob] = cur->hash_next;
             }
+            diskfs_cache_ghost_note(shard->ghost, shard->ghost_mask,
+                                    diskfs_block_hash(blk->device_id,
+                                                      blk->device_offset));
             break;
         }
     }
     blk->hash_next = NULL;
+    __atomic_store_n(&blk->home_current, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&blk->home_stale, 0, __ATOMIC_RELEASE);
+    blk->delta_owner = NULL;
     return blk;
 } /* diskfs_block_recycle */
 
@@ -406,18 +504,22 @@ diskfs_block_cow_swap(
 {
     struct diskfs_block  *y;
     struct diskfs_block **pp;
+    int                   hot = x->hot;
 
     /* X is the active block being forked and is pinned (refs>1 => a record holds
      * it), so it is never a recycle victim -- but if it happened to sit at the
      * LRU head, recycle would see a pinned head and spuriously park.  Move it to
-     * the MRU end first so recycle finds a genuinely idle victim. */
-    diskfs_block_lru_unlink(shard, x);
-    diskfs_block_lru_push_tail(shard, x);
+     * the MRU end first so recycle finds a genuinely idle victim.  X is about to
+     * be retired, so it goes to probation; Y inherits its segment below. */
+    diskfs_block_lru_move(shard, x, 0);
 
     y = diskfs_block_recycle(thread, shard);
     if (!y) {
         return NULL;     /* no clean victim at the LRU head -- caller parks */
     }
+    if (hot) {
+        diskfs_block_lru_move(shard, y, 1);
+    }
 
     /* y is keyless (off its old bucket), on the LRU tail, CLEAN, pin 0. */
     memcpy(y->iov.data, x->iov.data, DISKFS_BLOCK_SIZE);
@@ -442,6 +544,8 @@ diskfs_block_cow_swap(
     y->hash_next           = shard->buckets[bucket];
     shard->buckets[bucket] = y;
     __atomic_store_n(&y->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
+    /* Y carries X's un-pushed content, not the home image. */
+    diskfs_block_set_stale(y);
 
     diskfs_metric_block_cache(thread, DISKFS_METRIC_BLOCK_CACHE_COW);
     return y;
@@ -608,6 +712,7 @@ diskfs_block_unpin(
         if (__atomic_load_n(&blk->pin_count, __ATOMIC_ACQUIRE) == 0) {
             __atomic_sub_fetch(&shard->pinned, 1, __ATOMIC_RELAXED);  /* 1->0 */
             __atomic_store_n(&blk->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
+            diskfs_block_set_idle(blk);
             if (!blk->on_lru) {
                 diskfs_block_lru_push_tail(shard, blk);
             }
@@ -637,6 +742,7 @@ diskfs_block_release(
     if (__atomic_sub_fetch(&blk->pin_count, 1, __ATOMIC_ACQ_REL) == 0) {
         __atomic_sub_fetch(&shard->pinned, 1, __ATOMIC_RELAXED);  /* 1->0 */
         __atomic_store_n(&blk->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
+        diskfs_block_set_idle(blk);
         if (!blk->on_lru) {
             diskfs_block_lru_push_tail(shard, blk);
         }
@@ -687,6 +793,13 @@ diskfs_block_cache_create(struct diskfs_shared *shared)
                                 sizeof(struct diskfs_block *));
         shard->pool = calloc(cache->shard_cap, sizeof(struct diskfs_block));
 
+        /* Scan resistance: protected-segment cap, and a ghost table with
+         * about one slot per block. */
+        shard->hot_cap = (uint32_t) ((uint64_t) cache->shard_cap *
+                                     DISKFS_CACHE_PROTECTED_PCT / 100);
+        shard->ghost   = diskfs_cache_ghost_alloc(cache->shard_cap,
+                                                  &shard->ghost_mask);
+
         /* Pre-populate the struct pool: every block starts free (unkeyed, in
          * no bucket) and CLEAN on the LRU, with no buffer yet (iov.data NULL);
          * the iovec is allocated on first use and reused thereafter. */
@@ -830,6 +943,7 @@ diskfs_block_cache_destroy(struct diskfs_shared *shared)
         free(shard->global_bufs);
         free(shard->buffers);
         free(shard->pool);
+        free(shard->ghost);
         free(shard->buckets);
         pthread_mutex_destroy(&shard->lock);
     }
@@ -958,10 +1072,14 @@ diskfs_block_claim(
         blk = y;
     } else {
         /* Resident hit (refs == 1).  The block stays on the LRU (block-swap);
-         * move it to the MRU end since it is now active. */
+         * move it to the MRU end (promoting it) since it is now active. */
         diskfs_metric_block_cache(thread, DISKFS_METRIC_BLOCK_CACHE_HIT);
-        diskfs_block_lru_unlink(shard, blk);
-        diskfs_block_lru_push_tail(shard, blk);
+        diskfs_block_lru_touch(shard, blk);
+    }
+
+    /* A freshly-allocated block's home holds whatever the range last held. */
+    if (is_new) {
+        diskfs_block_set_stale(blk);
     }
 
     if (__atomic_add_fetch(&blk->pin_count, 1, __ATOMIC_ACQ_REL) == 1) {
@@ -1351,6 +1469,7 @@ diskfs_block_load_complete(
 
     pthread_mutex_lock(&shard->lock);
     __atomic_store_n(&blk->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
+    diskfs_block_set_home(blk);
     waiters        = blk->wait_head;
     blk->wait_head = NULL;
     blk->wait_tail = NULL;
@@ -1385,9 +1504,9 @@ diskfs_bt_op_pin(
     struct diskfs_block       *blk)
 {
     /* Block-swap: blocks stay on the LRU whether pinned or not.  Move this one
-     * to the MRU end since it is now active (recyclers take the unpinned head). */
-    diskfs_block_lru_unlink(shard, blk);
-    diskfs_block_lru_push_tail(shard, blk);
+     * to the MRU end (promoting it) since it is now active (recyclers take the
+     * unpinned head). */
+    diskfs_block_lru_touch(shard, blk);
     if (__atomic_add_fetch(&blk->pin_count, 1, __ATOMIC_ACQ_REL) == 1) {
         __atomic_add_fetch(&shard->pinned, 1, __ATOMIC_RELAXED);
     }
@@ -1440,6 +1559,7 @@ diskfs_bt_block_get(
         blk->hash_next         = shard->buckets[bucket];
         shard->buckets[bucket] = blk;
         issue                  = 1;
+        diskfs_block_lru_admit(thread, shard, blk);
     } else {
         diskfs_metric_block_cache(thread, DISKFS_METRIC_BLOCK_CACHE_WAIT);
     }
@@ -1553,6 +1673,7 @@ diskfs_block_claim_async(
             __atomic_store_n(&blk->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
             diskfs_block_assert_iov(thread, blk);
             memset(blk->iov.data, 0, DISKFS_BLOCK_SIZE);
+            diskfs_block_set_stale(blk);
             blk->hash_next         = shard->buckets[bucket];
             shard->buckets[bucket] = blk;
             if (__atomic_add_fetch(&blk->pin_count, 1, __ATOMIC_ACQ_REL) == 1) {
@@ -1574,6 +1695,7 @@ diskfs_block_claim_async(
         blk->wait_head         = w;
         blk->wait_tail         = w;
         issue                  = 1;
+        diskfs_block_lru_admit(thread, shard, blk);
     } else if (blk->buf->refs > 1) {
         /* CoW (block-swap): the live buffer is still referenced by an un-pushed
          * record, so swap a fresh block in for (dev,off) and retire this one onto
@@ -1588,10 +1710,9 @@ diskfs_block_claim_async(
         blk = y;
     } else {
         /* Resident hit (refs == 1).  Stays on the LRU (block-swap); move it to
-         * the MRU end since it is now active. */
+         * the MRU end (promoting it) since it is now active. */
         diskfs_metric_block_cache(thread, DISKFS_METRIC_BLOCK_CACHE_HIT);
-        diskfs_block_lru_unlink(shard, blk);
-        diskfs_block_lru_push_tail(shard, blk);
+        diskfs_block_lru_touch(shard, blk);
     }
 
     if (issue) {
@@ -1610,6 +1731,10 @@ diskfs_block_claim_async(
         return NULL;
     }
 
+    if (is_new) {
+        diskfs_block_set_stale(blk);
+    }
+
     if (__atomic_add_fetch(&blk->pin_count, 1, __ATOMIC_ACQ_REL) == 1) {
         __atomic_add_fetch(&shard->pinned, 1, __ATOMIC_RELAXED);
     }
@@ -1618,6 +1743,143 @@ diskfs_block_claim_async(
 } /* diskfs_block_claim_async */
 
 
+/* Prefetch read completion: like diskfs_block_load_complete, for every block
+ * the vectored read filled. */
+static void
+diskfs_block_prefetch_complete(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct diskfs_block_prefetch *pf   = private_data;
+    struct diskfs_thread         *self = pf->thread;
+    struct diskfs_block_waiter   *waiters, *w;
+    uint32_t                      i;
+
+    (void) evpl;
+    chimera_diskfs_abort_if(status != 0, "prefetch read failed off=%lu status=%d",
+                            pf->blk[0]->device_offset, status);
+
+    for (i = 0; i < pf->nblk; i++) {
+        struct diskfs_block       *blk   = pf->blk[i];
+        struct diskfs_block_shard *shard = diskfs_block_shard(self->shared->block_cache,
+                                                              blk->device_id,
+                                                              blk->device_offset);
+
+        pthread_mutex_lock(&shard->lock);
+        __atomic_store_n(&blk->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
+        diskfs_block_set_home(blk);
+        waiters        = blk->wait_head;
+        blk->wait_head = NULL;
+        blk->wait_tail = NULL;
+        pthread_mutex_unlock(&shard->lock);
+
+        while (waiters) {
+            w       = waiters;
+            waiters = w->next;
+            diskfs_block_waiter_dispatch(self, w);
+        }
+    }
+
+    diskfs_pending_io_add(self, -1);
+    if (pf->done) {
+        pf->done(self, pf->arg);
+    }
+    free(pf);
+
+    diskfs_io_resume_waiters(self);
+} /* diskfs_block_prefetch_complete */
+
+
+/*
+ * Prefetch: publish LOADING blocks for a run of device-contiguous offsets and
+ * fill them all with one vectored read.  A warm-cache manifest (diskfs_warm.c)
+ * prefetches hot, straight to the protected segment -- the blocks were hot
+ * when the manifest was written; readdir look-ahead admits them to probation
+ * as a demand miss would.  The blocks are not pinned (LOADING keeps recycle
+ * off them, exactly as on a b+tree miss), and a claim that finds one LOADING
+ * parks on it until the read lands.  The run ends at the first block that is
+ * already resident or loading, or whose shard has no clean victim; such a
+ * block at the head is simply skipped.
+ */
+uint32_t
+diskfs_block_prefetch(
+    struct diskfs_thread *thread,
+    uint32_t device_id,
+    uint64_t device_offset,
+    uint32_t n,
+    int hot,
+    void ( *done )(struct diskfs_thread *, void *),
+    void *arg,
+    int *issued)
+{
+    struct diskfs_block_cache    *cache = thread->shared->block_cache;
+    struct diskfs_block_prefetch *pf    = NULL;
+    uint32_t                      i;
+
+    *issued = 0;
+    if (n > DISKFS_BLOCK_PREFETCH_MAX) {
+        n = DISKFS_BLOCK_PREFETCH_MAX;
+    }
+
+    for (i = 0; i < n; i++) {
+        uint64_t                   off    = device_offset + ((uint64_t) i << DISKFS_BLOCK_SHIFT);
+        struct diskfs_block_shard *shard  = diskfs_block_shard(cache, device_id, off);
+        uint32_t                   bucket = diskfs_block_bucket(device_id, off);
+        struct diskfs_block       *blk;
+
+        pthread_mutex_lock(&shard->lock);
+        diskfs_block_drain_returned_locked(shard);
+        diskfs_block_drain_clean_locked(shard);
+        if (diskfs_block_lookup_locked(shard, bucket, device_id, off) ||
+            !(blk = diskfs_block_recycle(thread, shard))) {
+            pthread_mutex_unlock(&shard->lock);
+            break;
+        }
+        blk->device_id     = device_id;
+        blk->device_offset = off;
+        __atomic_store_n(&blk->state, DISKFS_BLOCK_LOADING, __ATOMIC_RELEASE);
+        blk->seq               = 0;
+        blk->wait_head         = NULL;
+        blk->wait_tail         = NULL;
+        blk->hash_next         = shard->buckets[bucket];
+        shard->buckets[bucket] = blk;
+        if (hot) {
+            diskfs_block_lru_move(shard, blk, 1);
+        } else {
+            diskfs_block_lru_admit(thread, shard, blk);
+        }
+        pthread_mutex_unlock(&shard->lock);
+
+        diskfs_block_assert_iov(thread, blk);
+        if (!pf) {
+            pf = malloc(sizeof(*pf));
+        }
+        pf->blk[i] = blk;
+        pf->iov[i] = blk->iov;
+    }
+
+    if (i == 0) {
+        return n ? 1 : 0;
+    }
+
+    pf->thread = thread;
+    pf->done   = done;
+    pf->arg    = arg;
+    pf->nblk   = i;
+    *issued    = 1;
+
+    diskfs_pending_io_add(thread, 1);
+    diskfs_metric_block_io(thread, DISKFS_METRIC_IO_READ,
+                           DISKFS_METRIC_IO_BTREE, (uint64_t) i * DISKFS_BLOCK_SIZE);
+    diskfs_metric_block_io_device(thread, device_id, DISKFS_METRIC_IO_READ,
+                                  DISKFS_METRIC_IO_BTREE, (uint64_t) i * DISKFS_BLOCK_SIZE);
+    evpl_block_read(thread->evpl, thread->queue[device_id], pf->iov, i,
+                    device_offset, diskfs_block_prefetch_complete, pf);
+    return i;
+} /* diskfs_block_prefetch */
+
+
 void
 diskfs_inode_finish_write_pin(
     struct diskfs_thread *thread,
@@ -1771,6 +2033,7 @@ diskfs_txn_drop_inode_block(
         if ((*pp)->block == inode->block) {
             tb  = *pp;
             *pp = tb->next;
+            diskfs_txn_block_drop_delta(txn, tb);
             free(tb);
             break;
         }
@@ -1814,6 +2077,7 @@ diskfs_inode_flush(struct diskfs_inode *inode)
     di->change         = inode->change;
     di->ea_size        = inode->ea_size;
     di->ea_count       = inode->ea_count;
+    di->flags          = inode->inline_data ? DISKFS_DINODE_INLINE : 0;
     if (S_ISDIR(inode->mode)) {
         di->parent_inum = inode->parent_inum;
         di->parent_gen  = inode->parent_gen;
@@ -1871,7 +2135,11 @@ diskfs_txn_unpin_blocks(struct diskfs_txn *txn)
         n = tb->next;
         /* Abort: no record was logged, so no tail-push will ever release this
          * txn's claim pin -- drop it here.  The block is home (nothing of ours
-         * went un-home), so unpin marks it CLEAN once fully unpinned. */
+         * went un-home), so unpin marks it CLEAN once fully unpinned.  Its
+         * buffer may still hold our partial edits, though, so it cannot serve
+         * as a delta base until it is next pushed home. */
+        diskfs_txn_block_drop_delta(txn, tb);
+        diskfs_block_set_stale(tb->block);
         diskfs_block_unpin(thread, tb->block, DISKFS_BLOCK_CLEAN);
         free(tb);
         tb = n;
@@ -1900,6 +2168,7 @@ diskfs_txn_retire_blocks(struct diskfs_txn *txn)
     txn->blocks = NULL;
     while (tb) {
         n = tb->next;
+        free(tb->delta);
         free(tb);
         tb = n;
     }
@@ -1443,6 +1443,9 @@ diskfs_bt_run(struct diskfs_bt_op *op)
                         diskfs_bt_complete(op, -1);
                         return;
                     }
+                    if (op->peek) {
+                        op->peek(op, buf, base, idx);
+                    }
                     diskfs_bt_complete(op, diskfs_bt_op_emit(op, buf, base, idx));
                     return;
                 }
@@ -1480,6 +1483,9 @@ diskfs_bt_run(struct diskfs_bt_op *op)
                     diskfs_bt_complete(op, -1);
                     return;
                 }
+                if (op->peek) {
+                    op->peek(op, buf, 0, 0);
+                }
                 diskfs_bt_complete(op, diskfs_bt_op_emit(op, buf, 0, 0));
                 return;
             }
@@ -1542,6 +1548,43 @@ diskfs_bt_lookup_async(
 } /* diskfs_bt_lookup_async */
 
 
+/*
+ * LOOKUP_GE that also hands the leaf it lands on to peek (see
+ * diskfs_bt_peek_t), for callers walking the tree in key order that want to
+ * read ahead of the walk.  Same return convention as diskfs_bt_lookup_async.
+ */
+int
+diskfs_bt_scan_async(
+    struct diskfs_bt_op        *op,
+    struct diskfs_thread       *thread,
+    struct diskfs_inode        *inode,
+    const struct diskfs_bt_key *key,
+    struct diskfs_bt_key       *r_key,
+    void                       *out,
+    uint32_t                    out_cap,
+    diskfs_bt_peek_t            peek,
+    diskfs_bt_cb_t              cb,
+    void                       *private_data)
+{
+    memset(op, 0, sizeof(*op));
+    op->thread       = thread;
+    op->inode        = inode;
+    op->opcode       = DISKFS_BT_OP_LOOKUP_GE;
+    op->phase        = DISKFS_BT_PHASE_DESCEND;
+    op->key          = *key;
+    op->r_key        = r_key;
+    op->out          = out;
+    op->out_cap      = out_cap;
+    op->use_root     = 1;
+    op->cb           = cb;
+    op->peek         = peek;
+    op->private_data = private_data;
+
+    diskfs_bt_run(op);
+    return op->done;
+} /* diskfs_bt_scan_async */
+
+
 int
 diskfs_bt_insert_async(
     struct diskfs_bt_op        *op,
@@ -0,0 +1,239 @@
+// SPDX-FileCopyrightText: 2025-2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * Data-chunk codecs for compressed pools: LZ4 and zstd wrappers, the
+ * per-worker scratch they run in, and the sampling heuristic that lets the
+ * write path store incompressible chunks plain without paying for a failed
+ * compression attempt.  Both codecs are optional at build time; a pool
+ * formatted with a codec this build lacks refuses to mount.
+ */
+
+#include "diskfs_internal.h"
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif /* ifdef HAVE_LZ4 */
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif /* ifdef HAVE_ZSTD */
+
+/* zstd level for chunk compression: the fast end, so compressing a chunk
+ * costs about as much as the block write it shrinks. */
+#define DISKFS_ZSTD_LEVEL       1
+
+/* Sampling: DISKFS_ZSAMPLE_RUNS runs of DISKFS_ZSAMPLE_LEN bytes spread
+ * evenly over the chunk. */
+#define DISKFS_ZSAMPLE_RUNS     16
+#define DISKFS_ZSAMPLE_LEN      64
+
+int
+diskfs_compress_parse(const char *name)
+{
+    if (!name || !strcmp(name, "none")) {
+        return DISKFS_COMPRESS_NONE;
+    }
+    if (!strcmp(name, "lz4")) {
+        return DISKFS_COMPRESS_LZ4;
+    }
+    if (!strcmp(name, "zstd")) {
+        return DISKFS_COMPRESS_ZSTD;
+    }
+    return -1;
+} /* diskfs_compress_parse */
+
+
+const char *
+diskfs_compress_name(int alg)
+{
+    switch (alg) {
+        case DISKFS_COMPRESS_NONE:
+            return "none";
+        case DISKFS_COMPRESS_LZ4:
+            return "lz4";
+        case DISKFS_COMPRESS_ZSTD:
+            return "zstd";
+        default:
+            return "unknown";
+    } /* switch */
+} /* diskfs_compress_name */
+
+
+int
+diskfs_compress_available(int alg)
+{
+    switch (alg) {
+        case DISKFS_COMPRESS_NONE:
+            return 1;
+#ifdef HAVE_LZ4
+        case DISKFS_COMPRESS_LZ4:
+            return 1;
+#endif /* ifdef HAVE_LZ4 */
+#ifdef HAVE_ZSTD
+        case DISKFS_COMPRESS_ZSTD:
+            return 1;
+#endif /* ifdef HAVE_ZSTD */
+        default:
+            return 0;
+    } /* switch */
+} /* diskfs_compress_available */
+
+
+void
+diskfs_compress_thread_init(struct diskfs_thread *thread)
+{
+    if (thread->shared->compression == DISKFS_COMPRESS_NONE) {
+        return;
+    }
+
+    thread->zraw = malloc(DISKFS_ZCHUNK_SIZE);
+    chimera_diskfs_abort_if(!thread->zraw, "compression scratch allocation failed");
+
+#ifdef HAVE_ZSTD
+    if (thread->shared->compression == DISKFS_COMPRESS_ZSTD) {
+        thread->zcctx = ZSTD_createCCtx();
+        thread->zdctx = ZSTD_createDCtx();
+        chimera_diskfs_abort_if(!thread->zcctx || !thread->zdctx,
+                                "zstd context allocation failed");
+    }
+#endif /* ifdef HAVE_ZSTD */
+} /* diskfs_compress_thread_init */
+
+
+void
+diskfs_compress_thread_fini(struct diskfs_thread *thread)
+{
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(thread->zcctx);
+    ZSTD_freeDCtx(thread->zdctx);
+#endif /* ifdef HAVE_ZSTD */
+    thread->zcctx = NULL;
+    thread->zdctx = NULL;
+
+    free(thread->zraw);
+    thread->zraw = NULL;
+} /* diskfs_compress_thread_fini */
+
+
+/*
+ * Cheap compressibility guess from a sample of the chunk: build a byte
+ * histogram over a few evenly spaced runs and count how many distinct byte
+ * values it takes to cover 90% of the sample (the "core set").  Text, logs
+ * and sparse binary data sit well under the cutoff; encrypted or already
+ * compressed data spreads over nearly all 256 values.  An all-one-value
+ * sample (zeros) is trivially compressible.
+ */
+int
+diskfs_compress_worthwhile(
+    const uint8_t *src,
+    uint32_t       len)
+{
+    uint32_t hist[256] = { 0 };
+    uint32_t stride, total = 0, covered = 0, core = 0;
+
+    if (len < DISKFS_ZSAMPLE_RUNS * DISKFS_ZSAMPLE_LEN) {
+        return 1;
+    }
+
+    stride = len / DISKFS_ZSAMPLE_RUNS;
+    for (int r = 0; r < DISKFS_ZSAMPLE_RUNS; r++) {
+        const uint8_t *s = src + (uint64_t) r * stride;
+
+        for (int i = 0; i < DISKFS_ZSAMPLE_LEN; i++) {
+            hist[s[i]]++;
+        }
+        total += DISKFS_ZSAMPLE_LEN;
+    }
+
+    /* Walk the bins from most to least frequent (selection over the
+     * histogram; at most 256 passes, and the common compressible case stops
+     * after a handful). */
+    while (covered * 10 < total * 9) {
+        uint32_t best = 0;
+        int      bi   = 0;
+
+        for (int b = 0; b < 256; b++) {
+            if (hist[b] > best) {
+                best = hist[b];
+                bi   = b;
+            }
+        }
+        covered += best;
+        hist[bi] = 0;
+        core++;
+    }
+
+    return core <= 200;
+} /* diskfs_compress_worthwhile */
+
+
+/*
+ * Compress len bytes at src with the pool's codec into dst (cap bytes).
+ * Returns the compressed size, or 0 if the output would not fit in cap --
+ * the caller sizes cap so a 0 means "would not save a block".
+ */
+uint32_t
+diskfs_compress_chunk(
+    struct diskfs_thread *thread,
+    const uint8_t        *src,
+    uint32_t              len,
+    uint8_t              *dst,
+    uint32_t              cap)
+{
+    switch (thread->shared->compression) {
+#ifdef HAVE_LZ4
+        case DISKFS_COMPRESS_LZ4:
+        {
+            int n = LZ4_compress_default((const char *) src, (char *) dst,
+                                         (int) len, (int) cap);
+
+            return n > 0 ? (uint32_t) n : 0;
+        }
+#endif /* ifdef HAVE_LZ4 */
+#ifdef HAVE_ZSTD
+        case DISKFS_COMPRESS_ZSTD:
+        {
+            size_t n = ZSTD_compressCCtx(thread->zcctx, dst, cap, src, len,
+                                         DISKFS_ZSTD_LEVEL);
+
+            return ZSTD_isError(n) ? 0 : (uint32_t) n;
+        }
+#endif /* ifdef HAVE_ZSTD */
+        default:
+            return 0;
+    } /* switch */
+} /* diskfs_compress_chunk */
+
+
+/* Decompress clen bytes at src, which must expand to exactly rlen bytes at
+ * dst.  Returns 0 on success, -1 on a corrupt chunk or an unsupported
+ * algorithm. */
+int
+diskfs_decompress_chunk(
+    struct diskfs_thread *thread,
+    int                   alg,
+    const uint8_t        *src,
+    uint32_t              clen,
+    uint8_t              *dst,
+    uint32_t              rlen)
+{
+    switch (alg) {
+#ifdef HAVE_LZ4
+        case DISKFS_COMPRESS_LZ4:
+            return LZ4_decompress_safe((const char *) src, (char *) dst,
+                                       (int) clen, (int) rlen) == (int) rlen ? 0 : -1;
+#endif /* ifdef HAVE_LZ4 */
+#ifdef HAVE_ZSTD
+        case DISKFS_COMPRESS_ZSTD:
+        {
+            size_t n = ZSTD_decompressDCtx(thread->zdctx, dst, rlen, src, clen);
+
+            return (!ZSTD_isError(n) && n == rlen) ? 0 : -1;
+        }
+#endif /* ifdef HAVE_ZSTD */
+        default:
+            return -1;
+    } /* switch */
+} /* diskfs_decompress_chunk */
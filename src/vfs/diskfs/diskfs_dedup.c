@@ -0,0 +1,518 @@
+// SPDX-FileCopyrightText: 2025-2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * Data deduplication index: the pool-level fingerprint -> chunk and
+ * chunk -> reference-count records kept in the b+tree of the reserved inode
+ * DISKFS_DEDUP_INUM (see diskfs_internal.h), and the shared free path that
+ * routes a deduplicated extent's backing through its reference count.  Every
+ * operation joins the caller's txn, so the index moves atomically with the
+ * extent records that reference it.
+ */
+
+#include "diskfs_internal.h"
+
+static inline struct diskfs_bt_key
+diskfs_dedup_fp_key(uint64_t hash)
+{
+    struct diskfs_bt_key k = { .type = DISKFS_REC_DEDUP_FP, .subkey = hash };
+
+    return k;
+} /* diskfs_dedup_fp_key */
+
+
+static inline struct diskfs_bt_key
+diskfs_dedup_ref_key(
+    uint32_t device_id,
+    uint64_t device_offset)
+{
+    struct diskfs_bt_key k = {
+        .type   = DISKFS_REC_DEDUP_REF,
+        .subkey = diskfs_dedup_ref_subkey(device_id, device_offset),
+    };
+
+    return k;
+} /* diskfs_dedup_ref_key */
+
+
+static struct diskfs_dedup_op *
+diskfs_dedup_op_new(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    void (               *done )(void *priv, int status),
+    void                 *priv)
+{
+    struct diskfs_dedup_op *d = calloc(1, sizeof(*d));
+
+    d->thread = thread;
+    d->txn    = txn;
+    d->done   = done;
+    d->priv   = priv;
+    return d;
+} /* diskfs_dedup_op_new */
+
+
+static void
+diskfs_dedup_op_finish(
+    struct diskfs_dedup_op *d,
+    int                     status)
+{
+    void (*done)(void *, int) = d->done;
+    void *priv                = d->priv;
+
+    free(d);
+    done(priv, status);
+} /* diskfs_dedup_op_finish */
+
+
+/* A b+tree update of the index failed partway through an operation; the
+ * caller aborts its txn, taking the index back to where it started. */
+static void
+diskfs_dedup_fail(
+    struct diskfs_dedup_op *d,
+    const char             *what,
+    int                     result)
+{
+    chimera_diskfs_error("dedup: %s for chunk %u:%lu failed: %d",
+                         what, d->device_id, d->device_offset, result);
+    diskfs_dedup_op_finish(d, DISKFS_DEDUP_EIO);
+} /* diskfs_dedup_fail */
+
+
+/* Take the index inode into the txn (a no-op when it already holds it). */
+static void
+diskfs_dedup_acquire(
+    struct diskfs_dedup_op *d,
+    diskfs_inode_cb_t       cb)
+{
+    diskfs_inode_acquire(d->thread, d->txn, NULL, DISKFS_DEDUP_INUM,
+                         DISKFS_DEDUP_GEN, DISKFS_INODE_LOCK_WRITE, cb, d);
+} /* diskfs_dedup_acquire */
+
+
+/* Replace a REF record with d->ref (remove, then insert at the same key). */
+static void
+diskfs_dedup_ref_put_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        diskfs_dedup_fail(d, "reference insert", result);
+        return;
+    }
+
+    diskfs_dedup_op_finish(d, 1);
+} /* diskfs_dedup_ref_put_cb */
+
+
+static void
+diskfs_dedup_ref_put(struct diskfs_dedup_op *d)
+{
+    struct diskfs_bt_op *op  = diskfs_bt_op_alloc(d->thread);
+    struct diskfs_bt_key key = diskfs_dedup_ref_key(d->device_id, d->device_offset);
+
+    if (diskfs_bt_insert_async(op, d->thread, d->txn, d->index, &key,
+                               &d->ref, sizeof(d->ref),
+                               diskfs_dedup_ref_put_cb, d)) {
+        diskfs_dedup_ref_put_cb(op, op->result, d);
+    }
+} /* diskfs_dedup_ref_put */
+
+
+/* ------------------------------------------------------------------ */
+/* Lookup: find a stored chunk by fingerprint and take a reference     */
+/* ------------------------------------------------------------------ */
+
+static void
+diskfs_dedup_lookup_ref_removed_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        diskfs_dedup_fail(d, "reference remove", result);
+        return;
+    }
+
+    d->ref.refs++;
+    diskfs_dedup_ref_put(d);
+} /* diskfs_dedup_lookup_ref_removed_cb */
+
+
+static void
+diskfs_dedup_lookup_ref_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0 || d->ref.hash != d->hash) {
+        /* The fingerprint names a chunk with no reference record: the index
+         * is inconsistent.  Don't reference it, and don't re-index the hash
+         * either (its FP slot is taken). */
+        chimera_diskfs_error("dedup: chunk %u:%lu has no reference record",
+                             d->device_id, d->device_offset);
+        diskfs_dedup_op_finish(d, -1);
+        return;
+    }
+
+    *d->r_device_id     = d->fp.device_id;
+    *d->r_device_offset = d->fp.device_offset;
+    *d->r_flags         = d->fp.flags;
+
+    op = diskfs_bt_op_alloc(d->thread);
+    {
+        struct diskfs_bt_key key = diskfs_dedup_ref_key(d->device_id,
+                                                        d->device_offset);
+
+        if (diskfs_bt_remove_async(op, d->thread, d->txn, d->index, &key,
+                                   diskfs_dedup_lookup_ref_removed_cb, d)) {
+            diskfs_dedup_lookup_ref_removed_cb(op, op->result, d);
+        }
+    }
+} /* diskfs_dedup_lookup_ref_cb */
+
+
+static void
+diskfs_dedup_lookup_fp_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        diskfs_dedup_op_finish(d, 0);
+        return;
+    }
+
+    if (d->fp.hash_hi != d->hash_hi) {
+        /* Same low 64 bits, different chunk: leave the incumbent indexed and
+         * store this one unshared. */
+        diskfs_dedup_op_finish(d, -1);
+        return;
+    }
+
+    d->device_id     = d->fp.device_id;
+    d->device_offset = d->fp.device_offset;
+
+    op = diskfs_bt_op_alloc(d->thread);
+    {
+        struct diskfs_bt_key key = diskfs_dedup_ref_key(d->device_id,
+                                                        d->device_offset);
+
+        if (diskfs_bt_lookup_async(op, d->thread, d->index,
+                                   DISKFS_BT_OP_LOOKUP_EXACT, &key, NULL,
+                                   &d->ref, sizeof(d->ref),
+                                   diskfs_dedup_lookup_ref_cb, d)) {
+            diskfs_dedup_lookup_ref_cb(op, op->result, d);
+        }
+    }
+} /* diskfs_dedup_lookup_fp_cb */
+
+
+static void
+diskfs_dedup_lookup_acquired_cb(
+    struct diskfs_inode *index,
+    int                  status,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d   = priv;
+    struct diskfs_bt_key    key = diskfs_dedup_fp_key(d->hash);
+    struct diskfs_bt_op    *op;
+
+    chimera_diskfs_abort_if(status != CHIMERA_VFS_OK,
+                            "dedup index inode acquire failed: %d", status);
+    d->index = index;
+
+    op = diskfs_bt_op_alloc(d->thread);
+    if (diskfs_bt_lookup_async(op, d->thread, index, DISKFS_BT_OP_LOOKUP_EXACT,
+                               &key, NULL, &d->fp, sizeof(d->fp),
+                               diskfs_dedup_lookup_fp_cb, d)) {
+        diskfs_dedup_lookup_fp_cb(op, op->result, d);
+    }
+} /* diskfs_dedup_lookup_acquired_cb */
+
+
+/*
+ * Look up a chunk by fingerprint.  done(priv, 1): the chunk is stored at
+ * *r_device_id / *r_device_offset with extent flags *r_flags, and a
+ * reference was taken for the caller's new extent.  done(priv, 0): not
+ * indexed; the caller may store and diskfs_dedup_insert it.  done(priv, -1):
+ * the fingerprint slot is held by a different chunk; store it unshared.
+ * done(priv, DISKFS_DEDUP_EIO): the index update failed; abort the txn.
+ */
+void
+diskfs_dedup_lookup(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    uint64_t              hash,
+    uint64_t              hash_hi,
+    uint32_t             *r_device_id,
+    uint64_t             *r_device_offset,
+    uint32_t             *r_flags,
+    void (               *done )(void *priv, int status),
+    void                 *priv)
+{
+    struct diskfs_dedup_op *d = diskfs_dedup_op_new(thread, txn, done, priv);
+
+    d->hash            = hash;
+    d->hash_hi         = hash_hi;
+    d->r_device_id     = r_device_id;
+    d->r_device_offset = r_device_offset;
+    d->r_flags         = r_flags;
+    diskfs_dedup_acquire(d, diskfs_dedup_lookup_acquired_cb);
+} /* diskfs_dedup_lookup */
+
+
+/* ------------------------------------------------------------------ */
+/* Insert: index a freshly stored chunk                                */
+/* ------------------------------------------------------------------ */
+
+static void
+diskfs_dedup_insert_fp_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        diskfs_dedup_fail(d, "fingerprint insert", result);
+        return;
+    }
+
+    diskfs_dedup_ref_put(d);
+} /* diskfs_dedup_insert_fp_cb */
+
+
+static void
+diskfs_dedup_insert_acquired_cb(
+    struct diskfs_inode *index,
+    int                  status,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d   = priv;
+    struct diskfs_bt_key    key = diskfs_dedup_fp_key(d->hash);
+    struct diskfs_bt_op    *op;
+
+    chimera_diskfs_abort_if(status != CHIMERA_VFS_OK,
+                            "dedup index inode acquire failed: %d", status);
+    d->index = index;
+
+    op = diskfs_bt_op_alloc(d->thread);
+    if (diskfs_bt_insert_async(op, d->thread, d->txn, index, &key,
+                               &d->fp, sizeof(d->fp),
+                               diskfs_dedup_insert_fp_cb, d)) {
+        diskfs_dedup_insert_fp_cb(op, op->result, d);
+    }
+} /* diskfs_dedup_insert_acquired_cb */
+
+
+/* Index a chunk just stored at device_id:device_offset with `refs` extent
+ * records pointing at it.  The caller must have had a 0 from
+ * diskfs_dedup_lookup for the hash in this txn.  done(priv, DISKFS_DEDUP_EIO)
+ * if the records could not be written; the txn must then abort. */
+void
+diskfs_dedup_insert(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    uint64_t              hash,
+    uint64_t              hash_hi,
+    uint32_t              device_id,
+    uint64_t              device_offset,
+    uint32_t              flags,
+    uint64_t              refs,
+    void (               *done )(void *priv, int status),
+    void                 *priv)
+{
+    struct diskfs_dedup_op *d = diskfs_dedup_op_new(thread, txn, done, priv);
+
+    d->hash             = hash;
+    d->device_id        = device_id;
+    d->device_offset    = device_offset;
+    d->fp.hash_hi       = hash_hi;
+    d->fp.device_id     = device_id;
+    d->fp.flags         = flags;
+    d->fp.device_offset = device_offset;
+    d->ref.refs         = refs;
+    d->ref.hash         = hash;
+    diskfs_dedup_acquire(d, diskfs_dedup_insert_acquired_cb);
+} /* diskfs_dedup_insert */
+
+
+/* ------------------------------------------------------------------ */
+/* Unref: drop one extent's reference; free the chunk with the last    */
+/* ------------------------------------------------------------------ */
+
+static void
+diskfs_dedup_unref_fp_removed_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        diskfs_dedup_fail(d, "fingerprint remove", result);
+        return;
+    }
+
+    diskfs_thread_free_space(d->thread, d->txn, d->device_id, d->device_offset,
+                             diskfs_ext_phys_len(d->flags, 0));
+    diskfs_dedup_op_finish(d, 0);
+} /* diskfs_dedup_unref_fp_removed_cb */
+
+
+static void
+diskfs_dedup_unref_removed_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        diskfs_dedup_fail(d, "reference remove", result);
+        return;
+    }
+
+    if (d->ref.refs > 1) {
+        d->ref.refs--;
+        diskfs_dedup_ref_put(d);
+        return;
+    }
+
+    /* Last reference: retire the fingerprint, then the blocks. */
+    op = diskfs_bt_op_alloc(d->thread);
+    {
+        struct diskfs_bt_key key = diskfs_dedup_fp_key(d->ref.hash);
+
+        if (diskfs_bt_remove_async(op, d->thread, d->txn, d->index, &key,
+                                   diskfs_dedup_unref_fp_removed_cb, d)) {
+            diskfs_dedup_unref_fp_removed_cb(op, op->result, d);
+        }
+    }
+} /* diskfs_dedup_unref_removed_cb */
+
+
+static void
+diskfs_dedup_unref_looked_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d = priv;
+
+    diskfs_bt_op_free(d->thread, op);
+
+    if (result < 0) {
+        /* Nothing to drop: leaking the chunk is the safe side of an
+         * inconsistent index (another extent may still point at it). */
+        chimera_diskfs_error("dedup: unref of unindexed chunk %u:%lu",
+                             d->device_id, d->device_offset);
+        diskfs_dedup_op_finish(d, 0);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(d->thread);
+    {
+        struct diskfs_bt_key key = diskfs_dedup_ref_key(d->device_id,
+                                                        d->device_offset);
+
+        if (diskfs_bt_remove_async(op, d->thread, d->txn, d->index, &key,
+                                   diskfs_dedup_unref_removed_cb, d)) {
+            diskfs_dedup_unref_removed_cb(op, op->result, d);
+        }
+    }
+} /* diskfs_dedup_unref_looked_cb */
+
+
+static void
+diskfs_dedup_unref_acquired_cb(
+    struct diskfs_inode *index,
+    int                  status,
+    void                *priv)
+{
+    struct diskfs_dedup_op *d   = priv;
+    struct diskfs_bt_key    key = diskfs_dedup_ref_key(d->device_id,
+                                                       d->device_offset);
+    struct diskfs_bt_op    *op;
+
+    chimera_diskfs_abort_if(status != CHIMERA_VFS_OK,
+                            "dedup index inode acquire failed: %d", status);
+    d->index = index;
+
+    op = diskfs_bt_op_alloc(d->thread);
+    if (diskfs_bt_lookup_async(op, d->thread, index, DISKFS_BT_OP_LOOKUP_EXACT,
+                               &key, NULL, &d->ref, sizeof(d->ref),
+                               diskfs_dedup_unref_looked_cb, d)) {
+        diskfs_dedup_unref_looked_cb(op, op->result, d);
+    }
+} /* diskfs_dedup_unref_acquired_cb */
+
+
+void
+diskfs_dedup_unref(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    uint32_t              device_id,
+    uint64_t              device_offset,
+    uint32_t              flags,
+    void (               *done )(void *priv, int status),
+    void                 *priv)
+{
+    struct diskfs_dedup_op *d = diskfs_dedup_op_new(thread, txn, done, priv);
+
+    d->device_id     = device_id;
+    d->device_offset = device_offset;
+    d->flags         = flags;
+    diskfs_dedup_acquire(d, diskfs_dedup_unref_acquired_cb);
+} /* diskfs_dedup_unref */
+
+
+/*
+ * Release the device space behind extent e, which the caller is dropping
+ * whole: a pending free for an ordinary extent (done runs inline), a
+ * reference drop for a deduplicated one.  done(priv, DISKFS_DEDUP_EIO) means
+ * the reference could not be dropped and the txn must not commit.
+ */
+void
+diskfs_ext_free_backing(
+    struct diskfs_thread       *thread,
+    struct diskfs_txn          *txn,
+    const struct diskfs_extent *e,
+    void (                     *done )(void *priv, int status),
+    void                       *priv)
+{
+    if (e->flags & DISKFS_EXT_DEDUP) {
+        diskfs_dedup_unref(thread, txn, e->device_id, e->device_offset,
+                           e->flags, done, priv);
+        return;
+    }
+
+    diskfs_thread_free_space(thread, txn, e->device_id, e->device_offset,
+                             diskfs_ext_phys_len(e->flags, e->length));
+    done(priv, 0);
+} /* diskfs_ext_free_backing */
@@ -0,0 +1,657 @@
+// SPDX-FileCopyrightText: 2025-2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * Background defragmentation: the write-path trigger that queues files which
+ * keep gaining uncoalesced extent records, and the per-reclaim-worker job
+ * that rewrites runs of small extents into single contiguous ones, one
+ * bounded window per transaction, under a byte-rate budget.
+ */
+
+#include "diskfs_internal.h"
+
+static void
+diskfs_defrag_kick(
+    struct diskfs_reclaim_worker *w);
+
+static void
+diskfs_defrag_begin(
+    struct diskfs_defrag *d);
+
+static void
+diskfs_defrag_scan(
+    struct diskfs_defrag *d);
+
+static void
+diskfs_defrag_rewrite(
+    struct diskfs_defrag *d);
+
+static void
+diskfs_defrag_swap(
+    struct diskfs_defrag *d);
+
+
+/*
+ * A plain extent record was just inserted for `inode` without merging into
+ * its predecessor (write path, inode write-locked).  Once a file has gained
+ * DISKFS_DEFRAG_TRIGGER of them and its size spread over them falls below
+ * DISKFS_DEFRAG_TARGET per record, hand it to the defragmenter.
+ */
+void
+diskfs_defrag_note_insert(
+    struct diskfs_thread *thread,
+    struct diskfs_inode  *inode)
+{
+    if (!thread->shared->defrag || inode->defrag_queued) {
+        return;
+    }
+
+    if (++inode->frag_inserts < DISKFS_DEFRAG_TRIGGER ||
+        inode->size / inode->frag_inserts >= DISKFS_DEFRAG_TARGET) {
+        return;
+    }
+
+    diskfs_reclaim_submit_defrag(thread, inode);
+} /* diskfs_defrag_note_insert */
+
+
+/* The job is over (the inode write lock is already released): drop the pin
+ * and start the next queued file. */
+static void
+diskfs_defrag_finish(struct diskfs_defrag *d)
+{
+    struct diskfs_reclaim_worker *w = d->worker;
+
+    if (!d->merged) {
+        diskfs_metric_defrag(d->thread, DISKFS_METRIC_DEFRAG_SKIPPED, 1);
+    }
+
+    w->defrag_active = NULL;
+    diskfs_inode_ref_drop(d->thread, d->inode);
+    free(d);
+    diskfs_defrag_kick(w);
+} /* diskfs_defrag_finish */
+
+
+/* Called with the inode write lock held, once the job knows it is done:
+ * re-arm the write-path trigger. */
+static void
+diskfs_defrag_rearm(struct diskfs_defrag *d)
+{
+    d->inode->defrag_queued = 0;
+    d->inode->frag_inserts  = 0;
+    d->eof                  = 1;
+} /* diskfs_defrag_rearm */
+
+
+static void
+diskfs_defrag_kick(struct diskfs_reclaim_worker *w)
+{
+    struct diskfs_defrag *d = w->defrag_active;
+
+    if (d) {
+        /* Only a parked job (out of budget between windows) can be resumed. */
+        if (!d->parked) {
+            return;
+        }
+        if (w->defrag_stopping) {
+            diskfs_defrag_finish(d);
+            return;
+        }
+        if (w->shared->defrag_rate && w->defrag_budget <= 0) {
+            return;
+        }
+        d->parked = 0;
+        diskfs_defrag_begin(d);
+        return;
+    }
+
+    while ((d = w->defrag_head)) {
+        w->defrag_head = d->next_job;
+        if (!w->defrag_head) {
+            w->defrag_tail = NULL;
+        }
+        d->next_job = NULL;
+
+        if (w->defrag_stopping) {
+            diskfs_inode_ref_drop(d->thread, d->inode);
+            free(d);
+            continue;
+        }
+
+        w->defrag_active = d;
+        if (w->shared->defrag_rate && w->defrag_budget <= 0) {
+            d->parked = 1;       /* the refill timer resumes it */
+            return;
+        }
+        diskfs_defrag_begin(d);
+        return;
+    }
+} /* diskfs_defrag_kick */
+
+
+/* Reclaim-worker side of a DISKFS_RECLAIM_JOB_DEFRAG: queue the pinned inode
+ * behind any file already being worked. */
+void
+diskfs_defrag_enqueue(
+    struct diskfs_reclaim_worker *w,
+    struct diskfs_inode          *inode)
+{
+    struct diskfs_defrag *d = calloc(1, sizeof(*d));
+
+    d->worker = w;
+    d->thread = w->ctx;
+    d->inode  = inode;
+
+    if (w->defrag_tail) {
+        w->defrag_tail->next_job = d;
+    } else {
+        w->defrag_head = d;
+    }
+    w->defrag_tail = d;
+    diskfs_defrag_kick(w);
+} /* diskfs_defrag_enqueue */
+
+
+static void
+diskfs_defrag_timer_cb(
+    struct evpl       *evpl,
+    struct evpl_timer *timer)
+{
+    struct diskfs_reclaim_worker *w = container_of(timer,
+                                                   struct diskfs_reclaim_worker,
+                                                   defrag_timer);
+    int64_t                       refill, cap;
+
+    (void) evpl;
+
+    /* Token bucket: one tick's worth per tick, banking at most a window (so
+     * a rate below one window per tick still makes progress). */
+    refill = (int64_t) (w->shared->defrag_rate * DISKFS_DEFRAG_TICK_US / 1000000);
+    cap    = refill > (int64_t) DISKFS_DEFRAG_WINDOW ? refill
+                                                     : (int64_t) DISKFS_DEFRAG_WINDOW;
+
+    w->defrag_budget += refill;
+    if (w->defrag_budget > cap) {
+        w->defrag_budget = cap;
+    }
+    diskfs_defrag_kick(w);
+} /* diskfs_defrag_timer_cb */
+
+
+void
+diskfs_defrag_worker_init(struct diskfs_reclaim_worker *w)
+{
+    if (!w->shared->defrag || !w->shared->defrag_rate) {
+        return;
+    }
+
+    w->defrag_budget = DISKFS_DEFRAG_WINDOW;
+    evpl_add_timer(w->ctx->evpl, &w->defrag_timer, diskfs_defrag_timer_cb,
+                   DISKFS_DEFRAG_TICK_US);
+} /* diskfs_defrag_worker_init */
+
+
+void
+diskfs_defrag_worker_fini(struct diskfs_reclaim_worker *w)
+{
+    w->defrag_stopping = 1;
+    diskfs_defrag_kick(w);
+
+    while (w->defrag_active) {
+        evpl_continue(w->ctx->evpl);
+    }
+
+    if (w->shared->defrag && w->shared->defrag_rate) {
+        evpl_remove_timer(w->ctx->evpl, &w->defrag_timer);
+    }
+} /* diskfs_defrag_worker_fini */
+
+
+/* ------------------------------------------------------------------ */
+/* One window: lock, find a run, rewrite it, swap the records, commit  */
+/* ------------------------------------------------------------------ */
+
+static void
+diskfs_defrag_next(struct diskfs_defrag *d)
+{
+    struct diskfs_reclaim_worker *w = d->worker;
+
+    if (d->eof || w->defrag_stopping) {
+        diskfs_defrag_finish(d);
+        return;
+    }
+
+    if (w->shared->defrag_rate && w->defrag_budget <= 0) {
+        d->parked = 1;
+        return;
+    }
+
+    diskfs_defrag_begin(d);
+} /* diskfs_defrag_next */
+
+
+static void
+diskfs_defrag_committed_cb(
+    struct diskfs_txn *txn,
+    int                status,
+    void              *priv)
+{
+    (void) txn;
+    (void) status;
+    diskfs_defrag_next((struct diskfs_defrag *) priv);
+} /* diskfs_defrag_committed_cb */
+
+
+/* Give up on this file (the window is abandoned whole; nothing it did is
+ * committed). */
+static void
+diskfs_defrag_abandon(struct diskfs_defrag *d)
+{
+    diskfs_defrag_rearm(d);
+    diskfs_txn_abort(d->txn);
+    diskfs_defrag_finish(d);
+} /* diskfs_defrag_abandon */
+
+
+static void
+diskfs_defrag_acquired_cb(
+    struct diskfs_inode *inode,
+    int                  status,
+    void                *priv)
+{
+    struct diskfs_defrag *d = priv;
+
+    /* Deleted, or no longer a file with extents: nothing to do. */
+    if (status != CHIMERA_VFS_OK || inode->nlink == 0 ||
+        !S_ISREG(inode->mode) || inode->inline_data) {
+        if (status == CHIMERA_VFS_OK) {
+            diskfs_defrag_rearm(d);
+        }
+        diskfs_txn_abort(d->txn);
+        diskfs_defrag_finish(d);
+        return;
+    }
+
+    diskfs_defrag_scan(d);
+} /* diskfs_defrag_acquired_cb */
+
+
+static void
+diskfs_defrag_begin(struct diskfs_defrag *d)
+{
+    d->txn     = diskfs_txn_begin(d->thread, DISKFS_TXN_WRITE);
+    d->scanned = 0;
+    d->n       = 0;
+    diskfs_inode_acquire_pinned(d->thread, d->txn, d->inode,
+                                DISKFS_INODE_LOCK_WRITE,
+                                diskfs_defrag_acquired_cb, d);
+} /* diskfs_defrag_begin */
+
+
+/* Small plain extents are the only ones moved; one already at the target
+ * size ends a run rather than joining it. */
+static inline int
+diskfs_defrag_movable(
+    struct diskfs_shared       *shared,
+    const struct diskfs_extent *e)
+{
+    return e->flags == 0 && e->length < DISKFS_DEFRAG_TARGET &&
+           SM_ALIGN_UP(e->length) <= shared->devices[e->device_id].max_request_size;
+} /* diskfs_defrag_movable */
+
+
+static void
+diskfs_defrag_scanned_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_defrag *d      = priv;
+    struct diskfs_shared *shared = d->thread->shared;
+    struct diskfs_extent  e;
+    int                   have, movable, joins = 0;
+
+    have = diskfs_ext_from_op(op, result, &e);
+    diskfs_bt_op_free(d->thread, op);
+
+    if (!have) {
+        /* End of file: rewrite what the tail run holds, then stop. */
+        diskfs_defrag_rearm(d);
+        if (d->n >= DISKFS_DEFRAG_MIN_EXTENTS) {
+            diskfs_defrag_rewrite(d);
+        } else {
+            diskfs_txn_abort(d->txn);
+            diskfs_defrag_finish(d);
+        }
+        return;
+    }
+
+    d->scanned++;
+    movable = diskfs_defrag_movable(shared, &e);
+
+    if (movable && d->n > 0) {
+        const struct diskfs_extent *last = &d->ext[d->n - 1];
+
+        joins = e.file_offset == last->file_offset + last->length &&
+            d->n < DISKFS_DEFRAG_MAX_EXTENTS &&
+            d->run_bytes + SM_ALIGN_UP(e.length) <= DISKFS_DEFRAG_WINDOW;
+    }
+
+    if (movable && (d->n == 0 || joins)) {
+        if (d->n == 0) {
+            d->run_bytes = 0;
+        }
+        d->ext[d->n++] = e;
+        d->run_bytes  += SM_ALIGN_UP(e.length);
+        d->cursor      = e.file_offset + e.length;
+    } else if (d->n >= DISKFS_DEFRAG_MIN_EXTENTS) {
+        /* e breaks a run worth rewriting; it is examined again next window
+         * (the cursor still points at the run's end). */
+        diskfs_defrag_rewrite(d);
+        return;
+    } else {
+        d->n = 0;
+        if (movable) {
+            d->ext[d->n++] = e;
+            d->run_bytes   = SM_ALIGN_UP(e.length);
+        }
+        d->cursor = e.file_offset + e.length;
+    }
+
+    if (d->scanned < DISKFS_DEFRAG_SCAN_BATCH) {
+        diskfs_defrag_scan(d);
+    } else if (d->n >= DISKFS_DEFRAG_MIN_EXTENTS) {
+        diskfs_defrag_rewrite(d);
+    } else {
+        /* Examined a batch without finding work: release the lock so the
+         * file's own I/O gets a turn, and carry on in a fresh txn. */
+        d->cursor = d->n ? d->ext[0].file_offset : d->cursor;
+        diskfs_txn_abort(d->txn);
+        diskfs_defrag_next(d);
+    }
+} /* diskfs_defrag_scanned_cb */
+
+
+static void
+diskfs_defrag_scan(struct diskfs_defrag *d)
+{
+    struct diskfs_bt_op *op = diskfs_bt_op_alloc(d->thread);
+
+    if (diskfs_ext_ceil_async(op, d->thread, d->inode, d->cursor, d->recbuf,
+                              sizeof(d->recbuf), diskfs_defrag_scanned_cb, d)) {
+        diskfs_defrag_scanned_cb(op, op->result, d);
+    }
+} /* diskfs_defrag_scan */
+
+
+static void
+diskfs_defrag_io_failed(struct diskfs_defrag *d)
+{
+    chimera_diskfs_error("defrag: data I/O failed (%d) on inode %lu; leaving it",
+                         d->status, d->inode->inum);
+    diskfs_defrag_abandon(d);
+} /* diskfs_defrag_io_failed */
+
+
+static void
+diskfs_defrag_write_cb(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct diskfs_defrag *d      = private_data;
+    struct diskfs_thread *thread = d->thread;
+
+    (void) evpl;
+
+    diskfs_pending_io_add(thread, -1);
+    diskfs_io_resume_waiters(thread);
+
+    if (status && !d->status) {
+        d->status = status;
+    }
+    if (--d->pending) {
+        return;
+    }
+
+    evpl_iovecs_release(thread->evpl, d->iov, d->n);
+    if (d->status) {
+        diskfs_defrag_io_failed(d);
+        return;
+    }
+
+    diskfs_defrag_swap(d);
+} /* diskfs_defrag_write_cb */
+
+
+/* Every extent of the run is staged: write them back to back at the new
+ * location, grouped up to the device's request size.  The write is durable
+ * before the swap commits, so a crash leaves the old copy referenced. */
+static void
+diskfs_defrag_write(struct diskfs_defrag *d)
+{
+    struct diskfs_thread *thread = d->thread;
+    struct diskfs_shared *shared = thread->shared;
+    uint64_t              maxreq = shared->devices[d->device_id].max_request_size;
+    uint64_t              off    = 0;
+    int                   g      = 0;
+
+    d->pending = 0;
+
+    while (g < d->n) {
+        uint64_t len = d->iov[g].length;
+        int      k   = 1;
+
+        while (g + k < d->n && len + d->iov[g + k].length <= maxreq) {
+            len += d->iov[g + k].length;
+            k++;
+        }
+
+        d->pending++;
+        diskfs_pending_io_add(thread, 1);
+        diskfs_metric_block_io(thread, DISKFS_METRIC_IO_WRITE,
+                               DISKFS_METRIC_IO_DATA, len);
+        diskfs_metric_block_io_device(thread, d->device_id, DISKFS_METRIC_IO_WRITE,
+                                      DISKFS_METRIC_IO_DATA, len);
+        evpl_block_write(thread->evpl, thread->queue[d->device_id], &d->iov[g], k,
+                         d->device_offset + off, !shared->unsafe_async,
+                         diskfs_defrag_write_cb, d);
+
+        off += len;
+        g   += k;
+    }
+} /* diskfs_defrag_write */
+
+
+static void
+diskfs_defrag_read_cb(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct diskfs_defrag *d      = private_data;
+    struct diskfs_thread *thread = d->thread;
+
+    (void) evpl;
+
+    diskfs_pending_io_add(thread, -1);
+    diskfs_io_resume_waiters(thread);
+
+    if (status && !d->status) {
+        d->status = status;
+    }
+    if (--d->pending) {
+        return;
+    }
+
+    if (d->status) {
+        evpl_iovecs_release(thread->evpl, d->iov, d->n);
+        diskfs_defrag_io_failed(d);
+        return;
+    }
+
+    diskfs_defrag_write(d);
+} /* diskfs_defrag_read_cb */
+
+
+static void
+diskfs_defrag_alloc_resume(
+    struct diskfs_thread *thread,
+    void                 *arg)
+{
+    (void) thread;
+    diskfs_defrag_rewrite((struct diskfs_defrag *) arg);
+} /* diskfs_defrag_alloc_resume */
+
+
+/*
+ * Rewrite the run ext[0..n) as one extent.  A run whose blocks already sit
+ * back to back on one device only needs its records merged; otherwise it is
+ * copied into a single fresh allocation first.
+ */
+static void
+diskfs_defrag_rewrite(struct diskfs_defrag *d)
+{
+    struct diskfs_thread *thread = d->thread;
+    uint64_t              dev_id, dev_off;
+    int                   i, rc;
+
+    d->next     = 0;
+    d->in_place = 1;
+    for (i = 1; i < d->n; i++) {
+        if (d->ext[i].device_id != d->ext[0].device_id ||
+            d->ext[i].device_offset != d->ext[0].device_offset +
+            (d->ext[i].file_offset - d->ext[0].file_offset)) {
+            d->in_place = 0;
+            break;
+        }
+    }
+
+    if (d->in_place) {
+        d->device_id     = d->ext[0].device_id;
+        d->device_offset = d->ext[0].device_offset;
+        diskfs_defrag_swap(d);
+        return;
+    }
+
+    rc = diskfs_inode_alloc_space(thread, d->txn, d->inode, (int64_t) d->run_bytes,
+                                  0, &dev_id, &dev_off,
+                                  diskfs_defrag_alloc_resume, d);
+    if (rc == SM_AGAIN) {
+        return;
+    }
+    if (rc) {
+        /* Out of space is not an error for an optimization; try later. */
+        diskfs_defrag_abandon(d);
+        return;
+    }
+
+    d->device_id     = dev_id;
+    d->device_offset = dev_off;
+    d->status        = 0;
+    d->pending       = 0;
+
+    for (i = 0; i < d->n; i++) {
+        if (evpl_iovec_alloc(thread->evpl, SM_ALIGN_UP(d->ext[i].length), 4096, 1,
+                             0, &d->iov[i]) <= 0) {
+            evpl_iovecs_release(thread->evpl, d->iov, i);
+            d->status = CHIMERA_VFS_EIO;
+            break;
+        }
+    }
+    if (d->status) {
+        diskfs_defrag_io_failed(d);
+        return;
+    }
+
+    /* Count every read before issuing any, so no completion sees zero early. */
+    d->pending = d->n;
+    for (i = 0; i < d->n; i++) {
+        const struct diskfs_extent *e   = &d->ext[i];
+        uint64_t                    len = d->iov[i].length;
+
+        diskfs_pending_io_add(thread, 1);
+        diskfs_metric_block_io(thread, DISKFS_METRIC_IO_READ,
+                               DISKFS_METRIC_IO_DATA, len);
+        diskfs_metric_block_io_device(thread, e->device_id, DISKFS_METRIC_IO_READ,
+                                      DISKFS_METRIC_IO_DATA, len);
+        evpl_block_read(thread->evpl, thread->queue[e->device_id], &d->iov[i], 1,
+                        e->device_offset, diskfs_defrag_read_cb, d);
+    }
+} /* diskfs_defrag_rewrite */
+
+
+static void
+diskfs_defrag_inserted_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_defrag *d = priv;
+
+    (void) result;
+    diskfs_bt_op_free(d->thread, op);
+
+    diskfs_metric_defrag(d->thread, DISKFS_METRIC_DEFRAG_RUNS, 1);
+    diskfs_metric_defrag(d->thread, DISKFS_METRIC_DEFRAG_EXTENTS, d->n - 1);
+    if (!d->in_place) {
+        diskfs_metric_defrag(d->thread, DISKFS_METRIC_DEFRAG_BYTES, d->run_bytes);
+        d->worker->defrag_budget -= (int64_t) d->run_bytes;
+    }
+    d->merged++;
+    d->n = 0;
+
+    diskfs_txn_commit(d->txn, diskfs_defrag_committed_cb, d);
+} /* diskfs_defrag_inserted_cb */
+
+
+static void
+diskfs_defrag_removed_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *priv)
+{
+    struct diskfs_defrag       *d = priv;
+    const struct diskfs_extent *e = &d->ext[d->next];
+
+    (void) result;
+    diskfs_bt_op_free(d->thread, op);
+
+    if (!d->in_place) {
+        diskfs_thread_free_space(d->thread, d->txn, e->device_id, e->device_offset,
+                                 SM_ALIGN_UP(e->length));
+    }
+
+    d->next++;
+    diskfs_defrag_swap(d);
+} /* diskfs_defrag_removed_cb */
+
+
+/* Drop the run's records one by one, then insert the merged one, all in the
+ * window's txn. */
+static void
+diskfs_defrag_swap(struct diskfs_defrag *d)
+{
+    const struct diskfs_extent *first = &d->ext[0];
+    const struct diskfs_extent *last  = &d->ext[d->n - 1];
+    struct diskfs_bt_op        *op    = diskfs_bt_op_alloc(d->thread);
+
+    if (d->next < d->n) {
+        struct diskfs_bt_key key = diskfs_extent_key(d->ext[d->next].file_offset);
+
+        if (diskfs_bt_remove_async(op, d->thread, d->txn, d->inode, &key,
+                                   diskfs_defrag_removed_cb, d)) {
+            diskfs_defrag_removed_cb(op, op->result, d);
+        }
+        return;
+    }
+
+    if (diskfs_ext_insert_async(op, d->thread, d->txn, d->inode, first->file_offset,
+                                last->file_offset + last->length - first->file_offset,
+                                (uint32_t) d->device_id, d->device_offset, 0,
+                                diskfs_defrag_inserted_cb, d)) {
+        diskfs_defrag_inserted_cb(op, op->result, d);
+    }
+} /* diskfs_defrag_swap */
@@ -247,6 +247,10 @@ diskfs_inode_grant_locked(
         diskfs_metric_inode_cache(thread, DISKFS_METRIC_INODE_CACHE_HIT);
         diskfs_inode_lock_grant(inode, mode);
         diskfs_inode_lru_unlink(shard, inode);     /* busy now, not a candidate */
+        /* A re-reference promotes it to the protected segment once it goes
+         * idle again; the grant its own fault re-drives does not count. */
+        inode->hot  |= !inode->fresh;
+        inode->fresh = 0;
         pthread_mutex_unlock(&shard->lock);
         diskfs_txn_add_slot(txn, inode, mode);
         /* The grant no longer eager-faults the home block: a b+tree modify links
@@ -478,7 +482,7 @@ diskfs_inode_load_sync(
     }
     pthread_mutex_unlock(&shard->lock);
 
-    /* Mirror the singleton ACL/pNFS records onto the freshly-constructed
+    /* Mirror the singleton ACL/pNFS/inline-data records onto the freshly-constructed
      * inode (the runtime fault path does the same through the async b+tree
      * ops), walking the on-disk tree through the pump. */
     if (created) {
@@ -498,6 +502,15 @@ diskfs_inode_load_sync(
             memcpy(inode->pnfs_blob, rec, len);
             inode->pnfs_blob_len = (uint32_t) len;
         }
+
+        if (S_ISREG(di->mode) && shared->dinode_flags &&
+            (di->flags & DISKFS_DINODE_INLINE)) {
+            len = diskfs_bt_lookup_pump(shared, io, buf, &diskfs_inline_key,
+                                        rec, DISKFS_INLINE_MAX);
+            if (len >= 0) {
+                diskfs_inline_install(inode, rec, (uint32_t) len);
+            }
+        }
     }
 
     /* Seed the inode's home block into the block cache from the disk image we
@@ -570,7 +583,7 @@ diskfs_gen_extend(struct diskfs_thread *thread)
     evpl_iovec_alloc(thread->evpl, SM_SUPERBLOCK_SIZE, SM_SUPERBLOCK_SIZE, 1,
                      0, &ge->iov);
     space_map_fill_superblock(shared->space_map, ge->iov.data, shared->fsid,
-                              0 /* dirty */, 0, 0, 0, ge->new_floor,
+                              diskfs_sb_flags(shared), 0, 0, 0, ge->new_floor,
                               shared->fs_table);
 
     evpl_block_write(thread->evpl, thread->queue[0], &ge->iov, 1,
@@ -237,6 +237,9 @@ struct diskfs_request_private {
     uint64_t                    rd_hash;
     uint64_t                    rd_inum;
     uint32_t                    rd_gen;
+    /* readdir look-ahead: dirents below this hash have had their child inode
+     * blocks read ahead (see diskfs_readdir_peek). */
+    uint64_t                    rd_ra_hash;
     /* rename(2) descendant-loop check: cursor inum/gen of the destination
      * parent's ancestor currently being examined, and the walk depth. */
     uint64_t                    anc_inum;
@@ -327,6 +330,48 @@ struct diskfs_request_private {
     uint32_t                    ci_devid, ci_flags;
     void                        (*ci_cont)(
         struct chimera_vfs_request *);
+
+    /* Inline-data record replace / conversion (diskfs_inline_store,
+     * diskfs_inline_convert): what runs once the b+tree holds the new record,
+     * the record image that then becomes the inode's mirror (NULL: no record),
+     * and the block-0 buffer a conversion writes.  inline_dirty marks that the
+     * record changed, so the inode block must stay in the txn. */
+    void                        (*inline_cont)(
+        struct chimera_vfs_request *);
+    uint8_t                    *inline_stage;
+    uint32_t                    inline_stage_len;
+    struct evpl_iovec           inline_blk;
+    int                         inline_dirty;
+
+    /* Compressed / deduplicated write (diskfs_write_z*): zwrite marks a
+     * chunk-aligned write whose chunks were staged in iov[0..niov) (one buffer
+     * per chunk); zc_flags is each chunk's extent flags (0 = stored plain),
+     * zc_next the chunk the current loop is on.  With dedup, zc_hash/_hi is a
+     * full chunk's fingerprint (zc_hashed bit set), zc_dup marks chunks that
+     * are not written because they reference a stored chunk -- one already in
+     * the index (zc_src -1) or an earlier chunk of this write (zc_src = its
+     * index) -- and zc_devid/zc_devoff is where each chunk ends up. */
+    int                         zwrite;
+    int                         zc_next;
+    uint32_t                    zc_flags[DISKFS_ZWRITE_MAX_CHUNKS];
+    uint32_t                    zc_hashed, zc_dup;
+    uint64_t                    zc_hash[DISKFS_ZWRITE_MAX_CHUNKS];
+    uint64_t                    zc_hash_hi[DISKFS_ZWRITE_MAX_CHUNKS];
+    uint64_t                    zc_devoff[DISKFS_ZWRITE_MAX_CHUNKS];
+    uint32_t                    zc_devid[DISKFS_ZWRITE_MAX_CHUNKS];
+    int8_t                      zc_src[DISKFS_ZWRITE_MAX_CHUNKS];
+
+    /* Compressed-extent expansion (diskfs_zx_expand): the aligned range
+     * [zx_alo, zx_ahi) about to be modified, the byte range [zx_lo, zx_hi)
+     * being fully replaced, which end is being probed, the extent being
+     * rewritten plain, its new backing, and what runs afterwards. */
+    uint64_t                    zx_alo, zx_ahi, zx_lo, zx_hi;
+    int                         zx_probe;
+    struct diskfs_extent        zx_ext;
+    struct evpl_iovec           zx_buf;
+    uint64_t                    zx_devid, zx_devoff;
+    void                        (*zx_cont)(
+        struct chimera_vfs_request *);
 };
 
 
@@ -409,6 +454,7 @@ enum diskfs_metric_inode_cache_op {
     DISKFS_METRIC_INODE_CACHE_LOAD,
     DISKFS_METRIC_INODE_CACHE_INSERT,
     DISKFS_METRIC_INODE_CACHE_WAIT,
+    DISKFS_METRIC_INODE_CACHE_GHOST_HIT,
     DISKFS_METRIC_INODE_CACHE_NUM,
 };
 
@@ -420,6 +466,7 @@ enum diskfs_metric_block_cache_op {
     DISKFS_METRIC_BLOCK_CACHE_WAIT,
     DISKFS_METRIC_BLOCK_CACHE_COW,
     DISKFS_METRIC_BLOCK_CACHE_RECYCLE,
+    DISKFS_METRIC_BLOCK_CACHE_GHOST_HIT,
     DISKFS_METRIC_BLOCK_CACHE_NUM,
 };
 
@@ -436,6 +483,17 @@ enum diskfs_metric_mtime_op {
 };
 
 
+/* Background defragmenter: windows rewritten, extent records merged away, data
+ * bytes moved, and candidates dropped (gone, or not fragmented after all). */
+enum diskfs_metric_defrag_op {
+    DISKFS_METRIC_DEFRAG_RUNS,
+    DISKFS_METRIC_DEFRAG_EXTENTS,
+    DISKFS_METRIC_DEFRAG_BYTES,
+    DISKFS_METRIC_DEFRAG_SKIPPED,
+    DISKFS_METRIC_DEFRAG_NUM,
+};
+
+
 enum diskfs_metric_io_dir {
     DISKFS_METRIC_IO_READ,
     DISKFS_METRIC_IO_WRITE,
@@ -474,6 +532,8 @@ struct diskfs_metrics {
     struct prometheus_counter_series   *block_cache_series[DISKFS_METRIC_BLOCK_CACHE_NUM];
     struct prometheus_counter          *mtime;
     struct prometheus_counter_series   *mtime_series[DISKFS_METRIC_MTIME_NUM];
+    struct prometheus_counter          *defrag;
+    struct prometheus_counter_series   *defrag_series[DISKFS_METRIC_DEFRAG_NUM];
     struct prometheus_counter          *block_io_ops;
     struct prometheus_counter_series *block_io_ops_series[DISKFS_METRIC_IO_NUM_DIRS][DISKFS_METRIC_IO_NUM_CLASSES];
     struct prometheus_counter          *block_io_bytes;
@@ -501,6 +561,7 @@ struct diskfs_thread_metrics {
     struct prometheus_counter_instance   *inode_cache[DISKFS_METRIC_INODE_CACHE_NUM];
     struct prometheus_counter_instance   *block_cache[DISKFS_METRIC_BLOCK_CACHE_NUM];
     struct prometheus_counter_instance   *mtime[DISKFS_METRIC_MTIME_NUM];
+    struct prometheus_counter_instance   *defrag[DISKFS_METRIC_DEFRAG_NUM];
     struct prometheus_counter_instance *block_io_ops[DISKFS_METRIC_IO_NUM_DIRS][DISKFS_METRIC_IO_NUM_CLASSES];
     struct prometheus_counter_instance *block_io_bytes[DISKFS_METRIC_IO_NUM_DIRS][DISKFS_METRIC_IO_NUM_CLASSES];
     struct prometheus_counter_instance  **block_io_device_ops;
@@ -620,9 +681,14 @@ struct diskfs_inode {
     uint32_t                    wait_high_water;
 
     /* Eviction: an idle inode (refcnt==1, unlocked) sits on its shard's LRU
-     * as a recycle candidate.  All under the shard lock. */
+     * as a recycle candidate -- the protected segment if hot (re-referenced
+     * since it was faulted, or faulted back in while still a ghost), else
+     * probation.  fresh = just faulted; the acquire it re-drives is not a
+     * re-reference.  All under the shard lock. */
     struct diskfs_inode        *lru_prev, *lru_next;
     int                         on_lru;
+    int                         hot;
+    int                         fresh;
 
     /* Deferred mtime/ctime: a non-FILE_SYNC in-place overwrite bumps the
      * timestamps in memory and links the inode on its shard's mtime-dirty list
@@ -641,6 +707,13 @@ struct diskfs_inode {
      * Mutated only under the inode write lock the data path already holds. */
     struct sm_thread_cache      space_resv;
 
+    /* Background defragmentation (RAM only): plain extent records this file
+     * gained without coalescing since it was last defragmented, and whether a
+     * defrag job (holding a refcnt pin) is queued for it.  Under the inode
+     * write lock. */
+    uint32_t                    frag_inserts;
+    int                         defrag_queued;
+
     /* This inode's 4 KiB metadata home block in the block cache; pinned
      * while the inode is dirty in a transaction.  NULL until first claimed.
      * Directory entries, extents and the symlink target all live as keyed
@@ -657,6 +730,12 @@ struct diskfs_inode {
     uint8_t                    *pnfs_blob;
     uint32_t                    pnfs_blob_len;
 
+    /* Regular file only: mirror of the DISKFS_REC_INLINE record (NULL = the
+     * file's data is in extents).  The buffer is DISKFS_INLINE_MAX bytes so
+     * inline writes update it in place; inline_len is the record length. */
+    uint8_t                    *inline_data;
+    uint32_t                    inline_len;
+
     /* Directory only: parent for ".." resolution (also persisted in dinode). */
     uint64_t                    parent_inum;
     uint32_t                    parent_gen;
@@ -666,8 +745,12 @@ struct diskfs_inode {
 struct diskfs_inode_shard {
     pthread_mutex_t      lock;
     struct rb_tree       inodes;       /* keyed by inum */
-    struct diskfs_inode *lru_head, *lru_tail; /* idle (recycle) candidates, LRU-first */
+    struct diskfs_inode *lru_head, *lru_tail; /* idle probationary candidates, LRU-first */
+    struct diskfs_inode *hot_head, *hot_tail; /* idle protected candidates, LRU-first */
+    uint32_t             nhot;         /* inodes on the protected list */
     uint32_t             ninodes;      /* resident inodes in this shard */
+    uint32_t            *ghost;        /* fingerprints of recently evicted inums */
+    uint32_t             ghost_mask;
     struct diskfs_inode *mdirty_head, *mdirty_tail; /* deferred-mtime queue (FIFO) */
 };
 
@@ -678,6 +761,19 @@ struct diskfs_inode_cache {
 };
 
 
+/*
+ * Scan resistance (2Q-style segmented LRU) for both the inode and block caches.
+ * A first-touch entry is admitted to the probationary segment and promoted to
+ * the protected segment only when it is referenced again while resident, or
+ * when a miss finds its key in the shard's ghost table (it was evicted recently
+ * and came straight back: the working set outgrew probation).  Recycling takes
+ * from probation first, so a one-pass find(1) or backup scan churns only the
+ * probationary side and leaves the hot b+tree interior nodes and inodes alone.
+ * The protected segment is capped at this share of the shard; past it the
+ * protected LRU entry is demoted to probation's MRU end rather than evicted.
+ */
+#define DISKFS_CACHE_PROTECTED_PCT           75
+
 /* Total inode cache target; per-shard cap = total / shards.  Eviction is a
  * soft cap (grows past it when every resident inode is busy -- bounded by the
  * live working set; the A5b waiter turns this into a hard cap). */
@@ -751,11 +847,23 @@ struct diskfs_block {
     int                         pin_count;     /* >0 => pinned, not reclaimable */
     enum diskfs_block_state state;
     uint64_t                    seq;           /* update order for tail-push */
+    /* Delta-redo eligibility (atomics).  home_current = the buffer is known to
+     * equal the durable home copy: set when the block goes idle (pin 0) unless
+     * home_stale, cleared by the txn that takes delta_owner.  home_stale = the
+     * buffer was filled from something other than home (fresh/zeroed claim,
+     * CoW fork, aborted txn) and stays suspect until the tail-pusher writes it
+     * home.  delta_owner = the txn holding this block's base image, or
+     * DISKFS_DELTA_SHARED if another txn attached it before that one logged. */
+    int                         home_current;
+    int                         home_stale;
+    struct diskfs_txn          *delta_owner;
     struct diskfs_block        *hash_next;     /* bucket chain */
     struct diskfs_block        *lru_prev, *lru_next; /* shard LRU (CLEAN + unpinned) */
     struct diskfs_block        *clean_next;    /* atomic clean-return queue */
     struct diskfs_block        *free_next;     /* free_blocks chain (bufless struct) */
     int                         on_lru;        /* 1 iff linked on the shard LRU */
+    int                         hot;           /* LRU segment: 1 protected, 0 probation */
+    int                         fresh;         /* faulted in; re-driven get is no re-reference */
     int                         clean_queued;  /* 1 iff queued on shard clean queue */
 
     /* Continuations blocked on a LOADING block, woken when the read I/O
@@ -776,10 +884,16 @@ struct diskfs_block_shard {
      * non-owning GLOBAL evpl-iovec slice of one of this shard's global_bufs
      * (carved at prealloc, reused across recyclings, never individually freed).
      * The LRU holds only CLEAN, unpinned buffers (recycle candidates), ordered
-     * least-recently-used first. */
+     * least-recently-used first and split into probation and protected
+     * segments (see DISKFS_CACHE_PROTECTED_PCT). */
     struct diskfs_block        *pool;           /* [nblocks] */
-    struct diskfs_block        *lru_head, *lru_tail; /* lru_head = next to recycle */
+    struct diskfs_block        *lru_head, *lru_tail; /* probation; lru_head = next to recycle */
+    struct diskfs_block        *hot_head, *hot_tail; /* protected segment, same order */
     uint32_t                    nblocks;        /* block structs owned by this shard */
+    uint32_t                    hot_count;      /* blocks on the protected segment */
+    uint32_t                    hot_cap;        /* protected cap (DISKFS_CACHE_PROTECTED_PCT) */
+    uint32_t                   *ghost;          /* fingerprints of recently evicted keys */
+    uint32_t                    ghost_mask;
 
     struct diskfs_block_buf    *buffers;        /* [nbuffers] */
     struct diskfs_block_buf    *free_buffers;
@@ -789,7 +903,7 @@ struct diskfs_block_shard {
     uint32_t                    nbuffers;
     uint32_t                    nfree_buffers;
     uint32_t                    pinned;         /* blocks with pin>0; non-atomic, 0<->1 under lock */
-    uint32_t                    lru_count;      /* CLEAN unpinned blocks on the LRU (reclaim candidates) */
+    uint32_t                    lru_count;      /* blocks on either LRU segment (reclaim candidates) */
     uint32_t                    n_bufless;      /* DIAG: blocks on free_blocks (donated buffer to a CoW fork, awaiting re-pair) */
 
     /* Backing storage for this shard's block-buffer slices.  Each entry is a
@@ -887,8 +1001,12 @@ struct diskfs_dinode {
      * within the dinode block; images written before this field read stale
      * block bytes here (the format is unversioned and not migrated). */
     uint64_t alloc_size;
+    uint32_t flags;           /* DISKFS_DINODE_*; valid only with SM_SB_DINODE_FLAGS */
 };
 
+/* dinode.flags bits */
+#define DISKFS_DINODE_INLINE 0x1u   /* data lives in a DISKFS_REC_INLINE record */
+
 
 /* ------------------------------------------------------------------ */
 /* Per-inode b+tree (on-disk, slotted nodes)                           */
@@ -903,6 +1021,9 @@ enum diskfs_bt_rectype {
     DISKFS_REC_XATTR   = 5,
     DISKFS_REC_PNFS    = 6,   /* regular file: opaque pNFS layout blob (flex-files) */
     DISKFS_REC_ACL     = 7,   /* single record: serialized NFSv4/Windows ACL (subkey 0) */
+    DISKFS_REC_INLINE  = 8,   /* regular file: bytes [0, len) of a small file (subkey 0) */
+    DISKFS_REC_DEDUP_FP  = 9, /* dedup index only: subkey = chunk hash (low 64 bits) */
+    DISKFS_REC_DEDUP_REF = 10, /* dedup index only: subkey = diskfs_dedup_ref_subkey() */
 };
 
 
@@ -959,6 +1080,83 @@ struct diskfs_dirent_rec {
                                      *
                                      * written: reads return zeros, the first
                                      * write clears the bit */
+#define DISKFS_EXT_COMPRESSED 0x2u  /* one compressed chunk: see below */
+#define DISKFS_EXT_DEDUP      0x4u  /* backing shared through the dedup index */
+
+/* Extents that are only ever dropped whole: never trimmed, split or
+ * overwritten in place (diskfs_zx_expand rewrites them plain first). */
+#define DISKFS_EXT_WHOLE      (DISKFS_EXT_COMPRESSED | DISKFS_EXT_DEDUP)
+
+/*
+ * Compressed data extents (pool formatted with "compression").  A write that
+ * covers whole DISKFS_ZCHUNK_SIZE logical chunks stores each compressible
+ * chunk as its own extent: file_offset is chunk-aligned, length is the
+ * chunk's logical length, and device_offset points at a diskfs_zchunk_hdr +
+ * payload padded to whole blocks.  The algorithm and the physical block
+ * count ride in the extent flags, so the record format is unchanged.  A
+ * compressed extent is never trimmed, split or overwritten in place:
+ * anything that would touch part of one first rewrites it as a plain extent
+ * (diskfs_zx_expand).  Truncate only shortens its logical length.
+ */
+#define DISKFS_ZCHUNK_SIZE      (64 * 1024)
+#define DISKFS_ZCHUNK_MAGIC     0x4b48435au   /* "ZCHK" */
+#define DISKFS_ZWRITE_MAX_CHUNKS 32
+
+#define DISKFS_EXT_ZALG_SHIFT   4
+#define DISKFS_EXT_ZALG_MASK    0xfu
+#define DISKFS_EXT_ZBLK_SHIFT   8
+#define DISKFS_EXT_ZBLK_MASK    0xffu
+
+/* Pool-wide compression algorithm (mkfs option, kept in the superblock). */
+#define DISKFS_COMPRESS_NONE    0
+#define DISKFS_COMPRESS_LZ4     1
+#define DISKFS_COMPRESS_ZSTD    2
+
+struct diskfs_zchunk_hdr {
+    uint32_t magic;
+    uint32_t clen;      /* compressed payload bytes following the header */
+    uint32_t rlen;      /* decompressed bytes */
+    uint32_t reserved;
+} __attribute__((packed));
+
+/*
+ * Deduplicated data extents (pool formatted with "dedup").  The same whole-
+ * chunk writes that compression handles are fingerprinted (XXH3-128 of the
+ * chunk's logical bytes) and looked up in a pool-level index held in the
+ * b+tree of the reserved inode DISKFS_DEDUP_INUM:
+ *
+ *   DEDUP_FP  hash.lo           -> where the chunk lives (diskfs_dedup_fp_rec)
+ *   DEDUP_REF device location   -> extent records pointing at it + hash.lo
+ *
+ * A hit records an extent pointing at the existing chunk (DISKFS_EXT_DEDUP
+ * plus the stored chunk's own flags) and takes a reference instead of writing.
+ * Freeing a DEDUP extent drops a reference (diskfs_dedup_unref); the chunk's
+ * blocks go back to the space map with the last one.  DEDUP extents are
+ * always whole chunks on the device, like compressed ones.  The index inode
+ * is acquired after every file inode in a txn, so it never orders before one.
+ */
+#define DISKFS_DEDUP_INUM       2   /* bootstrap slot (was the static root) */
+#define DISKFS_DEDUP_GEN        1
+
+struct diskfs_dedup_fp_rec {
+    uint64_t hash_hi;   /* high 64 bits of the chunk hash */
+    uint32_t device_id;
+    uint32_t flags;     /* extent flags of the stored chunk (DEDUP set) */
+    uint64_t device_offset;
+} __attribute__((packed));
+
+struct diskfs_dedup_ref_rec {
+    uint64_t refs;
+    uint64_t hash;      /* the chunk's DEDUP_FP subkey */
+} __attribute__((packed));
+
+static inline uint64_t
+diskfs_dedup_ref_subkey(
+    uint32_t device_id,
+    uint64_t device_offset)
+{
+    return ((uint64_t) device_id << 48) | (device_offset >> SM_BLOCK_SHIFT);
+} /* diskfs_dedup_ref_subkey */
 
 struct diskfs_extent_rec {
     uint64_t length;
@@ -968,6 +1166,41 @@ struct diskfs_extent_rec {
 } __attribute__((packed));
 
 
+static inline uint32_t
+diskfs_ext_zflags(
+    int      alg,
+    uint32_t blocks)
+{
+    return DISKFS_EXT_COMPRESSED |
+           ((uint32_t) alg << DISKFS_EXT_ZALG_SHIFT) |
+           (blocks << DISKFS_EXT_ZBLK_SHIFT);
+} /* diskfs_ext_zflags */
+
+static inline int
+diskfs_ext_zalg(uint32_t flags)
+{
+    return (flags >> DISKFS_EXT_ZALG_SHIFT) & DISKFS_EXT_ZALG_MASK;
+} /* diskfs_ext_zalg */
+
+/* Device bytes backing an extent: the whole-block rounding of its logical
+ * length, the recorded block count of a compressed chunk, or the full chunk
+ * behind a deduplicated one (its logical length may have been truncated). */
+static inline uint64_t
+diskfs_ext_phys_len(
+    uint32_t flags,
+    uint64_t length)
+{
+    if (flags & DISKFS_EXT_COMPRESSED) {
+        return (uint64_t) ((flags >> DISKFS_EXT_ZBLK_SHIFT) &
+                           DISKFS_EXT_ZBLK_MASK) * SM_BLOCK_SIZE;
+    }
+    if (flags & DISKFS_EXT_DEDUP) {
+        return DISKFS_ZCHUNK_SIZE;
+    }
+    return SM_ALIGN_UP(length);
+} /* diskfs_ext_phys_len */
+
+
 struct diskfs_xattr_rec {
     uint32_t name_len;
     uint32_t value_len;
@@ -996,22 +1229,37 @@ struct diskfs_xattr_rec {
 #define DISKFS_ACL_REC_MAX \
         (DISKFS_BT_ROOT_CAP - sizeof(struct diskfs_bt_node_hdr) - sizeof(struct diskfs_bt_lslot))
 
+/*
+ * Inline small-file data.  A regular file whose bytes all lie below
+ * DISKFS_INLINE_MAX keeps them as a single DISKFS_REC_INLINE record in its own
+ * b+tree -- normally the embedded root, so the file costs no data block and a
+ * read is served from the inode block.  The record holds bytes [0, len); any
+ * bytes in [len, size) read as zeros.  An inline file has no EXTENT records.
+ * The first write (or fallocate) reaching past the limit moves the bytes to a
+ * regular block-0 extent and drops the record (diskfs_inline_convert).
+ */
+#define DISKFS_INLINE_MAX 3072
+
 #define DISKFS_ACL_REC_MAX_ACES \
         (((DISKFS_ACL_REC_MAX) -CHIMERA_ACL_SERIAL_HDR) / CHIMERA_ACL_SERIAL_ACE)
 
 
 /*
  * Intent-log redo record, written into the reserved intent-log region.
- * A record is a header followed by num_blocks (block-header, 4 KiB content)
- * pairs, padded to a 4 KiB multiple.  Full-block redo: the record carries
- * the entire post-image of every dirty block in the transaction.
+ * A record is a header followed by num_blocks block headers and the block
+ * contents, padded to a 4 KiB multiple.  Each block is logged either as its
+ * full 4 KiB post-image or -- when the block was home at the time the txn
+ * first touched it and only a few bytes changed -- as a delta: the changed
+ * byte runs against that home image (see diskfs_redo_run).
  */
 #define DISKFS_REDO_MAGIC 0x4F44455246534944ULL     /* "DISFREDO" */
 
 
 /*
- * Redo record on-log layout: this header, then num_blocks
- * {diskfs_redo_block_header, 4 KiB image} pairs, padded to a 4 KiB multiple.
+ * Redo record on-log layout: this header, the num_blocks per-block headers,
+ * the num_deltas space-map deltas, then delta_bytes of block delta payload
+ * (each delta block's runs, in block-header order), padded to 4 KiB; then one
+ * 4 KiB image per full (delta_len == 0) block, in block-header order.
  *
  * `magic` is the scan signature and `csum_{lo,hi}` is an XXH3-128 over the
  * entire record (reclen bytes) computed with the csum fields zeroed.  Together
@@ -1031,19 +1279,46 @@ struct diskfs_redo_header {
     uint32_t num_blocks;
     uint32_t reclen;       /* total record length, including padding */
     uint32_t num_deltas;   /* space-map deltas carried in this record */
-    uint32_t pad0;
+    uint32_t delta_bytes;  /* block delta payload in the header region */
 };
 
 
+/* block_csum is the XXH3-128 of the block's full post-image for both kinds:
+ * recovery checks a delta by hashing the image it reconstructs. */
 struct diskfs_redo_block_header {
     uint32_t device_id;
-    uint32_t pad;
+    uint32_t delta_len;    /* 0 = full image; else bytes of runs in the payload */
     uint64_t device_offset;
     uint64_t block_csum_lo;
     uint64_t block_csum_hi;
 };
 
 
+/*
+ * One changed byte range of a delta-logged block: the header is followed by
+ * len bytes to store at off.  A block's runs are ascending and disjoint.
+ */
+struct diskfs_redo_run {
+    uint16_t off;
+    uint16_t len;
+};
+
+/* Delta logging limits.  A block whose runs would exceed DISKFS_REDO_DELTA_MAX
+ * bytes is logged full (the saving no longer pays for the worker-side diff),
+ * and one txn carries at most DISKFS_REDO_DELTA_TXN_MAX bytes of delta payload
+ * so its header region stays a single modest iovec.  Runs separated by fewer
+ * than DISKFS_REDO_RUN_GAP unchanged bytes are merged. */
+#define DISKFS_REDO_DELTA_MAX     1024
+#define DISKFS_REDO_DELTA_TXN_MAX (64 * 1024)
+#define DISKFS_REDO_RUN_GAP       16
+
+/* Header-region cap for a grouped record (a lone txn may exceed it). */
+#define DISKFS_REDO_HDR_BATCH_MAX (128 * 1024)
+
+/* delta_owner marker: more than one txn attached the block before it logged. */
+#define DISKFS_DELTA_SHARED       ((struct diskfs_txn *) 1)
+
+
 /*
  * A space-map delta carried inline in the redo record (header region, after the
  * per-block headers, before the block images).  This is what lets the allocator
@@ -1081,6 +1356,12 @@ struct diskfs_txn_block {
     struct diskfs_block_buf *snap_buf;
     uint64_t                 snap_csum_lo;
     uint64_t                 snap_csum_hi;
+    /* Delta redo: delta_base is the block's home image copied when this txn
+     * first attached it (NULL = log full); at commit the runs that differ from
+     * the snapshot are encoded into delta (delta_len bytes, 0 = full). */
+    uint8_t                 *delta_base;
+    uint8_t                 *delta;
+    uint32_t                 delta_len;
     struct diskfs_txn_block *next;
 };
 
@@ -1147,6 +1428,10 @@ struct diskfs_txn {
     struct diskfs_txn_free  *pending_frees; /* ranges freed, applied on commit */
     struct diskfs_txn_delta *space_deltas;  /* ALLOC deltas, serialized into redo */
     uint32_t                 n_space_deltas; /* count of space_deltas (alloc) */
+    /* Redo sizing, fixed at commit snapshot: blocks logged as full images and
+     * total delta payload bytes of the rest. */
+    uint32_t                 redo_full_blocks;
+    uint32_t                 redo_delta_bytes;
 
     /* When the IL submission queue is full, the commit parks on its worker's
      * commit-wait FIFO (carrying its completion cb) instead of spinning the
@@ -1254,6 +1539,11 @@ struct diskfs_il_record {
     uint64_t                  reclen;
     uint32_t                  num_blocks;
     uint32_t                  niov;      /* 1 + num_blocks */
+    /* What is actually written to the log: iovs[0] plus the full-image blocks'
+     * iovs (delta blocks travel inside the header region).  Shallow copies of
+     * iovs[] entries; iovs[] stays indexed by block for the tail-pusher. */
+    struct evpl_iovec        *log_iovs;
+    uint32_t                  log_niov;
     /* Scatter-gather image of the on-log record: iovs[0] is the 4 KiB-aligned
     * header region (redo_header + per-block headers); iovs[1..num_blocks] are
     * zero-copy refs (clones) of the cache blocks' buffers.  The same refs are
@@ -1517,6 +1807,11 @@ struct diskfs_shared {
     int                         orphans_scanned;   /* mount-time orphan recovery done */
     int                         unsafe_async;      /* config opt-in: submit block writes without FUA/sync (no crash safety) */
     int                         noatime;           /* config opt-in: never update atime on read (default: relatime) */
+    int                         inline_data;       /* store files up to DISKFS_INLINE_MAX in the inode block (default on) */
+    int                         dinode_flags;      /* pool formatted with dinode.flags (SM_SB_DINODE_FLAGS); else they are ignored */
+    int                         redo_delta;        /* log small block changes as byte-run deltas (default on) */
+    int                         compression;       /* DISKFS_COMPRESS_*: chunk codec for new data (mkfs option, in the superblock) */
+    int                         dedup;             /* fingerprint whole-chunk writes against the dedup index (mkfs option, in the superblock) */
     uint64_t                    mtime_defer_us;    /* coalesce non-FILE_SYNC in-place mtime updates: flush each dirty inode at most once per this many us (0 = disabled, log every write); default 1s */
     int                         mounted;           /* 1 = remounted existing FS (enables inode read-back) */
     uint64_t                    intent_log_size;   /* config knob (0 -> default at parse); persisted in the superblock */
@@ -1531,6 +1826,11 @@ struct diskfs_shared {
      * maintenance) runs here, off the request workers' hot path. */
     struct diskfs_reclaim      *reclaim;
     uint32_t                    reclaim_threads;   /* config knob (0 = default) */
+    uint32_t                    recovery_threads;  /* crash-replay workers (0 = default) */
+    int                         defrag;            /* config opt-in: background defragmenter */
+    uint64_t                    defrag_rate;       /* bytes/s rewritten per reclaim worker */
+    char                       *warm_manifest;     /* warm-cache manifest path (NULL = off) */
+    uint32_t                    warm_interval;     /* seconds between periodic saves (0 = unmount only) */
     /* Inode-generation epoch: every generation is drawn from this global
      * monotonic counter; gen_floor is the durably-persisted bound
      * (reserve-ahead) that no issued generation may reach.  A reused inode
@@ -1548,12 +1848,29 @@ struct diskfs_shared {
 };
 
 
+/* Superblock flags every rewrite must carry (the mkfs-time codec, dedup mode
+ * and dinode format); callers OR in SM_SB_CLEAN where it applies. */
+static inline uint64_t
+diskfs_sb_flags(const struct diskfs_shared *shared)
+{
+    return ((uint64_t) shared->compression << SM_SB_COMPRESS_SHIFT) |
+           (shared->dedup ? SM_SB_DEDUP : 0) |
+           (shared->dinode_flags ? SM_SB_DINODE_FLAGS : 0);
+} /* diskfs_sb_flags */
+
+
 struct diskfs_thread {
     struct evpl                 *evpl;
     struct diskfs_shared        *shared;
     struct evpl_block_queue    **queue;
     struct evpl_iovec            zero;
     struct evpl_iovec            pad;
+    /* Compression scratch (diskfs_compress.c), set up only on a compressed
+     * pool: a DISKFS_ZCHUNK_SIZE staging buffer for compress input and
+     * decompress output, plus the codec's reusable contexts. */
+    uint8_t                     *zraw;
+    void                        *zcctx;
+    void                        *zdctx;
     int                          thread_id;
     struct slab_allocator       *allocator;
     struct sm_reservation        meta_resv;        /* per-thread metadata bump reservation */
@@ -1638,6 +1955,18 @@ typedef void (*diskfs_bt_cb_t)(
     int                  result,
     void                *private_data);
 
+/*
+ * Look-ahead hook for a scan (diskfs_bt_scan_async): handed the pinned leaf
+ * holding the emitted slot idx just before the op completes, so the caller
+ * can read ahead on the records that follow and on h->next_leaf.  Must not
+ * block or touch the b+tree.
+ */
+typedef void (*diskfs_bt_peek_t)(
+    struct diskfs_bt_op *op,
+    void                *buf,
+    uint32_t             base,
+    int                  idx);
+
 
 enum diskfs_bt_opcode {
     DISKFS_BT_OP_LOOKUP_EXACT,
@@ -1718,6 +2047,7 @@ struct diskfs_bt_op {
      * deferred it); a fully-resident traversal completes inline and reports
      * via `done`/`result` so callers can iterate without recursing. */
     diskfs_bt_cb_t            cb;
+    diskfs_bt_peek_t          peek;        /* scan look-ahead (NULL = none) */
     void                     *private_data;
     int                       suspended;
     int                       done;
@@ -1811,6 +2141,25 @@ struct diskfs_block_load {
 };
 
 
+/* Longest run of device-contiguous blocks one prefetch read fills (see
+ * diskfs_block_prefetch). */
+#define DISKFS_BLOCK_PREFETCH_MAX 32
+
+/* Most child inodes one readdir look-ahead batch reads ahead. */
+#define DISKFS_READDIR_RA_MAX     64
+
+struct diskfs_block_prefetch {
+    struct diskfs_thread *thread;     /* worker that issued the read */
+    void                  (*done)(
+        struct diskfs_thread *,
+        void *);
+    void                 *arg;
+    uint32_t              nblk;
+    struct diskfs_block  *blk[DISKFS_BLOCK_PREFETCH_MAX];
+    struct evpl_iovec     iov[DISKFS_BLOCK_PREFETCH_MAX];
+};
+
+
 /*
  * Ensure a write-locked inode's home block is resident + pinned + attached to
  * the txn, then fire cb(inode, OK, private_data).  The block read (on a cache
@@ -1849,6 +2198,34 @@ struct diskfs_orphan_op {
 };
 
 
+/* One dedup-index operation (diskfs_dedup_*): lookup-and-reference, insert,
+ * or unreference.  Heap-allocated per call; the index inode is taken into the
+ * caller's txn. */
+struct diskfs_dedup_op {
+    struct diskfs_thread       *thread;
+    struct diskfs_txn          *txn;
+    struct diskfs_inode        *index;
+    uint64_t                    hash, hash_hi;
+    uint32_t                    device_id, flags;
+    uint64_t                    device_offset;
+    uint32_t                   *r_device_id;
+    uint64_t                   *r_device_offset;
+    uint32_t                   *r_flags;
+    struct diskfs_dedup_fp_rec  fp;
+    struct diskfs_dedup_ref_rec ref;
+    struct diskfs_bt_key        found_key;
+    void                        (*done)(
+        void *priv,
+        int   status);
+    void                       *priv;
+};
+
+/* done() status of a dedup-index operation (and of diskfs_ext_free_backing)
+ * whose b+tree update failed: the index no longer agrees with the extent
+ * records the caller is changing, so the caller must abort its txn. */
+#define DISKFS_DEDUP_EIO (-2)
+
+
 /* ------------------------------------------------------------------ */
 /* Background drainer: reclaim a large deleted inode incrementally.     */
 /*                                                                      */
@@ -1907,6 +2284,7 @@ struct diskfs_drain {
 enum diskfs_reclaim_job_type {
     DISKFS_RECLAIM_JOB_DRAIN = 0,   /* burn down a deleted inode */
     DISKFS_RECLAIM_JOB_CONDENSE,    /* condense an AG's allocation log */
+    DISKFS_RECLAIM_JOB_DEFRAG,      /* coalesce a fragmented file's extents */
 };
 
 
@@ -1916,6 +2294,7 @@ struct diskfs_reclaim_job {
     uint32_t                   gen;          /* DRAIN */
     uint32_t                   device_id;    /* CONDENSE */
     uint32_t                   ag_index;     /* CONDENSE */
+    struct diskfs_inode       *inode;        /* DEFRAG (refcnt-pinned) */
     struct diskfs_reclaim_job *next;
 };
 
@@ -1930,6 +2309,20 @@ struct diskfs_reclaim_worker {
     struct diskfs_reclaim_job *tail;
     int                        condenses;  /* condense jobs in flight here */
     int                        ready;      /* atomic: context constructed */
+    /* Defragmenter (diskfs_defrag.c): FIFO of queued files, the one being
+     * worked, and the rate limiter's byte budget, refilled by defrag_timer. */
+    struct diskfs_defrag      *defrag_head;
+    struct diskfs_defrag      *defrag_tail;
+    struct diskfs_defrag      *defrag_active;
+    int64_t                    defrag_budget;
+    int                        defrag_stopping;
+    struct evpl_timer          defrag_timer;
+    /* Warm-cache manifest (diskfs_warm.c), worker 0 only: the mount-time
+     * prefetch in progress, and the periodic save timer. */
+    uint32_t                   index;
+    struct diskfs_warm        *warm;
+    int                        warm_stopping;
+    struct evpl_timer          warm_timer;
 };
 
 
@@ -1941,6 +2334,101 @@ struct diskfs_reclaim {
 };
 
 
+/* ------------------------------------------------------------------ */
+/* Background defragmentation                                           */
+/*                                                                      */
+/* The write path counts plain extent records a file gains without     */
+/* coalescing; once a file has gained enough of them relative to its    */
+/* size it is pinned and queued on a reclaim worker.  The worker walks  */
+/* its extents in bounded windows: a run of small, file-contiguous      */
+/* plain extents is copied into one fresh allocation (written durable   */
+/* first) and its records are swapped for a single record in one txn,  */
+/* holding the inode write lock for that window only.  Compressed,      */
+/* shared and unwritten extents are left alone.                         */
+/* ------------------------------------------------------------------ */
+
+#define DISKFS_DEFRAG_TRIGGER       64           /* uncoalesced inserts before a look */
+#define DISKFS_DEFRAG_TARGET        (1ULL << 20) /* wanted bytes per extent record */
+#define DISKFS_DEFRAG_WINDOW        (1ULL << 20) /* max bytes rewritten per txn */
+#define DISKFS_DEFRAG_MAX_EXTENTS   32           /* max records merged per txn */
+#define DISKFS_DEFRAG_MIN_EXTENTS   4            /* shortest run worth rewriting */
+#define DISKFS_DEFRAG_SCAN_BATCH    64           /* extents examined per txn */
+#define DISKFS_DEFRAG_TICK_US       100000       /* rate limiter refill period */
+#define DISKFS_DEFRAG_RATE_DEFAULT  32           /* MiB/s per reclaim worker */
+
+
+struct diskfs_defrag {
+    struct diskfs_reclaim_worker *worker;
+    struct diskfs_thread         *thread;
+    struct diskfs_inode          *inode;     /* refcnt-pinned by the submitter */
+    struct diskfs_txn            *txn;
+    uint64_t                      cursor;    /* next file offset to examine */
+    int                           scanned;   /* extents examined this txn */
+    int                           merged;    /* windows rewritten, whole job */
+    /* The run being assembled / rewritten. */
+    struct diskfs_extent          ext[DISKFS_DEFRAG_MAX_EXTENTS];
+    struct evpl_iovec             iov[DISKFS_DEFRAG_MAX_EXTENTS];
+    int                           n;
+    int                           next;      /* record-swap cursor */
+    int                           pending;   /* data I/Os in flight */
+    int                           status;    /* first data I/O error */
+    int                           in_place;  /* run already physically contiguous */
+    int                           parked;    /* waiting for rate-limiter budget */
+    int                           eof;       /* last window: finish after commit */
+    uint64_t                      run_bytes; /* sum of block-aligned lengths */
+    uint64_t                      device_id;
+    uint64_t                      device_offset;
+    uint8_t                       recbuf[sizeof(struct diskfs_extent_rec)];
+    struct diskfs_defrag         *next_job;
+};
+
+
+/* ------------------------------------------------------------------ */
+/* Warm-cache manifest                                                  */
+/*                                                                      */
+/* A host file (config "warm_manifest") listing the block cache's      */
+/* protected metadata blocks and the hot inodes' numbers, written       */
+/* periodically and at unmount.  After the next mount of the same pool  */
+/* reclaim worker 0 reads it back and prefetches those blocks (inodes   */
+/* through their home blocks) in address order, coalescing contiguous   */
+/* runs into single vectored reads with several in flight, so the      */
+/* first requests after a restart or failover hit a warm cache.        */
+/* ------------------------------------------------------------------ */
+
+#define DISKFS_WARM_MAGIC            0x4d5241574b534944ULL /* "DISKWARM" */
+#define DISKFS_WARM_VERSION          1
+#define DISKFS_WARM_DEPTH            16            /* prefetch reads in flight */
+#define DISKFS_WARM_MAX_ENTRIES      (16U << 20)   /* sanity cap on a manifest */
+#define DISKFS_WARM_INTERVAL_DEFAULT 300           /* seconds between saves */
+
+/* Manifest file: this header, then nblocks block keys, then ninodes inums
+ * (all uint64_t, host order -- the file never leaves the host pair that
+ * mounts the pool).  hash = XXH3-64 over the entries. */
+struct diskfs_warm_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t nblocks;
+    uint64_t fsid;
+    uint32_t ninodes;
+    uint32_t reserved;
+    uint64_t hash;
+} __attribute__((packed));
+
+#define DISKFS_WARM_KEY(device_id, device_offset) \
+        (((uint64_t) (device_id) << 48) | ((device_offset) >> DISKFS_BLOCK_SHIFT))
+#define DISKFS_WARM_KEY_DEVICE(key)  ((uint32_t) ((key) >> 48))
+#define DISKFS_WARM_KEY_OFFSET(key)  (((key) & ((1ULL << 48) - 1)) << DISKFS_BLOCK_SHIFT)
+
+struct diskfs_warm {
+    struct diskfs_reclaim_worker *worker;
+    uint64_t                     *keys;      /* sorted, unique block keys */
+    uint32_t                      nkeys;
+    uint32_t                      next;      /* first key not yet issued */
+    uint32_t                      inflight;  /* prefetch reads outstanding */
+    uint64_t                      loaded;    /* blocks read in */
+};
+
+
 /* ------------------------------------------------------------------ */
 /* AG checkpoint                                                        */
 /*                                                                      */
@@ -2039,8 +2527,11 @@ struct diskfs_inode_load_ctx {
     struct diskfs_inode        *inode;
     int                         acl_len;
     int                         pnfs_len;
+    int                         inline_len;
+    int                         want_inline;  /* dinode has DISKFS_DINODE_INLINE */
     uint8_t                     acl_rec[DISKFS_ACL_REC_MAX];
     uint8_t                     pnfs_rec[CHIMERA_VFS_PNFS_LAYOUT_MAX];
+    uint8_t                     inline_rec[DISKFS_INLINE_MAX];
 };
 
 
@@ -2134,6 +2625,49 @@ struct diskfs_recover_rec {
 };
 
 
+/* Crash-recovery parallelism: the log image is read DISKFS_RECOVER_READ_DEPTH
+ * max-size requests at a time, record headers are scanned and checksummed by
+ * recovery_threads workers over disjoint stripes of the image, and the latest
+ * image of each home block is written by the same number of workers, each on
+ * its own evpl and device queues, DISKFS_RECOVER_WRITE_BATCH writes in flight. */
+#define DISKFS_RECOVER_THREADS_DEFAULT 4
+
+#define DISKFS_RECOVER_THREADS_MAX     32
+
+#define DISKFS_RECOVER_READ_DEPTH      8
+
+#define DISKFS_RECOVER_WRITE_BATCH     64
+
+
+/* One block image carried by an intact record.  Sorted by (device, offset,
+ * rank) so each home block's images sit together in seq order. */
+struct diskfs_recover_blk {
+    uint32_t                               device_id;
+    uint32_t                               rank; /* record's index in seq order */
+    uint64_t                               device_offset;
+    const struct diskfs_redo_block_header *bh;
+    const char                            *img; /* full image, or the delta runs */
+};
+
+
+struct diskfs_recover_worker {
+    struct diskfs_shared      *shared;
+    const char                *log;
+    pthread_t                  thread;
+    /* scan: candidate header offsets in [start, end) */
+    uint64_t                   start;
+    uint64_t                   end;
+    struct diskfs_recover_rec *recs;
+    uint32_t                   nrec;
+    uint32_t                   cap;
+    /* replay: a slice of the sorted images, cut on block boundaries */
+    struct diskfs_recover_blk *blks;
+    uint32_t                   nblk;
+    uint32_t                   nwrite;
+    uint32_t                   nskip;
+};
+
+
 /* ------------------------------------------------------------------ */
 /* Mount-time synchronous block I/O via a transient evpl pump.         */
 /*                                                                     */
@@ -2248,6 +2782,10 @@ static const struct diskfs_bt_key diskfs_pnfs_key = {
     .type = DISKFS_REC_PNFS, .subkey = 0
 };
 
+static const struct diskfs_bt_key diskfs_inline_key = {
+    .type = DISKFS_REC_INLINE, .subkey = 0
+};
+
 /* ------------------------------------------------------------------ */
 /* Cross-file function declarations                                    */
 /* ------------------------------------------------------------------ */
@@ -2347,6 +2885,22 @@ diskfs_block_claim_async(
     void ( *resume )(struct diskfs_thread *, void *),
     void *arg);
 
+/* Fault up to n blocks at consecutive offsets into the cache, unpinned, with
+ * one vectored read: straight to protected if hot (warm-cache manifest), else
+ * admitted to probation like a miss (readdir look-ahead).  Returns the blocks
+ * consumed (>= 1 for n >= 1); *issued says whether a read went out, in which
+ * case done(thread, arg), if set, fires when it lands. */
+uint32_t
+diskfs_block_prefetch(
+    struct diskfs_thread *thread,
+    uint32_t device_id,
+    uint64_t device_offset,
+    uint32_t n,
+    int hot,
+    void ( *done )(struct diskfs_thread *, void *),
+    void *arg,
+    int *issued);
+
 void
 diskfs_block_buf_release(
     struct diskfs_block_buf *buf);
@@ -2548,10 +3102,88 @@ diskfs_orphan_op_start(
     void (               *done )(void *priv),
     void                 *priv);
 
+void
+diskfs_dedup_lookup(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    uint64_t              hash,
+    uint64_t              hash_hi,
+    uint32_t             *r_device_id,
+    uint64_t             *r_device_offset,
+    uint32_t             *r_flags,
+    void (               *done )(void *priv, int status),
+    void                 *priv);
+
+void
+diskfs_dedup_insert(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    uint64_t              hash,
+    uint64_t              hash_hi,
+    uint32_t              device_id,
+    uint64_t              device_offset,
+    uint32_t              flags,
+    uint64_t              refs,
+    void (               *done )(void *priv, int status),
+    void                 *priv);
+
+void
+diskfs_dedup_unref(
+    struct diskfs_thread *thread,
+    struct diskfs_txn    *txn,
+    uint32_t              device_id,
+    uint64_t              device_offset,
+    uint32_t              flags,
+    void (               *done )(void *priv, int status),
+    void                 *priv);
+
+void
+diskfs_ext_free_backing(
+    struct diskfs_thread       *thread,
+    struct diskfs_txn          *txn,
+    const struct diskfs_extent *e,
+    void (                     *done )(void *priv, int status),
+    void                       *priv);
+
 void
 diskfs_reclaim_create(
     struct diskfs_shared *shared);
 
+void
+diskfs_defrag_note_insert(
+    struct diskfs_thread *thread,
+    struct diskfs_inode  *inode);
+
+void
+diskfs_defrag_enqueue(
+    struct diskfs_reclaim_worker *w,
+    struct diskfs_inode          *inode);
+
+void
+diskfs_defrag_worker_init(
+    struct diskfs_reclaim_worker *w);
+
+void
+diskfs_defrag_worker_fini(
+    struct diskfs_reclaim_worker *w);
+
+void
+diskfs_reclaim_submit_defrag(
+    struct diskfs_thread *thread,
+    struct diskfs_inode  *inode);
+
+int
+diskfs_warm_save(
+    struct diskfs_shared *shared);
+
+void
+diskfs_warm_worker_init(
+    struct diskfs_reclaim_worker *w);
+
+void
+diskfs_warm_worker_fini(
+    struct diskfs_reclaim_worker *w);
+
 void
 diskfs_reclaim_destroy(
     struct diskfs_shared *shared);
@@ -2617,6 +3249,19 @@ diskfs_bt_lookup_async(
     diskfs_bt_cb_t              cb,
     void                       *private_data);
 
+int
+diskfs_bt_scan_async(
+    struct diskfs_bt_op        *op,
+    struct diskfs_thread       *thread,
+    struct diskfs_inode        *inode,
+    const struct diskfs_bt_key *key,
+    struct diskfs_bt_key       *r_key,
+    void                       *out,
+    uint32_t                    out_cap,
+    diskfs_bt_peek_t            peek,
+    diskfs_bt_cb_t              cb,
+    void                       *private_data);
+
 int
 diskfs_bt_insert_async(
     struct diskfs_bt_op        *op,
@@ -3053,7 +3698,6 @@ diskfs_io_resume_waiters(
 void
 diskfs_read(
     struct diskfs_thread       *thread,
-    struct diskfs_shared       *shared,
     struct chimera_vfs_request *request,
     void                       *private_data);
 
@@ -3061,6 +3705,71 @@ void
 diskfs_ext_put(
     struct chimera_vfs_request *request);
 
+void
+diskfs_inline_store(
+    struct chimera_vfs_request *request,
+    int                         had_record,
+    uint8_t                    *data,
+    uint32_t                    len,
+    void (                     *cont )(struct chimera_vfs_request *));
+
+void
+diskfs_inline_convert(
+    struct chimera_vfs_request *request,
+    int                         write_out,
+    void (                     *cont )(struct chimera_vfs_request *));
+
+void
+diskfs_zx_expand(
+    struct chimera_vfs_request *request,
+    uint64_t                    alo,
+    uint64_t                    ahi,
+    uint64_t                    lo,
+    uint64_t                    hi,
+    void (                     *cont )(struct chimera_vfs_request *));
+
+int
+diskfs_compress_parse(
+    const char *name);
+
+const char *
+diskfs_compress_name(
+    int alg);
+
+int
+diskfs_compress_available(
+    int alg);
+
+void
+diskfs_compress_thread_init(
+    struct diskfs_thread *thread);
+
+void
+diskfs_compress_thread_fini(
+    struct diskfs_thread *thread);
+
+int
+diskfs_compress_worthwhile(
+    const uint8_t *src,
+    uint32_t       len);
+
+uint32_t
+diskfs_compress_chunk(
+    struct diskfs_thread *thread,
+    const uint8_t        *src,
+    uint32_t              len,
+    uint8_t              *dst,
+    uint32_t              cap);
+
+int
+diskfs_decompress_chunk(
+    struct diskfs_thread *thread,
+    int                   alg,
+    const uint8_t        *src,
+    uint32_t              clen,
+    uint8_t              *dst,
+    uint32_t              rlen);
+
 void
 diskfs_write(
     struct diskfs_thread       *thread,
@@ -3259,6 +3968,12 @@ diskfs_metric_mtime(
     struct diskfs_thread       *thread,
     enum diskfs_metric_mtime_op op);
 
+static inline void
+diskfs_metric_defrag(
+    struct diskfs_thread        *thread,
+    enum diskfs_metric_defrag_op op,
+    uint64_t                     value);
+
 static inline void
 diskfs_metric_block_io(
     struct diskfs_thread       *thread,
@@ -3317,6 +4032,23 @@ diskfs_txn_add_slot(
     struct diskfs_inode        *inode,
     enum diskfs_inode_lock_mode mode);
 
+static inline uint32_t *
+diskfs_cache_ghost_alloc(
+    uint32_t  entries,
+    uint32_t *mask);
+
+static inline void
+diskfs_cache_ghost_note(
+    uint32_t *ghost,
+    uint32_t  mask,
+    uint64_t  hash);
+
+static inline int
+diskfs_cache_ghost_take(
+    uint32_t *ghost,
+    uint32_t  mask,
+    uint64_t  hash);
+
 static inline void
 diskfs_inode_lru_push_tail(
     struct diskfs_inode_shard *shard,
@@ -3548,7 +4280,8 @@ diskfs_op_ok(
 static inline uint64_t
 diskfs_il_hdr_len(
     uint32_t nblocks,
-    uint32_t num_deltas);
+    uint32_t num_deltas,
+    uint32_t delta_bytes);
 
 static inline void
 diskfs_txn_commit(
@@ -3745,6 +4478,18 @@ diskfs_metric_mtime(
 } /* diskfs_metric_mtime */
 
 
+static inline void
+diskfs_metric_defrag(
+    struct diskfs_thread        *thread,
+    enum diskfs_metric_defrag_op op,
+    uint64_t                     value)
+{
+    if (thread) {
+        diskfs_metric_counter_add(thread->metrics.defrag[op], value);
+    }
+} /* diskfs_metric_defrag */
+
+
 static inline void
 diskfs_metric_block_io(
     struct diskfs_thread       *thread,
@@ -3884,21 +4629,81 @@ diskfs_txn_add_slot(
 } /* diskfs_txn_add_slot */
 
 
-/* Inode LRU (recycle candidates).  All require the owning shard lock. */
+/*
+ * Ghost tables: a direct-mapped array of 32-bit key fingerprints per cache
+ * shard remembering what was evicted recently (the 2Q "A1out" list without the
+ * list).  A colliding eviction simply overwrites the slot, and a false match
+ * costs only an early promotion.  Slot and fingerprint come from disjoint bits
+ * of the key hash; a fingerprint is never 0 so an empty slot never matches.
+ */
+static inline uint32_t *
+diskfs_cache_ghost_alloc(
+    uint32_t  entries,
+    uint32_t *mask)
+{
+    uint32_t  n = 1;
+    uint32_t *ghost;
+
+    while (n < entries && n < (1U << 24)) {
+        n <<= 1;
+    }
+    ghost = calloc(n, sizeof(*ghost));
+    chimera_diskfs_abort_if(!ghost, "cache ghost table allocation failed");
+    *mask = n - 1;
+    return ghost;
+} /* diskfs_cache_ghost_alloc */
+
+
+static inline void
+diskfs_cache_ghost_note(
+    uint32_t *ghost,
+    uint32_t  mask,
+    uint64_t  hash)
+{
+    ghost[(hash >> 8) & mask] = (uint32_t) (hash >> 32) | 1;
+} /* diskfs_cache_ghost_note */
+
+
+/* Returns 1 (and forgets the entry) if hash's key was evicted recently. */
+static inline int
+diskfs_cache_ghost_take(
+    uint32_t *ghost,
+    uint32_t  mask,
+    uint64_t  hash)
+{
+    uint32_t *slot = &ghost[(hash >> 8) & mask];
+
+    if (*slot != ((uint32_t) (hash >> 32) | 1)) {
+        return 0;
+    }
+    *slot = 0;
+    return 1;
+} /* diskfs_cache_ghost_take */
+
+
+/* Inode LRU (recycle candidates), segmented by inode->hot: a linked inode's
+ * hot flag must not change until it is unlinked.  All require the owning
+ * shard lock. */
 static inline void
 diskfs_inode_lru_push_tail(
     struct diskfs_inode_shard *shard,
     struct diskfs_inode       *inode)
 {
-    inode->lru_prev = shard->lru_tail;
+    struct diskfs_inode **head = inode->hot ? &shard->hot_head : &shard->lru_head;
+    struct diskfs_inode **tail = inode->hot ? &shard->hot_tail : &shard->lru_tail;
+
+    inode->lru_prev = *tail;
     inode->lru_next = NULL;
-    if (shard->lru_tail) {
-        shard->lru_tail->lru_next = inode;
+    if (*tail) {
+        (*tail)->lru_next = inode;
     } else {
-        shard->lru_head = inode;
+        *head = inode;
+    }
+    *tail         = inode;
+    inode->on_lru = 1;
+    if (inode->hot) {
+        shard->nhot++;
     }
-    shard->lru_tail = inode;
-    inode->on_lru   = 1;
 } /* diskfs_inode_lru_push_tail */
 
 
@@ -3907,21 +4712,27 @@ diskfs_inode_lru_unlink(
     struct diskfs_inode_shard *shard,
     struct diskfs_inode       *inode)
 {
+    struct diskfs_inode **head = inode->hot ? &shard->hot_head : &shard->lru_head;
+    struct diskfs_inode **tail = inode->hot ? &shard->hot_tail : &shard->lru_tail;
+
     if (!inode->on_lru) {
         return;
     }
     if (inode->lru_prev) {
         inode->lru_prev->lru_next = inode->lru_next;
     } else {
-        shard->lru_head = inode->lru_next;
+        *head = inode->lru_next;
     }
     if (inode->lru_next) {
         inode->lru_next->lru_prev = inode->lru_prev;
     } else {
-        shard->lru_tail = inode->lru_prev;
+        *tail = inode->lru_prev;
     }
     inode->lru_prev = inode->lru_next = NULL;
     inode->on_lru   = 0;
+    if (inode->hot) {
+        shard->nhot--;
+    }
 } /* diskfs_inode_lru_unlink */
 
 
@@ -4136,21 +4947,29 @@ diskfs_block_bucket(
 
 /* --- shard LRU (caller holds the shard lock) --------------------------- */
 
+/* Link blk at the MRU end of its segment (blk->hot picks protected vs
+ * probation; it must not change while linked). */
 static inline void
 diskfs_block_lru_push_tail(
     struct diskfs_block_shard *shard,
     struct diskfs_block       *blk)
 {
-    blk->lru_prev = shard->lru_tail;
+    struct diskfs_block **head = blk->hot ? &shard->hot_head : &shard->lru_head;
+    struct diskfs_block **tail = blk->hot ? &shard->hot_tail : &shard->lru_tail;
+
+    blk->lru_prev = *tail;
     blk->lru_next = NULL;
-    if (shard->lru_tail) {
-        shard->lru_tail->lru_next = blk;
+    if (*tail) {
+        (*tail)->lru_next = blk;
     } else {
-        shard->lru_head = blk;
+        *head = blk;
     }
-    shard->lru_tail = blk;
-    blk->on_lru     = 1;
+    *tail       = blk;
+    blk->on_lru = 1;
     shard->lru_count++;
+    if (blk->hot) {
+        shard->hot_count++;
+    }
 } /* diskfs_block_lru_push_tail */
 
 
@@ -4188,14 +5007,41 @@ diskfs_txn_add_block(
     struct diskfs_block *block)
 {
     struct diskfs_txn_block *tb = malloc(sizeof(*tb));
+    struct diskfs_txn       *owner;
 
     tb->block        = block;
     tb->snap_buf     = NULL;
     tb->snap_csum_lo = 0;
     tb->snap_csum_hi = 0;
+    tb->delta_base   = NULL;
+    tb->delta        = NULL;
+    tb->delta_len    = 0;
     tb->next         = txn->blocks;
     txn->blocks      = tb;
 
+    /* Delta redo: the one txn that wins delta_owner on a block whose buffer is
+     * still the durable home image keeps a copy of it as the delta base.  Any
+     * other txn attaching while an owner is set marks the block shared, and
+     * diskfs_txn_commit_finish then logs the owner's image in full. */
+    if (txn->thread->shared->redo_delta) {
+        owner = __atomic_load_n(&block->delta_owner, __ATOMIC_ACQUIRE);
+        if (owner == NULL) {
+            if (__atomic_compare_exchange_n(&block->delta_owner, &owner, txn, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                if (__atomic_exchange_n(&block->home_current, 0, __ATOMIC_ACQ_REL)) {
+                    tb->delta_base = malloc(DISKFS_BLOCK_SIZE);
+                    memcpy(tb->delta_base, block->iov.data, DISKFS_BLOCK_SIZE);
+                } else {
+                    __atomic_store_n(&block->delta_owner, NULL, __ATOMIC_RELEASE);
+                }
+            }
+        } else if (owner != txn && owner != DISKFS_DELTA_SHARED) {
+            __atomic_compare_exchange_n(&block->delta_owner, &owner,
+                                        DISKFS_DELTA_SHARED, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+    }
+
     /* Diag: a normal op dirties a handful of blocks.  If one txn balloons,
      * dump the call path + journal/direct split at growth thresholds so we can
      * see whether the same site repeats (re-execution loop) or varies, and
@@ -4208,6 +5054,58 @@ diskfs_txn_add_block(
 } /* diskfs_txn_add_block */
 
 
+/* Delta-redo home tracking (see struct diskfs_block).  The buffer now holds
+ * something other than the durable home image. */
+static inline void
+diskfs_block_set_stale(struct diskfs_block *blk)
+{
+    __atomic_store_n(&blk->home_stale, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&blk->home_current, 0, __ATOMIC_RELEASE);
+} /* diskfs_block_set_stale */
+
+
+/* The buffer was just read from, or written to, its durable home location. */
+static inline void
+diskfs_block_set_home(struct diskfs_block *blk)
+{
+    __atomic_store_n(&blk->home_stale, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&blk->home_current, 1, __ATOMIC_RELEASE);
+} /* diskfs_block_set_home */
+
+
+/* Last pin dropped outside the tail-pusher: the buffer matches home unless it
+ * was filled from elsewhere and never pushed since. */
+static inline void
+diskfs_block_set_idle(struct diskfs_block *blk)
+{
+    __atomic_store_n(&blk->home_current,
+                     !__atomic_load_n(&blk->home_stale, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+} /* diskfs_block_set_idle */
+
+
+/* Give up a txn block's delta base (abort, or the block left the txn before
+ * commit) and release the block's delta ownership if this txn held it. */
+static inline void
+diskfs_txn_block_drop_delta(
+    struct diskfs_txn       *txn,
+    struct diskfs_txn_block *tb)
+{
+    struct diskfs_txn *owner = txn;
+
+    if (!tb->delta_base) {
+        return;
+    }
+    free(tb->delta_base);
+    tb->delta_base = NULL;
+    if (!__atomic_compare_exchange_n(&tb->block->delta_owner, &owner, NULL, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) &&
+        owner == DISKFS_DELTA_SHARED) {
+        __atomic_store_n(&tb->block->delta_owner, NULL, __ATOMIC_RELEASE);
+    }
+} /* diskfs_txn_block_drop_delta */
+
+
 static inline void
 diskfs_block_buf_ref_locked(struct diskfs_block_buf *buf)
 {
@@ -4501,10 +5399,47 @@ diskfs_inode_struct_free(struct diskfs_inode *inode)
 {
     free(inode->acl_serial);
     free(inode->pnfs_blob);
+    free(inode->inline_data);
     free(inode);
 } /* diskfs_inode_struct_free */
 
 
+/* Set the inode's inline-data mirror to data[0..len), the INLINE record just
+ * read at inode load.  Updates go through diskfs_inline_store instead. */
+static inline void
+diskfs_inline_install(
+    struct diskfs_inode *inode,
+    const uint8_t       *data,
+    uint32_t             len)
+{
+    if (!inode->inline_data) {
+        inode->inline_data = malloc(DISKFS_INLINE_MAX);
+    }
+    memcpy(inode->inline_data, data, len);
+    inode->inline_len = len;
+} /* diskfs_inline_install */
+
+
+/* A DISKFS_INLINE_MAX buffer holding the first len bytes of the inode's
+ * inline data (zeros past the current record), for building a new record
+ * image to hand to diskfs_inline_store. */
+static inline uint8_t *
+diskfs_inline_stage(
+    const struct diskfs_inode *inode,
+    uint32_t                   len)
+{
+    uint8_t *data = malloc(DISKFS_INLINE_MAX);
+    uint32_t keep = len < inode->inline_len ? len : inode->inline_len;
+
+    if (keep) {
+        memcpy(data, inode->inline_data, keep);
+    }
+    memset(data + keep, 0, len - keep);
+
+    return data;
+} /* diskfs_inline_stage */
+
+
 static inline void
 diskfs_inode_cache_insert(
     struct diskfs_shared *shared,
@@ -4773,18 +5708,20 @@ diskfs_txn_begin(
         txn = malloc(sizeof(*txn));
     }
 
-    txn->type            = type;
-    txn->thread          = thread;
-    txn->next            = NULL;
-    txn->num_inodes      = 0;
-    txn->blocks          = NULL;
-    txn->nblocks         = 0;
-    txn->n_journal       = 0;
-    txn->n_reserve_again = 0;
-    txn->dbg_stage       = 1;   /* BEGUN */
-    txn->pending_frees   = NULL;
-    txn->space_deltas    = NULL;
-    txn->n_space_deltas  = 0;
+    txn->type             = type;
+    txn->thread           = thread;
+    txn->next             = NULL;
+    txn->num_inodes       = 0;
+    txn->blocks           = NULL;
+    txn->nblocks          = 0;
+    txn->n_journal        = 0;
+    txn->n_reserve_again  = 0;
+    txn->dbg_stage        = 1;   /* BEGUN */
+    txn->pending_frees    = NULL;
+    txn->space_deltas     = NULL;
+    txn->n_space_deltas   = 0;
+    txn->redo_full_blocks = 0;
+    txn->redo_delta_bytes = 0;
     return txn;
 } /* diskfs_txn_begin */
 
@@ -4861,19 +5798,22 @@ diskfs_op_ok(
 
 /*
  * On-log record layout (all 4 KiB-aligned for zero-copy scatter-gather):
- *   [ header region: redo_header + num_blocks * redo_block_header, 4K-padded ]
- *   [ block 0 data (4 KiB) ][ block 1 data ] ... [ block N-1 data ]
- * The header region is materialized into one iovec; each data block is a
+ *   [ header region: redo_header + num_blocks * redo_block_header
+ *     + space deltas + block delta payload, 4K-padded ]
+ *   [ full block data (4 KiB) ] ... one per block with delta_len == 0
+ * The header region is materialized into one iovec; each full data block is a
  * zero-copy clone of the cache block's buffer.
  */
 static inline uint64_t
 diskfs_il_hdr_len(
     uint32_t nblocks,
-    uint32_t num_deltas)
+    uint32_t num_deltas,
+    uint32_t delta_bytes)
 {
     uint64_t h = sizeof(struct diskfs_redo_header) +
         (uint64_t) nblocks * sizeof(struct diskfs_redo_block_header) +
-        (uint64_t) num_deltas * sizeof(struct diskfs_redo_delta);
+        (uint64_t) num_deltas * sizeof(struct diskfs_redo_delta) +
+        delta_bytes;
 
     return (h + DISKFS_BLOCK_SIZE - 1) & ~((uint64_t) DISKFS_BLOCK_SIZE - 1);
 } /* diskfs_il_hdr_len */
@@ -298,6 +298,18 @@ diskfs_write_inode_cb(
     int                  status,
     void                *private_data);
 
+static void
+diskfs_write_inline(
+    struct chimera_vfs_request *request);
+
+static void
+diskfs_write_map(
+    struct chimera_vfs_request *request);
+
+static void
+diskfs_write_classify(
+    struct chimera_vfs_request *request);
+
 static void
 diskfs_write_classify_cb(
     struct diskfs_bt_op *op,
@@ -349,6 +361,26 @@ static void
 diskfs_write_split_start(
     struct chimera_vfs_request *request);
 
+static void
+diskfs_write_zcompress(
+    struct chimera_vfs_request *request);
+
+static void
+diskfs_write_zdedup(
+    struct chimera_vfs_request *request);
+
+static void
+diskfs_write_zalloc(
+    struct chimera_vfs_request *request);
+
+static void
+diskfs_write_zput(
+    struct chimera_vfs_request *request);
+
+static void
+diskfs_write_zphase2(
+    struct chimera_vfs_request *request);
+
 static void
 diskfs_allocate_finalize(
     struct chimera_vfs_request *request);
@@ -462,6 +494,10 @@ diskfs_allocate_inode_cb(
     int                  status,
     void                *private_data);
 
+static void
+diskfs_allocate_inline(
+    struct chimera_vfs_request *request);
+
 static void
 diskfs_seek_walk_cb(
     struct diskfs_bt_op *op,
@@ -697,6 +733,11 @@ diskfs_inode_dinode_clean(
  * stale ones are unlinked (self-heal) and dinode-dirty ones skipped.  If none
  * are evictable the pool grows past the cap (bounded by the live working set;
  * the A5b waiter will make this a hard cap).
+ *
+ * Scan resistance (DISKFS_CACHE_PROTECTED_PCT): the protected list is first
+ * trimmed to its cap by demoting its LRU end to probation, then probation is
+ * walked before protected, so inodes seen once by a tree walk go first.  The
+ * evicted inum is remembered in the shard's ghost table.
  */
 void
 diskfs_inode_cache_recycle_locked(
@@ -704,13 +745,27 @@ diskfs_inode_cache_recycle_locked(
     struct diskfs_inode_shard *shard)
 {
     struct diskfs_inode *inode, *next;
+    uint32_t             hot_cap;
 
     if (shard->ninodes < shared->inode_cache->shard_cap) {
         return;
     }
 
-    for (inode = shard->lru_head; inode; inode = next) {
+    hot_cap = (uint32_t) ((uint64_t) shared->inode_cache->shard_cap *
+                          DISKFS_CACHE_PROTECTED_PCT / 100);
+    while (shard->nhot > hot_cap) {
+        inode = shard->hot_head;
+        diskfs_inode_lru_unlink(shard, inode);
+        inode->hot = 0;
+        diskfs_inode_lru_push_tail(shard, inode);
+    }
+
+    for (inode = shard->lru_head ? shard->lru_head : shard->hot_head;
+         inode; inode = next) {
         next = inode->lru_next;
+        if (!next && !inode->hot) {
+            next = shard->hot_head;                    /* probation exhausted */
+        }
 
         if (!diskfs_inode_idle(inode)) {
             diskfs_inode_lru_unlink(shard, inode);     /* went busy; self-heal */
@@ -729,6 +784,8 @@ diskfs_inode_cache_recycle_locked(
         diskfs_inode_lru_unlink(shard, inode);
         rb_tree_remove(&shard->inodes, &inode->node);
         shard->ninodes--;
+        diskfs_cache_ghost_note(shard->ghost, shard->ghost_mask,
+                                diskfs_inum_hash(inode->inum));
         diskfs_inode_struct_free(inode);
         return;
     }
@@ -752,6 +809,9 @@ diskfs_inode_load_recs_done(struct diskfs_inode_load_ctx *lc)
         memcpy(inode->pnfs_blob, lc->pnfs_rec, lc->pnfs_len);
         inode->pnfs_blob_len = (uint32_t) lc->pnfs_len;
     }
+    if (lc->inline_len >= 0) {
+        diskfs_inline_install(inode, lc->inline_rec, (uint32_t) lc->inline_len);
+    }
 
     diskfs_inode_release_one(thread, inode, DISKFS_INODE_LOCK_WRITE);
 
@@ -762,16 +822,44 @@ diskfs_inode_load_recs_done(struct diskfs_inode_load_ctx *lc)
 
 
 static void
-diskfs_inode_load_recs_pnfs_cb(
+diskfs_inode_load_recs_inline_cb(
     struct diskfs_bt_op *op,
     int                  result,
     void                *private_data)
 {
     struct diskfs_inode_load_ctx *lc = private_data;
 
-    lc->pnfs_len = result;
+    lc->inline_len = result;
     diskfs_bt_op_free(lc->thread, op);
     diskfs_inode_load_recs_done(lc);
+} /* diskfs_inode_load_recs_inline_cb */
+
+
+static void
+diskfs_inode_load_recs_pnfs_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *private_data)
+{
+    struct diskfs_inode_load_ctx *lc = private_data;
+
+    lc->pnfs_len   = result;
+    lc->inline_len = -1;
+    diskfs_bt_op_free(lc->thread, op);
+
+    /* Only a file whose dinode says it is inline has the record to fetch. */
+    if (!lc->want_inline) {
+        diskfs_inode_load_recs_done(lc);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(lc->thread);
+    if (diskfs_bt_lookup_async(op, lc->thread, lc->inode,
+                               DISKFS_BT_OP_LOOKUP_EXACT, &diskfs_inline_key,
+                               NULL, lc->inline_rec, sizeof(lc->inline_rec),
+                               diskfs_inode_load_recs_inline_cb, lc)) {
+        diskfs_inode_load_recs_inline_cb(op, op->result, lc);
+    }
 } /* diskfs_inode_load_recs_pnfs_cb */
 
 
@@ -896,6 +984,8 @@ diskfs_inode_load_resume(
         inode->ea_count       = di->ea_count;
         inode->parent_inum    = di->parent_inum;
         inode->parent_gen     = di->parent_gen;
+        lc->want_inline       = S_ISREG(di->mode) && self->shared->dinode_flags &&
+            (di->flags & DISKFS_DINODE_INLINE);
         /* Publish write-locked, held by this fault: nobody can grant (or
          * modify the tree) until the record loads below finish; concurrent
          * acquirers park as ordinary lock waiters. */
@@ -903,6 +993,14 @@ diskfs_inode_load_resume(
         rb_tree_insert(&shard->inodes, inum, inode);
         shard->ninodes++;
         diskfs_metric_inode_cache(self, DISKFS_METRIC_INODE_CACHE_LOAD);
+        /* Scan resistance: a fault enters probation unless this inum was
+         * evicted recently, in which case it goes straight to protected. */
+        inode->fresh = 1;
+        if (diskfs_cache_ghost_take(shard->ghost, shard->ghost_mask,
+                                    diskfs_inum_hash(lc->inum))) {
+            inode->hot = 1;
+            diskfs_metric_inode_cache(self, DISKFS_METRIC_INODE_CACHE_GHOST_HIT);
+        }
     } else {
         /* Lost a concurrent fault race: the winner published the inode (and
          * does/did its own record loads).  Just re-drive the acquire. */
@@ -919,8 +1017,8 @@ diskfs_inode_load_resume(
      * from the cache themselves (resident, since we just loaded it). */
     diskfs_block_unpin(self, blk, DISKFS_BLOCK_CLEAN);
 
-    /* Load the ACL/pNFS record mirrors, then release the hold and re-drive
-     * the acquire to grant the lock as usual. */
+    /* Load the ACL/pNFS/inline-data record mirrors, then release the hold
+     * and re-drive the acquire to grant the lock as usual. */
     lc->inode = inode;
     diskfs_inode_load_recs(lc);
 } /* diskfs_inode_load_resume */
@@ -1189,6 +1287,112 @@ diskfs_read_advance(struct chimera_vfs_request *request)
 } /* diskfs_read_advance */
 
 
+/*
+ * Read of a compressed chunk: the whole chunk is read into a bounce buffer,
+ * decompressed into the worker's scratch, and the requested window copied
+ * into the destination slices -- which were already cut from the read cursor
+ * into p->iov, so io_callback's release and the cursor's position come out
+ * the same as for a plain extent.
+ */
+struct diskfs_zread {
+    struct chimera_vfs_request *request;
+    struct evpl_iovec          *dst;
+    int                         dst_niov;
+    int                         alg;
+    uint32_t                    skip;
+    uint32_t                    len;
+    struct evpl_iovec           bounce;
+};
+
+
+static void
+diskfs_read_zchunk_cb(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct diskfs_zread            *zr      = private_data;
+    struct chimera_vfs_request     *request = zr->request;
+    struct diskfs_request_private  *p       = request->plugin_data;
+    struct diskfs_thread           *thread  = p->thread;
+    const struct diskfs_zchunk_hdr *hdr     = zr->bounce.data;
+    const uint8_t                  *src;
+    uint32_t                        left;
+
+    if (!status) {
+        if (hdr->magic != DISKFS_ZCHUNK_MAGIC ||
+            hdr->clen > zr->bounce.length - sizeof(*hdr) ||
+            hdr->rlen > DISKFS_ZCHUNK_SIZE ||
+            diskfs_decompress_chunk(thread, zr->alg, (const uint8_t *) (hdr + 1),
+                                    hdr->clen, thread->zraw, hdr->rlen) != 0) {
+            chimera_diskfs_error("corrupt compressed chunk (read)");
+            status = CHIMERA_VFS_EIO;
+        } else {
+            /* A chunk is rlen bytes; anything past it reads as zeros. */
+            if (hdr->rlen < zr->skip + zr->len) {
+                memset(thread->zraw + hdr->rlen, 0,
+                       zr->skip + zr->len - hdr->rlen);
+            }
+            src  = thread->zraw + zr->skip;
+            left = zr->len;
+            for (int i = 0; i < zr->dst_niov && left; i++) {
+                uint32_t n = zr->dst[i].length < left ? zr->dst[i].length : left;
+
+                memcpy(zr->dst[i].data, src, n);
+                src  += n;
+                left -= n;
+            }
+        }
+    }
+
+    evpl_iovec_release(evpl, &zr->bounce);
+    free(zr);
+
+    diskfs_io_callback(evpl, status, request);
+} /* diskfs_read_zchunk_cb */
+
+
+static void
+diskfs_read_zchunk(
+    struct chimera_vfs_request *request,
+    struct diskfs_extent       *extent,
+    uint64_t                    overlap_start,
+    uint64_t                    overlap_length)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_zread           *zr     = malloc(sizeof(*zr));
+    uint64_t                       plen   = diskfs_ext_phys_len(extent->flags,
+                                                                extent->length);
+
+    zr->request  = request;
+    zr->alg      = diskfs_ext_zalg(extent->flags);
+    zr->skip     = (uint32_t) overlap_start;
+    zr->len      = (uint32_t) overlap_length;
+    zr->dst      = &p->iov[p->niov];
+    zr->dst_niov = evpl_iovec_cursor_move(&p->rd_cursor, zr->dst, 32,
+                                          overlap_length, 1);
+    p->niov     += zr->dst_niov;
+
+    p->pending++;
+    diskfs_pending_io_add(thread, 1);
+
+    if (evpl_iovec_alloc(thread->evpl, plen, 4096, 1, 0, &zr->bounce) <= 0) {
+        free(zr);
+        diskfs_io_callback(thread->evpl, CHIMERA_VFS_EIO, request);
+        return;
+    }
+
+    diskfs_metric_block_io(thread, DISKFS_METRIC_IO_READ,
+                           DISKFS_METRIC_IO_DATA, plen);
+    diskfs_metric_block_io_device(thread, extent->device_id,
+                                  DISKFS_METRIC_IO_READ,
+                                  DISKFS_METRIC_IO_DATA, plen);
+    evpl_block_read(thread->evpl, thread->queue[extent->device_id], &zr->bounce, 1,
+                    extent->device_offset, diskfs_read_zchunk_cb, zr);
+} /* diskfs_read_zchunk */
+
+
 static void
 diskfs_read_process(struct chimera_vfs_request *request)
 {
@@ -1237,6 +1441,12 @@ diskfs_read_process(struct chimera_vfs_request *request)
         read_offset   += overlap_length;
         read_left     -= overlap_length;
         overlap_length = 0;
+    } else if (extent->flags & DISKFS_EXT_COMPRESSED) {
+        /* One compressed chunk: read + decompress it whole, copy the window. */
+        diskfs_read_zchunk(request, extent, overlap_start, overlap_length);
+        read_offset   += overlap_length;
+        read_left     -= overlap_length;
+        overlap_length = 0;
     }
 
     while (overlap_length) {
@@ -1331,6 +1541,30 @@ diskfs_read_first_cb(
 } /* diskfs_read_first_cb */
 
 
+/* Inline file: the data is the inode's mirror of its INLINE record, so the
+ * read is a copy into the provided buffers -- no extent walk, no device I/O.
+ * Bytes past the record read as zeros (diskfs_read_finish fills them). */
+static void
+diskfs_read_inline(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p     = request->plugin_data;
+    struct diskfs_inode           *inode = p->inode_stash[0];
+    uint64_t                       chunk;
+
+    if (p->loop_off < inode->inline_len) {
+        chunk = inode->inline_len - p->loop_off;
+        if (chunk > p->loop_left) {
+            chunk = p->loop_left;
+        }
+        evpl_iovec_cursor_append_blob(&p->rd_cursor,
+                                      inode->inline_data + p->loop_off, chunk);
+        p->loop_left -= chunk;
+    }
+
+    diskfs_read_finish(request);
+} /* diskfs_read_inline */
+
+
 static void
 diskfs_read_inode_cb(
     struct diskfs_inode *inode,
@@ -1358,6 +1592,16 @@ diskfs_read_inode_cb(
         return;
     }
 
+    /* Block/SCSI-mode shares keep extent data on remote (pNFS) devices the
+     * server can't touch, so the client must use a layout for it.  Inline
+     * files have no device blocks (LAYOUTGET hands out no segments for them)
+     * and are served from the inode here, like on any other share. */
+    if (unlikely((thread->shared->block_layout || thread->shared->scsi_layout) &&
+                 !inode->inline_data)) {
+        diskfs_op_fail(request, diskfs_private->txn, CHIMERA_VFS_EINVAL);
+        return;
+    }
+
     offset = request->read.offset;
     length = request->read.length;
 
@@ -1455,6 +1699,11 @@ diskfs_read_inode_cb(
     diskfs_private->loop_left      = aligned_length;
     diskfs_private->loop_pos       = aligned_offset + aligned_length;
 
+    if (inode->inline_data) {
+        diskfs_read_inline(request);
+        return;
+    }
+
     op = diskfs_bt_op_alloc(thread);
     if (diskfs_ext_floor_async(op, thread, inode, aligned_offset, diskfs_private->rec_scratch,
                                sizeof(diskfs_private->rec_scratch), diskfs_read_first_cb,
@@ -1467,7 +1716,6 @@ diskfs_read_inode_cb(
 void
 diskfs_read(
     struct diskfs_thread       *thread,
-    struct diskfs_shared       *shared,
     struct chimera_vfs_request *request,
     void                       *private_data)
 {
@@ -1475,16 +1723,6 @@ diskfs_read(
 
     (void) private_data;
 
-    /* Block/SCSI-mode shares keep all file data on remote (pNFS) devices the
-     * server can't touch, so inline reads are impossible -- the client must use
-     * a layout.  Reject so a non-pNFS read doesn't dereference a NULL device
-     * queue. */
-    if (unlikely(shared->block_layout || shared->scsi_layout)) {
-        request->status = CHIMERA_VFS_EINVAL;
-        request->complete(request);
-        return;
-    }
-
     p->opcode     = request->opcode;
     p->status     = 0;
     p->pending    = 0;
@@ -1856,6 +2094,9 @@ diskfs_ext_put_floor_cb(
         return;
     }
 
+    if (p->ci_flags == 0) {
+        diskfs_defrag_note_insert(thread, p->inode_stash[0]);
+    }
     diskfs_ext_put_insert(request);
 } /* diskfs_ext_put_floor_cb */
 
@@ -1881,8 +2122,579 @@ diskfs_ext_put(struct chimera_vfs_request *request)
 } /* diskfs_ext_put */
 
 
-/* Tail shared by every write path (in-place, unwritten-split, redirect):
- * stamp inode metadata, then RMW reads (if any) -> phase2 data write. */
+/* The b+tree now holds the staged record (or none): make it the mirror. */
+static void
+diskfs_inline_store_done(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p     = request->plugin_data;
+    struct diskfs_inode           *inode = p->inode_stash[0];
+
+    free(inode->inline_data);
+    inode->inline_data = p->inline_stage;
+    inode->inline_len  = p->inline_stage ? p->inline_stage_len : 0;
+    p->inline_stage    = NULL;
+
+    p->inline_cont(request);
+} /* diskfs_inline_store_done */
+
+
+static void
+diskfs_inline_store_inserted_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+
+    diskfs_bt_op_free(p->thread, op);
+
+    if (unlikely(result < 0)) {
+        /* The mirror still matches what the aborted txn leaves on disk. */
+        free(p->inline_stage);
+        p->inline_stage = NULL;
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    diskfs_inline_store_done(request);
+} /* diskfs_inline_store_inserted_cb */
+
+
+static void
+diskfs_inline_store_insert(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p = request->plugin_data;
+    struct diskfs_bt_op           *op;
+
+    if (!p->inline_stage) {
+        /* Remove-only (truncated to nothing, or converted to extents). */
+        diskfs_inline_store_done(request);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(p->thread);
+    if (diskfs_bt_insert_async(op, p->thread, p->txn, p->inode_stash[0], &diskfs_inline_key,
+                               p->inline_stage, p->inline_stage_len,
+                               diskfs_inline_store_inserted_cb, request)) {
+        diskfs_inline_store_inserted_cb(op, op->result, request);
+    }
+} /* diskfs_inline_store_insert */
+
+
+static void
+diskfs_inline_store_removed_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+
+    (void) result;
+    diskfs_bt_op_free(p->thread, op);
+    diskfs_inline_store_insert(request);
+} /* diskfs_inline_store_removed_cb */
+
+
+/*
+ * Replace the INLINE record of p->inode_stash[0] (held under the inode write
+ * lock) with data[0..len), a DISKFS_INLINE_MAX buffer this takes ownership of,
+ * or just drop it if data is NULL: remove the old record if there was one,
+ * insert the new one, and only then install data as the inode's mirror and run
+ * cont.  On failure the request fails and the mirror is left as it was.
+ */
+void
+diskfs_inline_store(
+    struct chimera_vfs_request *request,
+    int                         had_record,
+    uint8_t                    *data,
+    uint32_t                    len,
+    void (                     *cont )(struct chimera_vfs_request *))
+{
+    struct diskfs_request_private *p = request->plugin_data;
+    struct diskfs_bt_op           *op;
+
+    p->inline_cont      = cont;
+    p->inline_dirty     = 1;
+    p->inline_stage     = data;
+    p->inline_stage_len = len;
+
+    if (!had_record) {
+        diskfs_inline_store_insert(request);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(p->thread);
+    if (diskfs_bt_remove_async(op, p->thread, p->txn, p->inode_stash[0],
+                               &diskfs_inline_key, diskfs_inline_store_removed_cb,
+                               request)) {
+        diskfs_inline_store_removed_cb(op, op->result, request);
+    }
+} /* diskfs_inline_store */
+
+
+/* Block 0 is recorded as an extent; drop the record and the mirror. */
+static void
+diskfs_inline_convert_mapped(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p = request->plugin_data;
+
+    diskfs_inline_store(request, 1, NULL, 0, p->inline_cont);
+} /* diskfs_inline_convert_mapped */
+
+
+static void
+diskfs_inline_convert_written(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = p->thread;
+
+    evpl_iovec_release(evpl, &p->inline_blk);
+    p->inline_blk.data = NULL;
+
+    diskfs_pending_io_add(thread, -1);
+    diskfs_io_resume_waiters(thread);
+
+    if (status) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    p->ci_off   = 0;
+    p->ci_len   = DISKFS_BLOCK_SIZE;
+    p->ci_flags = 0;
+    p->ci_cont  = diskfs_inline_convert_mapped;
+    diskfs_ext_put(request);
+} /* diskfs_inline_convert_written */
+
+
+static void
+diskfs_inline_convert_alloc(struct chimera_vfs_request *request);
+
+static void
+diskfs_inline_convert_resume(
+    struct diskfs_thread *thread,
+    void                 *arg)
+{
+    (void) thread;
+    diskfs_inline_convert_alloc((struct chimera_vfs_request *) arg);
+} /* diskfs_inline_convert_resume */
+
+
+static void
+diskfs_inline_convert_alloc(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_shared          *shared = thread->shared;
+    struct diskfs_inode           *inode  = p->inode_stash[0];
+    uint64_t                       dev_id, dev_off;
+    int                            rc;
+
+    if (diskfs_io_gate(thread, request, diskfs_inline_convert_alloc)) {
+        return;
+    }
+
+    /* Over-reserve like a redirect write: the write that triggered the
+     * conversion usually lands right after block 0 and coalesces with it. */
+    rc = diskfs_inode_alloc_space(thread, p->txn, inode, DISKFS_BLOCK_SIZE,
+                                  SM_RESERVATION_MIN, &dev_id, &dev_off,
+                                  diskfs_inline_convert_resume, request);
+    if (rc == SM_AGAIN) {
+        return;
+    }
+    if (rc) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_ENOSPC);
+        return;
+    }
+
+    if (evpl_iovec_alloc(thread->evpl, DISKFS_BLOCK_SIZE, 4096, 1, 0,
+                         &p->inline_blk) <= 0) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    memcpy(p->inline_blk.data, inode->inline_data, inode->inline_len);
+    memset((uint8_t *) p->inline_blk.data + inode->inline_len, 0,
+           DISKFS_BLOCK_SIZE - inode->inline_len);
+
+    p->ci_devid  = (uint32_t) dev_id;
+    p->ci_devoff = dev_off;
+
+    diskfs_pending_io_add(thread, 1);
+    diskfs_metric_block_io(thread, DISKFS_METRIC_IO_WRITE,
+                           DISKFS_METRIC_IO_DATA, DISKFS_BLOCK_SIZE);
+    diskfs_metric_block_io_device(thread, dev_id, DISKFS_METRIC_IO_WRITE,
+                                  DISKFS_METRIC_IO_DATA, DISKFS_BLOCK_SIZE);
+    evpl_block_write(thread->evpl, thread->queue[dev_id], &p->inline_blk, 1,
+                     dev_off, diskfs_write_data_sync(shared, request),
+                     diskfs_inline_convert_written, request);
+} /* diskfs_inline_convert_alloc */
+
+
+/*
+ * Move an inline file's bytes out to a regular block-0 extent and drop its
+ * INLINE record, then run cont with the file in ordinary extent form.  The
+ * block is written (and FUA-complete) before the extent is recorded, so an RMW
+ * of block 0 by the caller reads the bytes back from the device.  write_out = 0
+ * when the caller is about to overwrite every inline byte anyway: the record
+ * is then simply dropped.
+ */
+void
+diskfs_inline_convert(
+    struct chimera_vfs_request *request,
+    int                         write_out,
+    void (                     *cont )(struct chimera_vfs_request *))
+{
+    struct diskfs_request_private *p = request->plugin_data;
+
+    p->inline_cont = cont;
+
+    if (!write_out) {
+        diskfs_inline_store(request, 1, NULL, 0, cont);
+        return;
+    }
+
+    diskfs_inline_convert_alloc(request);
+} /* diskfs_inline_convert */
+
+
+/*
+ * Whole-extent expansion.  A compressed or deduplicated extent
+ * (DISKFS_EXT_WHOLE) is only ever dropped whole, so before a write or
+ * deallocate modifies the block-aligned range [alo, ahi) every such extent
+ * that overlaps it without lying inside the fully replaced bytes [lo, hi) is
+ * rewritten as a private plain extent.  Extents start block-aligned, so only
+ * the ones holding alo and hi can straddle an edge: two floor probes cover it.
+ */
+static void
+diskfs_zx_probe(struct chimera_vfs_request *request);
+
+static void
+diskfs_zx_read(struct chimera_vfs_request *request);
+
+static void
+diskfs_zx_alloc(struct chimera_vfs_request *request);
+
+static void
+diskfs_zx_inserted_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+
+    diskfs_bt_op_free(p->thread, op);
+
+    if (unlikely(result < 0)) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    p->zx_probe++;
+    diskfs_zx_probe(request);
+} /* diskfs_zx_inserted_cb */
+
+
+static void
+diskfs_zx_removed_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = p->thread;
+
+    (void) result;
+    diskfs_bt_op_free(thread, op);
+
+    op = diskfs_bt_op_alloc(thread);
+    if (diskfs_ext_insert_async(op, thread, p->txn, p->inode_stash[0],
+                                p->zx_ext.file_offset, p->zx_ext.length,
+                                (uint32_t) p->zx_devid, p->zx_devoff, 0,
+                                diskfs_zx_inserted_cb, request)) {
+        diskfs_zx_inserted_cb(op, op->result, request);
+    }
+} /* diskfs_zx_removed_cb */
+
+
+static void
+diskfs_zx_freed(
+    void *priv,
+    int   status)
+{
+    struct chimera_vfs_request    *request = priv;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = p->thread;
+    struct diskfs_bt_op           *op;
+
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(thread);
+    if (diskfs_ext_remove_async(op, thread, p->txn, p->inode_stash[0],
+                                p->zx_ext.file_offset, diskfs_zx_removed_cb,
+                                request)) {
+        diskfs_zx_removed_cb(op, op->result, request);
+    }
+} /* diskfs_zx_freed */
+
+
+static void
+diskfs_zx_written(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = p->thread;
+
+    evpl_iovec_release(evpl, &p->zx_buf);
+    p->zx_buf.data = NULL;
+
+    diskfs_pending_io_add(thread, -1);
+    diskfs_io_resume_waiters(thread);
+
+    if (status) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    /* The plain copy is durable: let go of the old backing (a free, or a
+     * dedup reference drop) and repoint the record. */
+    diskfs_ext_free_backing(thread, p->txn, &p->zx_ext, diskfs_zx_freed, request);
+} /* diskfs_zx_written */
+
+
+static void
+diskfs_zx_alloc_resume(
+    struct diskfs_thread *thread,
+    void                 *arg)
+{
+    (void) thread;
+    diskfs_zx_alloc((struct chimera_vfs_request *) arg);
+} /* diskfs_zx_alloc_resume */
+
+
+static void
+diskfs_zx_alloc(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_shared          *shared = thread->shared;
+    uint64_t                       len    = SM_ALIGN_UP(p->zx_ext.length);
+    int                            rc;
+
+    if (diskfs_io_gate(thread, request, diskfs_zx_alloc)) {
+        return;
+    }
+
+    rc = diskfs_inode_alloc_space(thread, p->txn, p->inode_stash[0], len,
+                                  SM_RESERVATION_MIN, &p->zx_devid, &p->zx_devoff,
+                                  diskfs_zx_alloc_resume, request);
+    if (rc == SM_AGAIN) {
+        return;
+    }
+    if (rc) {
+        evpl_iovec_release(thread->evpl, &p->zx_buf);
+        p->zx_buf.data = NULL;
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_ENOSPC);
+        return;
+    }
+
+    diskfs_pending_io_add(thread, 1);
+    diskfs_metric_block_io(thread, DISKFS_METRIC_IO_WRITE,
+                           DISKFS_METRIC_IO_DATA, len);
+    diskfs_metric_block_io_device(thread, p->zx_devid, DISKFS_METRIC_IO_WRITE,
+                                  DISKFS_METRIC_IO_DATA, len);
+    evpl_block_write(thread->evpl, thread->queue[p->zx_devid], &p->zx_buf, 1,
+                     p->zx_devoff, diskfs_write_data_sync(shared, request),
+                     diskfs_zx_written, request);
+} /* diskfs_zx_alloc */
+
+
+static void
+diskfs_zx_read_cb(
+    struct evpl *evpl,
+    int          status,
+    void        *private_data)
+{
+    struct chimera_vfs_request     *request = private_data;
+    struct diskfs_request_private  *p       = request->plugin_data;
+    struct diskfs_thread           *thread  = p->thread;
+    struct diskfs_extent           *e       = &p->zx_ext;
+    const struct diskfs_zchunk_hdr *hdr     = p->zx_buf.data;
+    struct evpl_iovec               plain;
+    uint64_t                        len     = SM_ALIGN_UP(e->length);
+
+    diskfs_pending_io_add(thread, -1);
+    diskfs_io_resume_waiters(thread);
+
+    if (!status && !(e->flags & DISKFS_EXT_COMPRESSED)) {
+        /* A shared plain chunk: the bytes are already in zx_buf. */
+        memset((uint8_t *) p->zx_buf.data + e->length, 0, len - e->length);
+        p->zx_buf.length = len;
+        diskfs_zx_alloc(request);
+        return;
+    }
+
+    if (!status &&
+        (hdr->magic != DISKFS_ZCHUNK_MAGIC ||
+         hdr->clen > p->zx_buf.length - sizeof(*hdr) ||
+         hdr->rlen > DISKFS_ZCHUNK_SIZE ||
+         diskfs_decompress_chunk(thread, diskfs_ext_zalg(e->flags),
+                                 (const uint8_t *) (hdr + 1), hdr->clen,
+                                 thread->zraw, hdr->rlen) != 0)) {
+        chimera_diskfs_error("corrupt compressed chunk (expand)");
+        status = CHIMERA_VFS_EIO;
+    }
+
+    if (!status && evpl_iovec_alloc(evpl, len, 4096, 1, 0, &plain) <= 0) {
+        status = CHIMERA_VFS_EIO;
+    }
+
+    if (status) {
+        evpl_iovec_release(evpl, &p->zx_buf);
+        p->zx_buf.data = NULL;
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    /* Only the extent's logical bytes survive; a truncated-off tail of the
+     * chunk is zeroed rather than carried into the plain copy. */
+    memset(thread->zraw + e->length, 0, len - e->length);
+    memcpy(plain.data, thread->zraw, len);
+
+    evpl_iovec_release(evpl, &p->zx_buf);
+    p->zx_buf = plain;
+
+    diskfs_zx_alloc(request);
+} /* diskfs_zx_read_cb */
+
+
+static void
+diskfs_zx_read(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_extent          *e      = &p->zx_ext;
+    uint64_t                       plen   = diskfs_ext_phys_len(e->flags, e->length);
+
+    if (diskfs_io_gate(thread, request, diskfs_zx_read)) {
+        return;
+    }
+
+    if (evpl_iovec_alloc(thread->evpl, plen, 4096, 1, 0, &p->zx_buf) <= 0) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    diskfs_pending_io_add(thread, 1);
+    diskfs_metric_block_io(thread, DISKFS_METRIC_IO_READ,
+                           DISKFS_METRIC_IO_DATA, plen);
+    diskfs_metric_block_io_device(thread, e->device_id, DISKFS_METRIC_IO_READ,
+                                  DISKFS_METRIC_IO_DATA, plen);
+    evpl_block_read(thread->evpl, thread->queue[e->device_id], &p->zx_buf, 1,
+                    e->device_offset, diskfs_zx_read_cb, request);
+} /* diskfs_zx_read */
+
+
+static void
+diskfs_zx_probe_cb(
+    struct diskfs_bt_op *op,
+    int                  result,
+    void                *private_data)
+{
+    struct chimera_vfs_request    *request = private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_extent           e;
+    int                            have;
+
+    have = diskfs_ext_from_op(op, result, &e);
+    diskfs_bt_op_free(p->thread, op);
+
+    if (have && (e.flags & DISKFS_EXT_WHOLE) &&
+        e.file_offset < p->zx_ahi && e.file_offset + e.length > p->zx_alo &&
+        !(p->zx_lo <= e.file_offset && e.file_offset + e.length <= p->zx_hi)) {
+        p->zx_ext = e;
+        diskfs_zx_read(request);
+        return;
+    }
+
+    p->zx_probe++;
+    diskfs_zx_probe(request);
+} /* diskfs_zx_probe_cb */
+
+
+static void
+diskfs_zx_probe(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_bt_op           *op;
+
+    if (p->zx_probe == 2) {
+        p->zx_cont(request);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(thread);
+    if (diskfs_ext_floor_async(op, thread, p->inode_stash[0],
+                               p->zx_probe ? p->zx_hi : p->zx_alo,
+                               p->rec_scratch, sizeof(p->rec_scratch),
+                               diskfs_zx_probe_cb, request)) {
+        diskfs_zx_probe_cb(op, op->result, request);
+    }
+} /* diskfs_zx_probe */
+
+
+/*
+ * Make [alo, ahi) safe to modify on a compressed or deduplicated pool (see
+ * above), then run cont.  [lo, hi) is the byte range the caller replaces or
+ * deallocates outright; whole extents inside it are left for the caller to
+ * drop.  Other pools go straight to cont.
+ */
+void
+diskfs_zx_expand(
+    struct chimera_vfs_request *request,
+    uint64_t                    alo,
+    uint64_t                    ahi,
+    uint64_t                    lo,
+    uint64_t                    hi,
+    void (                     *cont )(struct chimera_vfs_request *))
+{
+    struct diskfs_request_private *p = request->plugin_data;
+
+    if ((p->thread->shared->compression == DISKFS_COMPRESS_NONE &&
+         !p->thread->shared->dedup) || alo >= ahi) {
+        cont(request);
+        return;
+    }
+
+    p->zx_alo      = alo;
+    p->zx_ahi      = ahi;
+    p->zx_lo       = lo;
+    p->zx_hi       = hi;
+    p->zx_probe    = 0;
+    p->zx_cont     = cont;
+    p->zx_buf.data = NULL;
+    diskfs_zx_probe(request);
+} /* diskfs_zx_expand */
+
+
+/* Tail shared by every write path (in-place, unwritten-split, redirect,
+ * inline): stamp inode metadata, then RMW reads (if any) -> phase2 data write.
+ * An inline write's data is already in the INLINE record, so it commits here. */
 static void
 diskfs_write_finish_map(struct chimera_vfs_request *request)
 {
@@ -1933,6 +2745,7 @@ diskfs_write_finish_map(struct chimera_vfs_request *request)
      * synchronously as before and reports FILE_SYNC.
      */
     deferrable = diskfs_private->inplace_written &&
+        !diskfs_private->inline_dirty &&
         !size_grew &&
         !killpriv &&
         request->write.sync != CHIMERA_VFS_WRITE_FILESYNC &&
@@ -1970,6 +2783,16 @@ diskfs_write_finish_map(struct chimera_vfs_request *request)
      * diskfs_txn_unlock_all).  The lock is a logical flag, so holding it across
      * async I/O doesn't block the worker -- conflicting ops park as waiters. */
 
+    if (inode->inline_data) {
+        diskfs_op_ok(request, diskfs_private->txn);
+        return;
+    }
+
+    if (diskfs_private->zwrite) {
+        diskfs_write_zphase2(request);
+        return;
+    }
+
     if (diskfs_private->need_prefix_read || diskfs_private->need_suffix_read) {
         diskfs_private->rmw_phase = 1;
 
@@ -2025,13 +2848,37 @@ diskfs_write_finish_map(struct chimera_vfs_request *request)
 } /* diskfs_write_finish_map */
 
 
+/* A dedup-index update under this write failed (DISKFS_DEDUP_EIO): drop the
+ * compressed chunk buffers a zwrite still holds and abort the txn. */
+static void
+diskfs_write_index_fail(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p = request->plugin_data;
+
+    if (p->niov) {
+        evpl_iovecs_release(p->thread->evpl, p->iov, p->niov);
+        p->niov = 0;
+    }
+
+    diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+} /* diskfs_write_index_fail */
+
+
 /* Redirect path: record the freshly-allocated extent (coalescing it with a
- * contiguous predecessor -- e.g. a sequential append), then run the tail. */
+ * contiguous predecessor -- e.g. a sequential append), then run the tail.  A
+ * compressed write records its chunks one by one instead. */
 static void
 diskfs_write_trim_done(struct chimera_vfs_request *request)
 {
     struct diskfs_request_private *p = request->plugin_data;
 
+    if (p->zwrite) {
+        p->zc_next  = 0;
+        p->loop_off = 0;
+        diskfs_write_zput(request);
+        return;
+    }
+
     p->ci_off    = p->rmw_aligned_start;
     p->ci_len    = p->rmw_aligned_length;
     p->ci_devid  = (uint32_t) p->rmw_device_id;
@@ -2202,6 +3049,30 @@ diskfs_write_trim_oright_removed_cb(
 } /* diskfs_write_trim_oright_removed_cb */
 
 
+static void
+diskfs_write_trim_inside_freed(
+    void *priv,
+    int   status)
+{
+    struct chimera_vfs_request    *request = priv;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = p->thread;
+    struct diskfs_bt_op           *op;
+
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_write_index_fail(request);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(thread);
+    if (diskfs_ext_remove_async(op, thread, p->txn, p->inode_stash[0],
+                                p->ext_iter.file_offset,
+                                diskfs_write_trim_advance_cb, request)) {
+        diskfs_write_trim_advance_cb(op, op->result, request);
+    }
+} /* diskfs_write_trim_inside_freed */
+
+
 static void
 diskfs_write_trim_process(struct chimera_vfs_request *request)
 {
@@ -2229,17 +3100,12 @@ diskfs_write_trim_process(struct chimera_vfs_request *request)
      * blocks (rmw_device_offset), so the old device blocks backing the part of
      * this extent that the region covers are now garbage and must be freed --
      * otherwise every overwrite leaks space.  (The in-place paths never reach
-     * here; they reuse the existing blocks and free nothing.) */
-    if (es >= astart && ee <= aend) {
-        /* Completely inside the aligned region: free + remove, then advance. */
-        diskfs_thread_free_space(thread, p->txn, p->ext_iter.device_id,
-                                 p->ext_iter.device_offset,
-                                 SM_ALIGN_UP(p->ext_iter.length));
-        op = diskfs_bt_op_alloc(thread);
-        if (diskfs_ext_remove_async(op, thread, p->txn, p->inode_stash[0], es,
-                                    diskfs_write_trim_advance_cb, request)) {
-            diskfs_write_trim_advance_cb(op, op->result, request);
-        }
+     * here; they reuse the existing blocks and free nothing.) */
+    if (es >= astart && ee <= aend) {
+        /* Completely inside the aligned region: free + remove, then advance.
+         * (Compressed and shared chunks only ever reach this branch.) */
+        diskfs_ext_free_backing(thread, p->txn, &p->ext_iter,
+                                diskfs_write_trim_inside_freed, request);
     } else if (es < astart && ee > aend) {
         /* Spans the region: free the covered middle, then insert tail at
          * aligned_end first. */
@@ -2452,8 +3318,11 @@ diskfs_write_recon_process(struct chimera_vfs_request *request)
         overlap_length = read_left;
     }
 
-    if (extent->flags & DISKFS_EXT_UNWRITTEN) {
-        /* Reserved but never written: reads back as zeros, no device I/O. */
+    if (extent->flags & (DISKFS_EXT_UNWRITTEN | DISKFS_EXT_COMPRESSED)) {
+        /* Reserved but never written: reads back as zeros, no device I/O.  A
+         * compressed chunk still here lies wholly inside the written bytes
+         * (diskfs_zx_expand rewrote any other), so none of it survives into
+         * the edge block either. */
         evpl_iovec_cursor_zero(&p->rd_cursor, overlap_length);
         read_offset   += overlap_length;
         read_left     -= overlap_length;
@@ -2678,8 +3547,6 @@ diskfs_write_inode_cb(
     struct diskfs_thread          *thread      = p->thread;
     uint64_t                       write_start = request->write.offset;
     uint64_t                       write_end   = write_start + request->write.length;
-    uint64_t                       aligned_start, aligned_end;
-    struct diskfs_bt_op           *op;
 
     if (unlikely(status != CHIMERA_VFS_OK)) {
         diskfs_op_fail(request, p->txn, status);
@@ -2702,8 +3569,72 @@ diskfs_write_inode_cb(
         return;
     }
 
-    aligned_start = write_start & ~4095ULL;
-    aligned_end   = (write_end + 4095ULL) & ~4095ULL;
+    p->inode_stash[0] = inode;
+
+    /* Small files live in the inode block: a write that stays under the
+     * inline limit on an inline (or still empty, hence extent-free) file just
+     * updates the INLINE record.  Growing an inline file past the limit first
+     * moves its bytes to a block-0 extent -- unless this write replaces all of
+     * them -- and then proceeds as an ordinary write. */
+    if (inode->inline_data || (inode->size == 0 && thread->shared->inline_data)) {
+        if (write_end <= DISKFS_INLINE_MAX) {
+            diskfs_write_inline(request);
+            return;
+        }
+        if (inode->inline_data) {
+            diskfs_inline_convert(request,
+                                  !(write_start == 0 && write_end >= inode->inline_len),
+                                  diskfs_write_map);
+            return;
+        }
+    }
+
+    diskfs_write_map(request);
+} /* diskfs_write_inode_cb */
+
+
+/* Write into a copy of an inline file's data and store it as the INLINE
+ * record; diskfs_write_finish_map then stamps the inode and commits. */
+static void
+diskfs_write_inline(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p           = request->plugin_data;
+    struct diskfs_inode           *inode       = p->inode_stash[0];
+    uint64_t                       write_start = request->write.offset;
+    uint64_t                       write_end   = write_start + request->write.length;
+    uint32_t                       len         = inode->inline_len;
+    uint8_t                       *data;
+    struct evpl_iovec_cursor       cursor;
+
+    /* Bytes between the old record end and the write read as zeros. */
+    if (write_end > len) {
+        len = (uint32_t) write_end;
+    }
+
+    data = diskfs_inline_stage(inode, len);
+
+    evpl_iovec_cursor_init(&cursor, request->write.iov, request->write.niov);
+    evpl_iovec_cursor_copy(&cursor, data + write_start, request->write.length);
+
+    diskfs_inline_store(request, inode->inline_data != NULL, data, len,
+                        diskfs_write_finish_map);
+} /* diskfs_write_inline */
+
+
+/* Extent-form write: compute the 4 KiB-aligned region and classify it.  On a
+ * compressed or deduplicated pool, a write covering whole chunks takes the
+ * chunked path; either way, whole extents it would only partly replace are
+ * first rewritten plain. */
+static void
+diskfs_write_map(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p             = request->plugin_data;
+    struct diskfs_thread          *thread        = p->thread;
+    struct diskfs_inode           *inode         = p->inode_stash[0];
+    uint64_t                       write_start   = request->write.offset;
+    uint64_t                       write_end     = write_start + request->write.length;
+    uint64_t                       aligned_start = write_start & ~4095ULL;
+    uint64_t                       aligned_end   = (write_end + 4095ULL) & ~4095ULL;
 
     p->rmw_prefix_len     = write_start - aligned_start;
     p->rmw_suffix_len     = aligned_end - write_end;
@@ -2714,15 +3645,32 @@ diskfs_write_inode_cb(
     p->rmw_suffix_adjust  = 0;
     p->need_prefix_read   = 0;
     p->need_suffix_read   = 0;
-    p->inode_stash[0]     = inode;
 
-    op = diskfs_bt_op_alloc(thread);
-    if (diskfs_ext_floor_async(op, thread, inode, aligned_start, p->rec_scratch,
-                               sizeof(p->rec_scratch), diskfs_write_classify_cb,
-                               request)) {
+    p->zwrite = (thread->shared->compression != DISKFS_COMPRESS_NONE ||
+                 thread->shared->dedup) &&
+        write_start % DISKFS_ZCHUNK_SIZE == 0 &&
+        (write_end % DISKFS_ZCHUNK_SIZE == 0 || write_end >= inode->size) &&
+        (aligned_end - aligned_start + DISKFS_ZCHUNK_SIZE - 1) / DISKFS_ZCHUNK_SIZE <=
+        DISKFS_ZWRITE_MAX_CHUNKS;
+
+    diskfs_zx_expand(request, aligned_start, aligned_end, write_start, write_end,
+                     p->zwrite ? diskfs_write_zcompress : diskfs_write_classify);
+} /* diskfs_write_map */
+
+
+static void
+diskfs_write_classify(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_bt_op           *op     = diskfs_bt_op_alloc(thread);
+
+    if (diskfs_ext_floor_async(op, thread, p->inode_stash[0], p->rmw_aligned_start,
+                               p->rec_scratch, sizeof(p->rec_scratch),
+                               diskfs_write_classify_cb, request)) {
         diskfs_write_classify_cb(op, op->result, request);
     }
-} /* diskfs_write_inode_cb */
+} /* diskfs_write_classify */
 
 
 static void
@@ -2742,9 +3690,12 @@ diskfs_write_classify_cb(
     have = diskfs_ext_from_op(op, result, &e);
     diskfs_bt_op_free(thread, op);
 
-    if (have && e.file_offset <= astart && e.file_offset + e.length >= aend) {
+    if (have && !(e.flags & DISKFS_EXT_WHOLE) &&
+        e.file_offset <= astart && e.file_offset + e.length >= aend) {
         /* Single extent fully covers the region: overwrite its blocks in
-         * place at the matching device offset. */
+         * place at the matching device offset.  (A compressed or shared
+         * chunk is never overwritten in place; it is replaced through the
+         * redirect.) */
         p->rmw_device_id     = e.device_id;
         p->rmw_device_offset = e.device_offset + (astart - e.file_offset);
 
@@ -2826,6 +3777,395 @@ diskfs_write_alloc_resume(
 } /* diskfs_write_alloc_resume */
 
 
+/*
+ * Chunked write (compressed and/or deduplicated pools).  A write that starts
+ * on a DISKFS_ZCHUNK_SIZE boundary and ends on one (or at/after EOF) replaces
+ * whole chunks, so each chunk can be staged, transformed and recorded as its
+ * own extent:
+ *
+ *   zcompress (stage, fingerprint + compress each chunk into iov[i])
+ *     -> [zdedup (look the fingerprints up; hits take a reference)]
+ *     -> zalloc (one allocation for all chunks still to be written)
+ *     -> trim (free the replaced backing, as for a redirect)
+ *     -> zput (one record per chunk, indexing new shared chunks)
+ *     -> finish_map -> zphase2 (data write)
+ *
+ * Chunks that fail the sampling test or would not save a block are stored
+ * uncompressed.  The staging buffers ride in iov[0..niov) and are released by
+ * diskfs_io_callback once the data write completes.
+ */
+static void
+diskfs_write_zcompress(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_shared          *shared = thread->shared;
+    uint64_t                       astart = p->rmw_aligned_start;
+    uint64_t                       aend   = astart + p->rmw_aligned_length;
+    uint64_t                       we     = request->write.offset + request->write.length;
+    const uint32_t                 hlen   = sizeof(struct diskfs_zchunk_hdr);
+    struct evpl_iovec_cursor       cursor;
+    uint64_t                       cstart;
+    int                            i;
+
+    evpl_iovec_cursor_init(&cursor, request->write.iov, request->write.niov);
+    p->zc_hashed = 0;
+    p->zc_dup    = 0;
+
+    for (cstart = astart, i = 0; cstart < aend; cstart += DISKFS_ZCHUNK_SIZE, i++) {
+        uint32_t  llen = aend - cstart < DISKFS_ZCHUNK_SIZE ?
+            (uint32_t) (aend - cstart) : DISKFS_ZCHUNK_SIZE;
+        uint32_t  dlen = we - cstart < llen ? (uint32_t) (we - cstart) : llen;
+        uint32_t  clen = 0;
+        uint8_t  *buf;
+
+        if (evpl_iovec_alloc(thread->evpl, llen, 4096, 1, 0, &p->iov[i]) <= 0) {
+            evpl_iovecs_release(thread->evpl, p->iov, p->niov);
+            p->niov = 0;
+            diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+            return;
+        }
+        p->niov = i + 1;
+
+        buf = p->iov[i].data;
+        evpl_iovec_cursor_get_blob(&cursor, buf, dlen);
+        memset(buf + dlen, 0, llen - dlen);
+        p->zc_flags[i] = 0;
+        p->zc_src[i]   = -1;
+
+        /* Only full chunks are shared: a short tail chunk is rewritten by
+         * the next append anyway. */
+        if (shared->dedup && llen == DISKFS_ZCHUNK_SIZE) {
+            XXH128_hash_t h = XXH3_128bits(buf, llen);
+
+            p->zc_hash[i]    = h.low64;
+            p->zc_hash_hi[i] = h.high64;
+            p->zc_hashed    |= 1u << i;
+
+            /* A repeat of an earlier chunk of this same write (zero runs
+             * in an image, typically) shares that chunk's blocks. */
+            for (int k = 0; k < i; k++) {
+                if ((p->zc_hashed & (1u << k)) && p->zc_hash[k] == h.low64) {
+                    if (p->zc_hash_hi[k] == h.high64) {
+                        p->zc_src[i] = k;
+                        p->zc_dup   |= 1u << i;
+                    } else {
+                        p->zc_hashed &= ~(1u << i);
+                    }
+                    break;
+                }
+            }
+            if (p->zc_dup & (1u << i)) {
+                continue;
+            }
+        }
+
+        /* Only worth it if the chunk comes out at least a block smaller. */
+        if (shared->compression && llen > SM_BLOCK_SIZE &&
+            diskfs_compress_worthwhile(buf, llen)) {
+            clen = diskfs_compress_chunk(thread, buf, llen, thread->zraw,
+                                         llen - SM_BLOCK_SIZE - hlen);
+        }
+
+        if (clen) {
+            struct diskfs_zchunk_hdr *hdr  = (struct diskfs_zchunk_hdr *) buf;
+            uint32_t                  plen = SM_ALIGN_UP(hlen + clen);
+
+            hdr->magic    = DISKFS_ZCHUNK_MAGIC;
+            hdr->clen     = clen;
+            hdr->rlen     = llen;
+            hdr->reserved = 0;
+            memcpy(buf + hlen, thread->zraw, clen);
+            memset(buf + hlen + clen, 0, plen - hlen - clen);
+
+            p->iov[i].length = plen;
+            p->zc_flags[i]   = diskfs_ext_zflags(shared->compression,
+                                                 plen >> SM_BLOCK_SHIFT);
+        }
+    }
+
+    if (p->zc_hashed & ~p->zc_dup) {
+        p->zc_next = 0;
+        diskfs_write_zdedup(request);
+        return;
+    }
+
+    diskfs_write_zalloc(request);
+} /* diskfs_write_zcompress */
+
+
+static void
+diskfs_write_zdedup_cb(
+    void *priv,
+    int   status)
+{
+    struct chimera_vfs_request    *request = priv;
+    struct diskfs_request_private *p       = request->plugin_data;
+    int                            i       = p->zc_next - 1;
+
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_write_index_fail(request);
+        return;
+    }
+
+    if (status > 0) {
+        p->zc_dup   |= 1u << i;
+        p->zc_src[i] = -1;
+    } else if (p->zc_src[i] >= 0) {
+        /* A repeat that could not take its own reference: store it. */
+        p->zc_hashed &= ~(1u << i);
+        p->zc_dup    &= ~(1u << i);
+        p->zc_src[i]  = -1;
+    } else if (status < 0) {
+        p->zc_hashed &= ~(1u << i);
+    }
+
+    diskfs_write_zdedup(request);
+} /* diskfs_write_zdedup_cb */
+
+
+/*
+ * Look each fingerprinted chunk up in the dedup index, in chunk order.  A hit
+ * becomes a reference to the stored chunk (taken now, before the trim can drop
+ * the last existing one).  A repeat of an earlier chunk follows its source: if
+ * that was a hit, the repeat takes its own reference; if that cannot be
+ * indexed, the repeat is written on its own.
+ */
+static void
+diskfs_write_zdedup(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p = request->plugin_data;
+
+    while (p->zc_next < p->niov) {
+        int i   = p->zc_next++;
+        int src = p->zc_src[i];
+
+        if (!(p->zc_hashed & (1u << i))) {
+            continue;
+        }
+
+        if (src >= 0) {
+            if (!(p->zc_hashed & (1u << src))) {
+                p->zc_hashed &= ~(1u << i);
+                p->zc_dup    &= ~(1u << i);
+                p->zc_src[i]  = -1;
+                continue;
+            }
+            if (p->zc_src[src] >= 0 || !(p->zc_dup & (1u << src))) {
+                continue;       /* source is written here: follows it at zput */
+            }
+        } else if (p->zc_dup & (1u << i)) {
+            continue;
+        }
+
+        diskfs_dedup_lookup(p->thread, p->txn, p->zc_hash[i], p->zc_hash_hi[i],
+                            &p->zc_devid[i], &p->zc_devoff[i], &p->zc_flags[i],
+                            diskfs_write_zdedup_cb, request);
+        return;
+    }
+
+    diskfs_write_zalloc(request);
+} /* diskfs_write_zdedup */
+
+
+static void
+diskfs_write_zalloc_resume(
+    struct diskfs_thread *thread,
+    void                 *arg)
+{
+    (void) thread;
+    diskfs_write_zalloc((struct chimera_vfs_request *) arg);
+} /* diskfs_write_zalloc_resume */
+
+
+static void
+diskfs_write_zalloc(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    uint64_t                       total  = 0;
+    uint64_t                       dev_id, dev_off;
+    int                            rc;
+
+    for (int i = 0; i < p->niov; i++) {
+        if (!(p->zc_dup & (1u << i))) {
+            total += p->iov[i].length;
+        }
+    }
+
+    if (total) {
+        rc = diskfs_inode_alloc_space(thread, p->txn, p->inode_stash[0],
+                                      (int64_t) total, SM_RESERVATION_MIN,
+                                      &dev_id, &dev_off,
+                                      diskfs_write_zalloc_resume, request);
+        if (rc == SM_AGAIN) {
+            return;
+        }
+        if (rc) {
+            evpl_iovecs_release(thread->evpl, p->iov, p->niov);
+            p->niov = 0;
+            diskfs_op_fail(request, p->txn, CHIMERA_VFS_ENOSPC);
+            return;
+        }
+
+        p->rmw_device_id     = dev_id;
+        p->rmw_device_offset = dev_off;
+    } else {
+        /* Every chunk is a duplicate; zphase2 writes nothing. */
+        p->rmw_device_id     = 0;
+        p->rmw_device_offset = 0;
+    }
+
+    /* No edge reconstruction: the write starts chunk-aligned and anything
+     * past its end in the last block is beyond EOF, so staging zero-filled
+     * it already. */
+    diskfs_write_trim_start(request);
+} /* diskfs_write_zalloc */
+
+
+static void
+diskfs_write_zindexed(
+    void *priv,
+    int   status)
+{
+    struct chimera_vfs_request *request = priv;
+
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_write_index_fail(request);
+        return;
+    }
+
+    diskfs_write_zput(request);
+} /* diskfs_write_zindexed */
+
+
+/* A new shared chunk is recorded: index it, with one reference for its own
+ * extent and one per repeat later in this write. */
+static void
+diskfs_write_zindex(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p    = request->plugin_data;
+    int                            i    = p->zc_next - 1;
+    uint64_t                       refs = 1;
+
+    for (int j = i + 1; j < p->niov; j++) {
+        if (p->zc_src[j] == i) {
+            refs++;
+        }
+    }
+
+    diskfs_dedup_insert(p->thread, p->txn, p->zc_hash[i], p->zc_hash_hi[i],
+                        p->zc_devid[i], p->zc_devoff[i], p->zc_flags[i], refs,
+                        diskfs_write_zindexed, request);
+} /* diskfs_write_zindex */
+
+
+/* Record the next chunk: a reference to a stored chunk, a new chunk (indexed
+ * when shared), or a plain one through the coalescing insert. */
+static void
+diskfs_write_zput(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p    = request->plugin_data;
+    uint64_t                       aend = p->rmw_aligned_start + p->rmw_aligned_length;
+    int                            i    = p->zc_next;
+
+    if (i == p->niov) {
+        diskfs_write_finish_map(request);
+        return;
+    }
+
+    p->zc_next++;
+    p->ci_off  = p->rmw_aligned_start + (uint64_t) i * DISKFS_ZCHUNK_SIZE;
+    p->ci_len  = aend - p->ci_off < DISKFS_ZCHUNK_SIZE ?
+        aend - p->ci_off : DISKFS_ZCHUNK_SIZE;
+    p->ci_cont = diskfs_write_zput;
+
+    if (p->zc_dup & (1u << i)) {
+        int src = p->zc_src[i] >= 0 ? p->zc_src[i] : i;
+
+        p->ci_devid  = p->zc_devid[src];
+        p->ci_devoff = p->zc_devoff[src];
+        p->ci_flags  = p->zc_flags[src];
+        diskfs_ext_put_insert(request);
+        return;
+    }
+
+    p->zc_devid[i]  = (uint32_t) p->rmw_device_id;
+    p->zc_devoff[i] = p->rmw_device_offset + p->loop_off;
+    p->loop_off    += p->iov[i].length;
+    p->ci_devid     = p->zc_devid[i];
+    p->ci_devoff    = p->zc_devoff[i];
+
+    if (p->zc_hashed & (1u << i)) {
+        p->zc_flags[i] |= DISKFS_EXT_DEDUP;
+        p->ci_cont      = diskfs_write_zindex;
+    }
+    p->ci_flags = p->zc_flags[i];
+
+    if (p->ci_flags) {
+        diskfs_ext_put_insert(request);
+    } else {
+        diskfs_ext_put(request);
+    }
+} /* diskfs_write_zput */
+
+
+/* Write the staged chunks that were not deduplicated back to back from
+ * rmw_device_offset, grouped up to the device's request size. */
+static void
+diskfs_write_zphase2(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p      = request->plugin_data;
+    struct diskfs_thread          *thread = p->thread;
+    struct diskfs_shared          *shared = thread->shared;
+    uint64_t                       devid  = p->rmw_device_id;
+    uint64_t                       maxreq = shared->devices[devid].max_request_size;
+    uint64_t                       off    = 0;
+    int                            g      = 0;
+
+    p->rmw_phase = 2;
+    p->pending   = 0;
+
+    while (g < p->niov) {
+        uint64_t len;
+        int      n = 1;
+
+        if (p->zc_dup & (1u << g)) {
+            g++;
+            continue;
+        }
+
+        len = p->iov[g].length;
+        while (g + n < p->niov && n < 32 && !(p->zc_dup & (1u << (g + n))) &&
+               len + p->iov[g + n].length <= maxreq) {
+            len += p->iov[g + n].length;
+            n++;
+        }
+
+        p->pending++;
+        diskfs_pending_io_add(thread, 1);
+        diskfs_metric_block_io(thread, DISKFS_METRIC_IO_WRITE,
+                               DISKFS_METRIC_IO_DATA, len);
+        diskfs_metric_block_io_device(thread, devid, DISKFS_METRIC_IO_WRITE,
+                                      DISKFS_METRIC_IO_DATA, len);
+        evpl_block_write(thread->evpl, thread->queue[devid], &p->iov[g], n,
+                         p->rmw_device_offset + off,
+                         diskfs_write_data_sync(shared, request),
+                         diskfs_io_callback, request);
+
+        off += len;
+        g   += n;
+    }
+
+    if (p->pending == 0) {
+        /* Every chunk was a duplicate: nothing to write. */
+        evpl_iovecs_release(thread->evpl, p->iov, p->niov);
+        p->niov = 0;
+        diskfs_op_ok(request, p->txn);
+    }
+} /* diskfs_write_zphase2 */
+
+
 /*
  * Unwritten-extent in-place split: the write lands inside a reserved-but-
  * unwritten extent e=[es,ee) (stashed in p->ext_iter).  Its blocks are
@@ -3004,6 +4344,8 @@ diskfs_write(
     p->need_prefix_read    = 0;
     p->need_suffix_read    = 0;
     p->inplace_written     = 0;
+    p->inline_dirty        = 0;
+    p->zwrite              = 0;
     p->txn                 = diskfs_txn_begin(thread, DISKFS_TXN_WRITE);
 
     /* Warm-handle fast path (see diskfs_read): reuse the inode pinned at open
@@ -3228,6 +4570,30 @@ diskfs_dealloc_spans_after_cb(
 } /* diskfs_dealloc_spans_after_cb */
 
 
+static void
+diskfs_dealloc_inside_freed(
+    void *priv,
+    int   status)
+{
+    struct chimera_vfs_request    *request = priv;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = p->thread;
+    struct diskfs_bt_op           *op;
+
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_op_fail(request, p->txn, CHIMERA_VFS_EIO);
+        return;
+    }
+
+    op = diskfs_bt_op_alloc(thread);
+    if (diskfs_ext_remove_async(op, thread, p->txn, p->inode_stash[0],
+                                p->ext_iter.file_offset,
+                                diskfs_dealloc_modify_advance_cb, request)) {
+        diskfs_dealloc_modify_advance_cb(op, op->result, request);
+    }
+} /* diskfs_dealloc_inside_freed */
+
+
 static void
 diskfs_dealloc_process(struct chimera_vfs_request *request)
 {
@@ -3266,14 +4632,8 @@ diskfs_dealloc_process(struct chimera_vfs_request *request)
      * is what keeps the space-map free accounting from leaking the edge. */
     if (es >= hole_start && ee <= hole_end) {
         /* Completely inside the hole: free + remove, then advance. */
-        diskfs_thread_free_space(thread, p->txn, p->ext_iter.device_id,
-                                 p->ext_iter.device_offset,
-                                 SM_ALIGN_UP(p->ext_iter.length));
-        op = diskfs_bt_op_alloc(thread);
-        if (diskfs_ext_remove_async(op, thread, p->txn, p->inode_stash[0], es,
-                                    diskfs_dealloc_modify_advance_cb, request)) {
-            diskfs_dealloc_modify_advance_cb(op, op->result, request);
-        }
+        diskfs_ext_free_backing(thread, p->txn, &p->ext_iter,
+                                diskfs_dealloc_inside_freed, request);
     } else if (es < hole_start && ee > hole_end) {
         /* Spans the hole: free the (block-aligned) punched-out middle
          * [hole_start, hole_end) of this extent's backing, then insert the tail at
@@ -3727,6 +5087,57 @@ diskfs_allocate_reserve_step(struct chimera_vfs_request *request)
 } /* diskfs_allocate_reserve_step */
 
 
+/* The inline file was converted to extent form: redo the dispatch. */
+static void
+diskfs_allocate_converted(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p = request->plugin_data;
+
+    diskfs_allocate_inode_cb(p->inode_stash[0], CHIMERA_VFS_OK, request);
+} /* diskfs_allocate_converted */
+
+
+/*
+ * ALLOCATE / DEALLOCATE on an inline file.  A punch zeroes the range in the
+ * record; a reservation that stays under the inline limit only extends the
+ * size (the bytes already live in the inode block).  A reservation past it
+ * converts the file to extents and runs the ordinary path.
+ */
+static void
+diskfs_allocate_inline(struct chimera_vfs_request *request)
+{
+    struct diskfs_request_private *p     = request->plugin_data;
+    struct diskfs_inode           *inode = p->inode_stash[0];
+    uint64_t                       start = request->allocate.offset;
+    uint64_t                       end   = start + request->allocate.length;
+    uint8_t                       *data;
+
+    if (request->allocate.flags & CHIMERA_VFS_ALLOCATE_DEALLOCATE) {
+        if (end > inode->inline_len) {
+            end = inode->inline_len;
+        }
+        if (start < end) {
+            data = diskfs_inline_stage(inode, inode->inline_len);
+            memset(data + start, 0, end - start);
+            diskfs_inline_store(request, 1, data, inode->inline_len,
+                                diskfs_allocate_finalize);
+            return;
+        }
+    } else if (request->allocate.length) {
+        if (end > DISKFS_INLINE_MAX) {
+            diskfs_inline_convert(request, 1, diskfs_allocate_converted);
+            return;
+        }
+        if (end > inode->size) {
+            inode->size       = end;
+            inode->space_used = (inode->size + 4095) & ~4095;
+        }
+    }
+
+    diskfs_allocate_finalize(request);
+} /* diskfs_allocate_inline */
+
+
 static void
 diskfs_allocate_inode_cb(
     struct diskfs_inode *inode,
@@ -3745,6 +5156,11 @@ diskfs_allocate_inode_cb(
     diskfs_map_attrs(thread, &request->allocate.r_pre_attr, inode);
     p->inode_stash[0] = inode;
 
+    if (inode->inline_data) {
+        diskfs_allocate_inline(request);
+        return;
+    }
+
     if (request->allocate.flags & CHIMERA_VFS_ALLOCATE_DEALLOCATE) {
         uint64_t hole_start = request->allocate.offset;
         uint64_t hole_end   = hole_start + request->allocate.length;
@@ -3776,7 +5192,11 @@ diskfs_allocate_inode_cb(
             p->status  = 0;
             p->pending = 0;
 
-            diskfs_dealloc_edge_step(request);
+            /* Rewrite plain any compressed chunk the punch would cut into;
+             * only chunks wholly inside the freed interior stay compressed. */
+            diskfs_zx_expand(request, hole_start & ~(uint64_t) SM_BLOCK_MASK,
+                             SM_ALIGN_UP(hole_end), p->loop_off, p->loop_left,
+                             diskfs_dealloc_edge_step);
             return;
         }
     } else if (request->allocate.length) {
@@ -3964,6 +5384,24 @@ diskfs_seek_inode_cb(
         return;
     }
 
+    if (inode->inline_data) {
+        /* Inline file: data is [0, inline_len), the rest one hole. */
+        if (request->seek.what == 0) {
+            if (offset >= inode->inline_len) {
+                diskfs_op_fail(request, p->txn, CHIMERA_VFS_ENXIO);
+                return;
+            }
+            request->seek.r_offset = offset;
+            request->seek.r_eof    = 0;
+        } else {
+            request->seek.r_offset = offset < inode->inline_len ?
+                inode->inline_len : offset;
+            request->seek.r_eof = (request->seek.r_offset >= inode->size);
+        }
+        diskfs_op_ok(request, p->txn);
+        return;
+    }
+
     p->inode_stash[0] = inode;
     p->loop_pos       = offset;
 
@@ -146,7 +146,9 @@ diskfs_il_write_redo(
     struct diskfs_redo_entry *entries,
     uint32_t                  num_entries,
     uint32_t                  nblocks,
+    uint32_t                  nfull,
     uint32_t                  num_deltas,
+    uint32_t                  delta_bytes,
     uint64_t                  end_txn_id);
 
 static uint32_t
@@ -156,7 +158,9 @@ diskfs_il_txn_blocks(
 static uint64_t
 diskfs_il_blocks_reclen(
     uint32_t nblocks,
-    uint32_t num_deltas);
+    uint32_t nfull,
+    uint32_t num_deltas,
+    uint32_t delta_bytes);
 
 static uint64_t
 diskfs_il_txn_reclen(
@@ -505,6 +509,7 @@ diskfs_il_rec_alloc(
         chimera_diskfs_abort_if(!rec, "out of memory allocating IL record");
         rec->blocks_cap = 0;
         rec->iovs       = NULL;
+        rec->log_iovs   = NULL;
         rec->block_bufs = NULL;
         rec->blocks     = NULL;
     }
@@ -515,12 +520,14 @@ diskfs_il_rec_alloc(
      * iovs[0] holds the redo header regardless of the block count. */
     if (nblocks > rec->blocks_cap || !rec->iovs) {
         free(rec->iovs);
+        free(rec->log_iovs);
         free(rec->block_bufs);
         free(rec->blocks);
         rec->iovs       = malloc((1 + nblocks) * sizeof(*rec->iovs));
+        rec->log_iovs   = malloc((1 + nblocks) * sizeof(*rec->log_iovs));
         rec->block_bufs = malloc(nblocks * sizeof(*rec->block_bufs));
         rec->blocks     = malloc(nblocks * sizeof(*rec->blocks));
-        chimera_diskfs_abort_if(!rec->iovs ||
+        chimera_diskfs_abort_if(!rec->iovs || !rec->log_iovs ||
                                 (nblocks && (!rec->block_bufs || !rec->blocks)),
                                 "out of memory growing IL record arrays");
         rec->blocks_cap = nblocks;
@@ -711,6 +718,8 @@ diskfs_push_unpin_block(
      * atomic pin_count/state, and the block stays on the LRU either way. */
     if (__atomic_sub_fetch(&blk->pin_count, 1, __ATOMIC_ACQ_REL) == 0) {
         __atomic_store_n(&blk->state, DISKFS_BLOCK_CLEAN, __ATOMIC_RELEASE);
+        /* The newest image is durably home: the next txn may log a delta. */
+        diskfs_block_set_home(blk);
         __atomic_sub_fetch(&shard->pinned, 1, __ATOMIC_RELAXED);
     }
 } /* diskfs_push_unpin_block */
@@ -1160,8 +1169,10 @@ diskfs_il_apply_doorbell_cb(
 
 
 /*
- * Build a full-block redo record for one transaction and issue a durable
- * write into the reserved intent-log region.  Runs on the intent-log thread.
+ * Build a redo record for a batch of transactions and issue a durable write
+ * into the reserved intent-log region.  Blocks the committing workers diffed
+ * (tb->delta_len != 0) ride in the header region as byte runs; the rest are
+ * written as full images.  Runs on the intent-log thread.
  */
 static void
 diskfs_il_write_redo(
@@ -1169,7 +1180,9 @@ diskfs_il_write_redo(
     struct diskfs_redo_entry *entries,
     uint32_t                  num_entries,
     uint32_t                  nblocks,
+    uint32_t                  nfull,
     uint32_t                  num_deltas,
+    uint32_t                  delta_bytes,
     uint64_t                  end_txn_id)
 {
     struct diskfs_redo_ctx          *ctx;
@@ -1177,12 +1190,12 @@ diskfs_il_write_redo(
     struct diskfs_redo_header       *hdr;
     struct diskfs_redo_block_header *bh;
     uint64_t                         hdr_len, reclen, offset;
-    uint32_t                         i, e, nd;
+    uint32_t                         i, e, nd, nf, db;
     char                            *p;
     int                              niov;
 
-    hdr_len = diskfs_il_hdr_len(nblocks, num_deltas);
-    reclen  = diskfs_il_blocks_reclen(nblocks, num_deltas);
+    hdr_len = diskfs_il_hdr_len(nblocks, num_deltas, delta_bytes);
+    reclen  = diskfs_il_blocks_reclen(nblocks, nfull, num_deltas, delta_bytes);
 
     /* Caller guarantees space (diskfs_iq_process_channel checks diskfs_il_fits
      * before consuming SQ entries), so placement always succeeds. */
@@ -1201,6 +1214,7 @@ diskfs_il_write_redo(
     rec->reclen     = reclen;
     rec->num_blocks = nblocks;
     rec->niov       = 1 + nblocks;
+    rec->log_niov   = 1 + nfull;
     rec->next       = NULL;
 
     /* iovs[0]: materialized header region (redo_header + per-block headers). */
@@ -1215,22 +1229,27 @@ diskfs_il_write_redo(
     ctx->end_txn_id  = end_txn_id;     /* Stage C: durable/applied watermark target */
     memcpy(ctx->entries, entries, num_entries * sizeof(*ctx->entries));
 
-    p               = (char *) rec->iovs[0].data;
-    hdr             = (struct diskfs_redo_header *) p;
-    hdr->magic      = DISKFS_REDO_MAGIC;
-    hdr->csum_lo    = 0;
-    hdr->csum_hi    = 0;
-    hdr->seq        = il->log_seq++;
-    rec->seq        = hdr->seq;
-    ctx->seq        = hdr->seq;     /* Stage B: apply thread advances applied_seq from this */
-    hdr->tail       = __atomic_load_n(&il->log_tail, __ATOMIC_ACQUIRE);
-    hdr->num_blocks = nblocks;
-    hdr->reclen     = (uint32_t) reclen;
-    hdr->num_deltas = num_deltas;
-    hdr->pad0       = 0;
-    p              += sizeof(*hdr);
-
-    i = 0;
+    p                = (char *) rec->iovs[0].data;
+    hdr              = (struct diskfs_redo_header *) p;
+    hdr->magic       = DISKFS_REDO_MAGIC;
+    hdr->csum_lo     = 0;
+    hdr->csum_hi     = 0;
+    hdr->seq         = il->log_seq++;
+    rec->seq         = hdr->seq;
+    ctx->seq         = hdr->seq;     /* Stage B: apply thread advances applied_seq from this */
+    hdr->tail        = __atomic_load_n(&il->log_tail, __ATOMIC_ACQUIRE);
+    hdr->num_blocks  = nblocks;
+    hdr->reclen      = (uint32_t) reclen;
+    hdr->num_deltas  = num_deltas;
+    hdr->delta_bytes = delta_bytes;
+    p                += sizeof(*hdr);
+
+    /* Every block keeps its snapshot clone in rec->iovs[1 + i] (the tail-pusher
+     * writes home from it by header index), but only full-image blocks are
+     * also queued for the log write in rec->log_iovs. */
+    rec->log_iovs[0] = rec->iovs[0];
+    i                = 0;
+    nf               = 0;
     for (e = 0; e < num_entries; e++) {
         struct diskfs_txn_block *tb;
 
@@ -1239,7 +1258,7 @@ diskfs_il_write_redo(
 
             bh                = (struct diskfs_redo_block_header *) p;
             bh->device_id     = blk->device_id;
-            bh->pad           = 0;
+            bh->delta_len     = tb->delta_len;
             bh->device_offset = blk->device_offset;
             /* Per-block XXH3-128 computed by the submitting worker at commit
              * (tb->snap_csum); recovery verifies each image against this, so
@@ -1251,10 +1270,14 @@ diskfs_il_write_redo(
             evpl_iovec_clone(&rec->iovs[1 + i], &tb->snap_buf->iov);
             rec->block_bufs[i] = tb->snap_buf;
             rec->blocks[i]     = blk;
+            if (!tb->delta_len) {
+                rec->log_iovs[1 + nf++] = rec->iovs[1 + i];
+            }
         }
     }
-    chimera_diskfs_abort_if(i != nblocks,
-                            "redo grouped block count changed (%u != %u)", i, nblocks);
+    chimera_diskfs_abort_if(i != nblocks || nf != nfull,
+                            "redo grouped block count changed (%u != %u, %u != %u)",
+                            i, nblocks, nf, nfull);
 
     /* Serialize this batch's space-map deltas after the per-block headers.  The
      * allocator hot path no longer journals alloc/free to a per-AG on-disk log;
@@ -1283,6 +1306,22 @@ diskfs_il_write_redo(
     chimera_diskfs_abort_if(nd != num_deltas,
                             "redo grouped delta count changed (%u != %u)", nd, num_deltas);
 
+    /* Delta payloads last, in block-header order. */
+    db = 0;
+    for (e = 0; e < num_entries; e++) {
+        struct diskfs_txn_block *tb;
+
+        for (tb = entries[e].entry.txn->blocks; tb; tb = tb->next) {
+            if (tb->delta_len) {
+                memcpy(p, tb->delta, tb->delta_len);
+                p  += tb->delta_len;
+                db += tb->delta_len;
+            }
+        }
+    }
+    chimera_diskfs_abort_if(db != delta_bytes,
+                            "redo grouped delta bytes changed (%u != %u)", db, delta_bytes);
+
     /* Zero the header-region tail padding so the checksum covers deterministic
      * bytes, then stamp the XXH3-128 over the header region only.  Each block
      * image is protected by its own block_csum (stamped above from the worker's
@@ -1303,7 +1342,7 @@ diskfs_il_write_redo(
         hdr->csum_hi = h.high64;
     }
 
-    ctx->segments = (rec->niov + DISKFS_IL_MAX_IOV - 1) / DISKFS_IL_MAX_IOV;
+    ctx->segments = (rec->log_niov + DISKFS_IL_MAX_IOV - 1) / DISKFS_IL_MAX_IOV;
 
     /* Reserve this record's retirement-ring slot (in submission/log order) so
      * the completion can retire the contiguous done-prefix in order. */
@@ -1322,8 +1361,8 @@ diskfs_il_write_redo(
         uint32_t done = 0;
         uint64_t woff = offset;
 
-        while (done < rec->niov) {
-            uint32_t cnt   = rec->niov - done;
+        while (done < rec->log_niov) {
+            uint32_t cnt   = rec->log_niov - done;
             uint64_t bytes = 0;
             uint32_t k;
 
@@ -1331,11 +1370,11 @@ diskfs_il_write_redo(
                 cnt = DISKFS_IL_MAX_IOV;
             }
             for (k = 0; k < cnt; k++) {
-                bytes += rec->iovs[done + k].length;
+                bytes += rec->log_iovs[done + k].length;
             }
 
             evpl_block_write(il->evpl, il->log_queue,
-                             &rec->iovs[done], cnt, woff, il->sync,
+                             &rec->log_iovs[done], cnt, woff, il->sync,
                              diskfs_redo_write_cb, ctx);
             diskfs_metric_il_block_io(il, DISKFS_METRIC_IO_WRITE,
                                       DISKFS_METRIC_IO_INTENT_LOG, bytes);
@@ -1393,10 +1432,12 @@ diskfs_il_txn_deltas(struct diskfs_txn *txn)
 static uint64_t
 diskfs_il_blocks_reclen(
     uint32_t nblocks,
-    uint32_t num_deltas)
+    uint32_t nfull,
+    uint32_t num_deltas,
+    uint32_t delta_bytes)
 {
-    return diskfs_il_hdr_len(nblocks, num_deltas) +
-           (uint64_t) nblocks * DISKFS_BLOCK_SIZE;
+    return diskfs_il_hdr_len(nblocks, num_deltas, delta_bytes) +
+           (uint64_t) nfull * DISKFS_BLOCK_SIZE;
 } /* diskfs_il_blocks_reclen */
 
 
@@ -1405,7 +1446,9 @@ static uint64_t
 diskfs_il_txn_reclen(struct diskfs_txn *txn)
 {
     return diskfs_il_blocks_reclen(diskfs_il_txn_blocks(txn),
-                                   diskfs_il_txn_deltas(txn));
+                                   txn->redo_full_blocks,
+                                   diskfs_il_txn_deltas(txn),
+                                   txn->redo_delta_bytes);
 } /* diskfs_il_txn_reclen */
 
 
@@ -1415,7 +1458,9 @@ diskfs_iq_process_batch(struct diskfs_intent_log *il)
     struct diskfs_redo_entry entries[DISKFS_IL_MAX_IOV];
     uint32_t                 batch_count  = 0;
     uint32_t                 batch_blocks = 0;
+    uint32_t                 batch_full   = 0;
     uint32_t                 batch_deltas = 0;
+    uint32_t                 batch_dbytes = 0;
     uint32_t                 i;
     uint64_t                 pos;
 
@@ -1434,8 +1479,8 @@ diskfs_iq_process_batch(struct diskfs_intent_log *il)
     while (batch_count < DISKFS_IL_MAX_IOV) {
         struct diskfs_gsq_slot *slot = &il->gsq[pos & DISKFS_GSQ_MASK];
         struct diskfs_txn      *txn;
-        uint32_t                nblocks, next_blocks;
-        uint32_t                ndeltas, next_deltas;
+        uint32_t                nblocks, next_blocks, next_full;
+        uint32_t                ndeltas, next_deltas, next_dbytes;
         uint64_t                reclen;
 
         if (__atomic_load_n(&slot->turn, __ATOMIC_ACQUIRE) != pos + 1) {
@@ -1445,16 +1490,23 @@ diskfs_iq_process_batch(struct diskfs_intent_log *il)
         txn         = slot->txn;
         nblocks     = diskfs_il_txn_blocks(txn);
         next_blocks = batch_blocks + nblocks;
+        next_full   = batch_full + txn->redo_full_blocks;
         ndeltas     = diskfs_il_txn_deltas(txn);
         next_deltas = batch_deltas + ndeltas;
+        next_dbytes = batch_dbytes + txn->redo_delta_bytes;
 
         /* Keep one normal record to one backend write.  A txn larger than the
-         * iov cap goes alone via the segmented path. */
-        if (batch_count > 0 && 1 + next_blocks > DISKFS_IL_MAX_IOV) {
+         * iov cap goes alone via the segmented path.  Delta-logged blocks cost
+         * no iovec, only header-region bytes, which are capped separately. */
+        if (batch_count > 0 &&
+            (1 + next_full > DISKFS_IL_MAX_IOV ||
+             diskfs_il_hdr_len(next_blocks, next_deltas, next_dbytes) >
+             DISKFS_REDO_HDR_BATCH_MAX)) {
             break;
         }
 
-        reclen = diskfs_il_blocks_reclen(next_blocks, next_deltas);
+        reclen = diskfs_il_blocks_reclen(next_blocks, next_full,
+                                         next_deltas, next_dbytes);
         if (!diskfs_il_fits(il, reclen)) {
             if (batch_count > 0) {
                 break;
@@ -1478,10 +1530,12 @@ diskfs_iq_process_batch(struct diskfs_intent_log *il)
 
         batch_count++;
         batch_blocks = next_blocks;
+        batch_full   = next_full;
         batch_deltas = next_deltas;
+        batch_dbytes = next_dbytes;
         pos++;
 
-        if (1 + batch_blocks > DISKFS_IL_MAX_IOV) {
+        if (1 + batch_full > DISKFS_IL_MAX_IOV) {
             break;                        /* the lone over-cap txn; stop here */
         }
     }
@@ -1498,7 +1552,8 @@ diskfs_iq_process_batch(struct diskfs_intent_log *il)
     }
 
     il->gsq_head = pos;     /* == base + batch_count; the record covers [base, pos) */
-    diskfs_il_write_redo(il, entries, batch_count, batch_blocks, batch_deltas, pos);
+    diskfs_il_write_redo(il, entries, batch_count, batch_blocks, batch_full,
+                         batch_deltas, batch_dbytes, pos);
     return 1;
 } /* diskfs_iq_process_batch */
 
@@ -2183,6 +2238,100 @@ diskfs_il_apply_thread_shutdown(
 } /* diskfs_il_apply_thread_shutdown */
 
 
+/*
+ * Encode img as byte runs against base into out (struct diskfs_redo_run + data
+ * per run).  Runs closer than DISKFS_REDO_RUN_GAP unchanged bytes are merged.
+ * Returns the encoded length, or 0 if the block is unchanged or the runs would
+ * not fit in max bytes.
+ */
+static uint32_t
+diskfs_redo_delta_encode(
+    const uint8_t *img,
+    const uint8_t *base,
+    uint8_t       *out,
+    uint32_t       max)
+{
+    struct diskfs_redo_run run;
+    uint32_t               off = 0, end, same, len = 0;
+
+    while (off < DISKFS_BLOCK_SIZE) {
+        while (off + 8 <= DISKFS_BLOCK_SIZE && memcmp(img + off, base + off, 8) == 0) {
+            off += 8;
+        }
+        while (off < DISKFS_BLOCK_SIZE && img[off] == base[off]) {
+            off++;
+        }
+        if (off >= DISKFS_BLOCK_SIZE) {
+            break;
+        }
+
+        end  = off;
+        same = 0;
+        while (end < DISKFS_BLOCK_SIZE && same < DISKFS_REDO_RUN_GAP) {
+            same = (img[end] == base[end]) ? same + 1 : 0;
+            end++;
+        }
+        end -= same;
+
+        run.off = (uint16_t) off;
+        run.len = (uint16_t) (end - off);
+        if (len + sizeof(run) + run.len > max) {
+            return 0;
+        }
+        memcpy(out + len, &run, sizeof(run));
+        memcpy(out + len + sizeof(run), img + off, run.len);
+        len += sizeof(run) + run.len;
+        off  = end;
+    }
+    return len;
+} /* diskfs_redo_delta_encode */
+
+
+/*
+ * Decide full vs delta logging for one snapshotted block.  Only the txn that
+ * owns the block's delta base may diff against it, and only if no other txn
+ * attached the block meanwhile (delta_owner still == txn).  Releasing the
+ * ownership here, after the snapshot, means any later attacher finds
+ * home_current clear and logs full until the tail-pusher writes this image
+ * home.
+ */
+static void
+diskfs_txn_block_encode_delta(
+    struct diskfs_txn       *txn,
+    struct diskfs_txn_block *tb)
+{
+    struct diskfs_txn *owner = txn;
+    uint32_t           max;
+    uint8_t           *out;
+
+    if (!tb->delta_base) {
+        return;
+    }
+
+    if (!__atomic_compare_exchange_n(&tb->block->delta_owner, &owner, NULL, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&tb->block->delta_owner, NULL, __ATOMIC_RELEASE);
+    } else if (txn->redo_delta_bytes < DISKFS_REDO_DELTA_TXN_MAX) {
+        max = DISKFS_REDO_DELTA_TXN_MAX - txn->redo_delta_bytes;
+        if (max > DISKFS_REDO_DELTA_MAX) {
+            max = DISKFS_REDO_DELTA_MAX;
+        }
+        out           = malloc(max);
+        tb->delta_len = diskfs_redo_delta_encode(tb->snap.data, tb->delta_base,
+                                                 out, max);
+        if (tb->delta_len) {
+            tb->delta              = out;
+            txn->redo_delta_bytes += tb->delta_len;
+        } else {
+            free(out);
+        }
+    }
+
+    free(tb->delta_base);
+    tb->delta_base = NULL;
+} /* diskfs_txn_block_encode_delta */
+
+
 /*
  * Commit-prep fault context.  The grant no longer eager-faults the inode home
  * block; a b+tree modify links its inode's root in the descent, but an attr-only
@@ -2274,6 +2423,7 @@ diskfs_txn_commit_finish(
     {
         struct diskfs_txn_block *tb;
         uint64_t                 blocks = 0;
+        uint64_t                 logged;
 
         for (tb = txn->blocks; tb; tb = tb->next) {
             struct diskfs_block_shard *bshard =
@@ -2297,13 +2447,19 @@ diskfs_txn_commit_finish(
             tb->snap_csum_lo = snap_hash.low64;
             tb->snap_csum_hi = snap_hash.high64;
             blocks++;
+
+            diskfs_txn_block_encode_delta(txn, tb);
+            if (!tb->delta_len) {
+                txn->redo_full_blocks++;
+            }
         }
+        logged = (uint64_t) txn->redo_full_blocks * DISKFS_BLOCK_SIZE +
+            txn->redo_delta_bytes;
         diskfs_metric_counter_inc(thread->metrics.txn[0]);
         diskfs_metric_counter_add(thread->metrics.txn[1], blocks);
-        diskfs_metric_counter_add(thread->metrics.txn[2], blocks * DISKFS_BLOCK_SIZE);
+        diskfs_metric_counter_add(thread->metrics.txn[2], logged);
         diskfs_metric_histogram_sample(thread->metrics.txn_blocks, blocks);
-        diskfs_metric_histogram_sample(thread->metrics.txn_bytes,
-                                       blocks * DISKFS_BLOCK_SIZE);
+        diskfs_metric_histogram_sample(thread->metrics.txn_bytes, logged);
     }
 
     /* Hand the txn -> intent log thread via this worker's SQ.  The intent log
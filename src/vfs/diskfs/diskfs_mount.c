@@ -19,6 +19,7 @@ static const char *diskfs_metric_inode_cache_op_names[] = {
     "load",
     "insert",
     "wait",
+    "ghost_hit",
 };
 
 
@@ -29,6 +30,7 @@ static const char *diskfs_metric_block_cache_op_names[] = {
     "wait",
     "cow",
     "recycle",
+    "ghost_hit",
 };
 
 
@@ -41,6 +43,14 @@ static const char *diskfs_metric_mtime_op_names[] = {
 };
 
 
+static const char *diskfs_metric_defrag_op_names[] = {
+    "runs",
+    "extents",
+    "bytes",
+    "skipped",
+};
+
+
 static const char *diskfs_metric_io_dir_names[] = {
     "read",
     "write",
@@ -170,6 +180,9 @@ diskfs_metrics_init(
     m->mtime = prometheus_metrics_create_counter(
         metrics, "chimera_diskfs_mtime",
         "Diskfs deferred-mtime accounting (deferred/flushed/skip reasons)");
+    m->defrag = prometheus_metrics_create_counter(
+        metrics, "chimera_diskfs_defrag",
+        "Diskfs background defragmenter (runs/extents merged/bytes moved/skipped)");
     m->block_io_ops = prometheus_metrics_create_counter(
         metrics, "chimera_diskfs_block_io_ops",
         "Diskfs classified block I/O submissions");
@@ -212,6 +225,10 @@ diskfs_metrics_init(
         m->mtime_series[i] = prometheus_counter_create_series(
             m->mtime, op_label, &diskfs_metric_mtime_op_names[i], 1);
     }
+    for (int i = 0; i < DISKFS_METRIC_DEFRAG_NUM; i++) {
+        m->defrag_series[i] = prometheus_counter_create_series(
+            m->defrag, op_label, &diskfs_metric_defrag_op_names[i], 1);
+    }
     for (int d = 0; d < DISKFS_METRIC_IO_NUM_DIRS; d++) {
         for (int c = 0; c < DISKFS_METRIC_IO_NUM_CLASSES; c++) {
             const char *values[] = {
@@ -286,6 +303,9 @@ diskfs_thread_metrics_init(struct diskfs_thread *thread)
     for (int i = 0; i < DISKFS_METRIC_MTIME_NUM; i++) {
         tm->mtime[i] = prometheus_counter_series_create_instance(m->mtime_series[i]);
     }
+    for (int i = 0; i < DISKFS_METRIC_DEFRAG_NUM; i++) {
+        tm->defrag[i] = prometheus_counter_series_create_instance(m->defrag_series[i]);
+    }
     for (int d = 0; d < DISKFS_METRIC_IO_NUM_DIRS; d++) {
         for (int c = 0; c < DISKFS_METRIC_IO_NUM_CLASSES; c++) {
             tm->block_io_ops[d][c] =
@@ -682,127 +702,451 @@ diskfs_mount_sm_io(struct diskfs_mount_io *io)
 
 
 /*
- * Crash recovery (synchronous replay): the previous instance did not unmount
- * cleanly, so logged-but-not-yet-pushed redo records may still sit in the
- * intent log while their home locations hold stale data.  Sweep the log for
- * intact records -- a 4 KiB-aligned magic whose XXH3-128 over reclen bytes
- * verifies (rejecting torn/partially-overwritten records) -- and write each
- * block image to its home location in seq order (latest image of a block
- * wins), then flush.  After this the on-disk b+tree / inodes / data are
- * consistent with the last acknowledged write, exactly as the tail-pusher
- * would have left them.
- *
- * Replaying every intact record (rather than just [tail, head]) is safe: in a
- * FIFO circular log a superseding record outlives every record it supersedes,
- * so seq-ordered replay always lands the latest image, and re-writing an
- * already-current block is idempotent.  Runs at mount before worker threads
- * exist, so it drives the device through the mount-time evpl pump.
+ * Apply a delta-logged block's byte runs to out, which holds the base image,
+ * and check the result against the logged post-image csum.  Returns 0 if out
+ * now holds the post-image, -1 if the runs do not apply (the base is not the
+ * image they were taken against); out is then clobbered.
  */
 static int
-diskfs_recover_log(
-    struct diskfs_shared   *shared,
-    struct diskfs_mount_io *io)
+diskfs_recover_apply_delta(
+    const struct diskfs_redo_block_header *bh,
+    const char                            *runs,
+    char                                  *out)
 {
-    char                      *log;
-    uint64_t                   o;
-    struct diskfs_recover_rec *recs;
-    uint32_t                   nrec = 0, cap = 4096, i;
+    struct diskfs_redo_run run;
+    XXH128_hash_t          h;
+    uint32_t               pos = 0;
 
-    uint64_t                   intent_log_size = shared->intent_log_size;
+    while (pos < bh->delta_len) {
+        if (bh->delta_len - pos < sizeof(run)) {
+            return -1;
+        }
+        memcpy(&run, runs + pos, sizeof(run));
+        pos += sizeof(run);
+        if (run.len > bh->delta_len - pos ||
+            (uint32_t) run.off + run.len > DISKFS_BLOCK_SIZE) {
+            return -1;
+        }
+        memcpy(out + run.off, runs + pos, run.len);
+        pos += run.len;
+    }
 
-    log = malloc(intent_log_size);
-    if (diskfs_mount_io_read(io, SM_INTENT_LOG_DEVICE, log, intent_log_size,
-                             SM_INTENT_LOG_OFFSET) != 0) {
-        free(log);
+    h = XXH3_128bits(out, DISKFS_BLOCK_SIZE);
+    if (h.low64 != bh->block_csum_lo || h.high64 != bh->block_csum_hi) {
         return -1;
     }
+    return 0;
+} /* diskfs_recover_apply_delta */
 
-    recs = malloc(cap * sizeof(*recs));
 
-    for (o = 0; o + sizeof(struct diskfs_redo_header) <= intent_log_size;
-         o += DISKFS_BLOCK_SIZE) {
-        struct diskfs_redo_header *hdr = (struct diskfs_redo_header *) (log + o);
-        uint64_t                   lo, hi;
-        XXH128_hash_t              h;
+/*
+ * Read the whole intent log into buf, keeping DISKFS_RECOVER_READ_DEPTH
+ * max-size requests in flight instead of one at a time.
+ */
+static int
+diskfs_recover_read_log(
+    struct diskfs_mount_io *io,
+    char                   *buf,
+    uint64_t                length)
+{
+    struct evpl_iovec           iov[DISKFS_RECOVER_READ_DEPTH];
+    struct diskfs_mount_io_wait w[DISKFS_RECOVER_READ_DEPTH];
+    uint64_t                    at[DISKFS_RECOVER_READ_DEPTH];
+    uint64_t                    len[DISKFS_RECOVER_READ_DEPTH];
+    uint64_t                    maxreq, done = 0;
+    uint32_t                    n, i;
+    int                         rc = 0;
+
+    if (!io->queue[SM_INTENT_LOG_DEVICE]) {
+        return -1;
+    }
+    maxreq = io->shared->devices[SM_INTENT_LOG_DEVICE].max_request_size &
+        ~((uint64_t) DISKFS_BLOCK_SIZE - 1);
+    if (maxreq == 0) {
+        return -1;
+    }
 
-        if (hdr->magic != DISKFS_REDO_MAGIC) {
-            continue;
+    while (done < length && rc == 0) {
+        for (n = 0; n < DISKFS_RECOVER_READ_DEPTH && done < length; n++) {
+            len[n] = length - done < maxreq ? length - done : maxreq;
+            at[n]  = done;
+            w[n]   = (struct diskfs_mount_io_wait) { 0, 0 };
+            evpl_iovec_alloc(io->evpl, len[n], DISKFS_BLOCK_SIZE, 1, 0, &iov[n]);
+            evpl_block_read(io->evpl, io->queue[SM_INTENT_LOG_DEVICE], &iov[n], 1,
+                            SM_INTENT_LOG_OFFSET + done,
+                            diskfs_mount_io_complete, &w[n]);
+            done += len[n];
         }
-        if (hdr->reclen < sizeof(*hdr) ||
-            (hdr->reclen & (DISKFS_BLOCK_SIZE - 1)) ||
-            hdr->reclen != diskfs_il_hdr_len(hdr->num_blocks, hdr->num_deltas) +
-            (uint64_t) hdr->num_blocks * DISKFS_BLOCK_SIZE ||
-            o + hdr->reclen > intent_log_size) {
-            continue;
+
+        for (i = 0; i < n; i++) {
+            while (!w[i].done) {
+                evpl_continue(io->evpl);
+            }
         }
-        lo           = hdr->csum_lo;
-        hi           = hdr->csum_hi;
-        hdr->csum_lo = 0;
-        hdr->csum_hi = 0;
-        h            = XXH3_128bits(log + o, diskfs_il_hdr_len(hdr->num_blocks, hdr->num_deltas));
-        hdr->csum_lo = lo;
-        hdr->csum_hi = hi;
-        if (h.low64 != lo || h.high64 != hi) {
+
+        for (i = 0; i < n; i++) {
+            if (w[i].status) {
+                rc = -1;
+            } else {
+                memcpy(buf + at[i], iov[i].data, len[i]);
+            }
+            evpl_iovec_release(io->evpl, &iov[i]);
+        }
+    }
+    return rc;
+} /* diskfs_recover_read_log */
+
+
+/*
+ * Is there an intact record at log offset o: a magic whose XXH3-128 over the
+ * header region verifies, with consistent lengths and full images matching
+ * their per-block csums.  Read-only on the log image (the csum fields are
+ * zeroed in a stack copy), so stripes may be checked concurrently even where
+ * a record overlaps a neighbouring stripe.
+ */
+static int
+diskfs_recover_rec_intact(
+    const char *log,
+    uint64_t    intent_log_size,
+    uint64_t    o)
+{
+    const struct diskfs_redo_header *hdr = (const struct diskfs_redo_header *) (log + o);
+    struct diskfs_redo_header        zh;
+    XXH3_state_t                     st;
+    XXH128_hash_t                    h;
+    const char                      *bhp, *data;
+    uint64_t                         hdr_len, nfull = 0, dbytes = 0;
+    uint32_t                         b;
+
+    if (hdr->magic != DISKFS_REDO_MAGIC) {
+        return 0;
+    }
+    hdr_len = diskfs_il_hdr_len(hdr->num_blocks, hdr->num_deltas,
+                                hdr->delta_bytes);
+    if (hdr->reclen < hdr_len ||
+        (hdr->reclen & (DISKFS_BLOCK_SIZE - 1)) ||
+        o + hdr->reclen > intent_log_size) {
+        return 0;
+    }
+
+    zh         = *hdr;
+    zh.csum_lo = 0;
+    zh.csum_hi = 0;
+    XXH3_128bits_reset(&st);
+    XXH3_128bits_update(&st, &zh, sizeof(zh));
+    XXH3_128bits_update(&st, log + o + sizeof(zh), hdr_len - sizeof(zh));
+    h = XXH3_128bits_digest(&st);
+    if (h.low64 != hdr->csum_lo || h.high64 != hdr->csum_hi) {
+        return 0;
+    }
+
+    /* The header csum covers the block headers, so their delta_len fields are
+     * trusted: count the full images and check reclen. */
+    bhp  = log + o + sizeof(*hdr);
+    data = log + o + hdr_len;
+    for (b = 0; b < hdr->num_blocks; b++) {
+        const struct diskfs_redo_block_header *bh =
+            (const struct diskfs_redo_block_header *) (bhp + (size_t) b * sizeof(*bh));
+
+        if (bh->delta_len) {
+            dbytes += bh->delta_len;
+        } else {
+            nfull++;
+        }
+    }
+    if (dbytes != hdr->delta_bytes ||
+        hdr->reclen != hdr_len + nfull * DISKFS_BLOCK_SIZE) {
+        return 0;
+    }
+
+    for (b = 0; b < hdr->num_blocks; b++) {
+        const struct diskfs_redo_block_header *bh =
+            (const struct diskfs_redo_block_header *) (bhp + (size_t) b * sizeof(*bh));
+
+        if (bh->delta_len) {
+            continue;     /* verified against home at replay */
+        }
+        h     = XXH3_128bits(data, DISKFS_BLOCK_SIZE);
+        data += DISKFS_BLOCK_SIZE;
+        if (h.low64 != bh->block_csum_lo || h.high64 != bh->block_csum_hi) {
+            return 0;
+        }
+    }
+    return 1;
+} /* diskfs_recover_rec_intact */
+
+
+static void *
+diskfs_recover_scan_thread(void *arg)
+{
+    struct diskfs_recover_worker    *rw = arg;
+    const struct diskfs_redo_header *hdr;
+    uint64_t                         o;
+
+    for (o = rw->start; o < rw->end; o += DISKFS_BLOCK_SIZE) {
+        if (!diskfs_recover_rec_intact(rw->log, rw->shared->intent_log_size, o)) {
             continue;
         }
-        {
-            char    *bhp  = log + o + sizeof(*hdr);
-            char    *data = log + o + diskfs_il_hdr_len(hdr->num_blocks, hdr->num_deltas);
-            uint32_t b;
-            int      ok = 1;
-
-            for (b = 0; b < hdr->num_blocks; b++) {
-                struct diskfs_redo_block_header *bh =
-                    (struct diskfs_redo_block_header *) (bhp + (size_t) b * sizeof(*bh));
-                char                            *img   = data + (size_t) b * DISKFS_BLOCK_SIZE;
-                XXH128_hash_t                    bhash = XXH3_128bits(img, DISKFS_BLOCK_SIZE);
-
-                if (bhash.low64 != bh->block_csum_lo ||
-                    bhash.high64 != bh->block_csum_hi) {
-                    ok = 0;
-                    break;
-                }
+        if (rw->nrec == rw->cap) {
+            rw->cap  = rw->cap ? rw->cap * 2 : 1024;
+            rw->recs = realloc(rw->recs, rw->cap * sizeof(*rw->recs));
+        }
+        hdr                       = (const struct diskfs_redo_header *) (rw->log + o);
+        rw->recs[rw->nrec].seq    = hdr->seq;
+        rw->recs[rw->nrec].offset = o;
+        rw->nrec++;
+    }
+    return NULL;
+} /* diskfs_recover_scan_thread */
+
+
+static int
+diskfs_recover_blk_cmp(
+    const void *a,
+    const void *b)
+{
+    const struct diskfs_recover_blk *x = a;
+    const struct diskfs_recover_blk *y = b;
+
+    if (x->device_id != y->device_id) {
+        return (x->device_id > y->device_id) - (x->device_id < y->device_id);
+    }
+    if (x->device_offset != y->device_offset) {
+        return (x->device_offset > y->device_offset) -
+               (x->device_offset < y->device_offset);
+    }
+    return (x->rank > y->rank) - (x->rank < y->rank);
+} /* diskfs_recover_blk_cmp */
+
+
+/*
+ * Replay one slice of the sorted images.  Every image of a home block is in
+ * the same slice, in seq order, so the block's final content is resolved in
+ * memory exactly as seq-ordered replay would leave it -- start from its last
+ * full image (or from home if it has none), fold each later delta whose
+ * result verifies, skip the rest -- and written home once.  Writes go out in
+ * batches on this worker's own evpl and device queues, then each queue is
+ * flushed.
+ */
+static void *
+diskfs_recover_replay_thread(void *arg)
+{
+    struct diskfs_recover_worker *rw     = arg;
+    struct diskfs_shared         *shared = rw->shared;
+    struct diskfs_mount_io       *io     = diskfs_mount_io_open(shared);
+    struct sm_io_write            writes[DISKFS_RECOVER_WRITE_BATCH];
+    char                         *slots, *a, *b, *t;
+    uint32_t                      nw = 0, i = 0, j, k, full;
+    int                           d;
+
+    slots = malloc((size_t) (DISKFS_RECOVER_WRITE_BATCH + 2) * DISKFS_BLOCK_SIZE);
+    a     = slots + (size_t) DISKFS_RECOVER_WRITE_BATCH * DISKFS_BLOCK_SIZE;
+    b     = a + DISKFS_BLOCK_SIZE;
+
+    while (i < rw->nblk) {
+        const struct diskfs_recover_blk *g = &rw->blks[i];
+        const char                      *state = NULL;
+        int                              dirty = 0;
+
+        for (j = i + 1; j < rw->nblk &&
+             rw->blks[j].device_id == g->device_id &&
+             rw->blks[j].device_offset == g->device_offset; j++) {
+        }
+
+        full = i;
+        for (k = i; k < j; k++) {
+            if (!rw->blks[k].bh->delta_len) {
+                full  = k;
+                state = rw->blks[k].img;
+                dirty = 1;
             }
-            if (!ok) {
+        }
+
+        for (k = state ? full + 1 : i; k < j; k++) {
+            if (!state) {
+                chimera_diskfs_abort_if(
+                    diskfs_mount_io_read(io, g->device_id, a, DISKFS_BLOCK_SIZE,
+                                         g->device_offset) != 0,
+                    "recovery delta base read failed");
+                state = a;
+            }
+            memcpy(b, state, DISKFS_BLOCK_SIZE);
+            if (diskfs_recover_apply_delta(rw->blks[k].bh, rw->blks[k].img, b) != 0) {
+                rw->nskip++;
                 continue;
             }
+            t     = a;
+            a     = b;
+            b     = t;
+            state = a;
+            dirty = 1;
+        }
+
+        if (dirty) {
+            char *slot = slots + (size_t) nw * DISKFS_BLOCK_SIZE;
+
+            memcpy(slot, state, DISKFS_BLOCK_SIZE);
+            writes[nw].device_id = g->device_id;
+            writes[nw].buf       = slot;
+            writes[nw].length    = DISKFS_BLOCK_SIZE;
+            writes[nw].offset    = g->device_offset;
+            nw++;
+            rw->nwrite++;
         }
 
-        if (nrec == cap) {
-            cap *= 2;
-            recs = realloc(recs, cap * sizeof(*recs));
+        if (nw == DISKFS_RECOVER_WRITE_BATCH || (j == rw->nblk && nw)) {
+            chimera_diskfs_abort_if(diskfs_mount_io_write_many(io, writes, nw) != 0,
+                                    "recovery replay write failed");
+            nw = 0;
         }
-        recs[nrec].seq    = hdr->seq;
-        recs[nrec].offset = o;
-        nrec++;
+        i = j;
+    }
+
+    for (d = 0; d < shared->num_devices; d++) {
+        diskfs_mount_io_flush(io, d);
+    }
+
+    free(slots);
+    diskfs_mount_io_close(io);
+    return NULL;
+} /* diskfs_recover_replay_thread */
+
+
+/*
+ * Crash recovery: the previous instance did not unmount cleanly, so
+ * logged-but-not-yet-pushed redo records may still sit in the intent log while
+ * their home locations hold stale data.  Sweep the log for intact records -- a
+ * 4 KiB-aligned magic whose XXH3-128 over reclen bytes verifies (rejecting
+ * torn/partially-overwritten records) -- and write each home block's latest
+ * image to its home location, then flush.
+ *
+ * A delta-logged block is rebuilt by applying its byte runs to the block as it
+ * stands after every earlier record's image of it (home, if none) and is
+ * written only if the result hashes to the logged post-image.  The logging txn
+ * diffed against the durable home image, so home holds either that base
+ * (delta applies) or an image at least as new pushed by the tail-pusher or
+ * carried by an earlier record; a mismatch means the block already carries
+ * this record's change or a later one, and is skipped.  After this the on-disk
+ * b+tree / inodes / data are consistent with the last acknowledged write,
+ * exactly as the tail-pusher would have left them.
+ *
+ * Replaying every intact record (rather than just [tail, head]) is safe: in a
+ * FIFO circular log a superseding record outlives every record it supersedes,
+ * so seq-ordered resolution always lands the latest image, and re-writing an
+ * already-current block is idempotent.
+ *
+ * The log is read with batched large requests, scanned and verified by
+ * recovery_threads workers over disjoint stripes, and the images are
+ * partitioned by home block address so the same number of workers resolve
+ * and write them with no ordering between workers.  Runs at mount before
+ * worker threads exist; each replay worker drives its own mount-time evpl
+ * pump and device queues.
+ */
+static int
+diskfs_recover_log(
+    struct diskfs_shared   *shared,
+    struct diskfs_mount_io *io)
+{
+    char                         *log;
+    struct diskfs_recover_worker *rw;
+    struct diskfs_recover_rec    *recs;
+    struct diskfs_recover_blk    *blks;
+    uint32_t                      nrec = 0, nblk = 0, cap = 4096;
+    uint32_t                      nwrite = 0, nskip = 0;
+    uint32_t                      nthreads, i, b, start;
+    uint64_t                      stripe;
+    uint64_t                      intent_log_size = shared->intent_log_size;
+
+    nthreads = shared->recovery_threads ? shared->recovery_threads
+                                        : DISKFS_RECOVER_THREADS_DEFAULT;
+    if (nthreads > DISKFS_RECOVER_THREADS_MAX) {
+        nthreads = DISKFS_RECOVER_THREADS_MAX;
+    }
+
+    log = malloc(intent_log_size);
+    if (diskfs_recover_read_log(io, log, intent_log_size) != 0) {
+        free(log);
+        return -1;
+    }
+
+    rw     = calloc(nthreads, sizeof(*rw));
+    stripe = ((intent_log_size / nthreads) + DISKFS_BLOCK_SIZE - 1) &
+        ~((uint64_t) DISKFS_BLOCK_SIZE - 1);
+
+    for (i = 0; i < nthreads; i++) {
+        rw[i].shared = shared;
+        rw[i].log    = log;
+        rw[i].start  = (uint64_t) i * stripe;
+        rw[i].end    = i + 1 == nthreads ? intent_log_size : rw[i].start + stripe;
+        if (rw[i].start > intent_log_size) {
+            rw[i].start = intent_log_size;
+        }
+        if (rw[i].end > intent_log_size) {
+            rw[i].end = intent_log_size;
+        }
+        pthread_create(&rw[i].thread, NULL, diskfs_recover_scan_thread, &rw[i]);
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(rw[i].thread, NULL);
+        nrec += rw[i].nrec;
+    }
+
+    recs = malloc((nrec ? nrec : 1) * sizeof(*recs));
+    nrec = 0;
+    for (i = 0; i < nthreads; i++) {
+        if (rw[i].nrec) {
+            memcpy(recs + nrec, rw[i].recs, rw[i].nrec * sizeof(*recs));
+        }
+        nrec += rw[i].nrec;
+        free(rw[i].recs);
+        rw[i].recs = NULL;
     }
 
     qsort(recs, nrec, sizeof(*recs), diskfs_recover_rec_cmp);
 
+    blks = malloc(cap * sizeof(*blks));
+
     for (i = 0; i < nrec; i++) {
         struct diskfs_redo_header *hdr  = (struct diskfs_redo_header *) (log + recs[i].offset);
         char                      *bhp  = log + recs[i].offset + sizeof(*hdr);
         char                      *data = log + recs[i].offset +
-            diskfs_il_hdr_len(hdr->num_blocks, hdr->num_deltas);
-        char                      *dp;
-        uint32_t                   b;
+            diskfs_il_hdr_len(hdr->num_blocks, hdr->num_deltas, hdr->delta_bytes);
+        char                      *dp, *runs;
+
+        /* Layout: all per-block headers are grouped after the redo header, the
+         * space deltas and then the delta payloads follow them, and the full
+         * block images follow the 4 KiB-aligned header region. */
+        runs = bhp + (size_t) hdr->num_blocks * sizeof(struct diskfs_redo_block_header) +
+            (size_t) hdr->num_deltas * sizeof(struct diskfs_redo_delta);
 
-        /* New layout: all per-block headers are grouped after the redo header,
-         * the space deltas follow them, and the block images follow the 4 KiB-
-         * aligned header region. */
         for (b = 0; b < hdr->num_blocks; b++) {
             struct diskfs_redo_block_header *bh =
                 (struct diskfs_redo_block_header *) (bhp + (size_t) b * sizeof(*bh));
-            char                            *img = data + (size_t) b * DISKFS_BLOCK_SIZE;
+            char                            *img;
 
-            if (bh->device_id < (uint32_t) shared->num_devices) {
-                int wr = diskfs_mount_io_write(io, bh->device_id, img,
-                                               DISKFS_BLOCK_SIZE,
-                                               bh->device_offset);
+            if (bh->delta_len) {
+                img   = runs;
+                runs += bh->delta_len;
+            } else {
+                img   = data;
+                data += DISKFS_BLOCK_SIZE;
+            }
+
+            if (bh->device_id >= (uint32_t) shared->num_devices) {
+                continue;
+            }
 
-                chimera_diskfs_abort_if(wr != 0,
-                                        "recovery replay write failed");
+            if (nblk == cap) {
+                cap *= 2;
+                blks = realloc(blks, cap * sizeof(*blks));
             }
+            blks[nblk].device_id     = bh->device_id;
+            blks[nblk].rank          = i;
+            blks[nblk].device_offset = bh->device_offset;
+            blks[nblk].bh            = bh;
+            blks[nblk].img           = img;
+            nblk++;
         }
 
         /* Replay this record's space-map deltas on top of the loaded
@@ -825,13 +1169,47 @@ diskfs_recover_log(
         }
     }
 
-    for (i = 0; i < (uint32_t) shared->num_devices; i++) {
-        diskfs_mount_io_flush(io, i);
+    qsort(blks, nblk, sizeof(*blks), diskfs_recover_blk_cmp);
+
+    /* Cut the sorted images into nthreads slices, moving each cut forward to
+     * the next home-block boundary so a block is resolved by one worker. */
+    start = 0;
+    for (i = 0; i < nthreads; i++) {
+        uint32_t end = i + 1 == nthreads ? nblk
+                                         : (uint32_t) ((uint64_t) nblk * (i + 1) / nthreads);
+
+        if (end < start) {
+            end = start;
+        }
+        while (end > 0 && end < nblk &&
+               blks[end].device_id == blks[end - 1].device_id &&
+               blks[end].device_offset == blks[end - 1].device_offset) {
+            end++;
+        }
+        rw[i].blks = blks + start;
+        rw[i].nblk = end - start;
+        start      = end;
+        if (rw[i].nblk) {
+            pthread_create(&rw[i].thread, NULL, diskfs_recover_replay_thread, &rw[i]);
+        }
     }
 
+    for (i = 0; i < nthreads; i++) {
+        if (rw[i].nblk) {
+            pthread_join(rw[i].thread, NULL);
+        }
+        nwrite += rw[i].nwrite;
+        nskip  += rw[i].nskip;
+    }
+
+    free(rw);
+    free(blks);
     free(recs);
     free(log);
-    chimera_diskfs_info("crash recovery: replayed %u intact intent-log records", nrec);
+    chimera_diskfs_info("crash recovery: replayed %u intact intent-log records "
+                        "to %u home blocks over %u threads "
+                        "(%u delta blocks already current)",
+                        nrec, nwrite, nthreads, nskip);
     return 0;
 } /* diskfs_recover_log */
 
@@ -893,6 +1271,8 @@ diskfs_init(
     json_t                     *cfg, *devices_cfg, *device_cfg;
     json_error_t                json_error;
     int                         initialize;
+    int                         compression;
+    int                         dedup;
 
 
     cfg = json_loads(cfgdata, 0, &json_error);
@@ -1029,6 +1409,25 @@ diskfs_init(
     initialize           = json_object_get(cfg, "initialize") != NULL;
     shared->unsafe_async = json_is_true(json_object_get(cfg, "unsafe_async"));
     shared->noatime      = json_is_true(json_object_get(cfg, "noatime"));
+    /* Small-file inline data is on unless explicitly disabled; existing
+     * inline files stay readable and writable either way. */
+    shared->inline_data = !json_is_false(json_object_get(cfg, "inline_data"));
+    /* Delta redo records are on unless explicitly disabled; recovery replays
+     * both record forms regardless. */
+    shared->redo_delta = !json_is_false(json_object_get(cfg, "redo_delta"));
+    /* Data compression is fixed at format time: only a mkfs honors the
+     * option; a remount uses the codec the superblock recorded. */
+    {
+        json_t *cv = json_object_get(cfg, "compression");
+
+        compression = diskfs_compress_parse(cv ? json_string_value(cv) : NULL);
+        chimera_diskfs_abort_if(compression < 0,
+                                "unknown compression \"%s\" (none, lz4, zstd)",
+                                json_string_value(cv));
+    }
+    /* Likewise dedup: a mkfs-time choice, since the index must see every
+     * chunk it could later be asked to share. */
+    dedup = json_is_true(json_object_get(cfg, "dedup"));
     {
         /* Deferred-mtime coalescing window (ms in config); 0 disables it. */
         json_t *mdv = json_object_get(cfg, "mtime_defer_ms");
@@ -1041,6 +1440,13 @@ diskfs_init(
      * hardware designator) and the encoded layout type. */
     shared->block_layout       = json_is_true(json_object_get(cfg, "block_layout"));
     shared->scsi_layout        = json_is_true(json_object_get(cfg, "scsi_layout"));
+    /* Layout clients do file I/O straight to the data devices, so new files
+     * must live in extents there; no new inline files in layout mode. */
+    if (shared->block_layout || shared->scsi_layout) {
+        shared->inline_data = 0;
+        compression         = DISKFS_COMPRESS_NONE;
+        dedup               = 0;
+    }
     shared->block_cache_blocks = (uint32_t) json_integer_value(
         json_object_get(cfg, "block_cache_blocks"));
 
@@ -1078,6 +1484,28 @@ diskfs_init(
         json_object_get(cfg, "inode_cache_inodes"));
     shared->reclaim_threads = (uint32_t) json_integer_value(
         json_object_get(cfg, "reclaim_threads"));
+    shared->recovery_threads = (uint32_t) json_integer_value(
+        json_object_get(cfg, "recovery_threads"));
+    /* Background defragmenter: opt-in, and never in layout mode (clients hold
+     * device offsets it would move the data out from under). */
+    shared->defrag = json_is_true(json_object_get(cfg, "defrag")) &&
+        !shared->block_layout && !shared->scsi_layout;
+    {
+        /* Rewrite rate per reclaim worker, MiB/s in config. */
+        json_t *drv = json_object_get(cfg, "defrag_rate");
+
+        shared->defrag_rate = (drv ? (uint64_t) json_integer_value(drv)
+                                   : DISKFS_DEFRAG_RATE_DEFAULT) << 20;
+    }
+    {
+        /* Warm-cache manifest: host path, and save period in seconds. */
+        const char *wm  = json_string_value(json_object_get(cfg, "warm_manifest"));
+        json_t     *wiv = json_object_get(cfg, "warm_manifest_interval");
+
+        shared->warm_manifest = wm ? strdup(wm) : NULL;
+        shared->warm_interval = wiv ? (uint32_t) json_integer_value(wiv)
+                                    : DISKFS_WARM_INTERVAL_DEFAULT;
+    }
 
     json_decref(cfg);
 
@@ -1131,6 +1559,42 @@ diskfs_init(
             shared->intent_log_size = sb.intent_log_size;
         }
 
+        shared->compression = mode == 0 ? compression :
+            (int) ((sb.flags & SM_SB_COMPRESS_MASK) >> SM_SB_COMPRESS_SHIFT);
+        chimera_diskfs_abort_if(!diskfs_compress_available(shared->compression),
+                                "pool is compressed with %s, which this build does not support",
+                                diskfs_compress_name(shared->compression));
+        chimera_diskfs_abort_if(shared->compression &&
+                                (shared->block_layout || shared->scsi_layout),
+                                "a compressed pool cannot serve block/SCSI layouts");
+        shared->dedup = mode == 0 ? dedup : !!(sb.flags & SM_SB_DEDUP);
+        chimera_diskfs_abort_if(shared->dedup &&
+                                (shared->block_layout || shared->scsi_layout),
+                                "a deduplicated pool cannot serve block/SCSI layouts");
+        if (shared->compression || shared->dedup) {
+            /* A staged chunk goes to the device as one request. */
+            for (i = 0; i < shared->num_devices; i++) {
+                chimera_diskfs_abort_if(
+                    shared->devices[i].bdev &&
+                    shared->devices[i].max_request_size < DISKFS_ZCHUNK_SIZE,
+                    "device %s max_request_size %lu is below the %u-byte data chunk",
+                    shared->devices[i].name, shared->devices[i].max_request_size,
+                    DISKFS_ZCHUNK_SIZE);
+            }
+        }
+        if (shared->compression) {
+            chimera_diskfs_info("data compression: %s",
+                                diskfs_compress_name(shared->compression));
+        }
+        if (shared->dedup) {
+            chimera_diskfs_info("data deduplication: on");
+        }
+        shared->dinode_flags = mode == 0 ? 1 : !!(sb.flags & SM_SB_DINODE_FLAGS);
+        if (!shared->dinode_flags && shared->inline_data) {
+            chimera_diskfs_info("pool predates dinode flags: inline data off");
+            shared->inline_data = 0;
+        }
+
         dev_cfg = calloc(shared->num_devices, sizeof(*dev_cfg));
         for (i = 0; i < shared->num_devices; i++) {
             struct diskfs_device *dv = &shared->devices[i];
@@ -1253,7 +1717,7 @@ diskfs_init(
          * leaves it clear, so the next mount won't mistake a crash for a
          * clean shutdown. */
         rc = space_map_write_superblock(shared->space_map, &smio,
-                                        shared->fsid, 0, 0, 0,
+                                        shared->fsid, diskfs_sb_flags(shared), 0, 0,
                                         mode != 0 ? sb.log_seq : 0,
                                         shared->gen_floor,
                                         shared->fs_table);
@@ -1283,8 +1747,12 @@ diskfs_init(
         shared->inode_cache->shard_cap = 1;
     }
     for (i = 0; i < DISKFS_INODE_CACHE_SHARDS; i++) {
-        rb_tree_init(&shared->inode_cache->shards[i].inodes);
-        pthread_mutex_init(&shared->inode_cache->shards[i].lock, NULL);
+        struct diskfs_inode_shard *ishard = &shared->inode_cache->shards[i];
+
+        rb_tree_init(&ishard->inodes);
+        pthread_mutex_init(&ishard->lock, NULL);
+        ishard->ghost = diskfs_cache_ghost_alloc(shared->inode_cache->shard_cap,
+                                                 &ishard->ghost_mask);
     }
 
     /* Block cache: sharded RCU hash of 4 KiB device blocks. */
@@ -1406,12 +1874,66 @@ diskfs_fs_attach(
 } /* diskfs_fs_attach */
 
 
+/*
+ * Create one statically-reserved pool-level inode (an orphan-list shard or
+ * the dedup index): an empty directory-shaped b+tree holder owned by no named
+ * filesystem (inode->fs stays NULL; it never maps attrs), written home
+ * synchronously so it is re-readable from disk before it becomes an evictable
+ * CLEAN block.
+ */
+static void
+diskfs_bootstrap_pool_inode(
+    struct diskfs_thread   *thread,
+    struct diskfs_mount_io *mio,
+    uint64_t                inum,
+    struct timespec         now)
+{
+    struct diskfs_shared *shared = thread->shared;
+    uint32_t              odev;
+    uint64_t              ooff = sm_inum_to_device_offset(shared->space_map,
+                                                          inum, &odev);
+    struct diskfs_inode  *oin = diskfs_inode_struct_new(inum);
+    int                   rc;
+
+    oin->size       = 4096;
+    oin->space_used = 4096;
+    oin->alloc_size = 0;
+    oin->nlink      = 1;
+    oin->mode       = S_IFDIR | 0700;
+    oin->atime_sec  = now.tv_sec;
+    oin->atime_nsec = now.tv_nsec;
+    oin->mtime_sec  = now.tv_sec;
+    oin->mtime_nsec = now.tv_nsec;
+    oin->ctime_sec  = now.tv_sec;
+    oin->ctime_nsec = now.tv_nsec;
+    oin->change++;
+    oin->btime_sec      = now.tv_sec;
+    oin->btime_nsec     = now.tv_nsec;
+    oin->dos_attributes = 0;
+    oin->parent_inum    = inum;
+    oin->parent_gen     = oin->gen;
+
+    diskfs_inode_cache_insert(shared, oin);
+
+    oin->block = diskfs_block_claim(thread, odev, ooff, 1);
+    diskfs_bt_node_init(oin->block->iov.data, DISKFS_BT_ROOT_BASE,
+                        DISKFS_BT_ROOT_CAP, 0);
+    diskfs_inode_flush(oin);
+    rc = diskfs_mount_io_write(mio, odev, oin->block->iov.data,
+                               DISKFS_BLOCK_SIZE, ooff);
+    chimera_diskfs_abort_if(rc != 0, "bootstrap pool inode write failed");
+    diskfs_mount_io_flush(mio, odev);
+    oin->block->state = DISKFS_BLOCK_CLEAN;
+    diskfs_block_unpin(thread, oin->block, DISKFS_BLOCK_CLEAN);
+    oin->block = NULL;
+} /* diskfs_bootstrap_pool_inode */
+
+
 void
 diskfs_bootstrap_orphans(struct diskfs_thread *thread)
 {
     struct diskfs_shared   *shared = thread->shared;
     struct timespec         now;
-    int                     rc;
     struct diskfs_mount_io *mio;
 
     /* Guard against concurrent first-touch from multiple workers. */
@@ -1429,52 +1951,20 @@ diskfs_bootstrap_orphans(struct diskfs_thread *thread)
     mio = diskfs_mount_io_open(shared);
 
     clock_gettime(CLOCK_REALTIME, &now);
-    (void) rc;
+
+    /* The dedup index (inum 2) is created first: remount probes the last
+     * orphan shard to decide whether bootstrap ran. */
+    if (shared->dedup) {
+        diskfs_bootstrap_pool_inode(thread, mio, DISKFS_DEDUP_INUM, now);
+    }
 
     /* Statically-reserved orphan-list shard inodes (inums 3..): empty
      * directories whose b+tree keys are the inums of deleted-but-not-fully-
-     * reclaimed inodes, sharded by deleted inum.  Pool-level, owned by no
-     * named filesystem (inode->fs stays NULL; they never map attrs).
-     * Created once (persist; loaded from disk on remount); the reclaim
-     * workers scan them on mount and empty them. */
+     * reclaimed inodes, sharded by deleted inum.  Created once (persist;
+     * loaded from disk on remount); the reclaim workers scan them on mount
+     * and empty them. */
     for (int s = 0; s < DISKFS_ORPHAN_SHARDS; s++) {
-        uint64_t             oinum = DISKFS_ORPHAN_INUM_BASE + s;
-        uint32_t             odev;
-        uint64_t             ooff = sm_inum_to_device_offset(shared->space_map,
-                                                             oinum, &odev);
-        struct diskfs_inode *oin = diskfs_inode_struct_new(oinum);
-
-        oin->size       = 4096;
-        oin->space_used = 4096;
-        oin->alloc_size = 0;
-        oin->nlink      = 1;
-        oin->mode       = S_IFDIR | 0700;
-        oin->atime_sec  = now.tv_sec;
-        oin->atime_nsec = now.tv_nsec;
-        oin->mtime_sec  = now.tv_sec;
-        oin->mtime_nsec = now.tv_nsec;
-        oin->ctime_sec  = now.tv_sec;
-        oin->ctime_nsec = now.tv_nsec;
-        oin->change++;
-        oin->btime_sec      = now.tv_sec;
-        oin->btime_nsec     = now.tv_nsec;
-        oin->dos_attributes = 0;
-        oin->parent_inum    = oinum;
-        oin->parent_gen     = oin->gen;
-
-        diskfs_inode_cache_insert(shared, oin);
-
-        oin->block = diskfs_block_claim(thread, odev, ooff, 1);
-        diskfs_bt_node_init(oin->block->iov.data, DISKFS_BT_ROOT_BASE,
-                            DISKFS_BT_ROOT_CAP, 0);
-        diskfs_inode_flush(oin);
-        rc = diskfs_mount_io_write(mio, odev, oin->block->iov.data,
-                                   DISKFS_BLOCK_SIZE, ooff);
-        chimera_diskfs_abort_if(rc != 0, "bootstrap orphan write failed");
-        diskfs_mount_io_flush(mio, odev);
-        oin->block->state = DISKFS_BLOCK_CLEAN;
-        diskfs_block_unpin(thread, oin->block, DISKFS_BLOCK_CLEAN);
-        oin->block = NULL;
+        diskfs_bootstrap_pool_inode(thread, mio, DISKFS_ORPHAN_INUM_BASE + s, now);
     }
 
     /* Freshly-created shards are empty: nothing to scan. */
@@ -1513,10 +2003,14 @@ diskfs_destroy(void *private_data)
      * need the inode cache and the intent-log threads still alive. */
     diskfs_reclaim_destroy(shared);
 
+    /* Snapshot the warm caches for the next mount while they are intact. */
+    diskfs_warm_save(shared);
+
     for (i = 0; i < DISKFS_INODE_CACHE_SHARDS; i++) {
         rb_tree_destroy(&shared->inode_cache->shards[i].inodes,
                         diskfs_inode_cache_release, NULL);
         pthread_mutex_destroy(&shared->inode_cache->shards[i].lock);
+        free(shared->inode_cache->shards[i].ghost);
     }
 
     /* Shut down the intent-log threads before tearing down anything they
@@ -1550,6 +2044,7 @@ diskfs_destroy(void *private_data)
         while ((rec = shared->intent_log.rec_pool)) {
             shared->intent_log.rec_pool = rec->recycle_next;
             free(rec->iovs);
+            free(rec->log_iovs);
             free(rec->block_bufs);
             free(rec->blocks);
             free(rec);
@@ -1591,7 +2086,8 @@ diskfs_destroy(void *private_data)
              * needed -- nothing was issued past gen_next).  The pool is
              * always formatted by init, so always stamp CLEAN. */
             int rc = space_map_write_superblock(shared->space_map, &smio,
-                                                shared->fsid, SM_SB_CLEAN,
+                                                shared->fsid,
+                                                SM_SB_CLEAN | diskfs_sb_flags(shared),
                                                 0, 0,
                                                 shared->intent_log.log_seq,
                                                 __atomic_load_n(&shared->gen_next,
@@ -1618,6 +2114,7 @@ diskfs_destroy(void *private_data)
         free(shared->device_paths[i]);
     }
     free(shared->device_paths);
+    free(shared->warm_manifest);
     free(shared->metrics.block_io_device_ops_series);
     free(shared->metrics.block_io_device_bytes_series);
 
@@ -1668,6 +2165,8 @@ diskfs_thread_init(
     thread->shared = shared;
     thread->evpl   = evpl;
 
+    diskfs_compress_thread_init(thread);
+
     /* Allocate this worker's intent-log channel (holds its private in-flight
      * ring; completion is watermark-driven, so there is no per-worker CQ or
      * doorbell). */
@@ -1809,6 +2308,7 @@ diskfs_thread_destroy(void *private_data)
 
     evpl_iovec_release(thread->evpl, &thread->zero);
     evpl_iovec_release(thread->evpl, &thread->pad);
+    diskfs_compress_thread_fini(thread);
 
     slab_allocator_destroy(thread->allocator);
 
@@ -199,6 +199,18 @@ diskfs_readdir_next_cb(
     int                  result,
     void                *private_data);
 
+static int
+diskfs_readdir_ra_cmp(
+    const void *a,
+    const void *b);
+
+static void
+diskfs_readdir_peek(
+    struct diskfs_bt_op *op,
+    void                *buf,
+    uint32_t             base,
+    int                  idx);
+
 static void
 diskfs_readdir_iter_step(
     struct chimera_vfs_request *request);
@@ -1467,6 +1479,108 @@ diskfs_readdir_next_cb(
 } /* diskfs_readdir_next_cb */
 
 
+/* A child inode home block to read ahead. */
+struct diskfs_readdir_ra {
+    uint32_t device_id;
+    uint64_t device_offset;
+};
+
+
+static int
+diskfs_readdir_ra_cmp(
+    const void *a,
+    const void *b)
+{
+    const struct diskfs_readdir_ra *x = a;
+    const struct diskfs_readdir_ra *y = b;
+
+    if (x->device_id != y->device_id) {
+        return (x->device_id > y->device_id) - (x->device_id < y->device_id);
+    }
+    return (x->device_offset > y->device_offset) -
+           (x->device_offset < y->device_offset);
+} /* diskfs_readdir_ra_cmp */
+
+
+/*
+ * Scan look-ahead for readdir.  The first time the walk lands on a dirent at
+ * or past rd_ra_hash, gather the child inums of it and of the dirents that
+ * follow it in the same leaf (up to DISKFS_READDIR_RA_MAX not already in the
+ * inode cache), and read their home blocks in device-offset order, contiguous
+ * runs coalesced into one read.  The per-child faults that follow then hit,
+ * or park on a read already in flight, instead of going to disk one at a
+ * time.  A batch that runs off the end of the leaf reads the next leaf ahead
+ * too, so the following step's walk finds it resident.
+ */
+static void
+diskfs_readdir_peek(
+    struct diskfs_bt_op *op,
+    void                *buf,
+    uint32_t             base,
+    int                  idx)
+{
+    struct chimera_vfs_request    *request = op->private_data;
+    struct diskfs_request_private *p       = request->plugin_data;
+    struct diskfs_thread          *thread  = op->thread;
+    struct diskfs_shared          *shared  = thread->shared;
+    struct diskfs_bt_node_hdr     *h       = diskfs_bt_hdr(buf, base);
+    struct diskfs_bt_lslot        *sl      = diskfs_bt_lslots(buf, base);
+    struct diskfs_readdir_ra       ra[DISKFS_READDIR_RA_MAX];
+    uint32_t                       n = 0, i, run, dev;
+    uint64_t                       off;
+    int                            issued;
+
+    if (sl[idx].key.subkey < p->rd_ra_hash) {
+        return;
+    }
+
+    for (; idx < h->nitems && n < DISKFS_READDIR_RA_MAX; idx++) {
+        struct diskfs_inode_shard *shard;
+        struct diskfs_inode       *inode;
+        uint64_t                   inum;
+
+        if (sl[idx].key.type != DISKFS_REC_DIRENT) {
+            break;
+        }
+        p->rd_ra_hash = sl[idx].key.subkey + 1;
+
+        memcpy(&inum, (char *) buf + base + sl[idx].off, sizeof(inum));
+        /* A corrupt dirent is the child fault's to report, not ours. */
+        if (!sm_inum_valid(shared->space_map, inum)) {
+            continue;
+        }
+        shard = diskfs_inode_shard(shared, inum);
+        pthread_mutex_lock(&shard->lock);
+        rb_tree_query_exact(&shard->inodes, inum, inum, inode);
+        pthread_mutex_unlock(&shard->lock);
+        if (inode) {
+            continue;
+        }
+
+        ra[n].device_offset = sm_inum_to_device_offset(shared->space_map, inum,
+                                                       &ra[n].device_id);
+        n++;
+    }
+
+    if (idx == h->nitems && h->next_leaf) {
+        off = sm_inum_to_device_offset(shared->space_map, h->next_leaf, &dev);
+        diskfs_block_prefetch(thread, dev, off, 1, 0, NULL, NULL, &issued);
+    }
+
+    qsort(ra, n, sizeof(*ra), diskfs_readdir_ra_cmp);
+
+    for (i = 0; i < n; ) {
+        for (run = 1; i + run < n &&
+             ra[i + run].device_id == ra[i].device_id &&
+             ra[i + run].device_offset ==
+             ra[i].device_offset + ((uint64_t) run << DISKFS_BLOCK_SHIFT); run++) {
+        }
+        i += diskfs_block_prefetch(thread, ra[i].device_id, ra[i].device_offset,
+                                   run, 0, NULL, NULL, &issued);
+    }
+} /* diskfs_readdir_peek */
+
+
 static void
 diskfs_readdir_iter_step(struct chimera_vfs_request *request)
 {
@@ -1474,6 +1588,7 @@ diskfs_readdir_iter_step(struct chimera_vfs_request *request)
     struct diskfs_thread          *thread = p->thread;
     struct diskfs_inode           *inode  = p->inode_stash[0];
     struct diskfs_bt_op           *op;
+    struct diskfs_bt_key           key;
 
     /* A re-entrant call from a step that completed synchronously: don't
     * recurse, just ask the active loop to advance to the next entry. */
@@ -1486,9 +1601,11 @@ diskfs_readdir_iter_step(struct chimera_vfs_request *request)
     do {
         p->rd_advance = 0;
         op            = diskfs_bt_op_alloc(thread);
-        if (diskfs_dir_next_async(op, thread, inode, p->rd_from_hash, &op->found_key,
-                                  p->rec_scratch, sizeof(p->rec_scratch),
-                                  diskfs_readdir_next_cb, request)) {
+        key           = diskfs_dirent_key(p->rd_from_hash);
+        if (diskfs_bt_scan_async(op, thread, inode, &key, &op->found_key,
+                                 p->rec_scratch, sizeof(p->rec_scratch),
+                                 diskfs_readdir_peek, diskfs_readdir_next_cb,
+                                 request)) {
             diskfs_readdir_next_cb(op, op->result, request);
         }
         /* rd_advance: the step finished inline; loop for the next entry.
@@ -1659,6 +1776,7 @@ diskfs_readdir(
     p->rd_looping = 0;
     p->rd_advance = 0;
     p->rd_done    = 0;
+    p->rd_ra_hash = 0;
 
     diskfs_inode_get_fh_async(thread, p->txn, p->fs,
                               request->fh, request->fh_len,
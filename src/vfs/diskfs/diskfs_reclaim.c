@@ -60,6 +60,37 @@ diskfs_drain_removed_cb(
     int                  result,
     void                *priv);
 
+static void
+diskfs_drain_remove(struct diskfs_drain *d)
+{
+    struct diskfs_bt_op *rop = diskfs_bt_op_alloc(d->thread);
+
+    if (diskfs_bt_remove_async(rop, d->thread, d->txn, d->inode, &d->found_key,
+                               diskfs_drain_removed_cb, d)) {
+        diskfs_drain_removed_cb(rop, rop->result, d);
+    }
+} /* diskfs_drain_remove */
+
+
+static void
+diskfs_drain_freed(
+    void *priv,
+    int   status)
+{
+    struct diskfs_drain *d = priv;
+
+    /* The dedup index could not be updated to match: drop the batch and leave
+     * the orphan for a later drain rather than commit a half-freed inode. */
+    if (unlikely(status == DISKFS_DEDUP_EIO)) {
+        diskfs_txn_abort(d->txn);
+        diskfs_drain_complete(d);
+        return;
+    }
+
+    diskfs_drain_remove(d);
+} /* diskfs_drain_freed */
+
+
 static void
 diskfs_drain_looked_cb(
     struct diskfs_bt_op *op,
@@ -415,7 +446,6 @@ diskfs_drain_looked_cb(
     void                *priv)
 {
     struct diskfs_drain *d = priv;
-    struct diskfs_bt_op *rop;
 
     if (result < 0) {
         /* Tree empty: remove the durable orphan entry, then retire the inode in
@@ -442,21 +472,26 @@ diskfs_drain_looked_cb(
         return;
     }
 
-    /* Free a file extent's backing data before removing the record.  The
-     * remove reclaims any emptied b+tree node blocks (generic, any entry). */
-    if (d->found_key.type == DISKFS_REC_EXTENT) {
-        struct diskfs_extent_rec *e = (struct diskfs_extent_rec *) d->recbuf;
-
-        diskfs_thread_free_space(d->thread, d->txn, e->device_id, e->device_offset,
-                                 SM_ALIGN_UP(e->length));
-    }
     diskfs_bt_op_free(d->thread, op);
 
-    rop = diskfs_bt_op_alloc(d->thread);
-    if (diskfs_bt_remove_async(rop, d->thread, d->txn, d->inode, &d->found_key,
-                               diskfs_drain_removed_cb, d)) {
-        diskfs_drain_removed_cb(rop, rop->result, d);
+    /* Free a file extent's backing data before removing the record (a shared
+     * chunk drops a reference instead).  The remove reclaims any emptied
+     * b+tree node blocks (generic, any entry). */
+    if (d->found_key.type == DISKFS_REC_EXTENT) {
+        struct diskfs_extent_rec *rec = (struct diskfs_extent_rec *) d->recbuf;
+        struct diskfs_extent      e   = {
+            .file_offset   = d->found_key.subkey,
+            .length        = rec->length,
+            .device_id     = rec->device_id,
+            .flags         = rec->flags,
+            .device_offset = rec->device_offset,
+        };
+
+        diskfs_ext_free_backing(d->thread, d->txn, &e, diskfs_drain_freed, d);
+        return;
     }
+
+    diskfs_drain_remove(d);
 } /* diskfs_drain_looked_cb */
 
 
@@ -498,6 +533,8 @@ diskfs_reclaim_doorbell_cb(
         jobs = j->next;
         if (j->type == DISKFS_RECLAIM_JOB_CONDENSE) {
             diskfs_condense_start(w, j->device_id, j->ag_index);
+        } else if (j->type == DISKFS_RECLAIM_JOB_DEFRAG) {
+            diskfs_defrag_enqueue(w, j->inode);
         } else {
             diskfs_drain_enqueue(w->ctx, j->inum, j->gen);
         }
@@ -523,8 +560,8 @@ diskfs_reclaim_submit_job(
 
     /* Pool tearing down (a worker's own shutdown flush can drop a last
     * reference): skip -- the durable orphan record makes the next mount's
-    * scan pick the inode up.  (Condense jobs cannot arrive here during
-    * teardown: every journaling request completed before it began.) */
+    * scan pick the inode up.  (Condense and defrag jobs cannot arrive here
+    * during teardown: every journaling request completed before it began.) */
     if (__atomic_load_n(&r->shutdown, __ATOMIC_ACQUIRE)) {
         free(j);
         return;
@@ -561,6 +598,25 @@ diskfs_reclaim_submit(
 } /* diskfs_reclaim_submit */
 
 
+/* Queue a fragmented file for the defragmenter.  The caller holds its write
+ * lock; the job carries a refcnt pin so the inode stays resident until the
+ * worker is done with it. */
+void
+diskfs_reclaim_submit_defrag(
+    struct diskfs_thread *thread,
+    struct diskfs_inode  *inode)
+{
+    struct diskfs_reclaim_job *j = calloc(1, sizeof(*j));
+
+    inode->defrag_queued = 1;
+    diskfs_inode_ref_get(thread, inode);
+
+    j->type  = DISKFS_RECLAIM_JOB_DEFRAG;
+    j->inode = inode;
+    diskfs_reclaim_submit_job(thread->shared, j);
+} /* diskfs_reclaim_submit_defrag */
+
+
 static void *
 diskfs_reclaim_thread_init(
     struct evpl *evpl,
@@ -570,6 +626,8 @@ diskfs_reclaim_thread_init(
 
     w->ctx = diskfs_thread_init(evpl, w->shared);
     evpl_add_doorbell(evpl, &w->doorbell, diskfs_reclaim_doorbell_cb);
+    diskfs_defrag_worker_init(w);
+    diskfs_warm_worker_init(w);
     __atomic_store_n(&w->ready, 1, __ATOMIC_RELEASE);
     return w;
 } /* diskfs_reclaim_thread_init */
@@ -594,6 +652,13 @@ diskfs_reclaim_thread_shutdown(
         evpl_continue(evpl);
     }
 
+    /* Let the file being defragmented finish its window; drop the rest (the
+     * next write burst re-queues them). */
+    diskfs_defrag_worker_fini(w);
+
+    /* Stop the warm-cache prefetch (worker 0); unmount saves the manifest. */
+    diskfs_warm_worker_fini(w);
+
     evpl_remove_doorbell(evpl, &w->doorbell);
     diskfs_thread_destroy(w->ctx);
 
@@ -621,6 +686,7 @@ diskfs_reclaim_create(struct diskfs_shared *shared)
         struct diskfs_reclaim_worker *w = &r->workers[i];
 
         w->shared = shared;
+        w->index  = i;
         pthread_mutex_init(&w->lock, NULL);
         w->thread = evpl_thread_create(NULL, diskfs_reclaim_thread_init,
                                        diskfs_reclaim_thread_shutdown, w);
@@ -0,0 +1,418 @@
+// SPDX-FileCopyrightText: 2025-2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * Warm-cache manifest: snapshot the hot part of the block and inode caches to
+ * a host file (periodically from reclaim worker 0, and at unmount), and on the
+ * next mount of the same pool prefetch it back into the block cache in large
+ * batched reads, so a restart or failover does not fault every b+tree interior
+ * node one 4 KiB read at a time.  Best effort throughout: a missing, stale or
+ * corrupt manifest just means a cold start.
+ */
+
+#include <stdio.h>
+
+#include "diskfs_internal.h"
+
+static void
+diskfs_warm_pump(
+    struct diskfs_warm *wm);
+
+
+struct diskfs_warm_vec {
+    uint64_t *v;
+    uint32_t  n;
+    uint32_t  cap;
+};
+
+
+static void
+diskfs_warm_vec_push(
+    struct diskfs_warm_vec *vec,
+    uint64_t                x)
+{
+    if (vec->n >= DISKFS_WARM_MAX_ENTRIES) {
+        return;     /* a manifest only needs the hottest part anyway */
+    }
+    if (vec->n == vec->cap) {
+        vec->cap = vec->cap ? vec->cap * 2 : 1024;
+        vec->v   = realloc(vec->v, (size_t) vec->cap * sizeof(*vec->v));
+        chimera_diskfs_abort_if(!vec->v, "warm manifest allocation failed");
+    }
+    vec->v[vec->n++] = x;
+} /* diskfs_warm_vec_push */
+
+
+/* The protected (re-referenced) blocks of every shard that are keyed and
+ * valid: retired CoW blocks and never-keyed pool slots are not in the hash. */
+static void
+diskfs_warm_collect_blocks(
+    struct diskfs_shared   *shared,
+    struct diskfs_warm_vec *vec)
+{
+    struct diskfs_block_cache *cache = shared->block_cache;
+    struct diskfs_block       *blk;
+    int                        i;
+
+    for (i = 0; i < DISKFS_BLOCK_CACHE_SHARDS; i++) {
+        struct diskfs_block_shard *shard = &cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        for (blk = shard->hot_head; blk; blk = blk->lru_next) {
+            if (__atomic_load_n(&blk->state, __ATOMIC_ACQUIRE) == DISKFS_BLOCK_LOADING ||
+                diskfs_block_lookup_locked(shard,
+                                           diskfs_block_bucket(blk->device_id,
+                                                               blk->device_offset),
+                                           blk->device_id,
+                                           blk->device_offset) != blk) {
+                continue;
+            }
+            diskfs_warm_vec_push(vec, DISKFS_WARM_KEY(blk->device_id,
+                                                      blk->device_offset));
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+} /* diskfs_warm_collect_blocks */
+
+
+/* Live inodes promoted to the protected segment, idle or busy. */
+static void
+diskfs_warm_collect_inodes(
+    struct diskfs_shared   *shared,
+    struct diskfs_warm_vec *vec)
+{
+    struct diskfs_inode *inode;
+    int                  i;
+
+    for (i = 0; i < DISKFS_INODE_CACHE_SHARDS; i++) {
+        struct diskfs_inode_shard *shard = &shared->inode_cache->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        rb_tree_first(&shard->inodes, inode);
+        while (inode) {
+            if (inode->hot && inode->nlink > 0) {
+                diskfs_warm_vec_push(vec, inode->inum);
+            }
+            inode = rb_tree_next(&shard->inodes, inode);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+} /* diskfs_warm_collect_inodes */
+
+
+static int
+diskfs_warm_write_all(
+    int         fd,
+    const void *buf,
+    size_t      len)
+{
+    const uint8_t *p = buf;
+
+    while (len) {
+        ssize_t n = write(fd, p, len);
+
+        if (n < 0) {
+            return -1;
+        }
+        p   += n;
+        len -= n;
+    }
+    return 0;
+} /* diskfs_warm_write_all */
+
+
+/*
+ * Write the manifest: snapshot both caches (one shard lock at a time), then
+ * write a temporary file, fsync it and rename it over the old one, so a crash
+ * mid-save leaves the previous manifest intact.  Safe from any thread.
+ * Returns 0 on success (or when no manifest is configured).
+ */
+int
+diskfs_warm_save(struct diskfs_shared *shared)
+{
+    struct diskfs_warm_vec    vec = { 0 };
+    struct diskfs_warm_header hdr;
+    size_t                    plen;
+    char                     *tmp;
+    int                       fd, rc = -1;
+
+    if (!shared->warm_manifest) {
+        return 0;
+    }
+
+    /* Block keys first, then inums, in one array. */
+    diskfs_warm_collect_blocks(shared, &vec);
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.nblocks = vec.n;
+    diskfs_warm_collect_inodes(shared, &vec);
+
+    hdr.magic   = DISKFS_WARM_MAGIC;
+    hdr.version = DISKFS_WARM_VERSION;
+    hdr.fsid    = shared->fsid;
+    hdr.ninodes = vec.n - hdr.nblocks;
+    hdr.hash    = XXH3_64bits(vec.v, (size_t) vec.n * sizeof(uint64_t));
+
+    plen = strlen(shared->warm_manifest);
+    tmp  = malloc(plen + sizeof(".tmp"));
+    memcpy(tmp, shared->warm_manifest, plen);
+    memcpy(tmp + plen, ".tmp", sizeof(".tmp"));
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+        if (diskfs_warm_write_all(fd, &hdr, sizeof(hdr)) == 0 &&
+            diskfs_warm_write_all(fd, vec.v, (size_t) vec.n * sizeof(uint64_t)) == 0 &&
+            fsync(fd) == 0) {
+            rc = 0;
+        }
+        close(fd);
+    }
+    if (rc == 0 && rename(tmp, shared->warm_manifest) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        chimera_diskfs_error("warm-cache manifest write to %s failed: %s",
+                             shared->warm_manifest, strerror(errno));
+        unlink(tmp);
+    }
+    free(tmp);
+    free(vec.v);
+    return rc;
+} /* diskfs_warm_save */
+
+
+static int
+diskfs_warm_key_cmp(
+    const void *a,
+    const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+} /* diskfs_warm_key_cmp */
+
+
+/* A key the prefetcher may read: a whole block on an open local device. */
+static int
+diskfs_warm_key_valid(
+    struct diskfs_shared *shared,
+    uint64_t              key)
+{
+    uint32_t dev = DISKFS_WARM_KEY_DEVICE(key);
+    uint64_t off = DISKFS_WARM_KEY_OFFSET(key);
+
+    return dev < (uint32_t) shared->num_devices &&
+           shared->devices[dev].bdev &&
+           off + DISKFS_BLOCK_SIZE <= shared->devices[dev].size;
+} /* diskfs_warm_key_valid */
+
+
+/*
+ * Read and validate the manifest for this pool and turn it into a sorted,
+ * de-duplicated list of block keys (inums become their home blocks).  Returns
+ * NULL on any mismatch: no file, another pool, a torn or corrupt write.
+ */
+static uint64_t *
+diskfs_warm_load(
+    struct diskfs_shared *shared,
+    uint32_t             *r_nkeys)
+{
+    struct diskfs_warm_header hdr;
+    uint64_t                 *v = NULL;
+    uint64_t                  n;
+    uint32_t                  i, out;
+    FILE                     *f;
+
+    f = fopen(shared->warm_manifest, "r");
+    if (!f) {
+        return NULL;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        hdr.magic != DISKFS_WARM_MAGIC ||
+        hdr.version != DISKFS_WARM_VERSION ||
+        hdr.fsid != shared->fsid) {
+        goto bad;
+    }
+
+    n = (uint64_t) hdr.nblocks + hdr.ninodes;
+    if (n == 0) {
+        fclose(f);
+        return NULL;
+    }
+    if (n > DISKFS_WARM_MAX_ENTRIES) {
+        goto bad;
+    }
+
+    v = malloc(n * sizeof(*v));
+    if (!v || fread(v, sizeof(*v), n, f) != n ||
+        XXH3_64bits(v, n * sizeof(*v)) != hdr.hash) {
+        goto bad;
+    }
+    fclose(f);
+
+    for (i = hdr.nblocks; i < n; i++) {
+        uint64_t inum = v[i];
+        uint64_t off;
+        uint32_t dev;
+
+        if (!sm_inum_valid(shared->space_map, inum)) {
+            v[i] = UINT64_MAX;
+            continue;
+        }
+        off  = sm_inum_to_device_offset(shared->space_map, inum, &dev);
+        v[i] = DISKFS_WARM_KEY(dev, off);
+    }
+
+    qsort(v, n, sizeof(*v), diskfs_warm_key_cmp);
+
+    for (i = 0, out = 0; i < n; i++) {
+        if ((out && v[i] == v[out - 1]) || !diskfs_warm_key_valid(shared, v[i])) {
+            continue;
+        }
+        v[out++] = v[i];
+    }
+
+    *r_nkeys = out;
+    return v;
+
+ bad:
+    chimera_diskfs_info("warm-cache manifest %s does not match this pool; "
+                        "starting cold", shared->warm_manifest);
+    fclose(f);
+    free(v);
+    return NULL;
+} /* diskfs_warm_load */
+
+
+static void
+diskfs_warm_finish(struct diskfs_warm *wm)
+{
+    struct diskfs_reclaim_worker *w = wm->worker;
+
+    chimera_diskfs_info("warm-cache manifest: prefetched %lu of %u blocks",
+                        wm->loaded, wm->nkeys);
+    w->warm = NULL;
+    free(wm->keys);
+    free(wm);
+} /* diskfs_warm_finish */
+
+
+static void
+diskfs_warm_read_cb(
+    struct diskfs_thread *thread,
+    void                 *arg)
+{
+    struct diskfs_warm *wm = arg;
+
+    (void) thread;
+    wm->inflight--;
+    diskfs_warm_pump(wm);
+} /* diskfs_warm_read_cb */
+
+
+/* Keep DISKFS_WARM_DEPTH reads in flight, each covering the longest run of
+ * device-contiguous keys diskfs_block_prefetch will take. */
+static void
+diskfs_warm_pump(struct diskfs_warm *wm)
+{
+    struct diskfs_reclaim_worker *w = wm->worker;
+
+    while (wm->inflight < DISKFS_WARM_DEPTH && wm->next < wm->nkeys &&
+           !w->warm_stopping) {
+        uint64_t key = wm->keys[wm->next];
+        uint32_t run = 1, got;
+        int      issued;
+
+        while (wm->next + run < wm->nkeys && run < DISKFS_BLOCK_PREFETCH_MAX &&
+               wm->keys[wm->next + run] == key + run) {
+            run++;
+        }
+
+        got = diskfs_block_prefetch(w->ctx, DISKFS_WARM_KEY_DEVICE(key),
+                                    DISKFS_WARM_KEY_OFFSET(key), run, 1,
+                                    diskfs_warm_read_cb, wm, &issued);
+        wm->next += got;
+        if (issued) {
+            wm->inflight++;
+            wm->loaded += got;
+        }
+    }
+
+    if (wm->inflight == 0 && (wm->next >= wm->nkeys || w->warm_stopping)) {
+        diskfs_warm_finish(wm);
+    }
+} /* diskfs_warm_pump */
+
+
+static void
+diskfs_warm_timer_cb(
+    struct evpl       *evpl,
+    struct evpl_timer *timer)
+{
+    struct diskfs_reclaim_worker *w = container_of(timer,
+                                                   struct diskfs_reclaim_worker,
+                                                   warm_timer);
+
+    (void) evpl;
+
+    /* Until the prefetch is done the caches hold only part of what the last
+     * manifest listed; don't overwrite it with that. */
+    if (w->warm) {
+        return;
+    }
+    diskfs_warm_save(w->shared);
+} /* diskfs_warm_timer_cb */
+
+
+/* Reclaim worker 0, at startup (the pool is recovered and mounted): start the
+ * prefetch and the periodic save. */
+void
+diskfs_warm_worker_init(struct diskfs_reclaim_worker *w)
+{
+    struct diskfs_warm *wm;
+    uint64_t           *keys;
+    uint32_t            nkeys = 0;
+
+    if (w->index != 0 || !w->shared->warm_manifest) {
+        return;
+    }
+
+    if (w->shared->warm_interval) {
+        evpl_add_timer(w->ctx->evpl, &w->warm_timer, diskfs_warm_timer_cb,
+                       (uint64_t) w->shared->warm_interval * 1000000);
+    }
+
+    keys = diskfs_warm_load(w->shared, &nkeys);
+    if (!keys) {
+        return;
+    }
+
+    wm         = calloc(1, sizeof(*wm));
+    wm->worker = w;
+    wm->keys   = keys;
+    wm->nkeys  = nkeys;
+    w->warm    = wm;
+    diskfs_warm_pump(wm);
+} /* diskfs_warm_worker_init */
+
+
+void
+diskfs_warm_worker_fini(struct diskfs_reclaim_worker *w)
+{
+    if (w->index != 0 || !w->shared->warm_manifest) {
+        return;
+    }
+
+    /* Stop issuing; let the reads already out land (their blocks are
+     * published LOADING and must complete before the cache goes away). */
+    w->warm_stopping = 1;
+    while (w->warm) {
+        evpl_continue(w->ctx->evpl);
+    }
+
+    if (w->shared->warm_interval) {
+        evpl_remove_timer(w->ctx->evpl, &w->warm_timer);
+    }
+} /* diskfs_warm_worker_fini */
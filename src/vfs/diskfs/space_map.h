@@ -232,6 +232,16 @@ struct sm_io {
 
 /* superblock flags */
 #define SM_SB_CLEAN                0x1ULL  /* set at clean unmount, cleared at mount */
+/* Data-compression codec chosen at mkfs (diskfs DISKFS_COMPRESS_*); fixed for
+ * the life of the pool, so every superblock rewrite carries it forward. */
+#define SM_SB_COMPRESS_SHIFT       8
+#define SM_SB_COMPRESS_MASK        (0xfULL << SM_SB_COMPRESS_SHIFT)
+/* Pool formatted with data deduplication (diskfs dedup index at inum 2). */
+#define SM_SB_DEDUP                (1ULL << 12)
+/* Pool formatted with a valid diskfs dinode.flags word.  Older images hold
+ * stale bytes there, so without this bit the flags are ignored and no file is
+ * ever made inline. */
+#define SM_SB_DINODE_FLAGS         (1ULL << 13)
 
 /*
  * Named-filesystem table (CHIMERA_VFS_CAP_MKFS): one entry per filesystem in
@@ -8,6 +8,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <sys/types.h>
@@ -33,6 +34,7 @@
 
 #include "io_uring.h"
 #include "../linux/linux_common.h"
+#include "../linux/linux_readdir.h"
 #include "common/logging.h"
 #include "common/macros.h"
 
@@ -83,9 +85,94 @@ chimera_io_uring_dispatch(
 
 #define CHIMERA_IO_URING_STATX_MASK        STATX_BASIC_STATS
 
+/*
+ * Registered files ("fixed_files" option).  Each thread registers a sparse
+ * file table and installs an open file at the index equal to its fd the first
+ * time it does I/O on it, so READ/WRITE/FSYNC SQEs can use IOSQE_FIXED_FILE and
+ * skip the per-I/O fdget/fput.  Only fds below CHIMERA_IO_URING_FIXED_FILES are
+ * eligible; others use the plain fd.
+ *
+ * A table entry holds a reference on the file, so it must not outlive the
+ * handle: closing an fd bumps its generation in the shared fd_gen array and
+ * the close epoch, and every thread drops entries whose generation moved the
+ * next time it reaps completions.
+ */
+#define CHIMERA_IO_URING_FIXED_FILES       16384
+
+/*
+ * Direct I/O ("direct_io" option).  Opened regular files get O_DIRECT, set with
+ * fcntl after the open so directories and filesystems without direct I/O just
+ * stay buffered.  Reads cover the whole 4 KiB-aligned range the VFS core
+ * already pads its read buffers to, so they land in those buffers directly
+ * unless a segment is misaligned.  Writes aligned in the file but not in memory
+ * go through an aligned bounce buffer; writes with an unaligned head or tail
+ * are a read-modify-write of the edge blocks, done on the ring in two
+ * submissions: the edge reads (and a statx for the size), then, once the new
+ * data is merged over them, the aligned write linked to the trim of any
+ * extension past the data and to the fsync of a stable write.
+ *
+ * Every open of the same file shares one chimera_io_uring_dio_file, found by
+ * fd through a table filled in at open time.  Its writes are admitted in
+ * order: aligned writes run alongside each other, a read-modify-write runs
+ * alone so no write can land between its read and its write-back.  A write
+ * that has to wait is queued on the file and started by whichever thread
+ * releases it, on its own ring -- handed back through that thread's dio_ready
+ * list and doorbell when it belongs to another thread.
+ */
+#define CHIMERA_IO_URING_DIO_ALIGN         4096
+#define CHIMERA_IO_URING_DIO_FD_PAGE_SHIFT 12
+#define CHIMERA_IO_URING_DIO_FD_PAGE       (1 << CHIMERA_IO_URING_DIO_FD_PAGE_SHIFT)
+#define CHIMERA_IO_URING_DIO_FD_PAGES      1024
+
+#define CHIMERA_IO_URING_DIO_WRITE         0
+#define CHIMERA_IO_URING_DIO_RMW_READ      1
+
+struct chimera_io_uring_thread;
+
+struct chimera_io_uring_dio_key {
+    uint64_t dev;
+    uint64_t ino;
+};
+
+struct chimera_io_uring_dio_file {
+    struct chimera_io_uring_dio_key key;
+    uint32_t                        refcnt;   /* fd table entries */
+    uint32_t                        writers;  /* aligned writes in flight */
+    int                             rmw;      /* a read-modify-write in flight */
+    pthread_mutex_t                 lock;     /* never held across I/O */
+    struct chimera_vfs_request     *waiters;
+    UT_hash_handle                  hh;
+};
+
+struct chimera_io_uring_dio {
+    void                             *bounce;
+    uint32_t                          bounce_len;
+    int                               direct;
+    /* Direct writes only */
+    struct chimera_io_uring_thread   *thread;
+    struct chimera_io_uring_dio_file *file;
+    int                               rmw;
+    int                               stage;
+    int                               err;
+    int                               niov;
+    int                               head_res;
+    int                               tail_res;
+    uint64_t                          trim;
+    struct statx                      stx;
+};
+
 struct chimera_io_uring_shared {
-    struct io_uring ring;
-    int             readdir_verifier;
+    struct io_uring                    ring;
+    int                                readdir_verifier;
+    int                                fixed_files;
+    int                                sqpoll;
+    int                                direct_io;
+    uint32_t                           sqpoll_idle_ms;
+    uint32_t                          *fd_gen;
+    uint64_t                           close_epoch;
+    pthread_mutex_t                    dio_lock; /* dio_files, dio_fds updates */
+    struct chimera_io_uring_dio_file  *dio_files;
+    struct chimera_io_uring_dio_file **dio_fds[CHIMERA_IO_URING_DIO_FD_PAGES];
 };
 
 /*
@@ -109,6 +196,7 @@ struct chimera_io_uring_personality {
 
 struct chimera_io_uring_thread {
     struct evpl                        *evpl;
+    struct chimera_io_uring_shared     *shared;
     struct evpl_doorbell                doorbell;
     struct evpl_poll                   *poll;
     struct evpl_deferral                deferral;
@@ -117,12 +205,227 @@ struct chimera_io_uring_thread {
     uint64_t                            max_inflight;
     struct chimera_vfs_request         *pending_requests;
     struct chimera_linux_mount_table    mount_table;
+    struct chimera_linux_readdir_cache  readdir_cache;
     int                                 readdir_verifier;
     int                                 personality_supported;
     uint64_t                            personality_lru_clock;
     struct chimera_io_uring_personality personalities[CHIMERA_IO_URING_MAX_PERSONALITIES];
+    int                                 fixed_files;
+    int                                 fixed_count;
+    uint64_t                            close_epoch;
+    uint32_t                           *fixed_gen;  /* fd_gen + 1 at registration, 0 if free */
+    int                                *fixed_list; /* registered indexes, for the sweep */
+    pthread_mutex_t                     dio_ready_lock;
+    struct chimera_vfs_request         *dio_ready;  /* direct writes released by other threads */
 };
 
+/* Use the registered copy of fd for this SQE when fixed files are enabled,
+ * registering it first if this thread has not yet seen this open of it. */
+static inline void
+chimera_io_uring_sqe_set_file(
+    struct chimera_io_uring_thread *thread,
+    struct io_uring_sqe            *sqe,
+    int                             fd)
+{
+    uint32_t gen;
+    int      rc;
+
+    if (!thread->fixed_files || fd < 0 || fd >= CHIMERA_IO_URING_FIXED_FILES) {
+        return;
+    }
+
+    gen = __atomic_load_n(&thread->shared->fd_gen[fd], __ATOMIC_ACQUIRE) + 1;
+
+    if (thread->fixed_gen[fd] != gen) {
+        rc = io_uring_register_files_update(&thread->ring, fd, &fd, 1);
+
+        if (rc != 1) {
+            return;
+        }
+
+        if (thread->fixed_gen[fd] == 0) {
+            thread->fixed_list[thread->fixed_count++] = fd;
+        }
+
+        thread->fixed_gen[fd] = gen;
+    }
+
+    /* The table index is the fd itself, so sqe->fd stays as prepared */
+    sqe->flags |= IOSQE_FIXED_FILE;
+} /* chimera_io_uring_sqe_set_file */
+
+static inline void
+chimera_io_uring_fixed_drop(
+    struct chimera_io_uring_thread *thread,
+    int                             index)
+{
+    int fd  = thread->fixed_list[index];
+    int off = -1;
+
+    io_uring_register_files_update(&thread->ring, fd, &off, 1);
+
+    thread->fixed_gen[fd]     = 0;
+    thread->fixed_list[index] = thread->fixed_list[--thread->fixed_count];
+} /* chimera_io_uring_fixed_drop */
+
+/* Drop registered files whose fd has been closed since they were registered. */
+static void
+chimera_io_uring_fixed_sweep(struct chimera_io_uring_thread *thread)
+{
+    uint64_t epoch;
+    int      i, fd;
+
+    epoch = __atomic_load_n(&thread->shared->close_epoch, __ATOMIC_ACQUIRE);
+
+    if (epoch == thread->close_epoch) {
+        return;
+    }
+
+    thread->close_epoch = epoch;
+
+    for (i = 0; i < thread->fixed_count;) {
+        fd = thread->fixed_list[i];
+
+        if (thread->fixed_gen[fd] !=
+            __atomic_load_n(&thread->shared->fd_gen[fd], __ATOMIC_ACQUIRE) + 1) {
+            chimera_io_uring_fixed_drop(thread, i);
+        } else {
+            i++;
+        }
+    }
+} /* chimera_io_uring_fixed_sweep */
+
+/* The direct I/O file behind fd, or NULL if fd is not open for direct I/O. */
+static inline struct chimera_io_uring_dio_file *
+chimera_io_uring_dio_fd(
+    struct chimera_io_uring_shared *shared,
+    int                             fd)
+{
+    struct chimera_io_uring_dio_file **page;
+
+    if (fd < 0 || (fd >> CHIMERA_IO_URING_DIO_FD_PAGE_SHIFT) >= CHIMERA_IO_URING_DIO_FD_PAGES) {
+        return NULL;
+    }
+
+    page = __atomic_load_n(&shared->dio_fds[fd >> CHIMERA_IO_URING_DIO_FD_PAGE_SHIFT],
+                           __ATOMIC_ACQUIRE);
+
+    if (!page) {
+        return NULL;
+    }
+
+    return __atomic_load_n(&page[fd & (CHIMERA_IO_URING_DIO_FD_PAGE - 1)], __ATOMIC_ACQUIRE);
+} /* chimera_io_uring_dio_fd */
+
+/* Point fd's table entry at the file for key (or at nothing if key is NULL),
+ * dropping the reference held by whatever it pointed at before.  Returns -1
+ * if fd is beyond the table. */
+static int
+chimera_io_uring_dio_fd_set(
+    struct chimera_io_uring_shared        *shared,
+    int                                    fd,
+    const struct chimera_io_uring_dio_key *key)
+{
+    struct chimera_io_uring_dio_file **page, *file = NULL, *old;
+    int                                pg = fd >> CHIMERA_IO_URING_DIO_FD_PAGE_SHIFT;
+
+    if (fd < 0 || pg >= CHIMERA_IO_URING_DIO_FD_PAGES) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&shared->dio_lock);
+
+    page = shared->dio_fds[pg];
+
+    if (!page) {
+        if (!key) {
+            pthread_mutex_unlock(&shared->dio_lock);
+            return 0;
+        }
+
+        page = calloc(CHIMERA_IO_URING_DIO_FD_PAGE, sizeof(*page));
+
+        chimera_io_uring_abort_if(!page, "Failed to allocate direct I/O fd table");
+
+        __atomic_store_n(&shared->dio_fds[pg], page, __ATOMIC_RELEASE);
+    }
+
+    if (key) {
+        HASH_FIND(hh, shared->dio_files, key, sizeof(*key), file);
+
+        if (!file) {
+            file = calloc(1, sizeof(*file));
+
+            chimera_io_uring_abort_if(!file, "Failed to allocate direct I/O file");
+
+            file->key = *key;
+            pthread_mutex_init(&file->lock, NULL);
+            HASH_ADD(hh, shared->dio_files, key, sizeof(file->key), file);
+        }
+
+        file->refcnt++;
+    }
+
+    old = page[fd & (CHIMERA_IO_URING_DIO_FD_PAGE - 1)];
+
+    __atomic_store_n(&page[fd & (CHIMERA_IO_URING_DIO_FD_PAGE - 1)], file, __ATOMIC_RELEASE);
+
+    if (old && --old->refcnt == 0) {
+        HASH_DEL(shared->dio_files, old);
+        pthread_mutex_destroy(&old->lock);
+        free(old);
+    }
+
+    pthread_mutex_unlock(&shared->dio_lock);
+
+    return 0;
+} /* chimera_io_uring_dio_fd_set */
+
+/* Switch a freshly opened data fd to direct I/O and record it in the fd table,
+ * so the write path knows without a syscall.  A failure (a directory, or a
+ * filesystem without direct I/O support) leaves the fd buffered. */
+static void
+chimera_io_uring_dio_enable(
+    struct chimera_io_uring_thread *thread,
+    int                             fd,
+    unsigned int                    vfs_flags)
+{
+    struct chimera_io_uring_shared *shared = thread->shared;
+    struct chimera_io_uring_dio_key key;
+    struct stat                     st;
+    int                             fl;
+
+    if (!shared->direct_io) {
+        return;
+    }
+
+    /* The fd number may be reused from a file closed outside chimera_io_uring_close */
+    if (chimera_io_uring_dio_fd(shared, fd)) {
+        chimera_io_uring_dio_fd_set(shared, fd, NULL);
+    }
+
+    if (vfs_flags & (CHIMERA_VFS_OPEN_PATH | CHIMERA_VFS_OPEN_DIRECTORY)) {
+        return;
+    }
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+
+    fl = fcntl(fd, F_GETFL);
+
+    if (fl < 0 || fcntl(fd, F_SETFL, fl | O_DIRECT) < 0) {
+        return;
+    }
+
+    key.dev = st.st_dev;
+    key.ino = st.st_ino;
+
+    if (chimera_io_uring_dio_fd_set(shared, fd, &key) < 0) {
+        (void) fcntl(fd, F_SETFL, fl);
+    }
+} /* chimera_io_uring_dio_enable */
+
 /*
  * Return a registered personality id for `cred`'s identity, or 0 to use the
  * thread's own (server) credentials, or -1 if personalities are unavailable so
@@ -187,6 +490,30 @@ chimera_io_uring_get_personality(
     return id;
 } /* chimera_io_uring_get_personality */
 
+/*
+ * The personality an SQE submitted later, outside any impersonation, must
+ * carry to act as `cred`: 0 when the server's own identity is the right one,
+ * or -1 when `cred` can only be taken on by impersonating this thread (no
+ * personality support, a non-UNIX cred, or registration failed).
+ */
+static int
+chimera_io_uring_sqe_personality(
+    struct chimera_io_uring_thread *thread,
+    const struct chimera_vfs_cred  *cred)
+{
+    const struct chimera_vfs_cred *sc = chimera_vfs_get_server_cred();
+    int                            id;
+
+    if (cred->flavor == CHIMERA_VFS_AUTH_UNIX &&
+        cred->uid == sc->uid && cred->gid == sc->gid) {
+        return 0;
+    }
+
+    id = chimera_io_uring_get_personality(thread, cred);
+
+    return id > 0 ? id : -1;
+} /* chimera_io_uring_sqe_personality */
+
 static void *
 chimera_io_uring_init(
     const char                *cfgdata,
@@ -213,25 +540,71 @@ chimera_io_uring_init(
         json_t      *cfg = json_loads(cfgdata, 0, &json_error);
 
         if (cfg) {
-            json_t *verf = json_object_get(cfg, "readdir_verifier");
+            json_t *verf   = json_object_get(cfg, "readdir_verifier");
+            json_t *fixed  = json_object_get(cfg, "fixed_files");
+            json_t *sqpoll = json_object_get(cfg, "sqpoll");
+            json_t *idle   = json_object_get(cfg, "sqpoll_idle_ms");
+            json_t *direct = json_object_get(cfg, "direct_io");
 
             if (json_is_boolean(verf)) {
                 shared->readdir_verifier = json_boolean_value(verf);
             }
 
+            if (json_is_boolean(fixed)) {
+                shared->fixed_files = json_boolean_value(fixed);
+            }
+
+            if (json_is_boolean(sqpoll)) {
+                shared->sqpoll = json_boolean_value(sqpoll);
+            }
+
+            if (json_is_integer(idle)) {
+                shared->sqpoll_idle_ms = json_integer_value(idle);
+            }
+
+            if (json_is_boolean(direct)) {
+                shared->direct_io = json_boolean_value(direct);
+            }
+
             json_decref(cfg);
         }
     }
 
+    if (shared->fixed_files) {
+        shared->fd_gen = calloc(CHIMERA_IO_URING_FIXED_FILES, sizeof(*shared->fd_gen));
+    }
+
+    if (!shared->sqpoll_idle_ms) {
+        shared->sqpoll_idle_ms = 1000;
+    }
+
+    pthread_mutex_init(&shared->dio_lock, NULL);
+
     return shared;
 } /* io_uring_init */ /* io_uring_init */
 
 static void
 chimera_io_uring_destroy(void *private_data)
 {
-    struct chimera_io_uring_shared *shared = private_data;
+    struct chimera_io_uring_shared   *shared = private_data;
+    struct chimera_io_uring_dio_file *file, *tmp;
+    int                               i;
+
+    HASH_ITER(hh, shared->dio_files, file, tmp)
+    {
+        HASH_DEL(shared->dio_files, file);
+        pthread_mutex_destroy(&file->lock);
+        free(file);
+    }
+
+    for (i = 0; i < CHIMERA_IO_URING_DIO_FD_PAGES; i++) {
+        free(shared->dio_fds[i]);
+    }
+
+    pthread_mutex_destroy(&shared->dio_lock);
 
     io_uring_queue_exit(&shared->ring);
+    free(shared->fd_gen);
     free(shared);
 } /* io_uring_destroy */
 
@@ -375,6 +748,8 @@ chimera_io_uring_open_at_finish(
         return;
     }
 
+    chimera_io_uring_dio_enable(thread, fd, request->open_at.flags);
+
     sqe = chimera_io_uring_get_sqe(thread, request, 1, 0);
 
     if (request->open_at.flags & CHIMERA_VFS_OPEN_NOFOLLOW) {
@@ -406,6 +781,53 @@ chimera_io_uring_open_at_finish(
 static int chimera_io_uring_open_at_flags(
     struct chimera_vfs_request *request);
 
+static void chimera_io_uring_readdir_continue(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request);
+
+static void chimera_io_uring_write_dio_start(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request);
+
+static void chimera_io_uring_write_dio_continue(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request);
+
+static void chimera_io_uring_dio_ready(
+    struct chimera_io_uring_thread *thread);
+
+static void chimera_io_uring_read_direct_done(
+    struct chimera_vfs_request  *request,
+    struct chimera_io_uring_dio *dio,
+    uint32_t                     res);
+
+/* POSIX kill-priv: a non-privileged write to a regular file clears the
+ * set-user-ID bit and the set-group-ID bit (when group-executable).  The server
+ * runs with CAP_FSETID, so the host kernel does not do this for us; apply it
+ * against the caller's credential.  Only a non-root UNIX writer can trigger the
+ * clear, so skip the stat/chmod otherwise. */
+static void
+chimera_io_uring_write_killpriv(struct chimera_vfs_request *request)
+{
+    int         wfd = (int) request->write.handle->vfs_private;
+    struct stat wst;
+    uint32_t    new_mode;
+
+    if (!request->cred ||
+        request->cred->flavor != CHIMERA_VFS_AUTH_UNIX ||
+        request->cred->uid == 0) {
+        return;
+    }
+
+    if (fstat(wfd, &wst) == 0) {
+        new_mode = chimera_vfs_killpriv_mode(request->cred, wst.st_mode);
+
+        if (new_mode != (uint32_t) wst.st_mode) {
+            (void) fchmod(wfd, new_mode & 07777);
+        }
+    }
+} /* chimera_io_uring_write_killpriv */
+
 static void
 chimera_io_uring_reap(
     struct evpl                    *evpl,
@@ -418,8 +840,13 @@ chimera_io_uring_reap(
     struct statx                      *dir_stx, *stx;
     const char                        *name;
     struct io_uring_sqe               *sqe;
+    struct chimera_io_uring_dio       *dio;
     void                              *scratch;
 
+    if (thread->fixed_files) {
+        chimera_io_uring_fixed_sweep(thread);
+    }
+
     while (io_uring_peek_cqe(&thread->ring, &cqe) == 0) {
 
         handle = (struct chimera_vfs_request_handle *) cqe->user_data;
@@ -650,13 +1077,21 @@ chimera_io_uring_reap(
                     /* The VFS core owns request->read.iov (allocated on the
                      * connection thread); it trims/releases the buffers on
                      * completion, so io_uring only reports the outcome here. */
-                    if (cqe->res >= 0) {
+                    dio = (struct chimera_io_uring_dio *) (((struct statx *) request->plugin_data) + 1);
+
+                    if (cqe->res >= 0 && dio->direct) {
+                        request->status = CHIMERA_VFS_OK;
+                        chimera_io_uring_read_direct_done(request, dio, cqe->res);
+                    } else if (cqe->res >= 0) {
                         request->status        = CHIMERA_VFS_OK;
                         request->read.r_length = cqe->res;
                         request->read.r_eof    = (cqe->res < request->read.length);
                     } else {
                         request->status = chimera_linux_errno_to_status(-cqe->res);
                     }
+
+                    free(dio->bounce);
+                    dio->bounce = NULL;
                 } else {
                     if (cqe->res == 0) {
                         stx = (struct statx *) request->plugin_data;
@@ -680,41 +1115,65 @@ chimera_io_uring_reap(
                 }
                 break;
             case CHIMERA_VFS_OP_WRITE:
-                if (cqe->res >= 0) {
+                dio = (struct chimera_io_uring_dio *) request->plugin_data;
+
+                if (dio->file && dio->stage == CHIMERA_IO_URING_DIO_RMW_READ) {
+                    /* Edge block reads (slots 0 and 1) and the size (slot 2) */
+                    if (cqe->res < 0) {
+                        dio->err = dio->err ? dio->err : -cqe->res;
+                    } else if (handle->slot == 0) {
+                        dio->head_res = cqe->res;
+                    } else if (handle->slot == 1) {
+                        dio->tail_res = cqe->res;
+                    }
+                    break;
+                }
+
+                if (handle->slot != 0) {
+                    /* The trim or fsync following a read-modify-write; a
+                     * failed write cancels them and has set the status */
+                    if (cqe->res < 0 && cqe->res != -ECANCELED &&
+                        request->status == CHIMERA_VFS_OK) {
+                        request->status         = chimera_linux_errno_to_status(-cqe->res);
+                        request->write.r_length = 0;
+                    }
+                    break;
+                }
+
+                if (cqe->res >= 0 && dio->file && dio->rmw) {
+                    if ((uint32_t) cqe->res == dio->bounce_len) {
+                        request->status         = CHIMERA_VFS_OK;
+                        request->write.r_length = request->write.length;
+
+                        chimera_io_uring_write_killpriv(request);
+                    } else {
+                        request->status         = CHIMERA_VFS_EIO;
+                        request->write.r_length = 0;
+                    }
+                } else if (cqe->res >= 0) {
                     request->status         = CHIMERA_VFS_OK;
                     request->write.r_length = cqe->res;
 
-                    /* POSIX kill-priv: a non-privileged write to a regular file
-                     * clears the set-user-ID bit and the set-group-ID bit (when
-                     * group-executable).  The server runs with CAP_FSETID, so
-                     * the host kernel does not do this for us; apply it against
-                     * the caller's credential.  Only a non-root UNIX writer can
-                     * trigger the clear, so skip the stat/chmod otherwise. */
-                    if (request->cred &&
-                        request->cred->flavor == CHIMERA_VFS_AUTH_UNIX &&
-                        request->cred->uid != 0) {
-                        int         wfd = (int) request->write.handle->vfs_private;
-                        struct stat wst;
-
-                        if (fstat(wfd, &wst) == 0) {
-                            uint32_t new_mode = chimera_vfs_killpriv_mode(
-                                request->cred, wst.st_mode);
-
-                            if (new_mode != (uint32_t) wst.st_mode) {
-                                (void) fchmod(wfd, new_mode & 07777);
-                            }
-                        }
-                    }
+                    chimera_io_uring_write_killpriv(request);
                 } else {
                     request->status         = chimera_linux_errno_to_status(-cqe->res);
                     request->write.r_length = 0;
                 }
+
+                if (!dio->file) {
+                    free(dio->bounce);
+                }
+
                 /* Note: Write iovecs are NOT released here. They were allocated on the
                  * server thread and must be released there. The server's write completion
                  * callback handles the release after this request completes via doorbell.
                  */
                 break;
 
+            case CHIMERA_VFS_OP_READDIR:
+                /* A failed statx shows up as an empty stx_mask at emit */
+                break;
+
             default:
                 if (cqe->res) {
                     request->status = chimera_linux_errno_to_status(-cqe->res);
@@ -726,7 +1185,12 @@ chimera_io_uring_reap(
 
         --request->token_count;
 
-        if (request->token_count == 0) {
+        if (request->token_count == 0 && request->opcode == CHIMERA_VFS_OP_READDIR) {
+            chimera_io_uring_readdir_continue(thread, request);
+        } else if (request->token_count == 0 && request->opcode == CHIMERA_VFS_OP_WRITE &&
+                   ((struct chimera_io_uring_dio *) request->plugin_data)->file) {
+            chimera_io_uring_write_dio_continue(thread, request);
+        } else if (request->token_count == 0) {
             if (request->opcode == CHIMERA_VFS_OP_OPEN_AT ||
                 request->opcode == CHIMERA_VFS_OP_MKDIR_AT) {
                 chimera_restore_privilege(request->cred);
@@ -739,6 +1203,8 @@ chimera_io_uring_reap(
 
     } /* while peek_cqe */
 
+    chimera_io_uring_dio_ready(thread);
+
     while (thread->pending_requests && thread->inflight < thread->max_inflight) {
         request = thread->pending_requests;
         DL_DELETE(thread->pending_requests, request);
@@ -824,6 +1290,7 @@ chimera_io_uring_thread_init(
     thread = calloc(1, sizeof(*thread));
 
     thread->evpl             = evpl;
+    thread->shared           = shared;
     thread->readdir_verifier = shared->readdir_verifier;
 
     /* Neutralise the process umask for create paths.  mkdirat/openat/mknodat
@@ -841,16 +1308,52 @@ chimera_io_uring_thread_init(
     params.flags  = IORING_SETUP_SINGLE_ISSUER;
     params.flags |= IORING_SETUP_COOP_TASKRUN;
 
-    params.flags |= IORING_SETUP_ATTACH_WQ;
-    params.wq_fd  = shared->ring.ring_fd;
-
     thread->max_inflight = 1024;
 
-    // Initialize io_uring with params
-    rc = io_uring_queue_init_params(4 * thread->max_inflight, &thread->ring, &params);
+    if (shared->sqpoll) {
+        /* A kernel thread per ring polls the SQ, so submission needs no
+         * syscall while it is awake.  SQPOLL rings cannot attach to the shared
+         * ring's workqueue, which has no SQ thread. */
+        params.flags         |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = shared->sqpoll_idle_ms;
+
+        rc = io_uring_queue_init_params(4 * thread->max_inflight, &thread->ring, &params);
+
+        if (rc < 0) {
+            chimera_io_uring_error("Failed to create SQPOLL io_uring queue, using interrupt mode: %s",
+                                   strerror(-rc));
+            memset(&params, 0, sizeof(params));
+            params.flags  = IORING_SETUP_SINGLE_ISSUER;
+            params.flags |= IORING_SETUP_COOP_TASKRUN;
+        }
+    }
+
+    if (!(params.flags & IORING_SETUP_SQPOLL)) {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd  = shared->ring.ring_fd;
+
+        // Initialize io_uring with params
+        rc = io_uring_queue_init_params(4 * thread->max_inflight, &thread->ring, &params);
+    }
 
     chimera_io_uring_abort_if(rc < 0, "Failed to create io_uring queue: %s", strerror(-rc));
 
+    if (shared->fixed_files) {
+        rc = io_uring_register_files_sparse(&thread->ring, CHIMERA_IO_URING_FIXED_FILES);
+
+        if (rc < 0) {
+            chimera_io_uring_error("Failed to register fixed file table, fixed files disabled: %s",
+                                   strerror(-rc));
+        } else {
+            thread->fixed_files = 1;
+            thread->close_epoch = __atomic_load_n(&shared->close_epoch, __ATOMIC_ACQUIRE);
+            thread->fixed_gen   = calloc(CHIMERA_IO_URING_FIXED_FILES, sizeof(*thread->fixed_gen));
+            thread->fixed_list  = calloc(CHIMERA_IO_URING_FIXED_FILES, sizeof(*thread->fixed_list));
+        }
+    }
+
+    pthread_mutex_init(&thread->dio_ready_lock, NULL);
+
     evpl_add_doorbell(evpl, &thread->doorbell, chimera_io_uring_complete);
 
     rc = io_uring_register_eventfd(&thread->ring, evpl_doorbell_fd(&thread->doorbell));
@@ -886,6 +1389,7 @@ chimera_io_uring_thread_destroy(void *private_data)
     struct chimera_io_uring_thread *thread = private_data;
     int                             i;
 
+    chimera_linux_readdir_cache_destroy(&thread->readdir_cache);
     linux_mount_table_destroy(&thread->mount_table);
 
     for (i = 0; i < CHIMERA_IO_URING_MAX_PERSONALITIES; i++) {
@@ -898,7 +1402,10 @@ chimera_io_uring_thread_destroy(void *private_data)
     evpl_remove_poll(thread->evpl, thread->poll);
     io_uring_queue_exit(&thread->ring);
     evpl_remove_doorbell(thread->evpl, &thread->doorbell);
+    pthread_mutex_destroy(&thread->dio_ready_lock);
 
+    free(thread->fixed_gen);
+    free(thread->fixed_list);
     free(thread);
 } /* io_uring_thread_destroy */
 
@@ -1205,119 +1712,281 @@ chimera_io_uring_lookup_at(
     evpl_defer(thread->evpl, &thread->deferral);
 } /* io_uring_lookup */
 
-static void
-chimera_io_uring_readdir(
-    struct chimera_vfs_request *request,
-    void                       *private_data)
-{
-    struct chimera_io_uring_thread *thread = private_data;
-    int                             fd, dup_fd, rc;
-    DIR                            *dir;
-    struct dirent                  *dirent;
-    struct chimera_vfs_attrs        vattr;
-    int                             eof = 1;
-
-    --thread->inflight;
+/*
+ * READDIR pages come from a cached directory cursor (linux_readdir.h).  When
+ * the caller wants stat attributes they are fetched a batch at a time: one
+ * statx SQE per entry, all in flight together, with the batch handed to the
+ * callback once every statx has completed.  File handles and statfs values are
+ * still read synchronously at emit time as io_uring has no name_to_handle_at.
+ */
+#define CHIMERA_IO_URING_READDIR_STATX_ATTRS \
+        (CHIMERA_VFS_ATTR_MASK_STAT | CHIMERA_VFS_ATTR_FSID)
+
+/* READDIR's plugin_data: the directory cursor, and whether the current batch
+ * is stat'ed synchronously at emit time rather than by statx SQEs. */
+struct chimera_io_uring_readdir_ctx {
+    struct chimera_linux_readdir_cursor *cursor;
+    int                                  sync_attrs;
+};
 
+/* Gather the next batch of entries and queue a statx for each one the caller
+ * will see.  A failed statx leaves its stx_mask zero.  The SQEs carry the
+ * caller's personality, as the per-entry lookups must honour its search
+ * permission; where no personality can stand in for it the batch is left to
+ * emit, which stats it under the caller's impersonated creds.  Returns the
+ * number of SQEs queued. */
+static int
+chimera_io_uring_readdir_submit(
+    struct chimera_io_uring_thread      *thread,
+    struct chimera_vfs_request          *request,
+    struct chimera_io_uring_readdir_ctx *ctx)
+{
+    struct chimera_linux_readdir_cursor *cursor = ctx->cursor;
+    struct io_uring_sqe                 *sqe;
+    struct dirent64                     *de;
+    unsigned int                         space;
+    int                                  i, rc, personality, issued = 0;
+    int                                  dirfd = (int) request->readdir.handle->vfs_private;
+
+    if (!chimera_linux_readdir_cursor_gather(cursor)) {
+        return 0;
+    }
 
-    fd = request->readdir.handle->vfs_private;
+    personality     = chimera_io_uring_sqe_personality(thread, request->cred);
+    ctx->sync_attrs = personality < 0;
 
-    rc = chimera_setup_credential(request->cred, NULL);
-    if (rc != 0) {
-        request->status = chimera_linux_errno_to_status(rc);
-        request->complete(request);
-        return;
+    if (ctx->sync_attrs) {
+        return 0;
     }
 
-    if (thread->readdir_verifier) {
-        struct stat st;
+    space = io_uring_sq_space_left(&thread->ring);
 
-        rc = fstat(fd, &st);
+    if (space < (unsigned int) cursor->batch_count) {
+        rc = io_uring_submit(&thread->ring);
 
-        if (rc == 0) {
-            uint64_t mtime_verf = chimera_linux_mtime_to_verifier(&st);
+        chimera_io_uring_abort_if(rc < 0, "io_uring_submit");
 
-            if (request->readdir.verifier &&
-                request->readdir.verifier != mtime_verf) {
-                chimera_restore_privilege(request->cred);
-                request->status = CHIMERA_VFS_EBADCOOKIE;
-                request->complete(request);
-                return;
-            }
+        space = io_uring_sq_space_left(&thread->ring);
 
-            request->readdir.r_verifier = mtime_verf;
+        if (space < (unsigned int) cursor->batch_count) {
+            cursor->batch_count = space;
         }
     }
 
-    dup_fd = openat(fd, ".", O_RDONLY | O_DIRECTORY);
+    for (i = 0; i < cursor->batch_count; i++) {
+        de = cursor->batch[i];
 
-    if (dup_fd < 0) {
-        chimera_io_uring_error("io_uring_readdir: openat() failed: %s",
-                               strerror(errno));
-        chimera_restore_privilege(request->cred);
-        request->status = chimera_linux_errno_to_status(errno);
-        request->complete(request);
-        return;
-    }
+        cursor->batch_stx[i].stx_mask = 0;
 
-    dir = fdopendir(dup_fd);
+        if (!(request->readdir.flags & CHIMERA_VFS_READDIR_EMIT_DOT) &&
+            chimera_linux_readdir_is_dot(de->d_name)) {
+            continue;
+        }
 
-    if (!dir) {
-        chimera_io_uring_error("io_uring_readdir: fdopendir() failed: %s",
-                               strerror(errno));
-        close(dup_fd);
-        chimera_restore_privilege(request->cred);
-        request->status = chimera_linux_errno_to_status(errno);
-        request->complete(request);
-        return;
-    }
+        sqe = chimera_io_uring_get_sqe(thread, request, 0, 0);
+
+        io_uring_prep_statx(sqe, dirfd, de->d_name,
+                            AT_SYMLINK_NOFOLLOW | AT_STATX_SYNC_AS_STAT,
+                            CHIMERA_IO_URING_STATX_MASK,
+                            &cursor->batch_stx[i]);
 
-    if (request->readdir.cookie) {
-        seekdir(dir, request->readdir.cookie);
+        /* prep_statx zeroes sqe->personality, so set it after. */
+        if (personality > 0) {
+            sqe->personality = personality;
+        }
+        issued++;
+    }
+
+    return issued;
+} /* chimera_io_uring_readdir_submit */
+
+/* Hand the gathered batch to the callback.  Returns 1 once the page is done
+ * (status, r_cookie and r_eof set), 0 to carry on with the next batch. */
+static int
+chimera_io_uring_readdir_emit(
+    struct chimera_vfs_request          *request,
+    struct chimera_io_uring_readdir_ctx *ctx)
+{
+    struct chimera_linux_readdir_cursor *cursor = ctx->cursor;
+    struct chimera_vfs_attrs             vattr;
+    struct dirent64                     *de;
+    int                                  i, rc;
+    int                                  dirfd = (int) request->readdir.handle->vfs_private;
+
+    if (cursor->batch_count == 0) {
+        request->status = cursor->error ?
+            chimera_linux_errno_to_status(cursor->error) : CHIMERA_VFS_OK;
+        request->readdir.r_cookie = cursor->cookie;
+        request->readdir.r_eof    = 1;
+        return 1;
+    }
+
+    rc = chimera_setup_credential(request->cred, NULL);
+    if (rc != 0) {
+        request->status = chimera_linux_errno_to_status(rc);
+        return 1;
     }
 
     vattr.va_req_mask = request->readdir.attr_mask;
-    while ((dirent = readdir(dir))) {
 
-        /* Skip . and .. unless explicitly requested */
-        if (!(request->readdir.flags & CHIMERA_VFS_READDIR_EMIT_DOT)) {
-            if ((dirent->d_name[0] == '.' && dirent->d_name[1] == '\0') ||
-                (dirent->d_name[0] == '.' && dirent->d_name[1] == '.' &&
-                 dirent->d_name[2] == '\0')) {
-                continue;
-            }
+    for (i = 0; i < cursor->batch_count; i++) {
+        de = cursor->batch[i];
+
+        if (!(request->readdir.flags & CHIMERA_VFS_READDIR_EMIT_DOT) &&
+            chimera_linux_readdir_is_dot(de->d_name)) {
+            chimera_linux_readdir_cursor_advance(cursor, de);
+            continue;
         }
 
-        chimera_linux_map_child_attrs(CHIMERA_VFS_FH_MAGIC_IO_URING,
-                                      request,
-                                      &vattr,
-                                      fd,
-                                      dirent->d_name);
+        vattr.va_set_mask = 0;
+
+        if (ctx->sync_attrs) {
+            chimera_linux_map_child_attrs(CHIMERA_VFS_FH_MAGIC_IO_URING,
+                                          request,
+                                          &vattr,
+                                          dirfd,
+                                          de->d_name);
+        } else if (cursor->batch_stx[i].stx_mask) {
+            chimera_linux_map_child_attrs_statx(CHIMERA_VFS_FH_MAGIC_IO_URING,
+                                                request,
+                                                &vattr,
+                                                dirfd,
+                                                de->d_name,
+                                                &cursor->batch_stx[i]);
+        }
 
         rc = request->readdir.callback(
-            dirent->d_ino,
-            dirent->d_off,
-            dirent->d_name,
-            strlen(dirent->d_name),
+            de->d_ino,
+            de->d_off,
+            de->d_name,
+            strlen(de->d_name),
             &vattr,
             request->proto_private_data);
 
         if (rc) {
-            eof = 0;
-            break;
+            chimera_restore_privilege(request->cred);
+            request->status           = CHIMERA_VFS_OK;
+            request->readdir.r_cookie = cursor->cookie;
+            request->readdir.r_eof    = 0;
+            return 1;
         }
 
+        chimera_linux_readdir_cursor_advance(cursor, de);
     }
 
-    request->readdir.r_cookie = telldir(dir);
-    request->readdir.r_eof    = eof;
-
-    closedir(dir);
     chimera_restore_privilege(request->cred);
 
-    request->status = CHIMERA_VFS_OK;
+    return 0;
+} /* chimera_io_uring_readdir_emit */
+
+/* Emit the batch whose statx calls have all completed (if any), then either
+ * queue the next batch or complete the READDIR. */
+static void
+chimera_io_uring_readdir_continue(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request)
+{
+    struct chimera_io_uring_readdir_ctx *ctx = request->plugin_data;
+
+    while (!chimera_io_uring_readdir_emit(request, ctx)) {
+        if (chimera_io_uring_readdir_submit(thread, request, ctx)) {
+            evpl_defer(thread->evpl, &thread->deferral);
+            return;
+        }
+    }
+
+    chimera_linux_readdir_cursor_put(ctx->cursor);
+
+    thread->inflight--;
     request->complete(request);
-} /* io_uring_readdir */ /* io_uring_readdir */
+} /* chimera_io_uring_readdir_continue */
+
+static void
+chimera_io_uring_readdir(
+    struct chimera_vfs_request *request,
+    void                       *private_data)
+{
+    struct chimera_io_uring_thread      *thread = private_data;
+    struct chimera_linux_readdir_cursor *cursor;
+    struct chimera_io_uring_readdir_ctx *ctx;
+    int                                  fd, rc;
+
+    fd = request->readdir.handle->vfs_private;
+
+    rc = chimera_setup_credential(request->cred, NULL);
+    if (rc != 0) {
+        --thread->inflight;
+        request->status = chimera_linux_errno_to_status(rc);
+        request->complete(request);
+        return;
+    }
+
+    if (thread->readdir_verifier) {
+        struct stat st;
+
+        rc = fstat(fd, &st);
+
+        if (rc == 0) {
+            uint64_t mtime_verf = chimera_linux_mtime_to_verifier(&st);
+
+            if (request->readdir.verifier &&
+                request->readdir.verifier != mtime_verf) {
+                chimera_restore_privilege(request->cred);
+                --thread->inflight;
+                request->status = CHIMERA_VFS_EBADCOOKIE;
+                request->complete(request);
+                return;
+            }
+
+            request->readdir.r_verifier = mtime_verf;
+        }
+    }
+
+    cursor = chimera_linux_readdir_cursor_get(&thread->readdir_cache,
+                                              request->readdir.handle->fh,
+                                              request->readdir.handle->fh_len,
+                                              chimera_vfs_cred_hash(request->cred),
+                                              request->readdir.cookie,
+                                              fd);
+
+    if (!cursor) {
+        chimera_io_uring_error("io_uring_readdir: cursor open failed: %s",
+                               strerror(errno));
+        chimera_restore_privilege(request->cred);
+        --thread->inflight;
+        request->status = chimera_linux_errno_to_status(errno);
+        request->complete(request);
+        return;
+    }
+
+    if (!(request->readdir.attr_mask & CHIMERA_IO_URING_READDIR_STATX_ATTRS)) {
+        /* Nothing worth batching, e.g. a names-only listing */
+        request->status = chimera_linux_readdir_run(CHIMERA_VFS_FH_MAGIC_IO_URING,
+                                                    request,
+                                                    cursor,
+                                                    fd);
+
+        chimera_linux_readdir_cursor_put(cursor);
+        chimera_restore_privilege(request->cred);
+
+        --thread->inflight;
+        request->complete(request);
+        return;
+    }
+
+    chimera_restore_privilege(request->cred);
+
+    ctx             = request->plugin_data;
+    ctx->cursor     = cursor;
+    ctx->sync_attrs = 0;
+
+    if (chimera_io_uring_readdir_submit(thread, request, ctx)) {
+        evpl_defer(thread->evpl, &thread->deferral);
+        return;
+    }
+
+    chimera_io_uring_readdir_continue(thread, request);
+} /* io_uring_readdir */
 
 static void
 chimera_io_uring_open_fh(
@@ -1376,6 +2045,8 @@ chimera_io_uring_open_fh(
         return;
     }
 
+    chimera_io_uring_dio_enable(thread, fd, request->open_fh.flags);
+
     request->open_fh.r_vfs_private = fd;
 
     request->status = CHIMERA_VFS_OK;
@@ -1521,6 +2192,20 @@ chimera_io_uring_close(
     struct io_uring_sqe            *sqe;
     int                             fd = request->close.vfs_private;
 
+    if (chimera_io_uring_dio_fd(thread->shared, fd)) {
+        chimera_io_uring_dio_fd_set(thread->shared, fd, NULL);
+    }
+
+    if (thread->shared->fixed_files && fd >= 0 && fd < CHIMERA_IO_URING_FIXED_FILES) {
+        /* Invalidate every thread's registered copy; ours goes right away */
+        __atomic_add_fetch(&thread->shared->fd_gen[fd], 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&thread->shared->close_epoch, 1, __ATOMIC_RELEASE);
+
+        if (thread->fixed_files) {
+            chimera_io_uring_fixed_sweep(thread);
+        }
+    }
+
     sqe = chimera_io_uring_get_sqe(thread, request, 0, 0);
 
     io_uring_prep_close(sqe, fd);
@@ -1729,6 +2414,88 @@ chimera_io_uring_remove_at(
     request->complete(request);
 } /* chimera_io_uring_remove_at */ /* chimera_io_uring_remove_at */
 
+/* Build the readv vector for a direct read of the whole aligned range the
+ * VFS core allocated buffers for, falling back to a single aligned bounce
+ * buffer if any segment is not aligned.  Returns the vector length. */
+static int
+chimera_io_uring_read_direct_iov(
+    struct chimera_vfs_request  *request,
+    struct chimera_io_uring_dio *dio,
+    struct iovec                *iov)
+{
+    uint32_t left, length;
+    int      i, rc, aligned = 1;
+
+    length = (request->read.aligned_prefix + request->read.length +
+              CHIMERA_IO_URING_DIO_ALIGN - 1) & ~(CHIMERA_IO_URING_DIO_ALIGN - 1);
+
+    left = length;
+
+    for (i = 0; left && i < request->read.buffers_provided; i++) {
+        iov[i].iov_base = request->read.iov[i].data;
+        iov[i].iov_len  = request->read.iov[i].length;
+
+        if (iov[i].iov_len > left) {
+            iov[i].iov_len = left;
+        }
+
+        if (((uintptr_t) iov[i].iov_base | iov[i].iov_len) &
+            (CHIMERA_IO_URING_DIO_ALIGN - 1)) {
+            aligned = 0;
+        }
+
+        left -= iov[i].iov_len;
+    }
+
+    if (aligned && left == 0) {
+        return i;
+    }
+
+    rc = posix_memalign(&dio->bounce, CHIMERA_IO_URING_DIO_ALIGN, length);
+
+    chimera_io_uring_abort_if(rc, "Failed to allocate direct read bounce buffer");
+
+    dio->bounce_len = length;
+
+    iov[0].iov_base = dio->bounce;
+    iov[0].iov_len  = length;
+
+    return 1;
+} /* chimera_io_uring_read_direct_iov */
+
+/* Complete a direct read of res bytes from the aligned start of the range. */
+static void
+chimera_io_uring_read_direct_done(
+    struct chimera_vfs_request  *request,
+    struct chimera_io_uring_dio *dio,
+    uint32_t                     res)
+{
+    uint32_t prefix = request->read.aligned_prefix;
+    uint32_t copied = 0, chunk;
+    int      i;
+
+    if (dio->bounce) {
+        for (i = 0; copied < res && i < request->read.buffers_provided; i++) {
+            chunk = request->read.iov[i].length;
+
+            if (chunk > res - copied) {
+                chunk = res - copied;
+            }
+
+            memcpy(request->read.iov[i].data, (char *) dio->bounce + copied, chunk);
+            copied += chunk;
+        }
+    }
+
+    request->read.r_length = res > prefix ? res - prefix : 0;
+
+    if (request->read.r_length > request->read.length) {
+        request->read.r_length = request->read.length;
+    }
+
+    request->read.r_eof = (request->read.r_length < request->read.length);
+} /* chimera_io_uring_read_direct_done */
+
 static void
 chimera_io_uring_read(
     struct chimera_vfs_request *request,
@@ -1740,6 +2507,7 @@ chimera_io_uring_read(
     ssize_t                         left = request->read.length;
     struct iovec                   *iov;
     struct statx                   *stx;
+    struct chimera_io_uring_dio    *dio;
     void                           *scratch = request->plugin_data;
 
     /* Handle 0-byte reads specially - readv with uninitialized iov causes EFAULT */
@@ -1779,8 +2547,31 @@ chimera_io_uring_read(
     stx      = (struct statx *) scratch;
     scratch += sizeof(*stx);
 
+    dio      = (struct chimera_io_uring_dio *) scratch;
+    scratch += sizeof(*dio);
+
+    dio->bounce = NULL;
+    dio->direct = thread->shared->direct_io;
+
     iov = (struct iovec *) scratch;
 
+    fd = (int) request->read.handle->vfs_private;
+
+    if (dio->direct) {
+        i = chimera_io_uring_read_direct_iov(request, dio, iov);
+
+        io_uring_prep_readv(sqe, fd, iov, i,
+                            request->read.offset - request->read.aligned_prefix);
+        chimera_io_uring_sqe_set_file(thread, sqe, fd);
+
+        sqe = chimera_io_uring_get_sqe(thread, request, 1, 0);
+        io_uring_prep_statx(sqe, fd, "", AT_EMPTY_PATH | AT_STATX_SYNC_AS_STAT,
+                            CHIMERA_IO_URING_STATX_MASK, stx);
+
+        evpl_defer(thread->evpl, &thread->deferral);
+        return;
+    }
+
     for (i = 0; left && i < request->read.buffers_provided; i++) {
 
         iov[i].iov_base = request->read.iov[i].data;
@@ -1798,9 +2589,8 @@ chimera_io_uring_read(
         left -= iov[i].iov_len;
     }
 
-    fd = (int) request->read.handle->vfs_private;
-
     io_uring_prep_readv(sqe, fd, iov, i, request->read.offset);
+    chimera_io_uring_sqe_set_file(thread, sqe, fd);
 
     sqe = chimera_io_uring_get_sqe(thread, request, 1, 0);
     io_uring_prep_statx(sqe, fd, "", AT_EMPTY_PATH | AT_STATX_SYNC_AS_STAT,
@@ -1809,6 +2599,330 @@ chimera_io_uring_read(
     evpl_defer(thread->evpl, &thread->deferral);
 } /* chimera_io_uring_read */
 
+/*
+ * Admit a direct write to its file, or queue it behind the writes already
+ * waiting there.  Returns 1 if the write may start now.
+ */
+static int
+chimera_io_uring_dio_admit(
+    struct chimera_io_uring_dio_file *file,
+    struct chimera_vfs_request       *request,
+    int                               rmw)
+{
+    int admitted = 0;
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->waiters && !file->rmw && (!rmw || file->writers == 0)) {
+        if (rmw) {
+            file->rmw = 1;
+        } else {
+            file->writers++;
+        }
+        admitted = 1;
+    } else {
+        DL_APPEND(file->waiters, request);
+    }
+
+    pthread_mutex_unlock(&file->lock);
+
+    return admitted;
+} /* chimera_io_uring_dio_admit */
+
+/*
+ * Release a finished direct write and start the queued writes that can now
+ * run, each on the ring of the thread that dispatched it.
+ */
+static void
+chimera_io_uring_dio_release(
+    struct chimera_io_uring_thread   *thread,
+    struct chimera_io_uring_dio_file *file,
+    int                               rmw)
+{
+    struct chimera_vfs_request     *request, *ready = NULL;
+    struct chimera_io_uring_dio    *dio;
+    struct chimera_io_uring_thread *owner;
+
+    pthread_mutex_lock(&file->lock);
+
+    if (rmw) {
+        file->rmw = 0;
+    } else {
+        file->writers--;
+    }
+
+    while ((request = file->waiters)) {
+        dio = (struct chimera_io_uring_dio *) request->plugin_data;
+
+        if (file->rmw || (dio->rmw && file->writers)) {
+            break;
+        }
+
+        DL_DELETE(file->waiters, request);
+
+        if (dio->rmw) {
+            file->rmw = 1;
+        } else {
+            file->writers++;
+        }
+
+        DL_APPEND(ready, request);
+    }
+
+    pthread_mutex_unlock(&file->lock);
+
+    while ((request = ready)) {
+        DL_DELETE(ready, request);
+
+        dio   = (struct chimera_io_uring_dio *) request->plugin_data;
+        owner = dio->thread;
+
+        if (owner == thread) {
+            chimera_io_uring_write_dio_start(thread, request);
+        } else {
+            pthread_mutex_lock(&owner->dio_ready_lock);
+            DL_APPEND(owner->dio_ready, request);
+            pthread_mutex_unlock(&owner->dio_ready_lock);
+
+            evpl_ring_doorbell(&owner->doorbell);
+        }
+    }
+} /* chimera_io_uring_dio_release */
+
+/* Start the direct writes other threads released to this one. */
+static void
+chimera_io_uring_dio_ready(struct chimera_io_uring_thread *thread)
+{
+    struct chimera_vfs_request *request, *ready;
+
+    if (!__atomic_load_n(&thread->dio_ready, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    pthread_mutex_lock(&thread->dio_ready_lock);
+    ready             = thread->dio_ready;
+    thread->dio_ready = NULL;
+    pthread_mutex_unlock(&thread->dio_ready_lock);
+
+    while ((request = ready)) {
+        DL_DELETE(ready, request);
+        chimera_io_uring_write_dio_start(thread, request);
+    }
+} /* chimera_io_uring_dio_ready */
+
+/*
+ * First half of a direct write with an unaligned head or tail: read the
+ * partial edge blocks into an aligned buffer covering the whole range, and
+ * stat the file for the size the write-back may have to trim to.  The merge
+ * has to happen between the read and the write, so the write-back is a second
+ * submission from chimera_io_uring_write_dio_continue.
+ */
+static void
+chimera_io_uring_write_rmw(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request,
+    struct chimera_io_uring_dio    *dio)
+{
+    int                  fd     = (int) request->write.handle->vfs_private;
+    uint64_t             offset = request->write.offset;
+    uint64_t             end    = offset + request->write.length;
+    uint64_t             astart = offset & ~(uint64_t) (CHIMERA_IO_URING_DIO_ALIGN - 1);
+    uint64_t             aend   = (end + CHIMERA_IO_URING_DIO_ALIGN - 1) &
+        ~(uint64_t) (CHIMERA_IO_URING_DIO_ALIGN - 1);
+    struct io_uring_sqe *sqe;
+    int                  rc;
+
+    dio->bounce_len = aend - astart;
+    dio->stage      = CHIMERA_IO_URING_DIO_RMW_READ;
+    dio->err        = 0;
+    dio->head_res   = 0;
+    dio->tail_res   = 0;
+
+    rc = posix_memalign(&dio->bounce, CHIMERA_IO_URING_DIO_ALIGN, dio->bounce_len);
+
+    chimera_io_uring_abort_if(rc, "Failed to allocate direct write bounce buffer");
+
+    if (offset != astart) {
+        sqe = chimera_io_uring_get_sqe(thread, request, 0, 0);
+        io_uring_prep_read(sqe, fd, dio->bounce, CHIMERA_IO_URING_DIO_ALIGN, astart);
+        chimera_io_uring_sqe_set_file(thread, sqe, fd);
+    }
+
+    /* The tail block, unless the head read above already covers it */
+    if (end != aend && !(offset != astart && dio->bounce_len == CHIMERA_IO_URING_DIO_ALIGN)) {
+        sqe = chimera_io_uring_get_sqe(thread, request, 1, 0);
+        io_uring_prep_read(sqe, fd,
+                           (char *) dio->bounce + dio->bounce_len - CHIMERA_IO_URING_DIO_ALIGN,
+                           CHIMERA_IO_URING_DIO_ALIGN, aend - CHIMERA_IO_URING_DIO_ALIGN);
+        chimera_io_uring_sqe_set_file(thread, sqe, fd);
+    }
+
+    sqe = chimera_io_uring_get_sqe(thread, request, 2, 0);
+    io_uring_prep_statx(sqe, fd, "", AT_EMPTY_PATH | AT_STATX_SYNC_AS_STAT,
+                        STATX_SIZE, &dio->stx);
+
+    evpl_defer(thread->evpl, &thread->deferral);
+} /* chimera_io_uring_write_rmw */
+
+/*
+ * Second half of a read-modify-write: merge the new data over the edge blocks
+ * and write the aligned range back, linked to the trim of any extension past
+ * the end of the data and to the fsync of a stable write.  The file is held
+ * exclusively, so the size read in the first half is still current.
+ */
+static void
+chimera_io_uring_write_rmw_flush(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request,
+    struct chimera_io_uring_dio    *dio)
+{
+    int                  fd     = (int) request->write.handle->vfs_private;
+    uint64_t             offset = request->write.offset;
+    uint64_t             end    = offset + request->write.length;
+    uint64_t             astart = offset & ~(uint64_t) (CHIMERA_IO_URING_DIO_ALIGN - 1);
+    uint64_t             aend   = astart + dio->bounce_len;
+    uint64_t             size   = dio->stx.stx_size;
+    struct iovec        *iov    = (struct iovec *) (dio + 1);
+    struct io_uring_sqe *sqe;
+    char                *pos;
+    int                  i, link_trim = 0, link_sync;
+
+    if (offset != astart) {
+        memset((char *) dio->bounce + dio->head_res, 0,
+               CHIMERA_IO_URING_DIO_ALIGN - dio->head_res);
+    }
+
+    if (end != aend && !(offset != astart && dio->bounce_len == CHIMERA_IO_URING_DIO_ALIGN)) {
+        memset((char *) dio->bounce + dio->bounce_len - CHIMERA_IO_URING_DIO_ALIGN + dio->tail_res,
+               0, CHIMERA_IO_URING_DIO_ALIGN - dio->tail_res);
+    }
+
+    pos = (char *) dio->bounce + (offset - astart);
+
+    for (i = 0; i < dio->niov; i++) {
+        memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+
+    dio->stage = CHIMERA_IO_URING_DIO_WRITE;
+    dio->trim  = (aend > size && end < aend) ? (end > size ? end : size) : 0;
+
+    #ifdef CHIMERA_HAVE_IO_URING_FTRUNCATE
+    link_trim = dio->trim != 0;
+    #endif /* ifdef CHIMERA_HAVE_IO_URING_FTRUNCATE */
+
+    /* Without the ftruncate op the trim, and so the fsync, follow the write
+     * from chimera_io_uring_write_dio_continue instead */
+    link_sync = request->write.sync && (!dio->trim || link_trim);
+
+    sqe = chimera_io_uring_get_sqe(thread, request, 0, 0);
+    io_uring_prep_write(sqe, fd, dio->bounce, dio->bounce_len, astart);
+
+    if (link_trim || link_sync) {
+        sqe->flags |= IOSQE_IO_LINK;
+    }
+
+    chimera_io_uring_sqe_set_file(thread, sqe, fd);
+
+    #ifdef CHIMERA_HAVE_IO_URING_FTRUNCATE
+    if (link_trim) {
+        sqe = chimera_io_uring_get_sqe(thread, request, 1, 0);
+        io_uring_prep_ftruncate(sqe, fd, dio->trim);
+
+        if (link_sync) {
+            sqe->flags |= IOSQE_IO_LINK;
+        }
+
+        chimera_io_uring_sqe_set_file(thread, sqe, fd);
+
+        dio->trim = 0;
+    }
+    #endif /* ifdef CHIMERA_HAVE_IO_URING_FTRUNCATE */
+
+    if (link_sync) {
+        sqe = chimera_io_uring_get_sqe(thread, request, 2, 0);
+        io_uring_prep_fsync(sqe, fd, IORING_FSYNC_DATASYNC);
+        chimera_io_uring_sqe_set_file(thread, sqe, fd);
+    }
+
+    evpl_defer(thread->evpl, &thread->deferral);
+} /* chimera_io_uring_write_rmw_flush */
+
+/* Submit a direct write admitted to its file. */
+static void
+chimera_io_uring_write_dio_start(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request)
+{
+    struct chimera_io_uring_dio *dio = (struct chimera_io_uring_dio *) request->plugin_data;
+    struct iovec                *iov = (struct iovec *) (dio + 1);
+    int                          fd  = (int) request->write.handle->vfs_private;
+    struct io_uring_sqe         *sqe;
+
+    if (dio->rmw) {
+        chimera_io_uring_write_rmw(thread, request, dio);
+        return;
+    }
+
+    sqe = chimera_io_uring_get_sqe(thread, request, 0, 0);
+
+    io_uring_prep_writev2(sqe, fd, iov, dio->niov, request->write.offset,
+                          request->write.sync ? RWF_SYNC : 0);
+    chimera_io_uring_sqe_set_file(thread, sqe, fd);
+
+    evpl_defer(thread->evpl, &thread->deferral);
+} /* chimera_io_uring_write_dio_start */
+
+/*
+ * Called when a direct write has no SQEs left in flight: move a
+ * read-modify-write on to its write-back, or finish the write, releasing the
+ * file to the writes queued behind it.
+ */
+static void
+chimera_io_uring_write_dio_continue(
+    struct chimera_io_uring_thread *thread,
+    struct chimera_vfs_request     *request)
+{
+    struct chimera_io_uring_dio *dio = (struct chimera_io_uring_dio *) request->plugin_data;
+    int                          fd  = (int) request->write.handle->vfs_private;
+    struct io_uring_sqe         *sqe;
+
+    if (dio->stage == CHIMERA_IO_URING_DIO_RMW_READ) {
+        if (!dio->err) {
+            chimera_io_uring_write_rmw_flush(thread, request, dio);
+            return;
+        }
+
+        request->status         = chimera_linux_errno_to_status(dio->err);
+        request->write.r_length = 0;
+    } else if (dio->trim) {
+        /* No ftruncate op: trim here, then sync the result if asked to */
+        if (request->status == CHIMERA_VFS_OK && ftruncate(fd, dio->trim) < 0) {
+            request->status         = chimera_linux_errno_to_status(errno);
+            request->write.r_length = 0;
+        }
+
+        dio->trim = 0;
+
+        if (request->status == CHIMERA_VFS_OK && request->write.sync) {
+            sqe = chimera_io_uring_get_sqe(thread, request, 2, 0);
+            io_uring_prep_fsync(sqe, fd, IORING_FSYNC_DATASYNC);
+            chimera_io_uring_sqe_set_file(thread, sqe, fd);
+
+            evpl_defer(thread->evpl, &thread->deferral);
+            return;
+        }
+    }
+
+    free(dio->bounce);
+    dio->bounce = NULL;
+
+    chimera_io_uring_dio_release(thread, dio->file, dio->rmw);
+
+    thread->inflight--;
+    request->complete(request);
+} /* chimera_io_uring_write_dio_continue */
+
 static void
 chimera_io_uring_write(
     struct chimera_vfs_request *request,
@@ -1816,17 +2930,26 @@ chimera_io_uring_write(
 {
     struct chimera_io_uring_thread *thread = private_data;
     struct io_uring_sqe            *sge;
-    int                             fd, i, niov = 0;
+    int                             fd, i, rc, niov = 0, aligned = 1;
     uint32_t                        left, chunk;
     struct iovec                   *iov;
+    struct chimera_io_uring_dio    *dio;
+    char                           *pos;
     int                             flags   = 0;
     void                           *scratch = request->plugin_data;
 
-    sge = chimera_io_uring_get_sqe(thread, request, 0, 0);
-
     request->write.r_sync = request->write.sync;
 
-    iov = (struct iovec *) scratch;
+    /* Don't return post-write stat info - the linked statx may see stale
+     * metadata before the write's effects are fully visible. Let the VFS
+     * make an explicit getattr call when needed. */
+    request->write.r_post_attr.va_set_mask = 0;
+
+    dio         = (struct chimera_io_uring_dio *) scratch;
+    dio->bounce = NULL;
+    dio->file   = NULL;
+
+    iov = (struct iovec *) (dio + 1);
 
     left = request->write.length;
     for (i = 0; left && i < request->write.niov; i++) {
@@ -1839,20 +2962,59 @@ chimera_io_uring_write(
         iov[i].iov_len  = chunk;
         left           -= chunk;
         niov++;
+
+        if (((uintptr_t) iov[i].iov_base | chunk) & (CHIMERA_IO_URING_DIO_ALIGN - 1)) {
+            aligned = 0;
+        }
     }
 
     fd = (int) request->write.handle->vfs_private;
 
+    if (request->write.length) {
+        dio->file = chimera_io_uring_dio_fd(thread->shared, fd);
+    }
+
+    if (dio->file) {
+        dio->thread = thread;
+        dio->stage  = CHIMERA_IO_URING_DIO_WRITE;
+        dio->trim   = 0;
+        dio->rmw    = ((request->write.offset | request->write.length) &
+                       (CHIMERA_IO_URING_DIO_ALIGN - 1)) != 0;
+
+        if (!dio->rmw && !aligned) {
+            rc = posix_memalign(&dio->bounce, CHIMERA_IO_URING_DIO_ALIGN,
+                                request->write.length);
+
+            chimera_io_uring_abort_if(rc, "Failed to allocate direct write bounce buffer");
+
+            pos = dio->bounce;
+
+            for (i = 0; i < niov; i++) {
+                memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+                pos += iov[i].iov_len;
+            }
+
+            iov[0].iov_base = dio->bounce;
+            iov[0].iov_len  = request->write.length;
+            niov            = 1;
+        }
+
+        dio->niov = niov;
+
+        if (chimera_io_uring_dio_admit(dio->file, request, dio->rmw)) {
+            chimera_io_uring_write_dio_start(thread, request);
+        }
+        return;
+    }
+
     if (request->write.sync) {
         flags = RWF_SYNC;
     }
 
-    io_uring_prep_writev2(sge, fd, iov, niov, request->write.offset, flags);
+    sge = chimera_io_uring_get_sqe(thread, request, 0, 0);
 
-    /* Don't return post-write stat info - the linked statx may see stale
-     * metadata before the write's effects are fully visible. Let the VFS
-     * make an explicit getattr call when needed. */
-    request->write.r_post_attr.va_set_mask = 0;
+    io_uring_prep_writev2(sge, fd, iov, niov, request->write.offset, flags);
+    chimera_io_uring_sqe_set_file(thread, sge, fd);
 
     evpl_defer(thread->evpl, &thread->deferral);
 
@@ -1871,6 +3033,7 @@ chimera_io_uring_commit(
     sge = chimera_io_uring_get_sqe(thread, request, 0, 0);
 
     io_uring_prep_fsync(sge, fd, 0);
+    chimera_io_uring_sqe_set_file(thread, sge, fd);
 
     evpl_defer(thread->evpl, &thread->deferral);
 
@@ -37,6 +37,7 @@
 
 #include "linux.h"
 #include "linux_common.h"
+#include "linux_readdir.h"
 #include "common/logging.h"
 #include "common/format.h"
 #include "common/misc.h"
@@ -47,9 +48,10 @@ struct chimera_linux_shared {
 };
 
 struct chimera_linux_thread {
-    struct evpl                     *evpl;
-    struct chimera_linux_mount_table mount_table;
-    int                              readdir_verifier;
+    struct evpl                       *evpl;
+    struct chimera_linux_mount_table   mount_table;
+    struct chimera_linux_readdir_cache readdir_cache;
+    int                                readdir_verifier;
 };
 
 static void *
@@ -106,6 +108,7 @@ chimera_linux_thread_destroy(void *private_data)
 {
     struct chimera_linux_thread *thread = private_data;
 
+    chimera_linux_readdir_cache_destroy(&thread->readdir_cache);
     linux_mount_table_destroy(&thread->mount_table);
 
     free(thread);
@@ -473,12 +476,9 @@ chimera_linux_readdir(
     struct chimera_vfs_request *request,
     void                       *private_data)
 {
-    struct chimera_linux_thread *thread = private_data;
-    int                          fd, dup_fd, rc;
-    DIR                         *dir;
-    struct dirent               *dirent;
-    struct chimera_vfs_attrs     vattr;
-    int                          eof = 1;
+    struct chimera_linux_thread         *thread = private_data;
+    struct chimera_linux_readdir_cursor *cursor;
+    int                                  fd, rc;
 
     fd = request->readdir.handle->vfs_private;
 
@@ -511,74 +511,30 @@ chimera_linux_readdir(
         }
     }
 
-    dup_fd = openat(fd, ".", O_RDONLY | O_DIRECTORY);
-
-    if (dup_fd < 0) {
-        chimera_linux_error("linux_readdir: openat() failed: %s",
-                            strerror(errno));
-        chimera_restore_privilege(request->cred);
-        request->status = chimera_linux_errno_to_status(errno);
-        request->complete(request);
-        return;
-    }
-
-    dir = fdopendir(dup_fd);
+    cursor = chimera_linux_readdir_cursor_get(&thread->readdir_cache,
+                                              request->readdir.handle->fh,
+                                              request->readdir.handle->fh_len,
+                                              chimera_vfs_cred_hash(request->cred),
+                                              request->readdir.cookie,
+                                              fd);
 
-    if (!dir) {
-        chimera_linux_error("linux_readdir: fdopendir() failed: %s",
+    if (!cursor) {
+        chimera_linux_error("linux_readdir: cursor open failed: %s",
                             strerror(errno));
-        close(dup_fd);
         chimera_restore_privilege(request->cred);
         request->status = chimera_linux_errno_to_status(errno);
         request->complete(request);
         return;
     }
 
-    if (request->readdir.cookie) {
-        seekdir(dir, request->readdir.cookie);
-    }
+    request->status = chimera_linux_readdir_run(CHIMERA_VFS_FH_MAGIC_LINUX,
+                                                request,
+                                                cursor,
+                                                fd);
 
-    vattr.va_req_mask = request->readdir.attr_mask;
-
-    while ((dirent = readdir(dir))) {
-
-        /* Skip . and .. unless explicitly requested */
-        if (!(request->readdir.flags & CHIMERA_VFS_READDIR_EMIT_DOT)) {
-            if ((dirent->d_name[0] == '.' && dirent->d_name[1] == '\0') ||
-                (dirent->d_name[0] == '.' && dirent->d_name[1] == '.' &&
-                 dirent->d_name[2] == '\0')) {
-                continue;
-            }
-        }
-
-        chimera_linux_map_child_attrs(CHIMERA_VFS_FH_MAGIC_LINUX,
-                                      request,
-                                      &vattr,
-                                      fd,
-                                      dirent->d_name);
-
-        rc = request->readdir.callback(
-            dirent->d_ino,
-            dirent->d_off,
-            dirent->d_name,
-            strlen(dirent->d_name),
-            &vattr,
-            request->proto_private_data);
-
-        if (rc) {
-            eof = 0;
-            break;
-        }
-
-    } /* chimera_linux_readdir */
-
-    request->readdir.r_cookie = telldir(dir);
-    request->readdir.r_eof    = eof;
-
-    closedir(dir);
+    chimera_linux_readdir_cursor_put(cursor);
     chimera_restore_privilege(request->cred);
 
-    request->status = CHIMERA_VFS_OK;
     request->complete(request);
 } /* linux_readdir */ /* linux_readdir */
 
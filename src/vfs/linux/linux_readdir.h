@@ -0,0 +1,341 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#pragma once
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "linux_common.h"
+
+/*
+ * Directory cursors shared by the linux and io_uring backends.
+ *
+ * A READDIR used to dup the directory fd, fdopendir() it, seekdir() to the
+ * cookie and throw all of that away again at the end of the page.  Instead
+ * each backend thread keeps a few cursors, each a private O_DIRECTORY fd plus
+ * the raw getdents64 buffer read from it, keyed by (directory fh, credential).
+ * The cookie a page ends on is the offset of the first entry the next page
+ * needs, so a client walking a large directory resumes from the buffered
+ * entries with no syscall at all; any other cookie costs one lseek.
+ *
+ * Buffered entries are only trusted for CHIMERA_LINUX_READDIR_TTL_NS after the
+ * cursor was last used, so a later listing sees the directory afresh.  The fd
+ * is opened under the caller's credentials, which is why the credential is part
+ * of the key.
+ */
+
+#define CHIMERA_LINUX_READDIR_CURSORS  8
+#define CHIMERA_LINUX_READDIR_BUF_SIZE (16 * 1024)
+#define CHIMERA_LINUX_READDIR_BATCH    32
+#define CHIMERA_LINUX_READDIR_TTL_NS   (1000ULL * 1000 * 1000)
+
+struct chimera_linux_readdir_cursor {
+    int              fd;        /* -1 while the slot is unused */
+    int              busy;      /* held by an in-progress READDIR */
+    int              transient; /* not in the cache, freed on put */
+    int              error;     /* errno from getdents64, sticky */
+    uint64_t         cred_hash;
+    uint64_t         cookie;    /* offset of the next unconsumed entry */
+    uint64_t         last_used;
+    uint32_t         buf_pos;
+    uint32_t         buf_len;
+    uint32_t         fh_len;
+    uint8_t          fh[CHIMERA_VFS_FH_SIZE];
+    /* Entries gathered by chimera_linux_readdir_cursor_gather (pointers into
+     * buf) and the statx results io_uring fills in for them. */
+    int              batch_count;
+    struct dirent64 *batch[CHIMERA_LINUX_READDIR_BATCH];
+    struct statx     batch_stx[CHIMERA_LINUX_READDIR_BATCH];
+    char             buf[CHIMERA_LINUX_READDIR_BUF_SIZE] __attribute__((aligned(8)));
+};
+
+struct chimera_linux_readdir_cache {
+    struct chimera_linux_readdir_cursor *cursors[CHIMERA_LINUX_READDIR_CURSORS];
+};
+
+static inline uint64_t
+chimera_linux_readdir_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+} /* chimera_linux_readdir_now */
+
+static inline int
+chimera_linux_readdir_is_dot(const char *name)
+{
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+} /* chimera_linux_readdir_is_dot */
+
+static inline void
+chimera_linux_readdir_cursor_close(struct chimera_linux_readdir_cursor *cursor)
+{
+    if (cursor->fd >= 0) {
+        close(cursor->fd);
+    }
+    cursor->fd     = -1;
+    cursor->fh_len = 0;
+} /* chimera_linux_readdir_cursor_close */
+
+/* Position the cursor at cookie, discarding anything buffered. */
+static inline int
+chimera_linux_readdir_cursor_seek(
+    struct chimera_linux_readdir_cursor *cursor,
+    uint64_t                             cookie)
+{
+    if (lseek(cursor->fd, (off_t) cookie, SEEK_SET) < 0) {
+        return -1;
+    }
+
+    cursor->cookie  = cookie;
+    cursor->buf_pos = 0;
+    cursor->buf_len = 0;
+    cursor->error   = 0;
+
+    return 0;
+} /* chimera_linux_readdir_cursor_seek */
+
+/*
+ * Get a cursor on the directory open as dirfd, positioned at cookie, for the
+ * calling credential.  Must be called under that credential.  Returns NULL
+ * with errno set if the directory could not be opened.
+ */
+static inline struct chimera_linux_readdir_cursor *
+chimera_linux_readdir_cursor_get(
+    struct chimera_linux_readdir_cache *cache,
+    const uint8_t                      *fh,
+    uint32_t                            fh_len,
+    uint64_t                            cred_hash,
+    uint64_t                            cookie,
+    int                                 dirfd)
+{
+    struct chimera_linux_readdir_cursor *cursor, *victim = NULL;
+    uint64_t                             now = chimera_linux_readdir_now();
+    int                                  i, err, empty = -1;
+
+    for (i = 0; i < CHIMERA_LINUX_READDIR_CURSORS; i++) {
+        cursor = cache->cursors[i];
+
+        if (!cursor) {
+            if (empty < 0) {
+                empty = i;
+            }
+            continue;
+        }
+
+        if (cursor->busy) {
+            continue;
+        }
+
+        if (cursor->fd >= 0 && cursor->fh_len == fh_len &&
+            cursor->cred_hash == cred_hash &&
+            memcmp(cursor->fh, fh, fh_len) == 0) {
+
+            if (cursor->cookie != cookie ||
+                now - cursor->last_used >= CHIMERA_LINUX_READDIR_TTL_NS) {
+                if (chimera_linux_readdir_cursor_seek(cursor, cookie) < 0) {
+                    chimera_linux_readdir_cursor_close(cursor);
+                    return NULL;
+                }
+            }
+
+            cursor->busy = 1;
+            return cursor;
+        }
+
+        if (!victim || cursor->last_used < victim->last_used) {
+            victim = cursor;
+        }
+    }
+
+    if (empty >= 0) {
+        cursor     = calloc(1, sizeof(*cursor));
+        cursor->fd = -1;
+
+        cache->cursors[empty] = cursor;
+    } else if (victim) {
+        cursor = victim;
+        chimera_linux_readdir_cursor_close(cursor);
+    } else {
+        /* Every cursor is mid-READDIR; use a throwaway one */
+        cursor            = calloc(1, sizeof(*cursor));
+        cursor->transient = 1;
+    }
+
+    cursor->fd = openat(dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (cursor->fd < 0 || chimera_linux_readdir_cursor_seek(cursor, cookie) < 0) {
+        err = errno;
+        chimera_linux_readdir_cursor_close(cursor);
+        if (cursor->transient) {
+            free(cursor);
+        }
+        errno = err;
+        return NULL;
+    }
+
+    cursor->cred_hash = cred_hash;
+    cursor->fh_len    = fh_len;
+    cursor->busy      = 1;
+    memcpy(cursor->fh, fh, fh_len);
+
+    return cursor;
+} /* chimera_linux_readdir_cursor_get */
+
+static inline void
+chimera_linux_readdir_cursor_put(struct chimera_linux_readdir_cursor *cursor)
+{
+    cursor->busy      = 0;
+    cursor->last_used = chimera_linux_readdir_now();
+
+    if (cursor->error || cursor->transient) {
+        chimera_linux_readdir_cursor_close(cursor);
+    }
+
+    if (cursor->transient) {
+        free(cursor);
+    }
+} /* chimera_linux_readdir_cursor_put */
+
+static inline void
+chimera_linux_readdir_cache_destroy(struct chimera_linux_readdir_cache *cache)
+{
+    int i;
+
+    for (i = 0; i < CHIMERA_LINUX_READDIR_CURSORS; i++) {
+        if (cache->cursors[i]) {
+            chimera_linux_readdir_cursor_close(cache->cursors[i]);
+            free(cache->cursors[i]);
+            cache->cursors[i] = NULL;
+        }
+    }
+} /* chimera_linux_readdir_cache_destroy */
+
+/* Refill the buffer once it has been consumed.  Returns 0 at end of directory
+ * or on error (cursor->error). */
+static inline int
+chimera_linux_readdir_cursor_fill(struct chimera_linux_readdir_cursor *cursor)
+{
+    ssize_t rc;
+
+    rc = getdents64(cursor->fd, cursor->buf, sizeof(cursor->buf));
+
+    if (rc < 0) {
+        cursor->error = errno;
+        rc            = 0;
+    }
+
+    cursor->buf_pos = 0;
+    cursor->buf_len = rc;
+
+    return rc > 0;
+} /* chimera_linux_readdir_cursor_fill */
+
+/* The next unconsumed entry, or NULL at end of directory (or on error). */
+static inline struct dirent64 *
+chimera_linux_readdir_cursor_peek(struct chimera_linux_readdir_cursor *cursor)
+{
+    if (cursor->buf_pos >= cursor->buf_len &&
+        !chimera_linux_readdir_cursor_fill(cursor)) {
+        return NULL;
+    }
+
+    return (struct dirent64 *) (cursor->buf + cursor->buf_pos);
+} /* chimera_linux_readdir_cursor_peek */
+
+/* Consume de, which must be the entry peek just returned. */
+static inline void
+chimera_linux_readdir_cursor_advance(
+    struct chimera_linux_readdir_cursor *cursor,
+    const struct dirent64               *de)
+{
+    cursor->buf_pos += de->d_reclen;
+    cursor->cookie   = de->d_off;
+} /* chimera_linux_readdir_cursor_advance */
+
+/*
+ * Collect up to CHIMERA_LINUX_READDIR_BATCH unconsumed entries into
+ * cursor->batch without consuming them.  The batch never spans a refill, so
+ * its pointers stay valid until the entries are consumed.  Returns the number
+ * gathered, 0 at end of directory (or on error).
+ */
+static inline int
+chimera_linux_readdir_cursor_gather(struct chimera_linux_readdir_cursor *cursor)
+{
+    struct dirent64 *de;
+    uint32_t         pos;
+
+    cursor->batch_count = 0;
+
+    if (cursor->buf_pos >= cursor->buf_len &&
+        !chimera_linux_readdir_cursor_fill(cursor)) {
+        return 0;
+    }
+
+    for (pos = cursor->buf_pos;
+         pos < cursor->buf_len && cursor->batch_count < CHIMERA_LINUX_READDIR_BATCH;
+         pos += de->d_reclen) {
+        de                                   = (struct dirent64 *) (cursor->buf + pos);
+        cursor->batch[cursor->batch_count++] = de;
+    }
+
+    return cursor->batch_count;
+} /* chimera_linux_readdir_cursor_gather */
+
+/*
+ * Synchronous READDIR over a cursor: emit entries with attributes read one by
+ * one from dirfd until the callback is full or the directory ends.  A page that
+ * stops on a full callback ends on the cookie of the last entry accepted, so
+ * the rejected entry leads the next page.
+ */
+static inline enum chimera_vfs_error
+chimera_linux_readdir_run(
+    uint8_t                              fh_magic,
+    struct chimera_vfs_request          *request,
+    struct chimera_linux_readdir_cursor *cursor,
+    int                                  dirfd)
+{
+    struct dirent64         *de;
+    struct chimera_vfs_attrs vattr;
+    int                      rc, eof = 1;
+
+    vattr.va_req_mask = request->readdir.attr_mask;
+
+    while ((de = chimera_linux_readdir_cursor_peek(cursor))) {
+
+        if (!(request->readdir.flags & CHIMERA_VFS_READDIR_EMIT_DOT) &&
+            chimera_linux_readdir_is_dot(de->d_name)) {
+            chimera_linux_readdir_cursor_advance(cursor, de);
+            continue;
+        }
+
+        chimera_linux_map_child_attrs(fh_magic, request, &vattr, dirfd, de->d_name);
+
+        rc = request->readdir.callback(
+            de->d_ino,
+            de->d_off,
+            de->d_name,
+            strlen(de->d_name),
+            &vattr,
+            request->proto_private_data);
+
+        if (rc) {
+            eof = 0;
+            break;
+        }
+
+        chimera_linux_readdir_cursor_advance(cursor, de);
+    }
+
+    request->readdir.r_cookie = cursor->cookie;
+    request->readdir.r_eof    = eof;
+
+    return cursor->error ? chimera_linux_errno_to_status(cursor->error) : CHIMERA_VFS_OK;
+} /* chimera_linux_readdir_run */
@@ -48,6 +48,13 @@
  * Always a power-of-two divisor of every supported block size (>= 4 KiB). */
 #define CHIMERA_MEMFS_CLONE_ALIGN        (4 * 1024)
 
+/* Fork block map radix tree: 64-way nodes, enough levels for any 64-bit
+ * block index. */
+#define CHIMERA_MEMFS_BMAP_SHIFT         6
+#define CHIMERA_MEMFS_BMAP_FANOUT        (1 << CHIMERA_MEMFS_BMAP_SHIFT)
+#define CHIMERA_MEMFS_BMAP_MASK          (CHIMERA_MEMFS_BMAP_FANOUT - 1)
+#define CHIMERA_MEMFS_BMAP_MAX_HEIGHT    11
+
 #define CHIMERA_MEMFS_INODE_LIST_SHIFT   8
 #define CHIMERA_MEMFS_INODE_NUM_LISTS    (1 << CHIMERA_MEMFS_INODE_LIST_SHIFT)
 #define CHIMERA_MEMFS_INODE_LIST_MASK    (CHIMERA_MEMFS_INODE_NUM_LISTS - 1)
@@ -92,15 +99,22 @@ struct memfs_block {
     struct evpl_iovec    iov[CHIMERA_MEMFS_BLOCK_MAX_IOV];
 };
 
-/* A regular file's data fork: a sparse array of fixed-size blocks.  The inode's
- * default (unnamed) data fork lives in the inode union as `file`; each named
- * stream carries its own fork.  Note the default fork's logical size lives in
+/* Interior or leaf node of a fork's block map (see memfs_bmap_capacity).  Slots
+ * of a level-0 node point at blocks, slots of higher levels at child nodes. */
+struct memfs_bmap_node {
+    uint64_t nblocks;   /* data blocks anywhere beneath this node */
+    void    *slot[CHIMERA_MEMFS_BMAP_FANOUT];
+};
+
+/* A regular file's data fork: a sparse set of fixed-size blocks held in a
+ * radix tree of `height` levels (0 = no blocks).  The inode's default
+ * (unnamed) data fork lives in the inode union as `file`; each named stream
+ * carries its own fork.  Note the default fork's logical size lives in
  * inode->size / inode->space_used (shared with the stat path), whereas a named
  * stream keeps its own size/space_used (see struct memfs_named_stream). */
 struct memfs_fork {
-    struct memfs_block **blocks;
-    unsigned int         num_blocks;
-    unsigned int         max_blocks;
+    struct memfs_bmap_node *root;
+    uint32_t                height;
 };
 
 struct memfs_dirent {
@@ -624,6 +638,371 @@ memfs_block_free(
     memfs_block_free_charged(thread, fs, block, 1);
 } /* memfs_block_free */
 
+/* Fork block map: a radix tree keyed by block index.  Each level consumes
+ * CHIMERA_MEMFS_BMAP_SHIFT bits of the index; level-0 nodes hold block
+ * pointers, higher levels hold child nodes.  The tree is only as tall as the
+ * highest stored index requires, so a write at a large sparse offset costs a
+ * handful of small nodes rather than a pointer for every block below it.
+ * Every node carries the number of data blocks beneath it, which lets the hole
+ * and data scans skip empty and fully-populated subtrees without descending.
+ * Empty nodes are never left in the tree: removing the last block under a node
+ * frees it, and the root collapses as the file shrinks.  All access is under
+ * the inode lock. */
+static inline uint64_t
+memfs_bmap_capacity(uint32_t height)
+{
+    if (height == 0) {
+        return 0;
+    }
+
+    if (height * CHIMERA_MEMFS_BMAP_SHIFT >= 64) {
+        return UINT64_MAX;
+    }
+
+    return 1ULL << (height * CHIMERA_MEMFS_BMAP_SHIFT);
+} /* memfs_bmap_capacity */
+
+static inline uint32_t
+memfs_bmap_slot(
+    uint64_t bi,
+    uint32_t level)
+{
+    return (bi >> (level * CHIMERA_MEMFS_BMAP_SHIFT)) & CHIMERA_MEMFS_BMAP_MASK;
+} /* memfs_bmap_slot */
+
+static inline uint64_t
+memfs_bmap_count(const struct memfs_fork *fork)
+{
+    return fork->root ? fork->root->nblocks : 0;
+} /* memfs_bmap_count */
+
+static inline struct memfs_block *
+memfs_bmap_lookup(
+    const struct memfs_fork *fork,
+    uint64_t                 bi)
+{
+    struct memfs_bmap_node *node = fork->root;
+    uint32_t                level;
+
+    if (!node || bi >= memfs_bmap_capacity(fork->height)) {
+        return NULL;
+    }
+
+    for (level = fork->height - 1; level > 0; level--) {
+        node = node->slot[memfs_bmap_slot(bi, level)];
+
+        if (!node) {
+            return NULL;
+        }
+    }
+
+    return node->slot[memfs_bmap_slot(bi, 0)];
+} /* memfs_bmap_lookup */
+
+/* Free the now-empty nodes at the bottom of a root-to-leaf path (path[0] is
+ * the root), then collapse the root while it only has a child in slot 0. */
+static void
+memfs_bmap_prune(
+    struct memfs_fork       *fork,
+    struct memfs_bmap_node **path,
+    uint32_t                 depth,
+    uint64_t                 bi)
+{
+    struct memfs_bmap_node *root, *child;
+    uint32_t                i;
+
+    for (i = depth; i > 1 && path[i - 1]->nblocks == 0; i--) {
+        path[i - 2]->slot[memfs_bmap_slot(bi, fork->height - i + 1)] = NULL;
+        free(path[i - 1]);
+    }
+
+    root = fork->root;
+
+    if (root->nblocks == 0) {
+        free(root);
+        fork->root   = NULL;
+        fork->height = 0;
+        return;
+    }
+
+    /* A non-empty child in slot 0 holding every block of the root means all
+     * other slots are empty (empty nodes are never kept), so the root level
+     * can be dropped. */
+    while (fork->height > 1) {
+        root  = fork->root;
+        child = root->slot[0];
+
+        if (!child || child->nblocks != root->nblocks) {
+            break;
+        }
+
+        fork->root = child;
+        fork->height--;
+        free(root);
+    }
+} /* memfs_bmap_prune */
+
+/* Store a block at index bi, replacing whatever was there (the caller owns the
+ * old block).  Returns -1 if a node could not be allocated, leaving the map as
+ * it was. */
+static int
+memfs_bmap_store(
+    struct memfs_fork  *fork,
+    uint64_t            bi,
+    struct memfs_block *block)
+{
+    struct memfs_bmap_node *path[CHIMERA_MEMFS_BMAP_MAX_HEIGHT];
+    struct memfs_bmap_node *node, *child;
+    uint32_t                level, depth, i, slot;
+
+    /* Grow by pushing the current root down under new roots until bi fits */
+    while (bi >= memfs_bmap_capacity(fork->height)) {
+        if (fork->root) {
+            node = calloc(1, sizeof(*node));
+
+            if (!node) {
+                /* Drop any roots added so far (they only hold the old root) */
+                memfs_bmap_prune(fork, &fork->root, 1, bi);
+                return -1;
+            }
+
+            node->nblocks = fork->root->nblocks;
+            node->slot[0] = fork->root;
+            fork->root    = node;
+        }
+        fork->height++;
+    }
+
+    if (!fork->root) {
+        fork->root = calloc(1, sizeof(*fork->root));
+
+        if (!fork->root) {
+            fork->height = 0;
+            return -1;
+        }
+    }
+
+    node    = fork->root;
+    path[0] = node;
+    depth   = 1;
+
+    for (level = fork->height - 1; level > 0; level--) {
+        slot  = memfs_bmap_slot(bi, level);
+        child = node->slot[slot];
+
+        if (!child) {
+            child = calloc(1, sizeof(*child));
+
+            if (!child) {
+                memfs_bmap_prune(fork, path, depth, bi);
+                return -1;
+            }
+
+            node->slot[slot] = child;
+        }
+
+        node          = child;
+        path[depth++] = node;
+    }
+
+    slot = memfs_bmap_slot(bi, 0);
+
+    if (!node->slot[slot]) {
+        for (i = 0; i < depth; i++) {
+            path[i]->nblocks++;
+        }
+    }
+
+    node->slot[slot] = block;
+
+    return 0;
+} /* memfs_bmap_store */
+
+/* Detach and return the block at index bi (NULL for a hole). */
+static struct memfs_block *
+memfs_bmap_remove(
+    struct memfs_fork *fork,
+    uint64_t           bi)
+{
+    struct memfs_bmap_node *path[CHIMERA_MEMFS_BMAP_MAX_HEIGHT];
+    struct memfs_bmap_node *node = fork->root;
+    struct memfs_block     *block;
+    uint32_t                level, depth, i, slot;
+
+    if (!node || bi >= memfs_bmap_capacity(fork->height)) {
+        return NULL;
+    }
+
+    path[0] = node;
+    depth   = 1;
+
+    for (level = fork->height - 1; level > 0; level--) {
+        node = node->slot[memfs_bmap_slot(bi, level)];
+
+        if (!node) {
+            return NULL;
+        }
+
+        path[depth++] = node;
+    }
+
+    slot  = memfs_bmap_slot(bi, 0);
+    block = node->slot[slot];
+
+    if (!block) {
+        return NULL;
+    }
+
+    node->slot[slot] = NULL;
+
+    for (i = 0; i < depth; i++) {
+        path[i]->nblocks--;
+    }
+
+    memfs_bmap_prune(fork, path, depth, bi);
+
+    return block;
+} /* memfs_bmap_remove */
+
+static uint64_t
+memfs_bmap_scan(
+    const struct memfs_bmap_node *node,
+    uint32_t                      level,
+    uint64_t                      base,
+    uint64_t                      bi,
+    int                           data)
+{
+    const struct memfs_bmap_node *child;
+    uint32_t                      shift = level * CHIMERA_MEMFS_BMAP_SHIFT;
+    uint64_t                      span  = 1ULL << shift;
+    uint64_t                      child_base, found;
+    uint32_t                      slot;
+
+    slot = bi > base ? (bi - base) >> shift : 0;
+
+    for (; slot < CHIMERA_MEMFS_BMAP_FANOUT; slot++) {
+        child      = node->slot[slot];
+        child_base = base + slot * span;
+
+        if (level == 0) {
+            if ((child != NULL) == data) {
+                return child_base;
+            }
+            continue;
+        }
+
+        if (!child) {
+            if (!data) {
+                return bi > child_base ? bi : child_base;
+            }
+            continue;
+        }
+
+        /* A full subtree has no hole in it */
+        if (!data && child->nblocks == span) {
+            continue;
+        }
+
+        found = memfs_bmap_scan(child, level - 1, child_base,
+                                bi > child_base ? bi : child_base, data);
+
+        if (found != UINT64_MAX) {
+            return found;
+        }
+    }
+
+    return UINT64_MAX;
+} /* memfs_bmap_scan */
+
+/* Return the first block index >= bi holding data (data=1) or a hole (data=0).
+ * UINT64_MAX means there is no data at or beyond bi; a hole always exists. */
+static uint64_t
+memfs_bmap_next(
+    const struct memfs_fork *fork,
+    uint64_t                 bi,
+    int                      data)
+{
+    uint64_t found;
+
+    if (!fork->root || bi >= memfs_bmap_capacity(fork->height)) {
+        return data ? UINT64_MAX : bi;
+    }
+
+    found = memfs_bmap_scan(fork->root, fork->height - 1, 0, bi, data);
+
+    if (found == UINT64_MAX && !data) {
+        found = memfs_bmap_capacity(fork->height);
+    }
+
+    return found;
+} /* memfs_bmap_next */
+
+/* Free every data block with index in [first, last], visiting only the
+ * populated parts of the range. */
+static void
+memfs_bmap_punch(
+    struct memfs_thread *thread,
+    struct memfs_fs     *fs,
+    struct memfs_fork   *fork,
+    uint64_t             first,
+    uint64_t             last)
+{
+    struct memfs_block *block;
+    uint64_t            bi;
+
+    for (bi = memfs_bmap_next(fork, first, 1);
+         bi <= last && bi != UINT64_MAX;
+         bi = memfs_bmap_next(fork, bi + 1, 1)) {
+        block = memfs_bmap_remove(fork, bi);
+        memfs_block_free(thread, fs, block);
+    }
+} /* memfs_bmap_punch */
+
+static void
+memfs_bmap_node_destroy(
+    struct memfs_bmap_node *node,
+    uint32_t                level,
+    void (                 *release )(
+        struct memfs_block *block,
+        void               *private_data),
+    void                   *private_data)
+{
+    uint32_t slot;
+
+    for (slot = 0; slot < CHIMERA_MEMFS_BMAP_FANOUT; slot++) {
+        if (!node->slot[slot]) {
+            continue;
+        }
+
+        if (level == 0) {
+            release(node->slot[slot], private_data);
+        } else {
+            memfs_bmap_node_destroy(node->slot[slot], level - 1,
+                                    release, private_data);
+        }
+    }
+
+    free(node);
+} /* memfs_bmap_node_destroy */
+
+/* Tear down the whole map, handing each block to release() */
+static void
+memfs_bmap_destroy(
+    struct memfs_fork *fork,
+    void (            *release )(
+        struct memfs_block *block,
+        void               *private_data),
+    void              *private_data)
+{
+    if (fork->root) {
+        memfs_bmap_node_destroy(fork->root, fork->height - 1,
+                                release, private_data);
+    }
+
+    fork->root   = NULL;
+    fork->height = 0;
+} /* memfs_bmap_destroy */
+
 static inline struct memfs_symlink_target *
 memfs_symlink_target_alloc(struct memfs_thread *thread)
 {
@@ -803,23 +1182,7 @@ memfs_inode_truncate_blocks(
     struct memfs_thread *thread,
     struct memfs_inode  *inode)
 {
-    struct memfs_fs    *fs = inode->fs;
-    struct memfs_block *block;
-    int                 i;
-
-    if (inode->file.blocks) {
-        for (i = 0; i < inode->file.num_blocks; i++) {
-            block = inode->file.blocks[i];
-            if (block) {
-                memfs_block_free(thread, fs, block);
-                inode->file.blocks[i] = NULL;
-            }
-        }
-        free(inode->file.blocks);
-        inode->file.blocks = NULL;
-    }
-    inode->file.num_blocks = 0;
-    inode->file.max_blocks = 0;
+    memfs_bmap_punch(thread, inode->fs, &inode->file, 0, UINT64_MAX);
 } /* memfs_inode_truncate_blocks */
 
 /* Free all data blocks of an arbitrary fork (a named stream's fork) and reset
@@ -830,20 +1193,7 @@ memfs_fork_free_blocks(
     struct memfs_fs     *fs,
     struct memfs_fork   *fork)
 {
-    unsigned int i;
-
-    if (fork->blocks) {
-        for (i = 0; i < fork->num_blocks; i++) {
-            if (fork->blocks[i]) {
-                memfs_block_free(thread, fs, fork->blocks[i]);
-                fork->blocks[i] = NULL;
-            }
-        }
-        free(fork->blocks);
-        fork->blocks = NULL;
-    }
-    fork->num_blocks = 0;
-    fork->max_blocks = 0;
+    memfs_bmap_punch(thread, fs, fork, 0, UINT64_MAX);
 } /* memfs_fork_free_blocks */
 
 /* Free a single named-stream node (its fork blocks, name and the node itself).
@@ -1254,6 +1604,21 @@ memfs_fs_create(
     return fs;
 } /* memfs_fs_create */
 
+/* Release a block straight to the heap rather than a thread freelist, which
+ * is gone by the time a filesystem's contents are freed. */
+static void
+memfs_block_destroy(
+    struct memfs_block *block,
+    void               *private_data)
+{
+    int iovi;
+
+    for (iovi = 0; iovi < block->niov; iovi++) {
+        evpl_iovec_release(NULL, &block->iov[iovi]);
+    }
+    free(block);
+} /* memfs_block_destroy */
+
 /* Free every inode and data block belonging to one filesystem.  Used by both
  * module destroy and RMFS; runs with no concurrent users of the filesystem
  * (destroy is single-threaded, RMFS defers through an RCU grace period). */
@@ -1261,7 +1626,7 @@ static void
 memfs_fs_free_contents(struct memfs_fs *fs)
 {
     struct memfs_inode *inode;
-    int                 i, j, k, bi, iovi;
+    int                 i, j, k;
 
     for (i = 0; i < fs->num_inode_list; i++) {
         for (j = 0; j < fs->inode_list[i].num_blocks; j++) {
@@ -1283,20 +1648,7 @@ memfs_fs_free_contents(struct memfs_fs *fs)
                 } else if (S_ISLNK(inode->mode)) {
                     free(inode->symlink.target);
                 } else if (S_ISREG(inode->mode)) {
-                    for (bi = 0; bi < inode->file.num_blocks; bi++) {
-                        if (inode->file.blocks[bi]) {
-                            for (iovi = 0; iovi < inode->file.blocks[bi]->niov;
-                                 iovi++) {
-                                evpl_iovec_release(NULL, &inode->file.blocks[bi]->iov[
-                                                       iovi]);
-                            }
-                            free(inode->file.blocks[bi]);
-                        }
-                    }
-
-                    if (inode->file.blocks) {
-                        free(inode->file.blocks);
-                    }
+                    memfs_bmap_destroy(&inode->file, memfs_block_destroy, NULL);
 
                     /* Named-stream forks are freed the same way as the main
                      * fork (direct release, not via the per-thread freelist,
@@ -1311,24 +1663,11 @@ memfs_fs_free_contents(struct memfs_fs *fs)
 
                         while (*head) {
                             struct memfs_named_stream *stream = *head;
-                            unsigned int               sbi;
 
                             *head = stream->next;
 
-                            for (sbi = 0; sbi < stream->fork.num_blocks; sbi++) {
-                                if (stream->fork.blocks[sbi]) {
-                                    for (iovi = 0;
-                                         iovi < stream->fork.blocks[sbi]->niov;
-                                         iovi++) {
-                                        evpl_iovec_release(NULL,
-                                                           &stream->fork.blocks[sbi]->iov[iovi]);
-                                    }
-                                    free(stream->fork.blocks[sbi]);
-                                }
-                            }
-                            if (stream->fork.blocks) {
-                                free(stream->fork.blocks);
-                            }
+                            memfs_bmap_destroy(&stream->fork,
+                                               memfs_block_destroy, NULL);
                             free(stream->name);
                             free(stream);
                         }
@@ -1989,29 +2328,20 @@ memfs_setattr(
         uint64_t       new_size       = attr->va_size;
         uint64_t       new_num_blocks = (new_size + block_size - 1) >>
             block_shift;
-        uint64_t       bi;
+        int            had_blocks = memfs_bmap_count(fork) != 0;
 
         /* Free blocks that are entirely past the new EOF */
-        if (fork->blocks) {
-            for (bi = new_num_blocks; bi < fork->num_blocks; bi++) {
-                if (fork->blocks[bi]) {
-                    memfs_block_free(thread, fs, fork->blocks[bi]);
-                    fork->blocks[bi] = NULL;
-                }
-            }
-        }
+        memfs_bmap_punch(thread, fs, fork, new_num_blocks, UINT64_MAX);
 
         /* Zero the partial region in the last block if EOF is not aligned.
          * We must allocate a new block and copy the retained portion because
          * readers may still be referencing the old block's iovecs. */
         if (new_size > 0 && (new_size & block_mask)) {
-            uint64_t last_block_idx = (new_size - 1) >> block_shift;
+            uint64_t            last_block_idx = (new_size - 1) >> block_shift;
+            struct memfs_block *old_block      = memfs_bmap_lookup(fork,
+                                                                   last_block_idx);
 
-            if (fork->blocks &&
-                last_block_idx < fork->num_blocks &&
-                fork->blocks[last_block_idx]) {
-
-                struct memfs_block      *old_block = fork->blocks[last_block_idx];
+            if (old_block) {
                 struct memfs_block      *new_block;
                 struct evpl_iovec_cursor old_cursor;
                 uint32_t                 offset_in_block = new_size &
@@ -2041,21 +2371,19 @@ memfs_setattr(
                 memset(new_block->iov[0].data + offset_in_block, 0,
                        block_size - offset_in_block);
 
+                /* Replace old block with new block; the slot exists, so
+                 * the store cannot fail. */
+                memfs_bmap_store(fork, last_block_idx, new_block);
                 memfs_block_free_charged(thread, fs, old_block, 0);
-
-                /* Replace old block with new block */
-                fork->blocks[last_block_idx] = new_block;
             }
         }
 
-        /* Only update num_blocks if blocks array exists.
-         * If blocks is NULL (sparse file extended via setattr), keep num_blocks=0. */
-        if (fork->blocks) {
-            fork->num_blocks = new_num_blocks;
-            *p_space_used    = new_num_blocks * block_size;
+        /* A fork that never held data (sparse file extended via setattr)
+         * stays at zero space. */
+        if (had_blocks) {
+            *p_space_used = new_num_blocks * block_size;
         } else {
-            fork->num_blocks = 0;
-            *p_space_used    = 0;
+            *p_space_used = 0;
         }
     }
 
@@ -2598,6 +2926,10 @@ memfs_lookup_at(
      * for an SMB (AUTH_ATTR) caller when the exact match misses (names3). */
     if (!dirent && request->cred->flavor == CHIMERA_VFS_AUTH_ATTR) {
         dirent = memfs_dirent_find_ci(inode, name, namelen);
+        if (dirent) {
+            memcpy(request->lookup_at.r_name, dirent->name, dirent->name_len);
+            request->lookup_at.r_namelen = dirent->name_len;
+        }
     }
 
     if (!dirent) {
@@ -3305,9 +3637,8 @@ memfs_open_at(
         inode->mtime = now;
         inode->ctime = now;
         inode->change++;
-        inode->file.blocks     = NULL;
-        inode->file.max_blocks = 0;
-        inode->file.num_blocks = 0;
+        inode->file.root   = NULL;
+        inode->file.height = 0;
 
         memfs_apply_attrs(inode, request->open_at.set_attr);
 
@@ -3461,9 +3792,8 @@ memfs_create_unlinked(
     inode->mtime      = now;
     inode->ctime      = now;
     inode->change++;
-    inode->file.blocks     = NULL;
-    inode->file.max_blocks = 0;
-    inode->file.num_blocks = 0;
+    inode->file.root   = NULL;
+    inode->file.height = 0;
 
     inode->refcnt++;
 
@@ -3572,9 +3902,9 @@ memfs_read(
 
     /* memfs advertises CAP_READ_PROVIDES_BUFFERS: it returns zero-copy refs to
      * its own SHARED block iovecs, so the VFS core never pre-allocates buffers
-     * for it (buffers_provided is always 0).  If a future VFS data cache ever
-     * hands memfs buffers to populate, this is where memfs would memcpy its
-     * block data into request->read.iov instead of cloning refs below. */
+     * for it (buffers_provided is always 0).  memfs also advertises
+     * CAP_DATA_IN_MEMORY, so the VFS data cache never reads ahead into or
+     * serves from a copy of these blocks. */
     chimera_memfs_abort_if(request->read.buffers_provided,
                            "memfs read received VFS-provided buffers but only "
                            "implements the zero-copy ref path");
@@ -3665,11 +3995,7 @@ memfs_read(
             block_len = block_size - block_offset;
         }
 
-        if (fork->blocks && bi < fork->num_blocks) {
-            block = fork->blocks[bi];
-        } else {
-            block = NULL;
-        }
+        block = memfs_bmap_lookup(fork, bi);
 
         if (!block) {
             if (niov >= max_iov) {
@@ -3725,7 +4051,7 @@ memfs_write(
     struct memfs_named_stream *stream;
     struct memfs_fork         *fork;
     uint64_t                  *p_size, *p_space_used;
-    struct memfs_block       **blocks, *block, *old_block;
+    struct memfs_block        *block, *old_block;
     struct evpl_iovec_cursor   cursor, old_block_cursor;
     uint64_t                   first_block, last_block, bi;
     uint32_t                   block_offset, left, block_len;
@@ -3777,7 +4103,8 @@ memfs_write(
     if (request->write.length == 0) {
         /* A zero-length write changes nothing. Returning early also avoids
          * the (offset + length - 1) underflow above, which drives last_block
-         * to a huge value and spins the 32-bit block-growth loop forever. */
+         * to a huge value and would run the block loop across the whole
+         * index space. */
         memfs_map_post_attr_fork(fs, &request->write.r_post_attr, inode, stream, request->fh);
         pthread_mutex_unlock(&inode->lock);
         request->status         = CHIMERA_VFS_OK;
@@ -3787,46 +4114,6 @@ memfs_write(
         return;
     }
 
-    if (fork->max_blocks <= last_block || !fork->blocks) {
-        struct memfs_block **new_blocks;
-        unsigned int         new_max_blocks;
-
-        blocks = fork->blocks;
-
-        new_max_blocks = 1024;
-
-        while (new_max_blocks <= last_block) {
-            new_max_blocks <<= 1;
-        }
-
-        /* calloc (not malloc+memset) so a sparse write at a high block index
-         * does not force the whole pointer array resident: large allocations
-         * are served by mmap and the unwritten tail stays backed by the zero
-         * page until a block is actually stored there. */
-        new_blocks = calloc(new_max_blocks, sizeof(struct memfs_block *));
-
-        if (!new_blocks) {
-            pthread_mutex_unlock(&inode->lock);
-            request->status = CHIMERA_VFS_ENOSPC;
-            request->complete(request);
-            return;
-        }
-
-        if (blocks) {
-            memcpy(new_blocks, blocks,
-                   fork->num_blocks * sizeof(struct memfs_block *));
-            free(blocks);
-        }
-
-        fork->blocks     = new_blocks;
-        fork->max_blocks = new_max_blocks;
-    }
-
-    /* Only increase num_blocks, never decrease it during write */
-    if (last_block + 1 > fork->num_blocks) {
-        fork->num_blocks = last_block + 1;
-    }
-
     for (bi = first_block; bi <= last_block; bi++) {
 
         block_len = block_size - block_offset;
@@ -3835,7 +4122,7 @@ memfs_write(
             block_len = left;
         }
 
-        old_block = fork->blocks ? fork->blocks[bi] : NULL;
+        old_block = memfs_bmap_lookup(fork, bi);
 
         /* Overwriting an existing block is net-zero (new block paired with the
         * old block's free below), so don't charge it -- a write into already
@@ -3871,28 +4158,35 @@ memfs_write(
                                        block_len,
                                        block_size - block_len -
                                        block_offset);
-
-                fork->blocks[bi] = NULL;
-                memfs_block_free_charged(thread, fs, old_block, 0);
             } else {
                 memset(block->iov[0].data, 0, block_offset);
 
                 memset(block->iov[0].data + block_offset + block_len, 0,
                        block_size - block_offset - block_len);
             }
-        } else if (old_block) {
-            /* Full block overwrite: free the old block (net-zero, no uncharge) */
-            fork->blocks[bi] = NULL;
-            memfs_block_free_charged(thread, fs, old_block, 0);
         }
 
         evpl_iovec_cursor_copy(&cursor,
                                block->iov[0].data + block_offset,
                                block_len);
 
-        fork->blocks[bi] = block;
-        block_offset     = 0;
-        left            -= block_len;
+        /* Replacing an existing block reuses its slot and cannot fail; only
+         * a block landing in a hole may need new map nodes. */
+        if (memfs_bmap_store(fork, bi, block) != 0) {
+            memfs_block_free(thread, fs, block);
+            pthread_mutex_unlock(&inode->lock);
+            request->status = CHIMERA_VFS_ENOSPC;
+            request->complete(request);
+            return;
+        }
+
+        if (old_block) {
+            /* Overwrite: free the old block (net-zero, no uncharge) */
+            memfs_block_free_charged(thread, fs, old_block, 0);
+        }
+
+        block_offset = 0;
+        left        -= block_len;
     }
 
     if (*p_size < request->write.offset + request->write.length) {
@@ -3920,11 +4214,6 @@ memfs_write(
     request->complete(request);
 } /* memfs_write */
 
-
-static int memfs_grow_blocks(
-    struct memfs_inode *inode,
-    uint64_t            last_block);
-
 static void
 memfs_allocate(
     struct memfs_thread        *thread,
@@ -3968,25 +4257,24 @@ memfs_allocate(
             hole_end = *p_size;
         }
 
-        if (hole_start < hole_end && fork->blocks) {
+        if (hole_start < hole_end && fork->root) {
             first_block = hole_start >> block_shift;
             last_block  = (hole_end - 1) >> block_shift;
 
-            for (bi = first_block; bi <= last_block && bi < fork->num_blocks; bi++) {
-                if (!fork->blocks[bi]) {
-                    continue;
-                }
+            /* Visit only the blocks that hold data */
+            for (bi = memfs_bmap_next(fork, first_block, 1);
+                 bi <= last_block;
+                 bi = memfs_bmap_next(fork, bi + 1, 1)) {
 
                 uint64_t block_start = bi << block_shift;
                 uint64_t block_end   = block_start + block_size;
 
                 if (hole_start <= block_start && hole_end >= block_end) {
                     /* Entire block is within hole - free it */
-                    memfs_block_free(thread, fs, fork->blocks[bi]);
-                    fork->blocks[bi] = NULL;
+                    memfs_block_free(thread, fs, memfs_bmap_remove(fork, bi));
                 } else {
                     /* Partial block - COW and zero the hole portion */
-                    struct memfs_block      *old_block = fork->blocks[bi];
+                    struct memfs_block      *old_block = memfs_bmap_lookup(fork, bi);
                     struct memfs_block      *new_block;
                     struct evpl_iovec_cursor old_cursor;
                     uint32_t                 zero_start, zero_end;
@@ -4021,18 +4309,12 @@ memfs_allocate(
                     memset(new_block->iov[0].data + zero_start, 0,
                            zero_end - zero_start);
 
+                    memfs_bmap_store(fork, bi, new_block);
                     memfs_block_free_charged(thread, fs, old_block, 0);
-                    fork->blocks[bi] = new_block;
                 }
             }
 
-            *p_space_used = 0;
-
-            for (bi = 0; bi < fork->num_blocks; bi++) {
-                if (fork->blocks[bi]) {
-                    *p_space_used += block_size;
-                }
-            }
+            *p_space_used = memfs_bmap_count(fork) * block_size;
         }
     } else {
         /* ALLOCATE: reserve space for [offset, offset+length) and extend size. */
@@ -4046,7 +4328,7 @@ memfs_allocate(
          * a later write reuses these blocks (alloc-new + free-old nets to zero,
          * so no double charge) and DEALLOCATE frees them.  block_alloc returns
          * NULL (ENOSPC) when the filesystem is full.  Streams keep the cheap
-         * size-only path (memfs_grow_blocks operates on the base fork). */
+         * size-only path. */
         if (!stream && request->allocate.length) {
             const uint32_t block_size  = thread->shared->block_size;
             const uint32_t block_shift = thread->shared->block_shift;
@@ -4054,24 +4336,12 @@ memfs_allocate(
             uint64_t       last_block  = (new_end - 1) >> block_shift;
             uint64_t       bi;
 
-            if (memfs_grow_blocks(inode, last_block) != 0) {
-                pthread_mutex_unlock(&inode->lock);
-                request->status = CHIMERA_VFS_ENOSPC;
-                request->complete(request);
-                return;
-            }
-
-            if (last_block + 1 > fork->num_blocks) {
-                fork->num_blocks = last_block + 1;
-            }
-
-            for (bi = first_block; bi <= last_block; bi++) {
+            /* Visit only the holes; materialized blocks are kept */
+            for (bi = memfs_bmap_next(fork, first_block, 0);
+                 bi <= last_block;
+                 bi = memfs_bmap_next(fork, bi + 1, 0)) {
                 struct memfs_block *block;
 
-                if (fork->blocks[bi]) {
-                    continue;   /* already materialized */
-                }
-
                 block = memfs_block_alloc(thread, fs);
 
                 if (!block) {
@@ -4085,7 +4355,14 @@ memfs_allocate(
                                                CHIMERA_MEMFS_BLOCK_MAX_IOV,
                                                EVPL_IOVEC_FLAG_SHARED, block->iov);
                 memset(block->iov[0].data, 0, block_size);
-                fork->blocks[bi] = block;
+
+                if (memfs_bmap_store(fork, bi, block) != 0) {
+                    memfs_block_free(thread, fs, block);
+                    pthread_mutex_unlock(&inode->lock);
+                    request->status = CHIMERA_VFS_ENOSPC;
+                    request->complete(request);
+                    return;
+                }
             }
         }
 
@@ -4134,11 +4411,7 @@ memfs_copy_from_inode(
             chunk = len;
         }
 
-        if (src->file.blocks && src_bi < src->file.num_blocks) {
-            sb = src->file.blocks[src_bi];
-        } else {
-            sb = NULL;
-        }
+        sb = memfs_bmap_lookup(&src->file, src_bi);
 
         if (sb) {
             memcpy(out, (uint8_t *) sb->iov[0].data + src_off, chunk);
@@ -4157,61 +4430,9 @@ memfs_recompute_space_used(
     struct memfs_shared *shared,
     struct memfs_inode  *inode)
 {
-    const uint32_t block_size = shared->block_size;
-    uint64_t       bi;
-
-    inode->space_used = 0;
-
-    if (!inode->file.blocks) {
-        return;
-    }
-
-    for (bi = 0; bi < inode->file.num_blocks; bi++) {
-        if (inode->file.blocks[bi]) {
-            inode->space_used += block_size;
-        }
-    }
+    inode->space_used = memfs_bmap_count(&inode->file) * shared->block_size;
 } /* memfs_recompute_space_used */
 
-static int
-memfs_grow_blocks(
-    struct memfs_inode *inode,
-    uint64_t            last_block)
-{
-    struct memfs_block **new_blocks;
-    unsigned int         new_max_blocks;
-
-    if (inode->file.blocks && inode->file.max_blocks > last_block) {
-        return 0;
-    }
-
-    new_max_blocks = inode->file.max_blocks ? inode->file.max_blocks : 1024;
-
-    while (new_max_blocks <= last_block) {
-        new_max_blocks <<= 1;
-    }
-
-    new_blocks = malloc(new_max_blocks * sizeof(struct memfs_block *));
-
-    if (!new_blocks) {
-        return -1;
-    }
-
-    if (inode->file.blocks) {
-        memcpy(new_blocks, inode->file.blocks,
-               inode->file.num_blocks * sizeof(struct memfs_block *));
-        free(inode->file.blocks);
-    }
-
-    memset(new_blocks + inode->file.num_blocks, 0,
-           (new_max_blocks - inode->file.num_blocks) *
-           sizeof(struct memfs_block *));
-
-    inode->file.blocks     = new_blocks;
-    inode->file.max_blocks = new_max_blocks;
-    return 0;
-} /* memfs_grow_blocks */
-
 static void
 memfs_copy_range(
     struct memfs_thread        *thread,
@@ -4226,8 +4447,8 @@ memfs_copy_range(
     struct memfs_inode *src_inode, *dst_inode;
     struct memfs_block *old_block, *new_block;
     uint64_t            src_offset, dst_offset, length, src_eof_len;
-    uint64_t            first_block, last_block, bi;
-    uint32_t            block_offset, left, block_len;
+    uint64_t            first_block, last_block, bi, left;
+    uint32_t            block_offset, block_len;
     uint64_t            copied = 0;
     struct timespec     now;
 
@@ -4367,27 +4588,13 @@ memfs_copy_range(
     last_block   = (dst_offset + length - 1) >> block_shift;
     left         = length;
 
-    if (memfs_grow_blocks(dst_inode, last_block) != 0) {
-        if (src_inode != dst_inode) {
-            pthread_mutex_unlock(&src_inode->lock);
-        }
-        pthread_mutex_unlock(&dst_inode->lock);
-        request->status = CHIMERA_VFS_ENOSPC;
-        request->complete(request);
-        return;
-    }
-
-    if (last_block + 1 > dst_inode->file.num_blocks) {
-        dst_inode->file.num_blocks = last_block + 1;
-    }
-
     for (bi = first_block; bi <= last_block; bi++) {
         block_len = block_size - block_offset;
         if (left < block_len) {
             block_len = left;
         }
 
-        old_block = dst_inode->file.blocks[bi];
+        old_block = memfs_bmap_lookup(&dst_inode->file, bi);
 
         /* Full-destination-block copies preserve source holes: when every
          * source block covering this destination block is absent, drop the
@@ -4404,21 +4611,11 @@ memfs_copy_range(
             uint64_t s_off  = src_offset + copied;
             uint64_t s_bi   = s_off >> block_shift;
             uint64_t s_last = (s_off + block_len - 1) >> block_shift;
-            int      hole   = 1;
-
-            for (uint64_t sb = s_bi; sb <= s_last; sb++) {
-                if (sb < src_inode->file.num_blocks &&
-                    src_inode->file.blocks &&
-                    src_inode->file.blocks[sb]) {
-                    hole = 0;
-                    break;
-                }
-            }
 
-            if (hole) {
+            if (memfs_bmap_next(&src_inode->file, s_bi, 1) > s_last) {
                 if (old_block) {
+                    memfs_bmap_remove(&dst_inode->file, bi);
                     memfs_block_free(thread, fs, old_block);
-                    dst_inode->file.blocks[bi] = NULL;
                 }
                 copied      += block_len;
                 left        -= block_len;
@@ -4471,10 +4668,20 @@ memfs_copy_range(
                               (uint8_t *) new_block->iov[0].data + block_offset,
                               block_len);
 
+        if (memfs_bmap_store(&dst_inode->file, bi, new_block) != 0) {
+            memfs_block_free(thread, fs, new_block);
+            if (src_inode != dst_inode) {
+                pthread_mutex_unlock(&src_inode->lock);
+            }
+            pthread_mutex_unlock(&dst_inode->lock);
+            request->status = CHIMERA_VFS_ENOSPC;
+            request->complete(request);
+            return;
+        }
+
         if (old_block) {
             memfs_block_free(thread, fs, old_block);
         }
-        dst_inode->file.blocks[bi] = new_block;
 
         copied      += block_len;
         left        -= block_len;
@@ -4516,7 +4723,7 @@ memfs_move_range(
     const uint32_t      block_mask  = thread->shared->block_mask;
     struct memfs_inode *src_inode, *dst_inode;
     uint64_t            src_offset, dst_offset, length;
-    uint64_t            first_block, last_block, bi;
+    uint64_t            first_block, bi;
     uint64_t            src_first_block, n_blocks;
     struct timespec     now;
 
@@ -4589,42 +4796,43 @@ memfs_move_range(
                        request->move_range.dst_handle->fh);
 
     first_block     = dst_offset >> block_shift;
-    last_block      = (dst_offset + length - 1) >> block_shift;
     src_first_block = src_offset >> block_shift;
     n_blocks        = length >> block_shift;
 
-    if (memfs_grow_blocks(dst_inode, last_block) != 0) {
-        if (src_inode != dst_inode) {
-            pthread_mutex_unlock(&src_inode->lock);
-        }
-        pthread_mutex_unlock(&dst_inode->lock);
-        request->status = CHIMERA_VFS_ENOSPC;
-        request->complete(request);
-        return;
-    }
-
-    if (last_block + 1 > dst_inode->file.num_blocks) {
-        dst_inode->file.num_blocks = last_block + 1;
-    }
-
     for (bi = 0; bi < n_blocks; bi++) {
         uint64_t            si = src_first_block + bi;
         uint64_t            di = first_block + bi;
-        struct memfs_block *src_block;
+        struct memfs_block *src_block, *dst_block;
 
-        if (src_inode->file.blocks && si < src_inode->file.num_blocks) {
-            src_block                  = src_inode->file.blocks[si];
-            src_inode->file.blocks[si] = NULL;
+        src_block = memfs_bmap_lookup(&src_inode->file, si);
+
+        if (!src_block) {
+            /* A source hole moves as a hole: drop the destination block */
+            dst_block = memfs_bmap_remove(&dst_inode->file, di);
         } else {
-            src_block = NULL;
-        }
+            dst_block = memfs_bmap_lookup(&dst_inode->file, di);
+
+            /* Link into the destination before unlinking from the source so
+             * a failed map allocation loses nothing. */
+            if (memfs_bmap_store(&dst_inode->file, di, src_block) != 0) {
+                memfs_recompute_space_used(thread->shared, dst_inode);
+                memfs_recompute_space_used(thread->shared, src_inode);
+                if (src_inode != dst_inode) {
+                    pthread_mutex_unlock(&src_inode->lock);
+                }
+                pthread_mutex_unlock(&dst_inode->lock);
+                request->status = CHIMERA_VFS_ENOSPC;
+                request->complete(request);
+                return;
+            }
 
-        /* Free anything currently at the destination slot before overwriting */
-        if (dst_inode->file.blocks[di]) {
-            memfs_block_free(thread, fs, dst_inode->file.blocks[di]);
+            memfs_bmap_remove(&src_inode->file, si);
         }
 
-        dst_inode->file.blocks[di] = src_block;
+        /* Free whatever the destination slot held before */
+        if (dst_block) {
+            memfs_block_free(thread, fs, dst_block);
+        }
     }
 
     if (dst_inode->size < dst_offset + length) {
@@ -4669,8 +4877,8 @@ memfs_clone_range(
     struct memfs_inode *src_inode, *dst_inode;
     struct memfs_block *old_block, *new_block;
     uint64_t            src_offset, dst_offset, length;
-    uint64_t            first_block, last_block, bi;
-    uint32_t            block_offset, left, block_len;
+    uint64_t            first_block, last_block, bi, left;
+    uint32_t            block_offset, block_len;
     uint64_t            copied = 0;
     struct timespec     now;
 
@@ -4763,20 +4971,6 @@ memfs_clone_range(
     last_block   = (dst_offset + length - 1) >> block_shift;
     left         = length;
 
-    if (memfs_grow_blocks(dst_inode, last_block) != 0) {
-        if (src_inode != dst_inode) {
-            pthread_mutex_unlock(&src_inode->lock);
-        }
-        pthread_mutex_unlock(&dst_inode->lock);
-        request->status = CHIMERA_VFS_ENOSPC;
-        request->complete(request);
-        return;
-    }
-
-    if (last_block + 1 > dst_inode->file.num_blocks) {
-        dst_inode->file.num_blocks = last_block + 1;
-    }
-
     for (bi = first_block; bi <= last_block; bi++) {
         uint64_t            cur_src_off = src_offset + copied;
         uint64_t            si          = cur_src_off >> block_shift;
@@ -4788,27 +4982,38 @@ memfs_clone_range(
             block_len = left;
         }
 
-        if (src_inode->file.blocks && si < src_inode->file.num_blocks) {
-            src_block = src_inode->file.blocks[si];
-        } else {
-            src_block = NULL;
-        }
+        /* A source hole under whole destination blocks stays sparse at the
+         * destination (reads as zeros) -- preserves sparseness across the
+         * clone.  The block map says where the source's next data starts, so
+         * the whole run of destination blocks before it is punched at once
+         * instead of block by block. */
+        if (block_offset == 0 && block_len == block_size) {
+            uint64_t next_data = memfs_bmap_next(&src_inode->file, si, 1);
+            uint64_t run       = left >> block_shift;
 
-        old_block = dst_inode->file.blocks[bi];
+            if (next_data != UINT64_MAX) {
+                uint64_t data_off = next_data << block_shift;
+                uint64_t hole_len = data_off > cur_src_off ?
+                    data_off - cur_src_off : 0;
 
-        /* A full-block hole in the source stays sparse at the destination
-         * (reads as zeros) -- preserves sparseness across the clone. */
-        if (!src_block && block_offset == 0 && block_len == block_size) {
-            if (old_block) {
-                memfs_block_free(thread, fs, old_block);
-                dst_inode->file.blocks[bi] = NULL;
+                if ((hole_len >> block_shift) < run) {
+                    run = hole_len >> block_shift;
+                }
+            }
+
+            if (run) {
+                memfs_bmap_punch(thread, fs, &dst_inode->file,
+                                 bi, bi + run - 1);
+                copied += run << block_shift;
+                left   -= run << block_shift;
+                bi     += run - 1;
+                continue;
             }
-            copied      += block_len;
-            left        -= block_len;
-            block_offset = 0;
-            continue;
         }
 
+        src_block = memfs_bmap_lookup(&src_inode->file, si);
+        old_block = memfs_bmap_lookup(&dst_inode->file, bi);
+
         /* Zero-copy fast path: the clone range fully covers this internal
          * block, the source position is block-aligned, and the source block is
          * fully backed (not a trailing partial block or a hole).  Share the
@@ -4876,10 +5081,20 @@ memfs_clone_range(
                                   block_len);
         }
 
+        if (memfs_bmap_store(&dst_inode->file, bi, new_block) != 0) {
+            memfs_block_free(thread, fs, new_block);
+            if (src_inode != dst_inode) {
+                pthread_mutex_unlock(&src_inode->lock);
+            }
+            pthread_mutex_unlock(&dst_inode->lock);
+            request->status = CHIMERA_VFS_ENOSPC;
+            request->complete(request);
+            return;
+        }
+
         if (old_block) {
             memfs_block_free(thread, fs, old_block);
         }
-        dst_inode->file.blocks[bi] = new_block;
 
         copied      += block_len;
         left        -= block_len;
@@ -4948,67 +5163,46 @@ memfs_seek(
     const uint32_t block_shift = thread->shared->block_shift;
 
     if (request->seek.what == 0) {
-        /* SEEK_DATA: find first non-NULL block from offset forward */
-        bi = offset >> block_shift;
-
-        while (bi < fork->num_blocks) {
-            if (fork->blocks && fork->blocks[bi]) {
-                block_start = bi << block_shift;
-
-                request->seek.r_offset = (block_start > offset) ?
-                    block_start : offset;
-                request->seek.r_eof = 0;
-                pthread_mutex_unlock(&inode->lock);
-                request->status = CHIMERA_VFS_OK;
-                request->complete(request);
-                return;
-            }
-            bi++;
+        /* SEEK_DATA: find first data block from offset forward */
+        bi = memfs_bmap_next(fork, offset >> block_shift, 1);
+
+        if (bi == UINT64_MAX) {
+            /* No data at or beyond the offset: SEEK_DATA fails with NXIO
+             * (the trailing region is an implicit hole to EOF). */
+            pthread_mutex_unlock(&inode->lock);
+            request->status = CHIMERA_VFS_ENXIO;
+            request->complete(request);
+            return;
         }
 
-        /* No data at or beyond the offset: SEEK_DATA fails with NXIO
-         * (the trailing region is an implicit hole to EOF). */
+        block_start = bi << block_shift;
+
+        request->seek.r_offset = (block_start > offset) ?
+            block_start : offset;
+        request->seek.r_eof = 0;
         pthread_mutex_unlock(&inode->lock);
-        request->status = CHIMERA_VFS_ENXIO;
+        request->status = CHIMERA_VFS_OK;
         request->complete(request);
         return;
     } else {
-        /* SEEK_HOLE: find first NULL block or past num_blocks from offset */
-        bi = offset >> block_shift;
-
-        while (bi < fork->num_blocks) {
-            if (!fork->blocks || !fork->blocks[bi]) {
-                block_start = bi << block_shift;
-
-                request->seek.r_offset = (block_start > offset) ?
-                    block_start : offset;
-                request->seek.r_eof = 0;
-                pthread_mutex_unlock(&inode->lock);
-                request->status = CHIMERA_VFS_OK;
-                request->complete(request);
-                return;
-            }
-            bi++;
-        }
+        /* SEEK_HOLE: find first unallocated block from offset forward.  Past
+         * the last data block everything is a hole, so this always succeeds. */
+        bi          = memfs_bmap_next(fork, offset >> block_shift, 0);
+        block_start = bi << block_shift;
 
-        /* Virtual hole at EOF - all blocks are data */
-        request->seek.r_offset = fork->num_blocks <<
-            block_shift;
-
-        if (request->seek.r_offset < offset) {
-            request->seek.r_offset = offset;
-        }
+        request->seek.r_offset = (block_start > offset) ?
+            block_start : offset;
 
         if (request->seek.r_offset >= fork_size) {
             request->seek.r_offset = fork_size;
         }
 
-        /* No explicit hole block found before EOF: the match is the implicit
-         * hole at the end of the file, so the search has reached EOF.  RFC 7862
-         * §11.4.4 requires sr_eof TRUE here (the Linux client surfaces it to
-         * lseek).  A trailing unallocated region that begins before the logical
-         * size is a real hole short of EOF, so only flag eof once the returned
-         * offset reaches fork_size. */
+        /* A hole found at or past EOF is the implicit hole at the end of the
+         * file, so the search has reached EOF.  RFC 7862 §11.4.4 requires
+         * sr_eof TRUE here (the Linux client surfaces it to lseek).  An
+         * unallocated region that begins before the logical size is a real
+         * hole short of EOF, so only flag eof once the returned offset reaches
+         * fork_size. */
         request->seek.r_eof = (request->seek.r_offset >= fork_size);
         pthread_mutex_unlock(&inode->lock);
         request->status = CHIMERA_VFS_OK;
@@ -6303,7 +6497,7 @@ SYMBOL_EXPORT struct chimera_vfs_module vfs_memfs = {
         CHIMERA_VFS_CAP_ACL_NATIVE | CHIMERA_VFS_CAP_XATTR | CHIMERA_VFS_CAP_LAYOUT |
         CHIMERA_VFS_CAP_READ_PROVIDES_BUFFERS |
         CHIMERA_VFS_CAP_NAMED_STREAMS | CHIMERA_VFS_CAP_RPL | CHIMERA_VFS_CAP_FS_LOCK |
-        CHIMERA_VFS_CAP_CHANGE | CHIMERA_VFS_CAP_MKFS,
+        CHIMERA_VFS_CAP_CHANGE | CHIMERA_VFS_CAP_MKFS | CHIMERA_VFS_CAP_DATA_IN_MEMORY,
     .init           = memfs_init,
     .destroy        = memfs_destroy,
     .thread_init    = memfs_thread_init,
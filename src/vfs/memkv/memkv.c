@@ -10,6 +10,16 @@
  * Storage is a fixed set of hash-sharded red-black trees keyed by
  * chimera_vfs_hash(key); each shard has its own mutex so unrelated keys do not
  * contend.  This is the same design that previously lived inside memfs.
+ *
+ * Every entry is also linked into an ordered index so range scans
+ * (search_keys) seek straight to the start key and stream in key order.  The
+ * index is MEMKV_INDEX_STRIPES skiplists ordered by raw key bytes, an entry
+ * living in the one its hash selects; each has its own rwlock, taken for
+ * write only when a key in that stripe is created or removed, so creates
+ * and deletes of unrelated keys rarely contend.  A scan read-locks every
+ * stripe and merges them.  Overwriting the value of an existing key touches
+ * the owning shard alone.  Lock order is index stripes (ascending) before
+ * shard.
  */
 
 #include <stdint.h>
@@ -34,6 +44,15 @@
 
 #define CHIMERA_MEMKV_DEFAULT_SHARDS 256
 
+/* Skiplist tower height cap; with p = 1/4 per level this covers 4^24 keys. */
+#define MEMKV_SKIP_MAX_HEIGHT        24
+
+/* Entries copied out per index read-lock hold during a range scan. */
+#define MEMKV_SEARCH_BATCH           64
+
+/* Independent skiplists the ordered index is split into. */
+#define MEMKV_INDEX_STRIPES          16
+
 #define chimera_memkv_error(...) chimera_error("memkv", \
                                                __FILE__, \
                                                __LINE__, \
@@ -49,6 +68,8 @@ struct memkv_entry {
     struct memkv_entry *next;
     void               *key;
     void               *value;
+    int                 height;
+    struct memkv_entry *skip[];
 };
 
 struct memkv_shard {
@@ -56,16 +77,164 @@ struct memkv_shard {
     pthread_mutex_t lock;
 };
 
+struct memkv_index {
+    pthread_rwlock_t    lock;
+    int                 height;
+    struct memkv_entry *head;
+};
+
 struct memkv_shared {
     struct memkv_shard *shards;
     int                 num_shards;
+    struct memkv_index  index[MEMKV_INDEX_STRIPES];
 };
 
 struct memkv_thread {
     struct memkv_shared *shared;
     struct memkv_entry  *free_entry;
+    uint64_t             rng;
 };
 
+static inline int
+memkv_key_cmp(
+    const void *a,
+    uint32_t    a_len,
+    const void *b,
+    uint32_t    b_len)
+{
+    uint32_t len = a_len < b_len ? a_len : b_len;
+    int      cmp = len ? memcmp(a, b, len) : 0;   /* an empty key may be NULL */
+
+    if (cmp) {
+        return cmp;
+    }
+    /* Shorter key (a byte-prefix of the other) sorts first. */
+    return (a_len > b_len) - (a_len < b_len);
+} /* memkv_key_cmp */
+
+static inline int
+memkv_random_height(struct memkv_thread *thread)
+{
+    uint64_t x      = thread->rng;
+    int      height = 1;
+
+    x          ^= x << 13;
+    x          ^= x >> 7;
+    x          ^= x << 17;
+    thread->rng = x;
+
+    while (height < MEMKV_SKIP_MAX_HEIGHT && (x & 3) == 0) {
+        height++;
+        x >>= 2;
+    }
+
+    return height;
+} /* memkv_random_height */
+
+static inline struct memkv_index *
+memkv_index_stripe(
+    struct memkv_shared *shared,
+    uint64_t             hash)
+{
+    return &shared->index[(hash >> 32) % MEMKV_INDEX_STRIPES];
+} /* memkv_index_stripe */
+
+/*
+ * Position on the first entry >= key (> key when strict) in one stripe.  When
+ * preds is non-NULL it receives, per level, the last entry ordered before
+ * that point.  Caller holds the stripe's lock.
+ */
+static struct memkv_entry *
+memkv_index_find(
+    struct memkv_index  *index,
+    const void          *key,
+    uint32_t             key_len,
+    int                  strict,
+    struct memkv_entry **preds)
+{
+    struct memkv_entry *x = index->head, *next;
+    int                 level, cmp;
+
+    for (level = index->height - 1; level >= 0; level--) {
+        while ((next = x->skip[level]) != NULL) {
+            cmp = memkv_key_cmp(next->key, next->key_len, key, key_len);
+            if (cmp > 0 || (cmp == 0 && !strict)) {
+                break;
+            }
+            x = next;
+        }
+        if (preds) {
+            preds[level] = x;
+        }
+    }
+
+    return x->skip[0];
+} /* memkv_index_find */
+
+/* Caller holds the stripe's lock for write. */
+static void
+memkv_index_insert(
+    struct memkv_index *index,
+    struct memkv_entry *entry)
+{
+    struct memkv_entry *preds[MEMKV_SKIP_MAX_HEIGHT];
+    int                 level;
+
+    memkv_index_find(index, entry->key, entry->key_len, 0, preds);
+
+    for (level = index->height; level < entry->height; level++) {
+        preds[level] = index->head;
+    }
+
+    if (entry->height > index->height) {
+        index->height = entry->height;
+    }
+
+    for (level = 0; level < entry->height; level++) {
+        entry->skip[level]        = preds[level]->skip[level];
+        preds[level]->skip[level] = entry;
+    }
+} /* memkv_index_insert */
+
+/* Caller holds the stripe's lock for write. */
+static void
+memkv_index_remove(
+    struct memkv_index *index,
+    struct memkv_entry *entry)
+{
+    struct memkv_entry *preds[MEMKV_SKIP_MAX_HEIGHT];
+    int                 level;
+
+    memkv_index_find(index, entry->key, entry->key_len, 0, preds);
+
+    for (level = 0; level < entry->height && level < index->height; level++) {
+        if (preds[level]->skip[level] == entry) {
+            preds[level]->skip[level] = entry->skip[level];
+        }
+    }
+
+    while (index->height > 1 && index->head->skip[index->height - 1] == NULL) {
+        index->height--;
+    }
+} /* memkv_index_remove */
+
+/* The stripe cursor holding the smallest key, or -1 when all are spent. */
+static inline int
+memkv_index_merge_min(struct memkv_entry **cursor)
+{
+    int i, min = -1;
+
+    for (i = 0; i < MEMKV_INDEX_STRIPES; i++) {
+        if (cursor[i] &&
+            (min < 0 || memkv_key_cmp(cursor[i]->key, cursor[i]->key_len,
+                                      cursor[min]->key, cursor[min]->key_len) < 0)) {
+            min = i;
+        }
+    }
+
+    return min;
+} /* memkv_index_merge_min */
+
 static inline struct memkv_entry *
 memkv_entry_alloc(
     struct memkv_thread *thread,
@@ -76,6 +245,7 @@ memkv_entry_alloc(
     uint32_t             value_len)
 {
     struct memkv_entry *entry;
+    int                 height;
 
     entry = thread->free_entry;
 
@@ -85,7 +255,11 @@ memkv_entry_alloc(
         free(entry->key);
         free(entry->value);
     } else {
-        entry = malloc(sizeof(*entry));
+        /* A recycled entry keeps its tower; deletion is independent of
+         * height, so the free list preserves the geometric distribution. */
+        height        = memkv_random_height(thread);
+        entry         = malloc(sizeof(*entry) + height * sizeof(entry->skip[0]));
+        entry->height = height;
     }
 
     entry->hash      = hash;
@@ -155,6 +329,14 @@ memkv_init(
         pthread_mutex_init(&shared->shards[i].lock, NULL);
     }
 
+    for (i = 0; i < MEMKV_INDEX_STRIPES; i++) {
+        shared->index[i].head = calloc(1, sizeof(*shared->index[i].head) +
+                                       MEMKV_SKIP_MAX_HEIGHT * sizeof(shared->index[i].head->skip[0]));
+        shared->index[i].head->height = MEMKV_SKIP_MAX_HEIGHT;
+        shared->index[i].height       = 1;
+        pthread_rwlock_init(&shared->index[i].lock, NULL);
+    }
+
     return shared;
 } /* memkv_init */
 
@@ -168,6 +350,10 @@ memkv_destroy(void *private_data)
         rb_tree_destroy(&shared->shards[i].entries, memkv_entry_release, NULL);
         pthread_mutex_destroy(&shared->shards[i].lock);
     }
+    for (i = 0; i < MEMKV_INDEX_STRIPES; i++) {
+        pthread_rwlock_destroy(&shared->index[i].lock);
+        free(shared->index[i].head);
+    }
     free(shared->shards);
     free(shared);
 } /* memkv_destroy */
@@ -182,6 +368,7 @@ memkv_thread_init(
 
     (void) evpl;
     thread->shared = shared;
+    thread->rng    = ((uint64_t) (uintptr_t) thread * 0x9e3779b97f4a7c15ULL) | 1;
 
     return thread;
 } /* memkv_thread_init */
@@ -212,26 +399,44 @@ memkv_put_key(
     uint64_t            hash;
     int                 shard_idx;
     struct memkv_shard *shard;
+    struct memkv_index *index;
     struct memkv_entry *entry, *existing;
 
     hash      = chimera_vfs_hash(request->put_key.key, request->put_key.key_len);
     shard_idx = hash % shared->num_shards;
     shard     = &shared->shards[shard_idx];
+    index     = memkv_index_stripe(shared, hash);
 
     pthread_mutex_lock(&shard->lock);
 
     rb_tree_query_exact(&shard->entries, hash, hash, existing);
 
+    if (!existing) {
+        /* New key: the ordered index changes too, and its stripe lock must
+         * be taken before the shard lock, so back out and re-check under
+         * both. */
+        pthread_mutex_unlock(&shard->lock);
+        pthread_rwlock_wrlock(&index->lock);
+        pthread_mutex_lock(&shard->lock);
+
+        rb_tree_query_exact(&shard->entries, hash, hash, existing);
+
+        if (!existing) {
+            entry = memkv_entry_alloc(thread, hash,
+                                      request->put_key.key, request->put_key.key_len,
+                                      request->put_key.value, request->put_key.value_len);
+            rb_tree_insert(&shard->entries, hash, entry);
+            memkv_index_insert(index, entry);
+        }
+
+        pthread_rwlock_unlock(&index->lock);
+    }
+
     if (existing) {
         free(existing->value);
         existing->value_len = request->put_key.value_len;
         existing->value     = malloc(request->put_key.value_len);
         memcpy(existing->value, request->put_key.value, request->put_key.value_len);
-    } else {
-        entry = memkv_entry_alloc(thread, hash,
-                                  request->put_key.key, request->put_key.key_len,
-                                  request->put_key.value, request->put_key.value_len);
-        rb_tree_insert(&shard->entries, hash, entry);
     }
 
     pthread_mutex_unlock(&shard->lock);
@@ -285,26 +490,32 @@ memkv_delete_key(
     uint64_t            hash;
     int                 shard_idx;
     struct memkv_shard *shard;
+    struct memkv_index *index;
     struct memkv_entry *entry;
 
     hash      = chimera_vfs_hash(request->delete_key.key, request->delete_key.key_len);
     shard_idx = hash % shared->num_shards;
     shard     = &shared->shards[shard_idx];
+    index     = memkv_index_stripe(shared, hash);
 
+    pthread_rwlock_wrlock(&index->lock);
     pthread_mutex_lock(&shard->lock);
 
     rb_tree_query_exact(&shard->entries, hash, hash, entry);
 
     if (!entry) {
         pthread_mutex_unlock(&shard->lock);
+        pthread_rwlock_unlock(&index->lock);
         request->status = CHIMERA_VFS_ENOENT;
         request->complete(request);
         return;
     }
 
     rb_tree_remove(&shard->entries, &entry->node);
+    memkv_index_remove(index, entry);
 
     pthread_mutex_unlock(&shard->lock);
+    pthread_rwlock_unlock(&index->lock);
 
     memkv_entry_free(thread, entry);
 
@@ -312,163 +523,153 @@ memkv_delete_key(
     request->complete(request);
 } /* memkv_delete_key */
 
-static int
-memkv_key_in_range(
+static inline int
+memkv_key_past_end(
     const void *key,
     uint32_t    key_len,
-    const void *start_key,
-    uint32_t    start_key_len,
     const void *end_key,
     uint32_t    end_key_len,
     uint32_t    flags)
 {
     int cmp;
 
-    /* Compare key to start_key */
-    if (start_key_len > 0) {
-        cmp = memcmp(key, start_key,
-                     key_len < start_key_len ? key_len : start_key_len);
-        if (cmp < 0 || (cmp == 0 && key_len < start_key_len)) {
-            return 0; /* key < start_key */
-        }
+    if (end_key_len == 0) {
+        return 0; /* unbounded */
     }
 
-    /* Compare key to end_key */
-    if (end_key_len > 0) {
-        cmp = memcmp(key, end_key,
-                     key_len < end_key_len ? key_len : end_key_len);
-        if (cmp > 0 || (cmp == 0 && key_len > end_key_len)) {
-            return 0; /* key > end_key */
-        }
-        if ((flags & CHIMERA_VFS_SEARCH_KEYS_END_EXCLUSIVE) &&
-            cmp == 0 && key_len == end_key_len) {
-            return 0; /* key == end_key, end is exclusive */
-        }
-    }
+    cmp = memkv_key_cmp(key, key_len, end_key, end_key_len);
 
-    return 1; /* key is in range */
-} /* memkv_key_in_range */
+    return cmp > 0 || (cmp == 0 && (flags & CHIMERA_VFS_SEARCH_KEYS_END_EXCLUSIVE));
+} /* memkv_key_past_end */
 
-/* One matched key/value, copied out from under the shard lock so the search
- * can sort across shards and invoke the callback without holding any lock (the
- * callback is caller-supplied and may re-enter the backend). */
+/* One matched key/value, copied out from under the locks so the callback runs
+ * without any lock held (it is caller-supplied and may re-enter the backend).
+ * Offsets index the per-search arena, which may move as it grows. */
 struct memkv_search_item {
-    void    *key;
+    size_t   key_off;
     uint32_t key_len;
-    void    *value;
+    size_t   value_off;
     uint32_t value_len;
 };
 
-static int
-memkv_search_item_cmp(
-    const void *a,
-    const void *b)
-{
-    const struct memkv_search_item *ia  = a;
-    const struct memkv_search_item *ib  = b;
-    uint32_t                        min = ia->key_len < ib->key_len ? ia->key_len : ib->key_len;
-    int                             cmp = memcmp(ia->key, ib->key, min);
-
-    if (cmp) {
-        return cmp;
-    }
-    /* Shorter key (a byte-prefix of the other) sorts first. */
-    return (ia->key_len > ib->key_len) - (ia->key_len < ib->key_len);
-} /* memkv_search_item_cmp */
-
 static void
 memkv_search_keys(
     struct memkv_thread        *thread,
     struct memkv_shared        *shared,
     struct chimera_vfs_request *request)
 {
-    int                                i;
-    size_t                             n = 0, cap = 0, k;
+    struct memkv_search_item           items[MEMKV_SEARCH_BATCH];
+    struct memkv_entry                *cursor[MEMKV_INDEX_STRIPES];
     struct memkv_shard                *shard;
     struct memkv_entry                *entry;
-    struct memkv_search_item          *items = NULL, *grown;
+    char                              *arena = NULL, *grown;
+    size_t                             arena_len, arena_cap = 0, need;
+    const void                        *seek_key = request->search_keys.start_key;
+    uint32_t                           seek_len = request->search_keys.start_key_len;
+    int                                strict   = 0;
+    int                                more;
+    int                                i, n, k;
     chimera_vfs_search_keys_callback_t callback = request->search_keys.callback;
     enum chimera_vfs_error             status   = CHIMERA_VFS_OK;
 
     (void) thread;
 
-    /* Entries are stored hash-ordered (sharded by hash), so collect every
-     * in-range match across all shards, then sort by key to return results in
-     * the backend's natural (lexicographic) key order.  Keys and values are
-     * copied so the callback runs without any shard lock held. */
-    for (i = 0; i < shared->num_shards; i++) {
-        shard = &shared->shards[i];
-
-        pthread_mutex_lock(&shard->lock);
+    /* Walk the ordered index a batch at a time: read-lock every stripe, seek
+     * each to the resume point, merge up to MEMKV_SEARCH_BATCH entries out
+     * (values under their shard lock), drop the locks, deliver, then re-seek
+     * past the last key delivered.  Keys created or removed between batches
+     * are seen or not as if the scan had raced them, but order is never
+     * violated. */
+    for (;;) {
+        n         = 0;
+        arena_len = 0;
+        more      = 0;
+
+        for (i = 0; i < MEMKV_INDEX_STRIPES; i++) {
+            pthread_rwlock_rdlock(&shared->index[i].lock);
+            cursor[i] = memkv_index_find(&shared->index[i], seek_key, seek_len,
+                                         strict, NULL);
+        }
 
-        rb_tree_first(&shard->entries, entry);
+        while ((i = memkv_index_merge_min(cursor)) >= 0) {
+            entry = cursor[i];
 
-        while (entry) {
-            if (memkv_key_in_range(entry->key,
-                                   entry->key_len,
-                                   request->search_keys.start_key,
-                                   request->search_keys.start_key_len,
+            if (memkv_key_past_end(entry->key, entry->key_len,
                                    request->search_keys.end_key,
                                    request->search_keys.end_key_len,
                                    request->search_keys.flags)) {
-                struct memkv_search_item *item;
-
-                if (n == cap) {
-                    cap   = cap ? cap * 2 : 16;
-                    grown = realloc(items, cap * sizeof(*items));
-                    if (!grown) {
-                        pthread_mutex_unlock(&shard->lock);
-                        status = CHIMERA_VFS_EIO;
-                        goto out;
-                    }
-                    items = grown;
-                }
+                break;
+            }
+
+            if (n == MEMKV_SEARCH_BATCH) {
+                more = 1;
+                break;
+            }
+
+            shard = &shared->shards[entry->hash % shared->num_shards];
 
-                item            = &items[n];
-                item->key_len   = entry->key_len;
-                item->value_len = entry->value_len;
-                item->key       = malloc(entry->key_len);
-                item->value     = entry->value_len ? malloc(entry->value_len) : NULL;
+            pthread_mutex_lock(&shard->lock);
 
-                if (!item->key || (entry->value_len && !item->value)) {
-                    free(item->key);
-                    free(item->value);
+            need = (size_t) entry->key_len + entry->value_len;
+
+            if (arena_len + need > arena_cap) {
+                arena_cap = arena_cap ? arena_cap : 4096;
+                while (arena_len + need > arena_cap) {
+                    arena_cap *= 2;
+                }
+                grown = realloc(arena, arena_cap);
+                if (!grown) {
                     pthread_mutex_unlock(&shard->lock);
+                    for (i = MEMKV_INDEX_STRIPES - 1; i >= 0; i--) {
+                        pthread_rwlock_unlock(&shared->index[i].lock);
+                    }
                     status = CHIMERA_VFS_EIO;
                     goto out;
                 }
-
-                memcpy(item->key, entry->key, entry->key_len);
-                if (entry->value_len) {
-                    memcpy(item->value, entry->value, entry->value_len);
-                }
-                n++;
+                arena = grown;
             }
 
-            entry = rb_tree_next(&shard->entries, entry);
+            items[n].key_off   = arena_len;
+            items[n].key_len   = entry->key_len;
+            memcpy(arena + arena_len, entry->key, entry->key_len);
+            arena_len         += entry->key_len;
+            items[n].value_off = arena_len;
+            items[n].value_len = entry->value_len;
+            memcpy(arena + arena_len, entry->value, entry->value_len);
+            arena_len         += entry->value_len;
+
+            pthread_mutex_unlock(&shard->lock);
+
+            n++;
+            cursor[i] = entry->skip[0];
         }
 
-        pthread_mutex_unlock(&shard->lock);
-    }
+        for (i = MEMKV_INDEX_STRIPES - 1; i >= 0; i--) {
+            pthread_rwlock_unlock(&shared->index[i].lock);
+        }
 
-    if (n > 1) {
-        qsort(items, n, sizeof(*items), memkv_search_item_cmp);
-    }
+        for (k = 0; k < n; k++) {
+            if (callback(arena + items[k].key_off, items[k].key_len,
+                         items[k].value_len ? arena + items[k].value_off : NULL,
+                         items[k].value_len,
+                         request->proto_private_data)) {
+                goto out; /* caller aborted the search */
+            }
+        }
 
-    for (k = 0; k < n; k++) {
-        if (callback(items[k].key, items[k].key_len,
-                     items[k].value, items[k].value_len,
-                     request->proto_private_data)) {
-            break; /* caller aborted the search */
+        if (!more) {
+            break;
         }
+
+        /* The resume key lives in the arena, which the next batch only
+         * overwrites after the seek has consumed it. */
+        seek_key = arena + items[n - 1].key_off;
+        seek_len = items[n - 1].key_len;
+        strict   = 1;
     }
 
  out:
-    for (k = 0; k < n; k++) {
-        free(items[k].key);
-        free(items[k].value);
-    }
-    free(items);
+    free(arena);
 
     request->status = status;
     request->complete(request);
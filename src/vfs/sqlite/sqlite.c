@@ -10,17 +10,43 @@
  *     CREATE TABLE kv (key BLOB PRIMARY KEY, value BLOB NOT NULL) WITHOUT ROWID;
  *
  * The database runs in WAL journal mode so multiple reader threads and a writer
- * can operate concurrently.  Each VFS thread owns its own sqlite3 connection
+ * can operate concurrently.  Each VFS thread owns its own sqlite3 connections
  * (sqlite connections are not safe to share across threads); the module is
  * declared CAP_BLOCKING so the synchronous sqlite calls run on delegation
  * threads rather than the event-loop core threads.
+ *
+ * Each thread keeps two connections:
+ *   - a read-write connection for put/delete.  The first mutation a
+ *     delegation thread drains opens a BEGIN IMMEDIATE transaction; every
+ *     mutation drained after it joins, and the request is parked rather than
+ *     completed.  A deferral armed on the thread's evpl commits once the
+ *     drain loop goes idle (or inline at CHIMERA_SQLITE_BATCH_MAX_OPS) and
+ *     only then completes the parked requests, so a burst of DRC or
+ *     handle-state writes shares one WAL commit.
+ *
+ *     The transaction holds the database write lock, so threads take turns
+ *     through a FIFO ticket lock in the shared state before BEGIN, instead of
+ *     spinning in sqlite's busy handler.  A thread holding it commits as
+ *     soon as another thread is queued -- right after its current mutation,
+ *     or before it runs a read -- so batching only spans requests nobody
+ *     else is waiting behind.
+ *   - a read-only, memory-mapped connection for get/search_keys.  It sees
+ *     committed data only, never another request's parked mutation, and
+ *     never contends for the write lock.  search_keys statements are
+ *     prepared once per range shape and reused.
+ *
+ * Config: "path" (required) and "mmap_size" (bytes of the database file the
+ * connections memory-map, default CHIMERA_SQLITE_MMAP_SIZE; 0 disables).
  */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sqlite3.h>
 #include <jansson.h>
+#include <utlist.h>
 
 #include "vfs/vfs.h"
 #include "vfs/vfs_internal.h"
@@ -29,6 +55,14 @@
 #include "common/macros.h"
 
 #define CHIMERA_SQLITE_BUSY_TIMEOUT_MS 5000
+#define CHIMERA_SQLITE_MMAP_SIZE       (256LL * 1024 * 1024)
+
+/* Upper bound on mutations parked in one transaction before it is committed
+ * inline, bounding the wait of the first request in a long drain. */
+#define CHIMERA_SQLITE_BATCH_MAX_OPS   64
+
+/* search_keys shapes: bit 0 end bound, bit 1 start bound, bit 2 exclusive end. */
+#define CHIMERA_SQLITE_SEARCH_SHAPES   8
 
 #define chimera_sqlite_error(...) chimera_error("sqlite", \
                                                 __FILE__, \
@@ -38,15 +72,45 @@
         chimera_abort_if(cond, "sqlite", __FILE__, __LINE__, __VA_ARGS__)
 
 struct sqlite_shared {
-    char *path;
+    char           *path;
+    long long       mmap_size;
+    /* Write turn: FIFO ticket lock held for the life of a transaction. */
+    pthread_mutex_t write_lock;
+    pthread_cond_t  write_cond;
+    uint64_t        write_next;
+    uint64_t        write_serving;
+    int             write_waiting;
 };
 
 struct sqlite_thread {
-    struct sqlite_shared *shared;
-    sqlite3              *db;
-    sqlite3_stmt         *put_stmt;
-    sqlite3_stmt         *get_stmt;
-    sqlite3_stmt         *del_stmt;
+    struct sqlite_shared       *shared;
+    struct evpl                *evpl;
+    sqlite3                    *db;
+    sqlite3                    *ro_db;
+    sqlite3_stmt               *put_stmt;
+    sqlite3_stmt               *get_stmt;
+    sqlite3_stmt               *del_stmt;
+    sqlite3_stmt               *begin_stmt;
+    sqlite3_stmt               *commit_stmt;
+    sqlite3_stmt               *rollback_stmt;
+    sqlite3_stmt               *search_stmt[CHIMERA_SQLITE_SEARCH_SHAPES];
+    /* Mutations applied in the open transaction, completed at commit. */
+    struct chimera_vfs_request *pending;
+    int                         pending_count;
+    int                         txn_open;
+    int                         commit_scheduled;
+    struct evpl_deferral        commit;
+};
+
+static const char *sqlite_search_sql[CHIMERA_SQLITE_SEARCH_SHAPES] = {
+    "SELECT key,value FROM kv ORDER BY key",
+    "SELECT key,value FROM kv WHERE key<=? ORDER BY key",
+    "SELECT key,value FROM kv WHERE key>=? ORDER BY key",
+    "SELECT key,value FROM kv WHERE key>=? AND key<=? ORDER BY key",
+    "SELECT key,value FROM kv ORDER BY key",
+    "SELECT key,value FROM kv WHERE key<? ORDER BY key",
+    "SELECT key,value FROM kv WHERE key>=? ORDER BY key",
+    "SELECT key,value FROM kv WHERE key>=? AND key<? ORDER BY key",
 };
 
 static void *
@@ -73,7 +137,16 @@ sqlite_init(
     path = json_string_value(json_object_get(cfg, "path"));
     chimera_sqlite_abort_if(!path, "sqlite: 'path' missing in config");
 
-    shared->path = strdup(path);
+    shared->path      = strdup(path);
+    shared->mmap_size = CHIMERA_SQLITE_MMAP_SIZE;
+
+    pthread_mutex_init(&shared->write_lock, NULL);
+    pthread_cond_init(&shared->write_cond, NULL);
+
+    json_t *mmap_obj = json_object_get(cfg, "mmap_size");
+    if (mmap_obj && json_is_integer(mmap_obj) && json_integer_value(mmap_obj) >= 0) {
+        shared->mmap_size = json_integer_value(mmap_obj);
+    }
 
     /* Open once at init to create the schema and switch the database file into
      * WAL mode (WAL is a persistent property of the file, so per-thread
@@ -106,10 +179,84 @@ sqlite_destroy(void *private_data)
 {
     struct sqlite_shared *shared = private_data;
 
+    pthread_cond_destroy(&shared->write_cond);
+    pthread_mutex_destroy(&shared->write_lock);
     free(shared->path);
     free(shared);
 } /* sqlite_destroy */
 
+/* Wait for this thread's turn to hold the database write lock. */
+static void
+sqlite_write_turn_begin(struct sqlite_shared *shared)
+{
+    uint64_t ticket;
+
+    pthread_mutex_lock(&shared->write_lock);
+
+    ticket = shared->write_next++;
+
+    if (ticket != shared->write_serving) {
+        __atomic_add_fetch(&shared->write_waiting, 1, __ATOMIC_RELAXED);
+
+        while (ticket != shared->write_serving) {
+            pthread_cond_wait(&shared->write_cond, &shared->write_lock);
+        }
+
+        __atomic_sub_fetch(&shared->write_waiting, 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&shared->write_lock);
+} /* sqlite_write_turn_begin */
+
+static void
+sqlite_write_turn_end(struct sqlite_shared *shared)
+{
+    pthread_mutex_lock(&shared->write_lock);
+    shared->write_serving++;
+    pthread_cond_broadcast(&shared->write_cond);
+    pthread_mutex_unlock(&shared->write_lock);
+} /* sqlite_write_turn_end */
+
+/* True if another thread is queued for the write turn this one holds. */
+static inline int
+sqlite_write_contended(struct sqlite_thread *thread)
+{
+    return thread->txn_open &&
+           __atomic_load_n(&thread->shared->write_waiting, __ATOMIC_RELAXED);
+} /* sqlite_write_contended */
+
+static void
+sqlite_thread_flush(
+    struct sqlite_thread  *thread,
+    enum chimera_vfs_error status);
+
+static void
+sqlite_thread_commit(
+    struct evpl *evpl,
+    void        *private_data)
+{
+    struct sqlite_thread *thread = private_data;
+
+    (void) evpl;
+
+    thread->commit_scheduled = 0;
+
+    sqlite_thread_flush(thread, CHIMERA_VFS_OK);
+} /* sqlite_thread_commit */
+
+static void
+sqlite_prepare(
+    sqlite3       *db,
+    const char    *sql,
+    sqlite3_stmt **stmt)
+{
+    int rc;
+
+    rc = sqlite3_prepare_v2(db, sql, -1, stmt, NULL);
+    chimera_sqlite_abort_if(rc != SQLITE_OK, "sqlite: prepare '%s': %s",
+                            sql, sqlite3_errmsg(db));
+} /* sqlite_prepare */
+
 static void *
 sqlite_thread_init(
     struct evpl *evpl,
@@ -117,10 +264,15 @@ sqlite_thread_init(
 {
     struct sqlite_shared *shared = private_data;
     struct sqlite_thread *thread = calloc(1, sizeof(*thread));
+    char                  pragma[64];
     int                   rc;
 
-    (void) evpl;
     thread->shared = shared;
+    thread->evpl   = evpl;
+
+    evpl_deferral_init(&thread->commit, sqlite_thread_commit, thread);
+
+    snprintf(pragma, sizeof(pragma), "PRAGMA mmap_size=%lld;", shared->mmap_size);
 
     rc = sqlite3_open(shared->path, &thread->db);
     chimera_sqlite_abort_if(rc != SQLITE_OK, "sqlite: thread open '%s': %s",
@@ -128,24 +280,22 @@ sqlite_thread_init(
 
     sqlite3_busy_timeout(thread->db, CHIMERA_SQLITE_BUSY_TIMEOUT_MS);
     sqlite3_exec(thread->db, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+    sqlite3_exec(thread->db, pragma, NULL, NULL, NULL);
 
-    rc = sqlite3_prepare_v2(thread->db,
-                            "INSERT OR REPLACE INTO kv(key,value) VALUES(?,?)",
-                            -1, &thread->put_stmt, NULL);
-    chimera_sqlite_abort_if(rc != SQLITE_OK, "sqlite: prepare put: %s",
-                            sqlite3_errmsg(thread->db));
+    rc = sqlite3_open_v2(shared->path, &thread->ro_db,
+                         SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
+    chimera_sqlite_abort_if(rc != SQLITE_OK, "sqlite: thread open read-only '%s': %s",
+                            shared->path, sqlite3_errmsg(thread->ro_db));
 
-    rc = sqlite3_prepare_v2(thread->db,
-                            "SELECT value FROM kv WHERE key=?",
-                            -1, &thread->get_stmt, NULL);
-    chimera_sqlite_abort_if(rc != SQLITE_OK, "sqlite: prepare get: %s",
-                            sqlite3_errmsg(thread->db));
+    sqlite3_busy_timeout(thread->ro_db, CHIMERA_SQLITE_BUSY_TIMEOUT_MS);
+    sqlite3_exec(thread->ro_db, pragma, NULL, NULL, NULL);
 
-    rc = sqlite3_prepare_v2(thread->db,
-                            "DELETE FROM kv WHERE key=?",
-                            -1, &thread->del_stmt, NULL);
-    chimera_sqlite_abort_if(rc != SQLITE_OK, "sqlite: prepare delete: %s",
-                            sqlite3_errmsg(thread->db));
+    sqlite_prepare(thread->db, "INSERT OR REPLACE INTO kv(key,value) VALUES(?,?)", &thread->put_stmt);
+    sqlite_prepare(thread->db, "DELETE FROM kv WHERE key=?", &thread->del_stmt);
+    sqlite_prepare(thread->db, "BEGIN IMMEDIATE", &thread->begin_stmt);
+    sqlite_prepare(thread->db, "COMMIT", &thread->commit_stmt);
+    sqlite_prepare(thread->db, "ROLLBACK", &thread->rollback_stmt);
+    sqlite_prepare(thread->ro_db, "SELECT value FROM kv WHERE key=?", &thread->get_stmt);
 
     return thread;
 } /* sqlite_thread_init */
@@ -154,14 +304,136 @@ static void
 sqlite_thread_destroy(void *private_data)
 {
     struct sqlite_thread *thread = private_data;
+    int                   i;
+
+    sqlite_thread_flush(thread, CHIMERA_VFS_OK);
 
     sqlite3_finalize(thread->put_stmt);
     sqlite3_finalize(thread->get_stmt);
     sqlite3_finalize(thread->del_stmt);
+    sqlite3_finalize(thread->begin_stmt);
+    sqlite3_finalize(thread->commit_stmt);
+    sqlite3_finalize(thread->rollback_stmt);
+    for (i = 0; i < CHIMERA_SQLITE_SEARCH_SHAPES; i++) {
+        sqlite3_finalize(thread->search_stmt[i]);
+    }
+    sqlite3_close(thread->ro_db);
     sqlite3_close(thread->db);
     free(thread);
 } /* sqlite_thread_destroy */
 
+/*
+ * End the open transaction and complete every parked mutation.  Commits
+ * when status is OK, otherwise (or if the commit fails) rolls back and fails
+ * them all with EIO.  Safe to call with nothing open.
+ */
+static void
+sqlite_thread_flush(
+    struct sqlite_thread  *thread,
+    enum chimera_vfs_error status)
+{
+    struct chimera_vfs_request *request;
+    int                         rc;
+
+    if (thread->txn_open) {
+        if (status == CHIMERA_VFS_OK) {
+            rc = sqlite3_step(thread->commit_stmt);
+            sqlite3_reset(thread->commit_stmt);
+
+            if (rc != SQLITE_DONE) {
+                chimera_sqlite_error("commit failed: %s", sqlite3_errmsg(thread->db));
+                status = CHIMERA_VFS_EIO;
+            }
+        }
+
+        /* A failed COMMIT (e.g. BUSY) leaves the transaction open, and some
+         * statement errors have already rolled it back; only roll back what
+         * is still there. */
+        if (status != CHIMERA_VFS_OK && !sqlite3_get_autocommit(thread->db)) {
+            sqlite3_step(thread->rollback_stmt);
+            sqlite3_reset(thread->rollback_stmt);
+        }
+
+        thread->txn_open = 0;
+        sqlite_write_turn_end(thread->shared);
+    }
+
+    while (thread->pending) {
+        request = thread->pending;
+        DL_DELETE(thread->pending, request);
+        if (status != CHIMERA_VFS_OK) {
+            request->status = status;
+        }
+        request->complete(request);
+    }
+
+    thread->pending_count = 0;
+} /* sqlite_thread_flush */
+
+static int
+sqlite_txn_begin(struct sqlite_thread *thread)
+{
+    int rc;
+
+    if (thread->txn_open) {
+        return 0;
+    }
+
+    sqlite_write_turn_begin(thread->shared);
+
+    /* IMMEDIATE takes the write lock up front, so a statement never has to
+     * upgrade a read lock mid-transaction (which can fail BUSY without
+     * honouring the busy timeout). */
+    rc = sqlite3_step(thread->begin_stmt);
+    sqlite3_reset(thread->begin_stmt);
+
+    if (rc != SQLITE_DONE) {
+        chimera_sqlite_error("begin failed: %s", sqlite3_errmsg(thread->db));
+        sqlite_write_turn_end(thread->shared);
+        return -1;
+    }
+
+    thread->txn_open = 1;
+
+    if (!thread->commit_scheduled) {
+        thread->commit_scheduled = 1;
+        evpl_defer(thread->evpl, &thread->commit);
+    }
+
+    return 0;
+} /* sqlite_txn_begin */
+
+/*
+ * Finish a mutation step.  A successful one parks the request until its
+ * transaction commits.  A failed one is completed with EIO now; if the
+ * failure also rolled the transaction back, the mutations parked ahead of it
+ * are lost too and fail with it.
+ */
+static void
+sqlite_txn_finish(
+    struct sqlite_thread       *thread,
+    struct chimera_vfs_request *request,
+    int                         ok)
+{
+    if (!ok) {
+        request->status = CHIMERA_VFS_EIO;
+        request->complete(request);
+
+        if (sqlite3_get_autocommit(thread->db)) {
+            sqlite_thread_flush(thread, CHIMERA_VFS_EIO);
+        }
+        return;
+    }
+
+    DL_APPEND(thread->pending, request);
+
+    /* commit_scheduled stays set; the armed deferral finds nothing open. */
+    if (++thread->pending_count >= CHIMERA_SQLITE_BATCH_MAX_OPS ||
+        sqlite_write_contended(thread)) {
+        sqlite_thread_flush(thread, CHIMERA_VFS_OK);
+    }
+} /* sqlite_txn_finish */
+
 static void
 sqlite_put_key(
     struct sqlite_thread       *thread,
@@ -170,6 +442,12 @@ sqlite_put_key(
     sqlite3_stmt *stmt = thread->put_stmt;
     int           rc;
 
+    if (sqlite_txn_begin(thread)) {
+        request->status = CHIMERA_VFS_EIO;
+        request->complete(request);
+        return;
+    }
+
     sqlite3_bind_blob(stmt, 1, request->put_key.key, request->put_key.key_len, SQLITE_STATIC);
     sqlite3_bind_blob(stmt, 2, request->put_key.value, request->put_key.value_len, SQLITE_STATIC);
 
@@ -180,12 +458,11 @@ sqlite_put_key(
 
     if (rc != SQLITE_DONE) {
         chimera_sqlite_error("put_key step failed: %s", sqlite3_errmsg(thread->db));
-        request->status = CHIMERA_VFS_EIO;
     } else {
         request->status = CHIMERA_VFS_OK;
     }
 
-    request->complete(request);
+    sqlite_txn_finish(thread, request, rc == SQLITE_DONE);
 } /* sqlite_put_key */
 
 static void
@@ -237,7 +514,7 @@ sqlite_get_key(
     if (rc == SQLITE_DONE) {
         request->status = CHIMERA_VFS_ENOENT;
     } else {
-        chimera_sqlite_error("get_key step failed: %s", sqlite3_errmsg(thread->db));
+        chimera_sqlite_error("get_key step failed: %s", sqlite3_errmsg(thread->ro_db));
         request->status = CHIMERA_VFS_EIO;
     }
 
@@ -252,6 +529,12 @@ sqlite_delete_key(
     sqlite3_stmt *stmt = thread->del_stmt;
     int           rc, changes;
 
+    if (sqlite_txn_begin(thread)) {
+        request->status = CHIMERA_VFS_EIO;
+        request->complete(request);
+        return;
+    }
+
     sqlite3_bind_blob(stmt, 1, request->delete_key.key, request->delete_key.key_len, SQLITE_STATIC);
 
     rc      = sqlite3_step(stmt);
@@ -262,14 +545,13 @@ sqlite_delete_key(
 
     if (rc != SQLITE_DONE) {
         chimera_sqlite_error("delete_key step failed: %s", sqlite3_errmsg(thread->db));
-        request->status = CHIMERA_VFS_EIO;
     } else if (changes == 0) {
         request->status = CHIMERA_VFS_ENOENT;
     } else {
         request->status = CHIMERA_VFS_OK;
     }
 
-    request->complete(request);
+    sqlite_txn_finish(thread, request, rc == SQLITE_DONE);
 } /* sqlite_delete_key */
 
 static void
@@ -283,43 +565,30 @@ sqlite_search_keys(
     const void                        *end       = request->search_keys.end_key;
     uint32_t                           end_len   = request->search_keys.end_key_len;
     uint32_t                           flags     = request->search_keys.flags;
-    sqlite3_stmt                      *stmt      = NULL;
-    const char                        *sql;
+    sqlite3_stmt                      *stmt;
+    int                                shape;
     int                                bind_idx = 1;
     int                                rc, aborted = 0;
 
     /* BLOB comparison in sqlite is bytewise (memcmp with the shorter blob
      * ordering first), matching the range semantics used by the other KV
      * backends.  The start bound is inclusive; the end bound is inclusive
-     * unless END_EXCLUSIVE is set. */
-    if (flags & CHIMERA_VFS_SEARCH_KEYS_END_EXCLUSIVE) {
-        if (start_len && end_len) {
-            sql = "SELECT key,value FROM kv WHERE key>=? AND key<? ORDER BY key";
-        } else if (start_len) {
-            sql = "SELECT key,value FROM kv WHERE key>=? ORDER BY key";
-        } else if (end_len) {
-            sql = "SELECT key,value FROM kv WHERE key<? ORDER BY key";
-        } else {
-            sql = "SELECT key,value FROM kv ORDER BY key";
-        }
-    } else {
-        if (start_len && end_len) {
-            sql = "SELECT key,value FROM kv WHERE key>=? AND key<=? ORDER BY key";
-        } else if (start_len) {
-            sql = "SELECT key,value FROM kv WHERE key>=? ORDER BY key";
-        } else if (end_len) {
-            sql = "SELECT key,value FROM kv WHERE key<=? ORDER BY key";
-        } else {
-            sql = "SELECT key,value FROM kv ORDER BY key";
-        }
-    }
+     * unless END_EXCLUSIVE is set.  Each range shape's statement is prepared
+     * on first use and kept. */
+    shape = (end_len ? 1 : 0) | (start_len ? 2 : 0) |
+        ((flags & CHIMERA_VFS_SEARCH_KEYS_END_EXCLUSIVE) ? 4 : 0);
 
-    rc = sqlite3_prepare_v2(thread->db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        chimera_sqlite_error("search_keys prepare failed: %s", sqlite3_errmsg(thread->db));
-        request->status = CHIMERA_VFS_EIO;
-        request->complete(request);
-        return;
+    stmt = thread->search_stmt[shape];
+
+    if (!stmt) {
+        rc = sqlite3_prepare_v2(thread->ro_db, sqlite_search_sql[shape], -1, &stmt, NULL);
+        if (rc != SQLITE_OK) {
+            chimera_sqlite_error("search_keys prepare failed: %s", sqlite3_errmsg(thread->ro_db));
+            request->status = CHIMERA_VFS_EIO;
+            request->complete(request);
+            return;
+        }
+        thread->search_stmt[shape] = stmt;
     }
 
     if (start_len) {
@@ -341,15 +610,16 @@ sqlite_search_keys(
         }
     }
 
-    sqlite3_finalize(stmt);
-
     if (!aborted && rc != SQLITE_DONE && rc != SQLITE_ROW) {
-        chimera_sqlite_error("search_keys step failed: %s", sqlite3_errmsg(thread->db));
+        chimera_sqlite_error("search_keys step failed: %s", sqlite3_errmsg(thread->ro_db));
         request->status = CHIMERA_VFS_EIO;
     } else {
         request->status = CHIMERA_VFS_OK;
     }
 
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
     request->complete(request);
 } /* sqlite_search_keys */
 
@@ -360,6 +630,12 @@ sqlite_dispatch(
 {
     struct sqlite_thread *thread = private_data;
 
+    /* Hand the write turn over before running anything else, rather than
+     * keep a queued thread waiting on requests that are not its own */
+    if (sqlite_write_contended(thread)) {
+        sqlite_thread_flush(thread, CHIMERA_VFS_OK);
+    }
+
     switch (request->opcode) {
         case CHIMERA_VFS_OP_PUT_KEY:
             sqlite_put_key(thread, request);
@@ -0,0 +1,256 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * Table-driven tests for the SMB directory wildcard matcher
+ * (chimera_vfs_dirent_match, MS-FSA 2.1.4.4).  Each row is a pattern, a name
+ * and the expected verdict; the rows are grouped by the path through the
+ * matcher they exercise -- the no-filter shortcuts, the literal and
+ * prefix/suffix fast paths, and each metacharacter in the NFA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include "vfs/vfs_procs.h"
+
+#define TEST_PASS(name) fprintf(stderr, "  PASS: %s\n", name)
+
+struct match_case {
+    const char *pattern;
+    const char *name;
+    int         expect;
+};
+
+static void
+run_cases(
+    const struct match_case *cases,
+    int                      ncases)
+{
+    int i, got;
+
+    for (i = 0; i < ncases; i++) {
+        got = chimera_vfs_dirent_match(cases[i].name, strlen(cases[i].name),
+                                       cases[i].pattern,
+                                       strlen(cases[i].pattern));
+        if (got != cases[i].expect) {
+            fprintf(stderr, "  FAIL: pattern '%s' name '%s': got %d, want %d\n",
+                    cases[i].pattern, cases[i].name, got, cases[i].expect);
+        }
+        assert(got == cases[i].expect);
+    }
+} /* run_cases */
+
+#define RUN_CASES(cases) run_cases(cases, sizeof(cases) / sizeof(cases[0]))
+
+/* NULL, empty and "*" patterns match everything without compiling. */
+static void
+test_no_filter(void)
+{
+    assert(chimera_vfs_dirent_match("foo", 3, NULL, 0) == 1);
+    assert(chimera_vfs_dirent_match("foo", 3, "", 0) == 1);
+    assert(chimera_vfs_dirent_match("foo", 3, "*", 1) == 1);
+    assert(chimera_vfs_dirent_match("", 0, "*", 1) == 1);
+
+    TEST_PASS("NULL/empty/\"*\" patterns match everything");
+} /* test_no_filter */
+
+/* No metacharacters: a case-insensitive whole-name compare. */
+static void
+test_literal(void)
+{
+    static const struct match_case cases[] = {
+        { "foo.txt", "foo.txt",  1 },
+        { "foo.txt", "FOO.TXT",  1 },
+        { "FoO",     "fOo",      1 },
+        { "foo.txt", "foo.txt2", 0 },
+        { "foo.txt", "foo.tx",   0 },
+        { "foo",     "bar",      0 },
+        { "foo",     "",         0 },
+    };
+
+    RUN_CASES(cases);
+    TEST_PASS("literal patterns");
+} /* test_literal */
+
+/* Leading and trailing literal runs are checked before the NFA runs. */
+static void
+test_prefix_suffix(void)
+{
+    static const struct match_case cases[] = {
+        { "*.txt", "a.txt",     1 },
+        { "*.txt", "A.TXT",     1 },
+        { "*.txt", ".txt",      1 },
+        { "*.txt", "a.txt.bak", 0 },
+        { "*.txt", "txt",       0 },
+        { "foo*",  "foo",       1 },
+        { "foo*",  "foobar",    1 },
+        { "foo*",  "fo",        0 },
+        { "foo*",  "xfoo",      0 },
+        { "a*z",   "az",        1 },
+        { "a*z",   "abcz",      1 },
+        { "a*z",   "abc",       0 },
+        { "ab*ba", "aba",       0 },
+        { "ab*ba", "abba",      1 },
+    };
+
+    RUN_CASES(cases);
+    TEST_PASS("prefix/suffix fast paths");
+} /* test_prefix_suffix */
+
+/* '*' and '?': the plain wildcards. */
+static void
+test_star_qm(void)
+{
+    static const struct match_case cases[] = {
+        { "**",         "",                               1 },
+        { "*a*b*",      "xaxbx",                          1 },
+        { "*a*b*",      "ab",                             1 },
+        { "*a*b*",      "ba",                             0 },
+        { "*.*",        "noext",                          0 },
+        { "*.*",        "a.b.c",                          1 },
+        { "?",          "a",                              1 },
+        { "?",          "",                               0 },
+        { "?",          "ab",                             0 },
+        { "a?c",        "abc",                            1 },
+        { "a?c",        "a.c",                            1 },
+        { "a?c",        "ac",                             0 },
+        { "a?c",        "abbc",                           0 },
+        { "*?*?*?*?*",  "abcd",                           1 },
+        { "*?*?*?*?*",  "abc",                            0 },
+        { "*a*a*a*a*b", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 0 },
+    };
+
+    RUN_CASES(cases);
+    TEST_PASS("'*' and '?'");
+} /* test_star_qm */
+
+/* '<' (DOS_STAR): zero or more, but never past the name's last '.'.  One
+ * entered after the last '.' (or in a name with none) consumes freely. */
+static void
+test_dos_star(void)
+{
+    static const struct match_case cases[] = {
+        /* No dot: nothing to stop at. */
+        { "<",      "abc",       1 },
+        { "<",      "",          1 },
+        /* May consume up to and including the last '.', not past it. */
+        { "<",      "a.b",       0 },
+        { "<",      "a.",        1 },
+        { "<b",     "a.b",       1 },
+        { "<b",     "a.bb",      0 },
+        { "<.txt",  "a.txt",     1 },
+        { "<.txt",  "a.b.txt",   1 },
+        { "<.txt",  "a.b.txt.x", 0 },
+        /* Several dots: only the last one bounds it. */
+        { "<.gz",   "x.tar.gz",  1 },
+        { "<.tar",  "x.tar.gz",  0 },
+        { "<.<",    "x.tar.gz",  1 },
+        /* Entered past the last '.' (dos_post): consumes to the end. */
+        { "*.<",    "a.bcd",     1 },
+        { "a.<",    "a.b.c",     0 },
+        { "?<",     "abc",       1 },
+        { "x.<",    "x.",        1 },
+    };
+
+    RUN_CASES(cases);
+    TEST_PASS("'<' (DOS_STAR)");
+} /* test_dos_star */
+
+/* '>' (DOS_QM): one char, but stops at a '.', and at end-of-name matches if
+ * the rest of the pattern can match nothing. */
+static void
+test_dos_qm(void)
+{
+    static const struct match_case cases[] = {
+        { "a>",       "ab",       1 },
+        { "a>",       "a",        1 },
+        { "a>",       "abc",      0 },
+        { ">>>",      "ab",       1 },
+        { ">>>",      "abcd",     0 },
+        /* 8.3 "???.txt" downconverted: short base names still match. */
+        { ">>>.txt",  "ab.txt",   1 },
+        { ">>>.txt",  "abc.txt",  1 },
+        { ">>>.txt",  "abcd.txt", 0 },
+        { ">>>.txt",  "ab.doc",   0 },
+        /* A final '.' is absorbed like end-of-name. */
+        { "a>",       "a.",       1 },
+        { "a>b",      "a.b",      0 },
+        { "a>.b",     "a.b",      1 },
+    };
+
+    RUN_CASES(cases);
+    TEST_PASS("'>' (DOS_QM)");
+} /* test_dos_qm */
+
+/* '"' (DOS_DOT): a '.', or end-of-name if the rest can match nothing. */
+static void
+test_dos_dot(void)
+{
+    static const struct match_case cases[] = {
+        { "foo\"",    "foo",        1 },
+        { "foo\"",    "foo.",       1 },
+        { "foo\"",    "foox",       0 },
+        { "a\"b",     "a.b",        1 },
+        { "a\"b",     "axb",        0 },
+        { "a\"b",     "ab",         0 },
+        /* "*." downconverted: names with no extension. */
+        { "<\"",      "readme",     1 },
+        { "<\"",      "a.b",        0 },
+        { "foo\">>>", "foo",        1 },
+        { "foo\">>>", "foo.c",      1 },
+        { "foo\">>>", "foo.tar.gz", 0 },
+    };
+
+    RUN_CASES(cases);
+    TEST_PASS("'\"' (DOS_DOT)");
+} /* test_dos_dot */
+
+/* Patterns and names are both cut to CHIMERA_VFS_NAME_MAX - 1 bytes. */
+static void
+test_truncation(void)
+{
+    char name[CHIMERA_VFS_NAME_MAX + 64];
+    char pattern[CHIMERA_VFS_NAME_MAX + 64];
+    int  max = CHIMERA_VFS_NAME_MAX - 1;
+
+    /* Literal: the bytes past the limit never take part. */
+    memset(name, 'a', sizeof(name));
+    memset(pattern, 'a', sizeof(pattern));
+    name[max]    = 'x';
+    pattern[max] = 'y';
+    assert(chimera_vfs_dirent_match(name, sizeof(name), pattern, sizeof(pattern)) == 1);
+    assert(chimera_vfs_dirent_match(name, max, pattern, sizeof(pattern)) == 1);
+    assert(chimera_vfs_dirent_match(name, max - 1, pattern, sizeof(pattern)) == 0);
+
+    /* A suffix past the limit is dropped: "*x" truncated is all 'a's and '*'. */
+    memset(pattern, 'a', sizeof(pattern));
+    pattern[0]   = '*';
+    pattern[max] = 'x';
+    assert(chimera_vfs_dirent_match(name, sizeof(name), pattern, max + 1) == 1);
+    name[max - 1] = 'b';
+    assert(chimera_vfs_dirent_match(name, sizeof(name), pattern, max + 1) == 0);
+
+    TEST_PASS("255-byte truncation of pattern and name");
+} /* test_truncation */
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    test_no_filter();
+    test_literal();
+    test_prefix_suffix();
+    test_star_qm();
+    test_dos_star();
+    test_dos_qm();
+    test_dos_dot();
+    test_truncation();
+
+    fprintf(stderr, "All dirent match tests passed\n");
+    return 0;
+} /* main */
@@ -8,6 +8,7 @@
 #undef NDEBUG
 #include <assert.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "evpl/evpl.h"
 #include "vfs/vfs.h"
@@ -17,6 +18,10 @@
 
 #define TEST_PASS(name) fprintf(stderr, "  PASS: %s\n", name)
 
+#define TEST_WRITER_THREADS 4
+#define TEST_WRITER_KEYS    256
+#define TEST_WRITER_DEPTH   16
+
 struct test_ctx {
     int                        done;
     enum chimera_vfs_error     status;
@@ -455,6 +460,137 @@ test_nonexistent_key(struct test_ctx *ctx)
     TEST_PASS("operations on nonexistent key");
 } /* test_nonexistent_key */
 
+struct writer_ctx {
+    struct chimera_vfs *vfs;
+    int                 id;
+    int                 inflight;
+    int                 errors;
+    char                keys[TEST_WRITER_KEYS][32];
+};
+
+static void
+writer_put_callback(
+    enum chimera_vfs_error error_code,
+    void                  *private_data)
+{
+    struct writer_ctx *writer = private_data;
+
+    if (error_code != CHIMERA_VFS_OK) {
+        writer->errors++;
+    }
+    writer->inflight--;
+} /* writer_put_callback */
+
+static void *
+writer_thread(void *arg)
+{
+    struct writer_ctx         *writer = arg;
+    struct evpl               *evpl;
+    struct chimera_vfs_thread *vfs_thread;
+
+    evpl = evpl_create(NULL);
+    assert(evpl != NULL);
+
+    vfs_thread = chimera_vfs_thread_init(evpl, writer->vfs);
+    assert(vfs_thread != NULL);
+
+    /* Keep several puts in flight so they reach the backend in bursts */
+    for (int i = 0; i < TEST_WRITER_KEYS; i++) {
+        while (writer->inflight >= TEST_WRITER_DEPTH) {
+            evpl_continue(evpl);
+        }
+
+        snprintf(writer->keys[i], sizeof(writer->keys[i]), "mt_%d_%04d", writer->id, i);
+
+        writer->inflight++;
+        chimera_vfs_put_key(
+            vfs_thread,
+            writer->keys[i],
+            strlen(writer->keys[i]),
+            writer->keys[i],
+            strlen(writer->keys[i]),
+            writer_put_callback,
+            writer);
+    }
+
+    while (writer->inflight) {
+        evpl_continue(evpl);
+    }
+
+    chimera_vfs_thread_destroy(vfs_thread);
+    evpl_destroy(evpl);
+
+    return NULL;
+} /* writer_thread */
+
+static void
+test_concurrent_writers(struct test_ctx *ctx)
+{
+    static struct writer_ctx writers[TEST_WRITER_THREADS];
+    pthread_t                threads[TEST_WRITER_THREADS];
+    int                      i, j, rc;
+
+    /* Writers on several VFS threads land on different delegation threads,
+     * which then contend for the backend's write path at the same time.  No
+     * put may fail or be lost to that contention. */
+    for (i = 0; i < TEST_WRITER_THREADS; i++) {
+        memset(&writers[i], 0, sizeof(writers[i]));
+        writers[i].vfs = ctx->vfs;
+        writers[i].id  = i;
+
+        rc = pthread_create(&threads[i], NULL, writer_thread, &writers[i]);
+        assert(rc == 0);
+    }
+
+    for (i = 0; i < TEST_WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        assert(writers[i].errors == 0);
+    }
+
+    ctx->search_count = 0;
+    chimera_vfs_search_keys(
+        ctx->vfs_thread,
+        "mt_", 3,
+        "mt`", 3,
+        CHIMERA_VFS_SEARCH_KEYS_END_EXCLUSIVE,
+        search_keys_callback,
+        search_keys_complete,
+        ctx);
+
+    wait_for_completion(ctx);
+    assert(ctx->status == CHIMERA_VFS_OK);
+    assert(ctx->search_count == TEST_WRITER_THREADS * TEST_WRITER_KEYS);
+
+    chimera_vfs_get_key(
+        ctx->vfs_thread,
+        writers[1].keys[7],
+        strlen(writers[1].keys[7]),
+        get_key_callback,
+        ctx);
+
+    wait_for_completion(ctx);
+    assert(ctx->status == CHIMERA_VFS_OK);
+    assert(ctx->value_len == strlen(writers[1].keys[7]));
+    assert(memcmp(ctx->value, writers[1].keys[7], ctx->value_len) == 0);
+
+    /* Cleanup */
+    for (i = 0; i < TEST_WRITER_THREADS; i++) {
+        for (j = 0; j < TEST_WRITER_KEYS; j++) {
+            chimera_vfs_delete_key(
+                ctx->vfs_thread,
+                writers[i].keys[j],
+                strlen(writers[i].keys[j]),
+                delete_key_callback,
+                ctx);
+
+            wait_for_completion(ctx);
+            assert(ctx->status == CHIMERA_VFS_OK);
+        }
+    }
+
+    TEST_PASS("concurrent writers on several threads");
+} /* test_concurrent_writers */
+
 /* Run the full KV test suite against a single KV-only backend. */
 static void
 run_suite(
@@ -520,6 +656,7 @@ run_suite(
     test_search_keys(&ctx);
     test_binary_keys_values(&ctx);
     test_nonexistent_key(&ctx);
+    test_concurrent_writers(&ctx);
 
     if (has_fs) {
         ctx.done = 0;
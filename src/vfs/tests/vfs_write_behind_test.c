@@ -0,0 +1,563 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+/*
+ * Write-behind buffer error reporting across CLOSE and COMMIT.
+ *
+ * UNSTABLE writes are acknowledged from the VFS write-behind buffer and reach
+ * the backend later, so a failed flush can only be reported by the file's
+ * next COMMIT.  The test fills a diskfs pool with a preallocated file so that
+ * every flush fails with ENOSPC, then checks that the error reaches exactly
+ * one COMMIT when:
+ *
+ *   - the COMMIT itself parks behind the failing flush;
+ *   - an earlier GETATTR drove the flush and the backend CLOSE (issued by the
+ *     open cache's close sweep) ran before the COMMIT arrived on a new handle;
+ *   - the backend CLOSE drove the flush itself.
+ *
+ * A round trip on the empty pool first checks that buffered data commits and
+ * reads back.  memfs keeps its data in memory and is never buffered, so this
+ * runs against diskfs only:
+ *
+ *     vfs_write_behind_test <diskfs_io_uring|diskfs_aio>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include "evpl/evpl.h"
+#include "evpl/evpl_memory.h"
+#include "vfs/vfs.h"
+#include "vfs/vfs_procs.h"
+#include "vfs/vfs_release.h"
+#include "vfs/vfs_attrs.h"
+#include "vfs/vfs_cred.h"
+#include "vfs/vfs_error.h"
+#include "common/logging.h"
+#include "prometheus-c.h"
+
+#define DEV_SIZE_BYTES (1024ULL * 1024ULL * 1024ULL) /* 1 GiB, sparse */
+#define WB_SIZE        (64ULL * 1024 * 1024)
+#define WRITE_LEN      0x40000U   /* 256 KiB, the largest buffered write */
+#define FILE_LEN       0x100000U  /* 1 MiB per file */
+#define WRITE_NIOV     16
+#define READ_NIOV      64
+#define CLOSE_WAIT_US  2000000    /* many close sweeps (50 ms, set below) */
+
+#define TEST_PASS(name) fprintf(stderr, "  PASS: %s\n", name)
+
+enum test_file {
+    FILE_OK,
+    FILE_COMMIT,
+    FILE_GETATTR,
+    FILE_CLOSE,
+    FILE_FILL,
+    NUM_FILES
+};
+
+static const char *file_names[NUM_FILES] = {
+    "ok", "commit", "getattr", "close", "fill"
+};
+
+struct test_ctx {
+    int                             done;
+    enum chimera_vfs_error          status;
+    struct chimera_vfs             *vfs;
+    struct chimera_vfs_thread      *vfs_thread;
+    struct evpl                    *evpl;
+    struct chimera_vfs_cred         cred;
+    uint8_t                         fh[CHIMERA_VFS_FH_SIZE];
+    uint32_t                        fh_len;
+    struct chimera_vfs_open_handle *handle;
+    uint8_t                         file_fh[NUM_FILES][CHIMERA_VFS_FH_SIZE];
+    uint32_t                        file_fh_len[NUM_FILES];
+    uint8_t                        *readbuf;
+    uint32_t                        read_dst;
+    uint32_t                        readlen;
+};
+
+static void
+wait_done(struct test_ctx *ctx)
+{
+    while (!ctx->done) {
+        evpl_continue(ctx->evpl);
+    }
+    ctx->done = 0;
+} /* wait_done */
+
+static void
+mount_cb(
+    struct chimera_vfs_thread *thread,
+    enum chimera_vfs_error     status,
+    void                      *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = status;
+    ctx->done   = 1;
+} /* mount_cb */
+
+static void
+lookup_cb(
+    enum chimera_vfs_error    error_code,
+    struct chimera_vfs_attrs *attr,
+    void                     *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = error_code;
+    if (error_code == CHIMERA_VFS_OK) {
+        memcpy(ctx->fh, attr->va_fh, attr->va_fh_len);
+        ctx->fh_len = attr->va_fh_len;
+    }
+    ctx->done = 1;
+} /* lookup_cb */
+
+static void
+openfh_cb(
+    enum chimera_vfs_error          error_code,
+    struct chimera_vfs_open_handle *oh,
+    void                           *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = error_code;
+    ctx->handle = oh;
+    ctx->done   = 1;
+} /* openfh_cb */
+
+static void
+openat_cb(
+    enum chimera_vfs_error          error_code,
+    struct chimera_vfs_open_handle *oh,
+    struct chimera_vfs_attrs       *set_attr,
+    struct chimera_vfs_attrs       *attr,
+    struct chimera_vfs_attrs       *dir_pre,
+    struct chimera_vfs_attrs       *dir_post,
+    void                           *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = error_code;
+    ctx->handle = oh;
+    if (error_code == CHIMERA_VFS_OK) {
+        memcpy(ctx->fh, oh->fh, oh->fh_len);
+        ctx->fh_len = oh->fh_len;
+    }
+    ctx->done = 1;
+} /* openat_cb */
+
+static void
+write_cb(
+    enum chimera_vfs_error    error_code,
+    uint32_t                  length,
+    uint32_t                  sync,
+    struct chimera_vfs_attrs *pre_attr,
+    struct chimera_vfs_attrs *post_attr,
+    void                     *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = error_code;
+    ctx->done   = 1;
+} /* write_cb */
+
+static void
+attr_cb(
+    enum chimera_vfs_error    error_code,
+    struct chimera_vfs_attrs *attr,
+    void                     *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = error_code;
+    ctx->done   = 1;
+} /* attr_cb */
+
+static void
+pre_post_cb(
+    enum chimera_vfs_error    error_code,
+    struct chimera_vfs_attrs *pre_attr,
+    struct chimera_vfs_attrs *post_attr,
+    void                     *private_data)
+{
+    struct test_ctx *ctx = private_data;
+
+    ctx->status = error_code;
+    ctx->done   = 1;
+} /* pre_post_cb */
+
+static void
+read_cb(
+    enum chimera_vfs_error    error_code,
+    uint32_t                  count,
+    uint32_t                  eof,
+    struct evpl_iovec        *iov,
+    int                       niov,
+    struct chimera_vfs_attrs *attr,
+    void                     *private_data)
+{
+    struct test_ctx *ctx = private_data;
+    uint32_t         off = 0;
+
+    ctx->status = error_code;
+    if (error_code == CHIMERA_VFS_OK) {
+        for (int i = 0; i < niov && off < ctx->readlen; i++) {
+            uint32_t len = evpl_iovec_length(&iov[i]);
+
+            if (len > ctx->readlen - off) {
+                len = ctx->readlen - off;
+            }
+            memcpy(ctx->readbuf + ctx->read_dst + off, evpl_iovec_data(&iov[i]),
+                   len);
+            off += len;
+        }
+        evpl_iovecs_release(ctx->evpl, iov, niov);
+    }
+    ctx->done = 1;
+} /* read_cb */
+
+static struct chimera_vfs_open_handle *
+open_file(
+    struct test_ctx *ctx,
+    enum test_file   f)
+{
+    chimera_vfs_open_fh(ctx->vfs_thread, &ctx->cred, ctx->file_fh[f],
+                        ctx->file_fh_len[f], CHIMERA_VFS_OPEN_INFERRED,
+                        openfh_cb, ctx);
+    wait_done(ctx);
+    assert(ctx->status == CHIMERA_VFS_OK);
+    return ctx->handle;
+} /* open_file */
+
+/* Write [0, FILE_LEN) of `byte` as UNSTABLE writes small enough to be
+ * buffered; every one is acknowledged, whether or not it was absorbed. */
+static void
+write_unstable(
+    struct test_ctx                *ctx,
+    struct chimera_vfs_open_handle *handle,
+    uint8_t                         byte)
+{
+    struct evpl_iovec iov[WRITE_NIOV];
+    int               niov;
+
+    for (uint64_t off = 0; off < FILE_LEN; off += WRITE_LEN) {
+        niov = evpl_iovec_alloc(ctx->evpl, WRITE_LEN, 4096, WRITE_NIOV, 0, iov);
+        assert(niov > 0);
+        for (int i = 0; i < niov; i++) {
+            memset(evpl_iovec_data(&iov[i]), byte, evpl_iovec_length(&iov[i]));
+        }
+
+        chimera_vfs_write(ctx->vfs_thread, &ctx->cred, handle, off, WRITE_LEN,
+                          CHIMERA_VFS_WRITE_UNSTABLE, 0, 0, iov, niov,
+                          write_cb, ctx);
+        wait_done(ctx);
+        assert(ctx->status == CHIMERA_VFS_OK);
+        evpl_iovecs_release(ctx->evpl, iov, niov);
+    }
+} /* write_unstable */
+
+static enum chimera_vfs_error
+do_commit(
+    struct test_ctx                *ctx,
+    struct chimera_vfs_open_handle *handle)
+{
+    chimera_vfs_commit(ctx->vfs_thread, &ctx->cred, handle, 0, 0, 0, 0,
+                       pre_post_cb, ctx);
+    wait_done(ctx);
+    return ctx->status;
+} /* do_commit */
+
+static enum chimera_vfs_error
+do_getattr(
+    struct test_ctx                *ctx,
+    struct chimera_vfs_open_handle *handle)
+{
+    chimera_vfs_getattr(ctx->vfs_thread, &ctx->cred, handle,
+                        CHIMERA_VFS_ATTR_MASK_STAT, attr_cb, ctx);
+    wait_done(ctx);
+    return ctx->status;
+} /* do_getattr */
+
+static enum chimera_vfs_error
+do_allocate(
+    struct test_ctx                *ctx,
+    struct chimera_vfs_open_handle *handle,
+    uint64_t                        off,
+    uint64_t                        len)
+{
+    chimera_vfs_allocate(ctx->vfs_thread, &ctx->cred, handle, off, len, 0,
+                         0, 0, pre_post_cb, ctx);
+    wait_done(ctx);
+    return ctx->status;
+} /* do_allocate */
+
+/* Drop the last reference and give the close sweep time to issue the backend
+ * CLOSE (on its own thread). */
+static void
+release_and_close(
+    struct test_ctx                *ctx,
+    struct chimera_vfs_open_handle *handle)
+{
+    chimera_vfs_release(ctx->vfs_thread, handle);
+    usleep(CLOSE_WAIT_US);
+} /* release_and_close */
+
+static void
+read_all(
+    struct test_ctx                *ctx,
+    struct chimera_vfs_open_handle *handle)
+{
+    memset(ctx->readbuf, 0, FILE_LEN);
+
+    for (uint64_t off = 0; off < FILE_LEN; off += WRITE_LEN) {
+        struct evpl_iovec iov[READ_NIOV];
+
+        ctx->read_dst = (uint32_t) off;
+        ctx->readlen  = WRITE_LEN;
+
+        chimera_vfs_read(ctx->vfs_thread, &ctx->cred, handle, off, WRITE_LEN,
+                         iov, READ_NIOV, 0, read_cb, ctx);
+        wait_done(ctx);
+        assert(ctx->status == CHIMERA_VFS_OK);
+    }
+} /* read_all */
+
+/* With room on the pool the buffered data commits and reads back. */
+static void
+test_round_trip(struct test_ctx *ctx)
+{
+    struct chimera_vfs_open_handle *handle = open_file(ctx, FILE_OK);
+
+    write_unstable(ctx, handle, 0x5a);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_OK);
+
+    read_all(ctx, handle);
+    for (uint32_t i = 0; i < FILE_LEN; i++) {
+        assert(ctx->readbuf[i] == 0x5a);
+    }
+
+    chimera_vfs_release(ctx->vfs_thread, handle);
+    TEST_PASS("buffered writes commit and read back");
+} /* test_round_trip */
+
+/* Preallocate the rest of the pool, halving the request on each ENOSPC down
+ * to a single block, so that no buffered write can be placed. */
+static void
+fill_pool(struct test_ctx *ctx)
+{
+    struct chimera_vfs_open_handle *handle = open_file(ctx, FILE_FILL);
+    enum chimera_vfs_error          status;
+    uint64_t                        off = 0, len = 256ULL * 1024 * 1024;
+
+    while (len >= 4096) {
+        status = do_allocate(ctx, handle, off, len);
+        if (status == CHIMERA_VFS_OK) {
+            off += len;
+        } else {
+            assert(status == CHIMERA_VFS_ENOSPC);
+            len >>= 1;
+        }
+    }
+
+    fprintf(stderr, "  filled the pool with %lu MiB\n",
+            (unsigned long) (off >> 20));
+    chimera_vfs_release(ctx->vfs_thread, handle);
+} /* fill_pool */
+
+/* A COMMIT parked behind the failing flush reports the error; the next one
+ * has nothing left to report. */
+static void
+test_commit_parked(struct test_ctx *ctx)
+{
+    struct chimera_vfs_open_handle *handle = open_file(ctx, FILE_COMMIT);
+
+    write_unstable(ctx, handle, 0x11);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_ENOSPC);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_OK);
+
+    chimera_vfs_release(ctx->vfs_thread, handle);
+    TEST_PASS("COMMIT parked behind a failed flush reports it once");
+} /* test_commit_parked */
+
+/* A GETATTR drives the flush and succeeds itself; the error then outlives the
+ * backend CLOSE and goes to the first COMMIT on a new handle. */
+static void
+test_error_survives_close(struct test_ctx *ctx)
+{
+    struct chimera_vfs_open_handle *handle = open_file(ctx, FILE_GETATTR);
+
+    write_unstable(ctx, handle, 0x22);
+    assert(do_getattr(ctx, handle) == CHIMERA_VFS_OK);
+    release_and_close(ctx, handle);
+
+    handle = open_file(ctx, FILE_GETATTR);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_ENOSPC);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_OK);
+
+    chimera_vfs_release(ctx->vfs_thread, handle);
+    TEST_PASS("flush error held across CLOSE until COMMIT");
+} /* test_error_survives_close */
+
+/* The backend CLOSE itself drives the failing flush. */
+static void
+test_close_flush_error(struct test_ctx *ctx)
+{
+    struct chimera_vfs_open_handle *handle = open_file(ctx, FILE_CLOSE);
+
+    write_unstable(ctx, handle, 0x33);
+    release_and_close(ctx, handle);
+
+    handle = open_file(ctx, FILE_CLOSE);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_ENOSPC);
+    assert(do_commit(ctx, handle) == CHIMERA_VFS_OK);
+
+    chimera_vfs_release(ctx->vfs_thread, handle);
+    TEST_PASS("flush error from CLOSE reported by the next COMMIT");
+} /* test_close_flush_error */
+
+int
+main(
+    int    argc,
+    char **argv)
+{
+    struct test_ctx                 ctx = { 0 };
+    struct chimera_vfs_module_cfg   module_cfgs[2];
+    struct prometheus_metrics      *metrics;
+    struct chimera_vfs_attrs        sattr;
+    struct chimera_vfs_open_handle *root_handle;
+    const char                     *backend = argc > 1 ? argv[1] : "diskfs_io_uring";
+    const char                     *iotype;
+    char                            tmpl[] = "/tmp/vfs_wb_XXXXXX";
+    char                           *session_dir;
+    char                            dev_path[300];
+    char                            cfg[512];
+    uint8_t                         root_fh[CHIMERA_VFS_FH_SIZE];
+    uint32_t                        root_fh_len;
+    int                             fd, rc;
+
+    if (strcmp(backend, "diskfs_io_uring") == 0) {
+        iotype = "io_uring";
+    } else if (strcmp(backend, "diskfs_aio") == 0) {
+        iotype = "libaio";
+    } else {
+        fprintf(stderr, "unknown backend: %s\n", backend);
+        return 2;
+    }
+
+    /* Sweep the open cache often so a released handle's backend CLOSE is
+     * issued well inside CLOSE_WAIT_US. */
+    setenv("CHIMERA_CLOSE_SWEEP_INTERVAL_MS", "50", 1);
+
+    chimera_log_init();
+    chimera_vfs_cred_init_unix(&ctx.cred, 0, 0, 0, NULL);
+
+    session_dir = mkdtemp(tmpl);
+    assert(session_dir != NULL);
+
+    snprintf(dev_path, sizeof(dev_path), "%s/device-0.img", session_dir);
+    fd = open(dev_path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    assert(fd >= 0);
+    rc = ftruncate(fd, (off_t) DEV_SIZE_BYTES);
+    assert(rc == 0);
+    close(fd);
+
+    snprintf(cfg, sizeof(cfg),
+             "{\"initialize\":true,\"unsafe_async\":true,"
+             "\"intent_log_size\":67108864,"
+             "\"devices\":[{\"type\":\"%s\",\"size\":1,\"path\":\"%s\"}]}",
+             iotype, dev_path);
+
+    memset(module_cfgs, 0, sizeof(module_cfgs));
+    strncpy(module_cfgs[0].module_name, "diskfs", sizeof(module_cfgs[0].module_name) - 1);
+    strncpy(module_cfgs[0].config_data, cfg, sizeof(module_cfgs[0].config_data) - 1);
+    strncpy(module_cfgs[1].module_name, "memkv", sizeof(module_cfgs[1].module_name) - 1);
+
+    metrics = prometheus_metrics_create(NULL, NULL, 0);
+    assert(metrics != NULL);
+
+    ctx.evpl = evpl_create(NULL);
+    assert(ctx.evpl != NULL);
+
+    ctx.vfs = chimera_vfs_init(0, 0, module_cfgs, 2, "memkv", 60, 1, 1, 0,
+                               metrics);
+    assert(ctx.vfs != NULL);
+
+    chimera_vfs_set_write_behind_size(ctx.vfs, WB_SIZE);
+
+    ctx.vfs_thread = chimera_vfs_thread_init(ctx.evpl, ctx.vfs);
+    assert(ctx.vfs_thread != NULL);
+
+    ctx.readbuf = malloc(FILE_LEN);
+    assert(ctx.readbuf);
+
+    chimera_vfs_mkfs(ctx.vfs_thread, NULL, "diskfs", "fs0", NULL, mount_cb, &ctx);
+    wait_done(&ctx);
+    assert(ctx.status == CHIMERA_VFS_OK);
+
+    chimera_vfs_mount(ctx.vfs_thread, NULL, "/test", "diskfs", "fs0", NULL,
+                      mount_cb, &ctx);
+    wait_done(&ctx);
+    assert(ctx.status == CHIMERA_VFS_OK);
+
+    chimera_vfs_get_root_fh(root_fh, &root_fh_len);
+    chimera_vfs_lookup(ctx.vfs_thread, &ctx.cred, root_fh, root_fh_len, "test", 4,
+                       CHIMERA_VFS_ATTR_FH | CHIMERA_VFS_ATTR_MASK_STAT, 0,
+                       lookup_cb, &ctx);
+    wait_done(&ctx);
+    assert(ctx.status == CHIMERA_VFS_OK);
+
+    chimera_vfs_open_fh(ctx.vfs_thread, &ctx.cred, ctx.fh, ctx.fh_len,
+                        CHIMERA_VFS_OPEN_INFERRED, openfh_cb, &ctx);
+    wait_done(&ctx);
+    assert(ctx.status == CHIMERA_VFS_OK);
+    root_handle = ctx.handle;
+
+    /* Create every file up front: nothing can be created once the pool is
+     * full. */
+    memset(&sattr, 0, sizeof(sattr));
+    sattr.va_set_mask = CHIMERA_VFS_ATTR_MODE;
+    sattr.va_mode     = 0644;
+
+    for (int f = 0; f < NUM_FILES; f++) {
+        chimera_vfs_open_at(ctx.vfs_thread, &ctx.cred, root_handle, file_names[f],
+                            strlen(file_names[f]), CHIMERA_VFS_OPEN_CREATE, &sattr,
+                            CHIMERA_VFS_ATTR_FH, 0, 0, openat_cb, &ctx);
+        wait_done(&ctx);
+        assert(ctx.status == CHIMERA_VFS_OK);
+        memcpy(ctx.file_fh[f], ctx.fh, ctx.fh_len);
+        ctx.file_fh_len[f] = ctx.fh_len;
+        chimera_vfs_release(ctx.vfs_thread, ctx.handle);
+    }
+
+    chimera_vfs_release(ctx.vfs_thread, root_handle);
+
+    test_round_trip(&ctx);
+    fill_pool(&ctx);
+    test_commit_parked(&ctx);
+    test_error_survives_close(&ctx);
+    test_close_flush_error(&ctx);
+
+    chimera_vfs_umount(ctx.vfs_thread, NULL, "/test", mount_cb, &ctx);
+    wait_done(&ctx);
+    assert(ctx.status == CHIMERA_VFS_OK);
+
+    chimera_vfs_rmfs(ctx.vfs_thread, NULL, "diskfs", "fs0", mount_cb, &ctx);
+    wait_done(&ctx);
+    assert(ctx.status == CHIMERA_VFS_OK);
+
+    chimera_vfs_thread_destroy(ctx.vfs_thread);
+    chimera_vfs_destroy(ctx.vfs);
+    evpl_destroy(ctx.evpl);
+    prometheus_metrics_destroy(metrics);
+    free(ctx.readbuf);
+
+    fprintf(stderr, "All write-behind tests passed [%s]\n", backend);
+    return 0;
+} /* main */
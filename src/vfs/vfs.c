@@ -22,6 +22,8 @@
 #include "vfs/vfs_dump.h"
 #include "vfs/vfs_name_cache.h"
 #include "vfs/vfs_attr_cache.h"
+#include "vfs/vfs_data_cache.h"
+#include "vfs/vfs_write_behind.h"
 #include "vfs/vfs_user_cache.h"
 #include "vfs/vfs_identity.h"
 #include "vfs/vfs_notify.h"
@@ -73,24 +75,105 @@ chimera_vfs_clock_shutdown(void)
     chimera_vfs_clock.initialized = 0;
 } /* chimera_vfs_clock_shutdown */
 
+/* Take the oldest request queued on this thread, or NULL. */
+static struct chimera_vfs_request *
+chimera_vfs_delegation_pop(struct chimera_vfs_delegation_thread *delegation_thread)
+{
+    struct chimera_vfs_request *request;
+    int                         depth;
+
+    pthread_mutex_lock(&delegation_thread->lock);
+
+    request = delegation_thread->requests;
+
+    if (request) {
+        DL_DELETE(delegation_thread->requests, request);
+        depth = __atomic_sub_fetch(&delegation_thread->depth, 1, __ATOMIC_RELAXED);
+        if (delegation_thread->queue_depth) {
+            prometheus_gauge_set(delegation_thread->queue_depth, depth);
+        }
+    }
+
+    pthread_mutex_unlock(&delegation_thread->lock);
+
+    return request;
+} /* chimera_vfs_delegation_pop */
+
+/* Steal the oldest request not pinned by CAP_FH_AFFINITY from the busy
+ * sibling with the deepest queue.  The victim is stuck in a blocking call, so
+ * everything on its queue is waiting; taking the oldest keeps latency FIFO. */
+static struct chimera_vfs_request *
+chimera_vfs_delegation_steal(struct chimera_vfs_delegation_thread *thief)
+{
+    struct chimera_vfs_delegation_thread *victim = NULL, *sibling;
+    struct chimera_vfs_request           *request = NULL;
+    int                                   i, depth, max_depth = 0;
+
+    for (i = 1; i < thief->pool_size; i++) {
+        sibling = &thief->pool[(thief->index + i) % thief->pool_size];
+        depth   = __atomic_load_n(&sibling->depth, __ATOMIC_RELAXED);
+
+        if (depth > max_depth && __atomic_load_n(&sibling->busy, __ATOMIC_RELAXED)) {
+            victim    = sibling;
+            max_depth = depth;
+        }
+    }
+
+    if (!victim) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&victim->lock);
+
+    for (request = victim->requests; request; request = request->next) {
+        if (chimera_vfs_delegation_stealable(request)) {
+            break;
+        }
+    }
+
+    if (request) {
+        DL_DELETE(victim->requests, request);
+        depth = __atomic_sub_fetch(&victim->depth, 1, __ATOMIC_RELAXED);
+        if (victim->queue_depth) {
+            prometheus_gauge_set(victim->queue_depth, depth);
+        }
+    }
+
+    pthread_mutex_unlock(&victim->lock);
+
+    if (request && thief->steals) {
+        prometheus_counter_increment(thief->steals);
+    }
+
+    return request;
+} /* chimera_vfs_delegation_steal */
+
 static void
 chimera_vfs_delegation_drain(struct chimera_vfs_delegation_thread *delegation_thread)
 {
     struct chimera_vfs_thread  *thread = delegation_thread->vfs_thread;
-    struct chimera_vfs_request *requests, *request;
+    struct chimera_vfs_request *request;
     struct chimera_vfs_module  *module;
 
-    pthread_mutex_lock(&delegation_thread->lock);
-    requests                    = delegation_thread->requests;
-    delegation_thread->requests = NULL;
-    pthread_mutex_unlock(&delegation_thread->lock);
+    /* One request at a time, so whatever is still queued behind a blocking
+     * call stays visible to idle siblings. */
+    while (1) {
+        request = chimera_vfs_delegation_pop(delegation_thread);
 
-    while (requests) {
-        request = requests;
-        LL_DELETE(requests, request);
+        if (!request && delegation_thread->mode == CHIMERA_VFS_DELEGATION_SYNC) {
+            request = chimera_vfs_delegation_steal(delegation_thread);
+        }
+
+        if (!request) {
+            break;
+        }
+
+        __atomic_store_n(&delegation_thread->busy, 1, __ATOMIC_RELAXED);
 
         module = request->module;
         module->dispatch(request, thread->module_private[module->fh_magic]);
+
+        __atomic_store_n(&delegation_thread->busy, 0, __ATOMIC_RELAXED);
     }
 } /* chimera_vfs_delegation_drain */
 
@@ -425,10 +508,20 @@ chimera_vfs_spawn_delegation_pool(
     pool = calloc(count, sizeof(struct chimera_vfs_delegation_thread));
 
     for (int i = 0; i < count; i++) {
-        pool[i].vfs  = vfs;
-        pool[i].mode = mode;
+        pool[i].vfs       = vfs;
+        pool[i].mode      = mode;
+        pool[i].pool      = pool;
+        pool[i].pool_size = count;
+        pool[i].index     = i;
         pthread_mutex_init(&pool[i].lock, NULL);
 
+        if (vfs->metrics.metrics) {
+            pool[i].queue_depth = prometheus_gauge_series_create_instance(
+                vfs->metrics.delegation_queue_depth_series[mode]);
+            pool[i].steals = prometheus_counter_series_create_instance(
+                vfs->metrics.delegation_steals_series[mode]);
+        }
+
         pool[i].evpl_thread = evpl_thread_create(
             NULL,
             chimera_vfs_delegation_thread_init,
@@ -439,6 +532,31 @@ chimera_vfs_spawn_delegation_pool(
     return pool;
 } /* chimera_vfs_spawn_delegation_pool */
 
+static void
+chimera_vfs_destroy_delegation_pool(
+    struct chimera_vfs                   *vfs,
+    struct chimera_vfs_delegation_thread *pool,
+    int                                   count)
+{
+    /* Every thread is stopped before any instance goes: a running thread may
+     * still steal from (and so update the gauge of) a stopped sibling. */
+    for (int i = 0; i < count; i++) {
+        evpl_thread_destroy(pool[i].evpl_thread);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (pool[i].queue_depth) {
+            prometheus_gauge_series_destroy_instance(
+                vfs->metrics.delegation_queue_depth_series[pool[i].mode], pool[i].queue_depth);
+            prometheus_counter_series_destroy_instance(
+                vfs->metrics.delegation_steals_series[pool[i].mode], pool[i].steals);
+        }
+        pthread_mutex_destroy(&pool[i].lock);
+    }
+
+    free(pool);
+} /* chimera_vfs_destroy_delegation_pool */
+
 /*
  * Bring up the liburcu call_rcu reclaim workers.
  *
@@ -555,6 +673,24 @@ chimera_vfs_init(
             },
                                                                                    1);
         }
+
+        vfs->metrics.delegation_queue_depth = prometheus_metrics_create_gauge(metrics,
+                                                                              "chimera_vfs_delegation_queue_depth",
+                                                                              "Requests queued on VFS delegation threads");
+        vfs->metrics.delegation_steals = prometheus_metrics_create_counter(metrics,
+                                                                           "chimera_vfs_delegation_steals",
+                                                                           "Requests taken by an idle VFS delegation thread from a busy one");
+
+        for (int i = 0; i < 2; i++) {
+            const char *pool_name = i == CHIMERA_VFS_DELEGATION_SYNC ? "sync" : "async";
+
+            vfs->metrics.delegation_queue_depth_series[i] = prometheus_gauge_create_series(
+                vfs->metrics.delegation_queue_depth,
+                (const char *[]) { "pool" }, (const char *[]) { pool_name }, 1);
+            vfs->metrics.delegation_steals_series[i] = prometheus_counter_create_series(
+                vfs->metrics.delegation_steals,
+                (const char *[]) { "pool" }, (const char *[]) { pool_name }, 1);
+        }
     }
 
     vfs->vfs_open_path_cache = chimera_vfs_open_cache_init(CHIMERA_VFS_OPEN_ID_PATH, 10, 128 * 1024, metrics,
@@ -564,9 +700,11 @@ chimera_vfs_init(
 
     /* The name (lookup) cache is optional (common.name_cache).  When off we
      * leave it NULL; its helpers (lookup/insert/remove/destroy) are all no-ops
-     * on a NULL cache, so nothing is cached, consulted, or freed. */
+     * on a NULL cache, so nothing is cached, consulted, or freed.  Entries
+     * are size-classed (typically 128 or 192 bytes, not the worst-case ~450),
+     * so it carries 4x the slots of the attr cache for a similar footprint. */
     vfs->vfs_name_cache = name_cache_enabled ?
-        chimera_vfs_name_cache_create(8, 4, 2, cache_ttl, metrics) : NULL;
+        chimera_vfs_name_cache_create(8, 6, 2, cache_ttl, metrics) : NULL;
     /* The attr cache is optional (common.attr_cache).  When off we leave it
      * NULL; the cache helpers (lookup/insert/refresh/destroy) are all no-ops on
      * a NULL cache, so nothing is cached, consulted, or freed. */
@@ -710,6 +848,35 @@ chimera_vfs_set_caching_enabled(
     vfs->caching_enabled = enabled;
 } /* chimera_vfs_set_caching_enabled */
 
+SYMBOL_EXPORT void
+chimera_vfs_set_data_cache_size(
+    struct chimera_vfs *vfs,
+    uint64_t            size)
+{
+    if (vfs->vfs_data_cache || size < CHIMERA_VFS_DATA_CACHE_PAGE_SIZE) {
+        return;
+    }
+
+    if (!vfs->vfs_attr_cache) {
+        chimera_vfs_info("data cache requires the attr cache, leaving it disabled");
+        return;
+    }
+
+    vfs->vfs_data_cache = chimera_vfs_data_cache_create(size, vfs->metrics.metrics);
+} /* chimera_vfs_set_data_cache_size */
+
+SYMBOL_EXPORT void
+chimera_vfs_set_write_behind_size(
+    struct chimera_vfs *vfs,
+    uint64_t            size)
+{
+    if (vfs->vfs_write_behind || size < CHIMERA_VFS_WB_EXTENT_SIZE) {
+        return;
+    }
+
+    vfs->vfs_write_behind = chimera_vfs_write_behind_create(size);
+} /* chimera_vfs_set_write_behind_size */
+
 SYMBOL_EXPORT int
 chimera_vfs_fh_is_plausible(
     struct chimera_vfs_thread *thread,
@@ -921,15 +1088,11 @@ chimera_vfs_destroy(struct chimera_vfs *vfs)
      * its own doorbell/timer-driven completions need no delegation thread. */
     evpl_thread_destroy(vfs->close_thread.evpl_thread);
 
-    for (i = 0; i < vfs->num_sync_delegation_threads; i++) {
-        evpl_thread_destroy(vfs->sync_delegation_threads[i].evpl_thread);
-    }
-    free(vfs->sync_delegation_threads);
+    chimera_vfs_destroy_delegation_pool(vfs, vfs->sync_delegation_threads,
+                                        vfs->num_sync_delegation_threads);
 
-    for (i = 0; i < vfs->num_async_delegation_threads; i++) {
-        evpl_thread_destroy(vfs->async_delegation_threads[i].evpl_thread);
-    }
-    free(vfs->async_delegation_threads);
+    chimera_vfs_destroy_delegation_pool(vfs, vfs->async_delegation_threads,
+                                        vfs->num_async_delegation_threads);
 
     chimera_vfs_mount_table_destroy(vfs->mount_table);
 
@@ -969,6 +1132,12 @@ chimera_vfs_destroy(struct chimera_vfs *vfs)
         chimera_vfs_attr_cache_destroy(vfs->vfs_attr_cache);
     }
 
+    if (vfs->vfs_data_cache) {
+        chimera_vfs_data_cache_destroy(vfs->vfs_data_cache);
+    }
+
+    chimera_vfs_write_behind_destroy(vfs->vfs_write_behind);
+
     chimera_vfs_open_cache_destroy(vfs->vfs_open_path_cache);
     chimera_vfs_open_cache_destroy(vfs->vfs_open_file_cache);
 
@@ -986,6 +1155,17 @@ chimera_vfs_destroy(struct chimera_vfs *vfs)
         prometheus_histogram_destroy(vfs->metrics.metrics, vfs->metrics.op_latency);
     }
 
+    if (vfs->metrics.delegation_queue_depth) {
+        for (int i = 0; i < 2; i++) {
+            prometheus_gauge_destroy_series(vfs->metrics.delegation_queue_depth,
+                                            vfs->metrics.delegation_queue_depth_series[i]);
+            prometheus_counter_destroy_series(vfs->metrics.delegation_steals,
+                                              vfs->metrics.delegation_steals_series[i]);
+        }
+        prometheus_gauge_destroy(vfs->metrics.metrics, vfs->metrics.delegation_queue_depth);
+        prometheus_counter_destroy(vfs->metrics.metrics, vfs->metrics.delegation_steals);
+    }
+
     chimera_vfs_clock_shutdown();
 
     free(vfs);
@@ -998,14 +1178,17 @@ chimera_vfs_process_completion(
 {
     struct chimera_vfs_thread  *thread = container_of(doorbell, struct chimera_vfs_thread, doorbell);
     struct chimera_vfs_request *complete_requests, *unblocked_requests, *io_resume_requests, *request;
+    struct chimera_vfs_request *wb_resume_requests;
 
     pthread_mutex_lock(&thread->lock);
     complete_requests                 = thread->pending_complete_requests;
     unblocked_requests                = thread->unblocked_requests;
     io_resume_requests                = thread->pending_io_resume;
+    wb_resume_requests                = thread->pending_wb_resume;
     thread->pending_complete_requests = NULL;
     thread->unblocked_requests        = NULL;
     thread->pending_io_resume         = NULL;
+    thread->pending_wb_resume         = NULL;
     pthread_mutex_unlock(&thread->lock);
 
     while (complete_requests) {
@@ -1027,6 +1210,13 @@ chimera_vfs_process_completion(
         chimera_vfs_state_io_resume(request);
     }
 
+    /* Resume requests that were held behind a write-behind flush. */
+    while (wb_resume_requests) {
+        request = wb_resume_requests;
+        DL_DELETE(wb_resume_requests, request);
+        chimera_vfs_write_behind_resume(request);
+    }
+
     /* Deliver any identity-resolver jobs that completed for this thread. */
     chimera_vfs_identity_thread_complete(thread);
 
@@ -1038,6 +1228,8 @@ chimera_vfs_watchdog(struct chimera_vfs_thread *thread)
     struct chimera_vfs_request *request;
     uint64_t                    elapsed;
 
+    chimera_vfs_write_behind_flush(thread, CHIMERA_VFS_WB_MAX_AGE_NS);
+
     request = thread->active_requests;
 
     if (!request) {
@@ -1221,6 +1413,7 @@ chimera_vfs_thread_destroy(struct chimera_vfs_thread *thread)
     struct chimera_vfs_request     *request;
     struct chimera_vfs_open_handle *handle;
     struct chimera_vfs_find_result *find_result;
+    struct chimera_vfs_readahead   *readahead;
     int                             i;
 
     evpl_remove_doorbell(thread->evpl, &thread->doorbell);
@@ -1245,6 +1438,12 @@ chimera_vfs_thread_destroy(struct chimera_vfs_thread *thread)
         free(find_result);
     }
 
+    while (thread->free_readaheads) {
+        readahead = thread->free_readaheads;
+        LL_DELETE(thread->free_readaheads, readahead);
+        free(readahead);
+    }
+
     while (thread->free_synth_handles) {
         handle = thread->free_synth_handles;
         LL_DELETE(thread->free_synth_handles, handle);
@@ -1299,6 +1498,8 @@ chimera_vfs_register(
 SYMBOL_EXPORT void
 chimera_vfs_thread_drain(struct chimera_vfs_thread *thread)
 {
+    chimera_vfs_write_behind_flush(thread, 0);
+
     while (thread->num_active_requests) {
         evpl_continue(thread->evpl);
     }
@@ -32,13 +32,18 @@ struct chimera_vfs_user;
 struct chimera_vfs_user_cache;
 struct prometheus_metrics;
 
-/* RCU recycle pools: one per fungible cache (attr/name/rpl).  The per-thread
- * magazine type is defined here (no urcu dependency) so chimera_vfs_thread can
- * embed it; the pool itself and the helpers live in vfs_rcu_pool.h. */
+/* RCU recycle pools: one per fungible cache (attr/name/rpl/data).  The name
+ * and rpl caches hold variable-length entries and so own one pool per size
+ * class (CHIMERA_RCU_SIZE_CLASSES consecutive ids).  The per-thread magazine
+ * type is defined here (no urcu dependency) so chimera_vfs_thread can embed
+ * it; the pool itself and the helpers live in vfs_rcu_pool.h. */
+#define CHIMERA_RCU_SIZE_CLASSES 4
+
 enum chimera_rcu_pool_id {
-    CHIMERA_RCU_POOL_ATTR = 0,
+    CHIMERA_RCU_POOL_ATTR  = 0,
     CHIMERA_RCU_POOL_NAME,
-    CHIMERA_RCU_POOL_RPL,
+    CHIMERA_RCU_POOL_RPL   = CHIMERA_RCU_POOL_NAME + CHIMERA_RCU_SIZE_CLASSES,
+    CHIMERA_RCU_POOL_DATA  = CHIMERA_RCU_POOL_RPL + CHIMERA_RCU_SIZE_CLASSES,
     CHIMERA_RCU_POOL_COUNT
 };
 
@@ -194,6 +199,11 @@ struct chimera_vfs_metrics {
     struct prometheus_metrics           *metrics;
     struct prometheus_histogram         *op_latency;
     struct prometheus_histogram_series **op_latency_series;
+    /* Delegation pools, one series per pool (indexed by delegation mode) */
+    struct prometheus_gauge             *delegation_queue_depth;
+    struct prometheus_gauge_series      *delegation_queue_depth_series[2];
+    struct prometheus_counter           *delegation_steals;
+    struct prometheus_counter_series    *delegation_steals_series[2];
 };
 
 struct chimera_vfs_thread_metrics {
@@ -246,6 +256,14 @@ struct chimera_vfs_open_handle {
      * handles and until the first I/O.  Released (state_put) at handle teardown,
      * outside the open-cache shard lock. */
     struct chimera_vfs_file_state  *file_state;
+    /* Sequential read-ahead state for the shared data cache: the offset the
+     * next in-order read is expected at, how far ahead read-ahead has already
+     * been issued, and the current window (bytes).  Reset whenever the handle
+     * is (re)populated by the open cache.  Every thread with the file open
+     * shares the handle, so these are only accessed with __atomic builtins. */
+    uint64_t                        ra_next;
+    uint64_t                        ra_issued;
+    uint32_t                        ra_window;
     void                            ( *callback )(
         struct chimera_vfs_request     *request,
         struct chimera_vfs_open_handle *handle);
@@ -333,6 +351,22 @@ typedef int (*chimera_vfs_readdir_callback_t)(
     const struct chimera_vfs_attrs *attrs,
     void                           *arg);
 
+/*
+ * An SMB wildcard pattern compiled once per readdir (vfs_proc_readdir.c) and
+ * run as a position-set NFA over each name: linear in name length times
+ * pattern length, with no backtracking.  op[] holds the pattern with literals
+ * upper-cased; null_rest[i] says whether the pattern after op[i] can match
+ * end-of-name.
+ */
+struct chimera_vfs_match {
+    uint8_t  op[CHIMERA_VFS_NAME_MAX];
+    uint8_t  null_rest[CHIMERA_VFS_NAME_MAX];
+    uint16_t len;
+    uint16_t prefix_len;   /* leading literal run */
+    uint16_t suffix_len;   /* trailing literal run */
+    uint8_t  literal;      /* no metacharacters at all */
+};
+
 typedef void (*chimera_vfs_readdir_complete_t)(
     enum chimera_vfs_error          error_code,
     struct chimera_vfs_open_handle *handle,
@@ -549,6 +583,9 @@ struct chimera_vfs_request {
     struct chimera_vfs_open_handle    *io_handle;
     uint8_t                            io_owns_lease_ref;
     struct chimera_vfs_pending_acquire io_lease_ticket;
+    /* Set on the VFS's own write-behind flush writes so dispatch does not
+     * park them behind the very flush they belong to (vfs_write_behind.h). */
+    uint8_t                            wb_flush;
 
     struct chimera_vfs_open_handle    *pending_handle;
 
@@ -788,6 +825,11 @@ struct chimera_vfs_request {
             uint32_t                        component_len;
             struct chimera_vfs_attrs        r_attr;
             struct chimera_vfs_attrs        r_dir_attr;
+            /* Set by a backend whose lookup matched a dirent stored under a
+             * different spelling (a case-insensitive fallback): the stored
+             * name.  r_namelen == 0 means the component itself matched. */
+            char                            r_name[CHIMERA_VFS_NAME_MAX];
+            uint32_t                        r_namelen;
         } lookup_at;
 
         struct {
@@ -831,6 +873,7 @@ struct chimera_vfs_request {
             int                             match_pattern_len;
             chimera_vfs_readdir_callback_t  inner_callback;
             void                           *inner_arg;
+            struct chimera_vfs_match        match;
         } readdir;
 
         struct {
@@ -926,6 +969,13 @@ struct chimera_vfs_request {
             int                             dest_niov;
             int                             dest_provided;
             int                             landed_in_dest;
+            /* Data cache fill guard (vfs_data_cache.h): dc_valid is set at
+             * dispatch when the file's attr-cache stamp and generation were
+             * captured, and the completion only populates the data cache if
+             * neither moved while the read was in flight. */
+            int                             dc_valid;
+            uint64_t                        dc_stamp;
+            uint64_t                        dc_gen;
         } read;
 
         struct {
@@ -1458,6 +1508,17 @@ struct chimera_vfs_handle_state {
  * module path themselves (e.g. as a host path for passthrough backends). */
 #define CHIMERA_VFS_CAP_MKFS                  (1UL << 25)
 
+/* If set, the module's file data already lives in memory, so the shared VFS
+ * data cache (vfs_data_cache.h) would only hold a second copy of it.  Reads
+ * against such a module bypass the data cache and read-ahead entirely. */
+#define CHIMERA_VFS_CAP_DATA_IN_MEMORY        (1UL << 26)
+
+/* If set (with CAP_BLOCKING), every request for a given file must run on the
+ * delegation thread its fh_hash selects, e.g. because the module batches a
+ * file's writes in per-thread state.  Otherwise idle delegation threads may
+ * steal the module's requests from busy ones. */
+#define CHIMERA_VFS_CAP_FH_AFFINITY           (1UL << 27)
+
 struct chimera_vfs_module {
     /* Required
      * Short name for the module to be used in creating shares
@@ -1591,16 +1652,31 @@ enum chimera_vfs_delegation_mode {
     CHIMERA_VFS_DELEGATION_ASYNC,
 };
 
+/*
+ * A request posted to a delegation pool is queued on the thread picked by its
+ * fh_hash, so a file's requests normally run on one thread.  That is only a
+ * preference in the sync pool: a thread that runs out of work of its own
+ * steals the oldest request queued behind a busy sibling, and a post that
+ * lands on a busy thread wakes an idle one to do so.  Requests for a module
+ * with CHIMERA_VFS_CAP_FH_AFFINITY are never stolen.
+ */
 struct chimera_vfs_delegation_thread {
-    struct evpl                *evpl;
-    struct chimera_vfs         *vfs;
-    struct evpl_thread         *evpl_thread;
-    struct chimera_vfs_thread  *vfs_thread;
-    struct chimera_vfs_request *requests;
-    pthread_mutex_t             lock;
-    struct evpl_doorbell        doorbell;
-    enum chimera_vfs_delegation_mode mode;
-    struct evpl_poll           *poll;
+    struct evpl                          *evpl;
+    struct chimera_vfs                   *vfs;
+    struct evpl_thread                   *evpl_thread;
+    struct chimera_vfs_thread            *vfs_thread;
+    struct chimera_vfs_request           *requests;
+    pthread_mutex_t                       lock;
+    struct evpl_doorbell                  doorbell;
+    enum chimera_vfs_delegation_mode      mode;
+    struct evpl_poll                     *poll;
+    struct chimera_vfs_delegation_thread *pool;
+    int                                   pool_size;
+    int                                   index;
+    int                                   depth; /* requests queued, atomic */
+    int                                   busy;  /* in module dispatch, atomic */
+    struct prometheus_gauge_instance     *queue_depth;
+    struct prometheus_counter_instance   *steals;
 };
 
 struct chimera_vfs_close_thread {
@@ -1631,6 +1707,12 @@ struct chimera_vfs {
     struct vfs_open_cache                *vfs_open_file_cache;
     struct chimera_vfs_name_cache        *vfs_name_cache;
     struct chimera_vfs_attr_cache        *vfs_attr_cache;
+    /* Shared file data cache; NULL unless chimera_vfs_set_data_cache_size()
+     * sized it (and the attr cache, which validates it, is enabled). */
+    struct chimera_vfs_data_cache        *vfs_data_cache;
+    /* UNSTABLE write buffer; NULL unless chimera_vfs_set_write_behind_size()
+     * sized it. */
+    struct chimera_vfs_write_behind      *vfs_write_behind;
     struct chimera_vfs_user_cache        *vfs_user_cache;
     struct chimera_vfs_identity          *identity;
     struct chimera_vfs_notify            *vfs_notify;
@@ -1665,6 +1747,7 @@ struct chimera_vfs_thread {
     /* Thread-local recycle magazines for the fungible RCU caches. */
     struct chimera_rcu_magazine          rcu_magazines[CHIMERA_RCU_POOL_COUNT];
     struct chimera_vfs_find_result      *free_find_results;
+    struct chimera_vfs_readahead        *free_readaheads;
     struct chimera_vfs_request          *free_requests;
     struct chimera_vfs_request          *active_requests;
     uint64_t                             num_active_requests;
@@ -1677,6 +1760,8 @@ struct chimera_vfs_thread {
      * pump runs on whatever thread released/broke a lease, but a request's
      * dispatch+reply must run on the thread that owns its connection iovecs). */
     struct chimera_vfs_request          *pending_io_resume;
+    /* Requests parked behind a write-behind flush, resumed on this thread. */
+    struct chimera_vfs_request          *pending_wb_resume;
     /* Monotonic seconds of the last watchdog stuck-request report. */
     time_t                               watchdog_last_report;
     struct evpl_doorbell                 doorbell;
@@ -1740,6 +1825,21 @@ chimera_vfs_set_caching_enabled(
     struct chimera_vfs *vfs,
     int                 enabled);
 
+/* Size (in bytes) the shared file data cache.  0 leaves it disabled.  Must be
+ * called before any VFS thread issues I/O; the cache is only created when the
+ * attr cache is enabled, since cached pages are validated against it. */
+void
+chimera_vfs_set_data_cache_size(
+    struct chimera_vfs *vfs,
+    uint64_t            size);
+
+/* Size (in bytes) the write-behind buffer for UNSTABLE writes.  0 leaves it
+ * disabled.  Must be called before any VFS thread issues I/O. */
+void
+chimera_vfs_set_write_behind_size(
+    struct chimera_vfs *vfs,
+    uint64_t            size);
+
 /* Get the root pseudo-filesystem's file handle */
 void
 chimera_vfs_get_root_fh(
@@ -317,6 +317,57 @@ chimera_vfs_attr_cache_insert(
 
 } /* chimera_vfs_attr_cache_insert */
 
+static inline void
+chimera_vfs_attr_cache_remove(
+    struct chimera_vfs_attr_cache *cache,
+    uint64_t                       fh_hash,
+    const void                    *fh,
+    int                            fh_len)
+{
+    struct chimera_vfs_attr_cache_entry  *entry, *removed_entry = NULL;
+    struct chimera_vfs_attr_cache_shard  *shard;
+    struct chimera_vfs_attr_cache_entry **slot, **slot_end;
+
+    if (!cache) {
+        return;
+    }
+
+    shard = &cache->shards[fh_hash & cache->num_shards_mask];
+
+    /* See lookup for the disjoint slot/shard bit rationale. */
+    slot = &shard->entries[((fh_hash >> cache->num_shards_bits) & cache->num_slots_mask) << cache->num_entries_bits];
+
+    slot_end = slot + cache->num_entries;
+
+    urcu_qsbr_read_lock();
+
+    pthread_mutex_lock(&shard->entry_lock);
+
+    while (slot < slot_end) {
+
+        entry = *slot;
+
+        if (entry && entry->key == fh_hash &&
+            chimera_memequal(entry->attr.va_fh, entry->attr.va_fh_len, fh, fh_len)) {
+
+            removed_entry = entry;
+            rcu_assign_pointer(*slot, NULL);
+            break;
+        }
+
+        slot++;
+    }
+
+    pthread_mutex_unlock(&shard->entry_lock);
+
+    urcu_qsbr_read_unlock();
+
+    if (removed_entry) {
+        call_rcu(&removed_entry->rnode.rcu, chimera_rcu_pool_retire);
+    }
+
+} /* chimera_vfs_attr_cache_remove */
+
 /*
  * Do two attr sets carry the same change-significant fields?  ctime is the
  * metadata catch-all (it advances on any mode/uid/gid/size/mtime change), mtime
@@ -0,0 +1,625 @@
+// SPDX-FileCopyrightText: 2025-2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#pragma once
+
+/*
+ * Shared file data cache.
+ *
+ * Caches fixed-size, page-aligned chunks of file data across all VFS threads
+ * and all backends, so repeated and sequential reads of hot files are served
+ * from memory without a trip through the module.  Layout follows the attr and
+ * name caches: sharded, set-associative slots of RCU-published entries
+ * recycled through a chimera_rcu_pool.
+ *
+ * Coherence.  A page is only valid while two things hold:
+ *
+ *   - its stamp matches the file's current attr cache entry.  The stamp is
+ *     va_change for modules with CHIMERA_VFS_CAP_CHANGE, otherwise a digest
+ *     of size/mtime/ctime.  Any change another client makes to the file
+ *     surfaces through the attr cache (TTL-bounded, as for attributes), and
+ *     every page of the old version then stops matching.
+ *
+ *   - its generation matches the file's current generation.  Generations are
+ *     a small hashed array of counters bumped by every mutating VFS op on the
+ *     file, both at dispatch and at completion.  A read that straddles a local
+ *     write therefore can never publish the pre-write data, and a hit can
+ *     never serve data a completed local write has since replaced, even
+ *     before the attr cache has seen the new stamp.
+ *
+ * Pages are filled only from reads whose stamp and generation did not move
+ * between dispatch and completion (see vfs_proc_read.c).
+ */
+
+#include "vfs/vfs.h"
+#include "vfs/vfs_rcu_pool.h"
+#include "vfs/vfs_attr_cache.h"
+#include <urcu/urcu-qsbr.h>
+#include <xxhash.h>
+
+#define CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT 15
+#define CHIMERA_VFS_DATA_CACHE_PAGE_SIZE  (1U << CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT)
+#define CHIMERA_VFS_DATA_CACHE_PAGE_MASK  ((uint64_t) CHIMERA_VFS_DATA_CACHE_PAGE_SIZE - 1)
+
+/* Upper bound on the pages a single cached read may span; larger reads go
+ * to the backend (and still fill the cache on completion). */
+#define CHIMERA_VFS_DATA_CACHE_MAX_PAGES  128
+
+#define CHIMERA_VFS_DATA_CACHE_GEN_BITS   16
+
+/* Sequential read-ahead (vfs_proc_read.c): the window starts at MIN on the
+ * first in-order read, doubles on each further one up to MAX, and is issued
+ * as backend reads of at most CHUNK bytes. */
+#define CHIMERA_VFS_READAHEAD_MIN_WINDOW  (256 * 1024)
+#define CHIMERA_VFS_READAHEAD_MAX_WINDOW  (4 * 1024 * 1024)
+#define CHIMERA_VFS_READAHEAD_CHUNK       (1024 * 1024)
+#define CHIMERA_VFS_READAHEAD_NIOV        64
+
+/* One in-flight read-ahead.  Recycled on thread->free_readaheads. */
+struct chimera_vfs_readahead {
+    struct chimera_vfs_thread      *thread;
+    struct chimera_vfs_open_handle *handle;
+    struct chimera_vfs_cred         cred;
+    struct evpl_iovec               iov[CHIMERA_VFS_READAHEAD_NIOV];
+    struct chimera_vfs_readahead   *next;
+};
+
+struct chimera_vfs_data_cache_entry {
+    struct chimera_rcu_node rnode; /* must be first: aliases the entry pointer */
+    uint64_t                key;
+    uint64_t                fh_hash;
+    uint64_t                page;
+    uint64_t                gen;
+    uint64_t                stamp;
+    int64_t                 score;
+    uint32_t                length; /* valid bytes; < page size only for the EOF page */
+    uint16_t                fh_len;
+    uint8_t                 fh[CHIMERA_VFS_FH_SIZE];
+    uint8_t                 data[] __attribute__((aligned(64)));
+};
+
+struct chimera_vfs_data_cache_shard {
+    struct chimera_vfs_data_cache_entry **entries;
+    pthread_mutex_t                       entry_lock;
+    struct prometheus_counter_instance   *miss;
+    struct prometheus_counter_instance   *hit;
+    struct prometheus_counter_instance   *insert;
+    struct prometheus_counter_instance   *readahead;
+};
+
+struct chimera_vfs_data_cache {
+    uint8_t                              num_slots_bits;
+    uint8_t                              num_shards_bits;
+    uint8_t                              num_entries_bits;
+    uint64_t                             num_slots;
+    uint32_t                             num_shards;
+    uint32_t                             num_entries;
+    uint64_t                             num_slots_mask;
+    uint32_t                             num_shards_mask;
+    uint32_t                             num_entries_mask;
+    uint64_t                            *gens;
+    struct chimera_rcu_pool              pool;
+    struct chimera_vfs_data_cache_shard *shards;
+    struct prometheus_metrics           *metrics;
+    struct prometheus_counter           *data_cache;
+    struct prometheus_counter_series    *miss_series;
+    struct prometheus_counter_series    *hit_series;
+    struct prometheus_counter_series    *insert_series;
+    struct prometheus_counter_series    *readahead_series;
+};
+
+static inline struct chimera_vfs_data_cache *
+chimera_vfs_data_cache_create(
+    uint64_t                   size,
+    struct prometheus_metrics *metrics)
+{
+    struct chimera_vfs_data_cache       *cache;
+    struct chimera_vfs_data_cache_shard *shard;
+    uint64_t                             num_pages;
+    int                                  i;
+
+    cache = calloc(1, sizeof(struct chimera_vfs_data_cache));
+
+    /* 256 shards of 4-way slots; the slot count per shard is what scales
+     * with the configured size. */
+    cache->num_shards_bits  = 8;
+    cache->num_entries_bits = 2;
+
+    num_pages = size >> CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT;
+
+    cache->num_slots_bits = 0;
+
+    while ((2ULL << (cache->num_slots_bits + cache->num_shards_bits + cache->num_entries_bits)) <= num_pages) {
+        cache->num_slots_bits++;
+    }
+
+    chimera_rcu_pool_init(&cache->pool, CHIMERA_RCU_POOL_DATA,
+                          sizeof(struct chimera_vfs_data_cache_entry) + CHIMERA_VFS_DATA_CACHE_PAGE_SIZE);
+
+    cache->num_shards  = 1 << cache->num_shards_bits;
+    cache->num_slots   = 1ULL << cache->num_slots_bits;
+    cache->num_entries = 1 << cache->num_entries_bits;
+
+    cache->num_slots_mask   = cache->num_slots - 1;
+    cache->num_shards_mask  = cache->num_shards - 1;
+    cache->num_entries_mask = cache->num_entries - 1;
+
+    cache->gens = calloc(1ULL << CHIMERA_VFS_DATA_CACHE_GEN_BITS, sizeof(uint64_t));
+
+    cache->shards = calloc(cache->num_shards, sizeof(struct chimera_vfs_data_cache_shard));
+
+    if (metrics) {
+        cache->metrics    = metrics;
+        cache->data_cache = prometheus_metrics_create_counter(metrics, "chimera_data_cache",
+                                                              "Operations on the chimera VFS data cache");
+
+        cache->miss_series = prometheus_counter_create_series(cache->data_cache,
+                                                              (const char *[]) { "op" },
+                                                              (const char *[]) { "miss" }, 1);
+        cache->hit_series = prometheus_counter_create_series(cache->data_cache,
+                                                             (const char *[]) { "op" },
+                                                             (const char *[]) { "hit" }, 1);
+        cache->insert_series = prometheus_counter_create_series(cache->data_cache,
+                                                                (const char *[]) { "op" },
+                                                                (const char *[]) { "insert" }, 1);
+        cache->readahead_series = prometheus_counter_create_series(cache->data_cache,
+                                                                   (const char *[]) { "op" },
+                                                                   (const char *[]) { "readahead" }, 1);
+    }
+
+    for (i = 0; i < cache->num_shards; i++) {
+
+        shard          = &cache->shards[i];
+        shard->entries = calloc(cache->num_slots * cache->num_entries,
+                                sizeof(struct chimera_vfs_data_cache_entry *));
+
+        pthread_mutex_init(&shard->entry_lock, NULL);
+
+        shard->miss      = prometheus_counter_series_create_instance(cache->miss_series);
+        shard->hit       = prometheus_counter_series_create_instance(cache->hit_series);
+        shard->insert    = prometheus_counter_series_create_instance(cache->insert_series);
+        shard->readahead = prometheus_counter_series_create_instance(cache->readahead_series);
+    }
+
+    return cache;
+} /* chimera_vfs_data_cache_create */
+
+static inline void
+chimera_vfs_data_cache_destroy(struct chimera_vfs_data_cache *cache)
+{
+    struct chimera_vfs_data_cache_shard *shard;
+    int                                  i, j;
+
+    if (!cache) {
+        return;
+    }
+
+    rcu_barrier();
+
+    for (i = 0; i < cache->num_shards; i++) {
+        shard = &cache->shards[i];
+
+        prometheus_counter_series_destroy_instance(cache->readahead_series, shard->readahead);
+        prometheus_counter_series_destroy_instance(cache->insert_series, shard->insert);
+        prometheus_counter_series_destroy_instance(cache->hit_series, shard->hit);
+        prometheus_counter_series_destroy_instance(cache->miss_series, shard->miss);
+
+        for (j = 0; j < cache->num_slots * cache->num_entries; j++) {
+            if (shard->entries[j]) {
+                free(shard->entries[j]);
+            }
+        }
+
+        free(shard->entries);
+
+        pthread_mutex_destroy(&shard->entry_lock);
+    }
+
+    chimera_rcu_pool_destroy(&cache->pool);
+
+    if (cache->metrics) {
+        prometheus_counter_destroy_series(cache->data_cache, cache->readahead_series);
+        prometheus_counter_destroy_series(cache->data_cache, cache->insert_series);
+        prometheus_counter_destroy_series(cache->data_cache, cache->hit_series);
+        prometheus_counter_destroy_series(cache->data_cache, cache->miss_series);
+        prometheus_counter_destroy(cache->metrics, cache->data_cache);
+    }
+
+    free(cache->gens);
+    free(cache->shards);
+    free(cache);
+} /* chimera_vfs_data_cache_destroy */
+
+/* Mix the page index into the file hash so consecutive pages of one file
+ * scatter across shards instead of hammering one. */
+static inline uint64_t
+chimera_vfs_data_cache_key(
+    uint64_t fh_hash,
+    uint64_t page)
+{
+    uint64_t h = fh_hash ^ (page * 0x9E3779B97F4A7C15ULL);
+
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 29;
+
+    return h;
+} /* chimera_vfs_data_cache_key */
+
+static inline uint64_t *
+chimera_vfs_data_cache_gen_slot(
+    struct chimera_vfs_data_cache *cache,
+    uint64_t                       fh_hash)
+{
+    return &cache->gens[fh_hash & ((1ULL << CHIMERA_VFS_DATA_CACHE_GEN_BITS) - 1)];
+} /* chimera_vfs_data_cache_gen_slot */
+
+static inline uint64_t
+chimera_vfs_data_cache_gen(
+    struct chimera_vfs_data_cache *cache,
+    uint64_t                       fh_hash)
+{
+    return __atomic_load_n(chimera_vfs_data_cache_gen_slot(cache, fh_hash), __ATOMIC_ACQUIRE);
+} /* chimera_vfs_data_cache_gen */
+
+/* Invalidate every cached page of the file (and of any file sharing its
+ * generation slot) by advancing the generation.  Pages are not unlinked;
+ * they simply stop matching and age out. */
+static inline void
+chimera_vfs_data_cache_invalidate(
+    struct chimera_vfs_data_cache *cache,
+    uint64_t                       fh_hash)
+{
+    if (!cache) {
+        return;
+    }
+
+    __atomic_add_fetch(chimera_vfs_data_cache_gen_slot(cache, fh_hash), 1, __ATOMIC_RELEASE);
+} /* chimera_vfs_data_cache_invalidate */
+
+/* Version stamp of a file's data as described by a stat-complete attr set. */
+static inline uint64_t
+chimera_vfs_data_cache_stamp(const struct chimera_vfs_attrs *attr)
+{
+    uint64_t v[5];
+
+    if (attr->va_set_mask & CHIMERA_VFS_ATTR_CHANGE) {
+        return attr->va_change;
+    }
+
+    v[0] = attr->va_size;
+    v[1] = attr->va_mtime.tv_sec;
+    v[2] = attr->va_mtime.tv_nsec;
+    v[3] = attr->va_ctime.tv_sec;
+    v[4] = attr->va_ctime.tv_nsec;
+
+    return XXH3_64bits(v, sizeof(v));
+} /* chimera_vfs_data_cache_stamp */
+
+/*
+ * Resolve the current stamp of a file from the attr cache.  Returns 0 and
+ * fills *r_attr / *r_stamp when a live attr entry exists, -1 otherwise (in
+ * which case the data cache can neither serve nor be filled for this file).
+ */
+static inline int
+chimera_vfs_data_cache_validate(
+    struct chimera_vfs_attr_cache *attr_cache,
+    uint64_t                       fh_hash,
+    const void                    *fh,
+    int                            fh_len,
+    struct chimera_vfs_attrs      *r_attr,
+    uint64_t                      *r_stamp)
+{
+    if (chimera_vfs_attr_cache_lookup(attr_cache, fh_hash, fh, fh_len, r_attr) != 0) {
+        return -1;
+    }
+
+    *r_stamp = chimera_vfs_data_cache_stamp(r_attr);
+
+    return 0;
+} /* chimera_vfs_data_cache_validate */
+
+static inline struct chimera_vfs_data_cache_entry **
+chimera_vfs_data_cache_slot(
+    struct chimera_vfs_data_cache        *cache,
+    uint64_t                              key,
+    struct chimera_vfs_data_cache_shard **r_shard)
+{
+    struct chimera_vfs_data_cache_shard *shard;
+
+    shard = &cache->shards[key & cache->num_shards_mask];
+
+    *r_shard = shard;
+
+    /* Disjoint slot/shard bit windows, as in the attr cache. */
+    return &shard->entries[((key >> cache->num_shards_bits) & cache->num_slots_mask) << cache->num_entries_bits];
+} /* chimera_vfs_data_cache_slot */
+
+/*
+ * Find every page covering [offset, offset + length) of the file.  Must be
+ * called inside an RCU read-side critical section, which the caller holds
+ * until it is done copying out of the returned entries.  Returns 0 only if
+ * every page is resident with the given stamp and generation and holds
+ * enough bytes; on any miss returns -1 (nothing is partially served).
+ */
+static inline int
+chimera_vfs_data_cache_gather(
+    struct chimera_vfs_data_cache        *cache,
+    uint64_t                              fh_hash,
+    const void                           *fh,
+    int                                   fh_len,
+    uint64_t                              stamp,
+    uint64_t                              gen,
+    uint64_t                              offset,
+    uint32_t                              length,
+    struct chimera_vfs_data_cache_entry **r_entries)
+{
+    struct chimera_vfs_data_cache_shard  *shard;
+    struct chimera_vfs_data_cache_entry **slot, **slot_end, *entry;
+    uint64_t                              page, first, last, key, need;
+    int                                   i, n = 0;
+
+    first = offset >> CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT;
+    last  = (offset + length - 1) >> CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT;
+
+    if (last - first >= CHIMERA_VFS_DATA_CACHE_MAX_PAGES) {
+        return -1;
+    }
+
+    for (page = first; page <= last; page++) {
+
+        key = chimera_vfs_data_cache_key(fh_hash, page);
+
+        slot     = chimera_vfs_data_cache_slot(cache, key, &shard);
+        slot_end = slot + cache->num_entries;
+
+        /* Bytes of this page the read needs, measured from the page start. */
+        need = (page == last) ?
+            ((offset + length - 1) & CHIMERA_VFS_DATA_CACHE_PAGE_MASK) + 1 :
+            CHIMERA_VFS_DATA_CACHE_PAGE_SIZE;
+
+        entry = NULL;
+
+        while (slot < slot_end) {
+            entry = rcu_dereference(*slot);
+
+            if (entry &&
+                entry->key == key &&
+                entry->page == page &&
+                entry->fh_hash == fh_hash &&
+                entry->gen == gen &&
+                entry->stamp == stamp &&
+                entry->length >= need &&
+                chimera_memequal(entry->fh, entry->fh_len, fh, fh_len)) {
+                break;
+            }
+
+            entry = NULL;
+            slot++;
+        }
+
+        if (!entry) {
+            prometheus_counter_increment(shard->miss);
+            return -1;
+        }
+
+        r_entries[n++] = entry;
+    }
+
+    for (i = 0; i < n; i++) {
+        r_entries[i]->score++;
+    }
+
+    prometheus_counter_increment(shard->hit);
+
+    return 0;
+} /* chimera_vfs_data_cache_gather */
+
+/* Copy [offset, offset + length) out of the entries returned by _gather into
+ * iov.  iov must have room for length bytes. */
+static inline void
+chimera_vfs_data_cache_copyout(
+    struct chimera_vfs_data_cache_entry **entries,
+    uint64_t                              offset,
+    uint32_t                              length,
+    struct evpl_iovec                    *iov,
+    int                                   niov)
+{
+    uint32_t page_off = offset & CHIMERA_VFS_DATA_CACHE_PAGE_MASK;
+    uint32_t iov_off  = 0, chunk;
+    int      e        = 0, i = 0;
+
+    while (length && i < niov) {
+
+        chunk = CHIMERA_VFS_DATA_CACHE_PAGE_SIZE - page_off;
+
+        if (chunk > length) {
+            chunk = length;
+        }
+
+        if (chunk > iov[i].length - iov_off) {
+            chunk = iov[i].length - iov_off;
+        }
+
+        memcpy((uint8_t *) iov[i].data + iov_off, entries[e]->data + page_off, chunk);
+
+        length   -= chunk;
+        page_off += chunk;
+        iov_off  += chunk;
+
+        if (page_off == CHIMERA_VFS_DATA_CACHE_PAGE_SIZE) {
+            page_off = 0;
+            e++;
+        }
+
+        if (iov_off == iov[i].length) {
+            iov_off = 0;
+            i++;
+        }
+    }
+} /* chimera_vfs_data_cache_copyout */
+
+static inline void
+chimera_vfs_data_cache_insert_page(
+    struct chimera_vfs_thread           *thread,
+    struct chimera_vfs_data_cache       *cache,
+    struct chimera_vfs_data_cache_entry *entry)
+{
+    struct chimera_vfs_data_cache_shard  *shard;
+    struct chimera_vfs_data_cache_entry **slot, **slot_end, **slot_best;
+    struct chimera_vfs_data_cache_entry  *old_entry, *best_entry;
+
+    slot     = chimera_vfs_data_cache_slot(cache, entry->key, &shard);
+    slot_end = slot + cache->num_entries;
+
+    slot_best = slot;
+
+    urcu_qsbr_read_lock();
+
+    pthread_mutex_lock(&shard->entry_lock);
+
+    best_entry = *slot_best;
+
+    while (slot < slot_end) {
+        old_entry = *slot;
+
+        if (old_entry && old_entry->key == entry->key && old_entry->page == entry->page) {
+            best_entry = old_entry;
+            slot_best  = slot;
+            break;
+        }
+
+        if ((best_entry && !old_entry) || (best_entry && old_entry && best_entry->score > old_entry->score)) {
+            best_entry = old_entry;
+            slot_best  = slot;
+        }
+
+        slot++;
+    }
+
+    rcu_assign_pointer(*slot_best, entry);
+
+    prometheus_counter_increment(shard->insert);
+
+    pthread_mutex_unlock(&shard->entry_lock);
+
+    urcu_qsbr_read_unlock();
+
+    if (best_entry) {
+        call_rcu(&best_entry->rnode.rcu, chimera_rcu_pool_retire);
+    }
+} /* chimera_vfs_data_cache_insert_page */
+
+/*
+ * Populate the cache from a completed read of [offset, offset + length).
+ * Only whole pages are cached, plus the partial final page when the read hit
+ * EOF (its length then records how much of it exists).
+ */
+static inline void
+chimera_vfs_data_cache_insert(
+    struct chimera_vfs_thread     *thread,
+    struct chimera_vfs_data_cache *cache,
+    uint64_t                       fh_hash,
+    const void                    *fh,
+    int                            fh_len,
+    uint64_t                       stamp,
+    uint64_t                       gen,
+    uint64_t                       offset,
+    uint32_t                       length,
+    int                            eof,
+    const struct evpl_iovec       *iov,
+    int                            niov)
+{
+    struct chimera_vfs_data_cache_entry *entry;
+    uint64_t                             page, page_start, end = offset + length;
+    uint32_t                             skip, page_len, chunk, done;
+    uint32_t                             iov_off = 0;
+    int                                  i       = 0;
+
+    if (!cache || !length) {
+        return;
+    }
+
+    page = (offset + CHIMERA_VFS_DATA_CACHE_PAGE_MASK) >> CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT;
+
+    /* Skip the unaligned head: it belongs to a page this read only partially
+     * covers. */
+    skip = (page << CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT) - offset;
+
+    while (i < niov && skip) {
+        chunk = iov[i].length - iov_off;
+        if (chunk > skip) {
+            chunk = skip;
+        }
+        skip    -= chunk;
+        iov_off += chunk;
+        if (iov_off == iov[i].length) {
+            iov_off = 0;
+            i++;
+        }
+    }
+
+    for (;; page++) {
+
+        page_start = page << CHIMERA_VFS_DATA_CACHE_PAGE_SHIFT;
+
+        if (page_start >= end) {
+            break;
+        }
+
+        if (page_start + CHIMERA_VFS_DATA_CACHE_PAGE_SIZE <= end) {
+            page_len = CHIMERA_VFS_DATA_CACHE_PAGE_SIZE;
+        } else if (eof) {
+            page_len = end - page_start;
+        } else {
+            break;
+        }
+
+        entry = (struct chimera_vfs_data_cache_entry *)
+            chimera_rcu_pool_alloc(&thread->rcu_magazines[CHIMERA_RCU_POOL_DATA], &cache->pool);
+
+        entry->key     = chimera_vfs_data_cache_key(fh_hash, page);
+        entry->fh_hash = fh_hash;
+        entry->page    = page;
+        entry->gen     = gen;
+        entry->stamp   = stamp;
+        entry->score   = 0;
+        entry->length  = page_len;
+        entry->fh_len  = fh_len;
+        memcpy(entry->fh, fh, fh_len);
+
+        done = 0;
+
+        while (done < page_len && i < niov) {
+            chunk = iov[i].length - iov_off;
+            if (chunk > page_len - done) {
+                chunk = page_len - done;
+            }
+            memcpy(entry->data + done, (const uint8_t *) iov[i].data + iov_off, chunk);
+            done    += chunk;
+            iov_off += chunk;
+            if (iov_off == iov[i].length) {
+                iov_off = 0;
+                i++;
+            }
+        }
+
+        if (done < page_len) {
+            /* Short iov chain; should not happen, but never publish a page
+             * with uninitialised bytes. */
+            call_rcu(&entry->rnode.rcu, chimera_rcu_pool_retire);
+            break;
+        }
+
+        chimera_vfs_data_cache_insert_page(thread, cache, entry);
+    }
+} /* chimera_vfs_data_cache_insert */
+
+static inline void
+chimera_vfs_data_cache_count_readahead(
+    struct chimera_vfs_data_cache *cache,
+    uint64_t                       fh_hash)
+{
+    prometheus_counter_increment(cache->shards[fh_hash & cache->num_shards_mask].readahead);
+} /* chimera_vfs_data_cache_count_readahead */
@@ -20,6 +20,8 @@
 #include "common/misc.h"
 #include "metrics/metrics.h"
 #include "vfs/vfs_dump.h"
+#include "vfs/vfs_data_cache.h"
+#include "vfs/vfs_write_behind.h"
 
 /* Canonical access bits an open with the given flags requires against
  * the target file. */
@@ -406,6 +408,7 @@ chimera_vfs_request_alloc_common(
     request->io_lease_file        = NULL;
     request->io_handle            = NULL;
     request->io_owns_lease_ref    = 0;
+    request->wb_flush             = 0;
 
     if (fh && fhlen > 0) {
         memcpy(request->fh, fh, fhlen);
@@ -559,6 +562,77 @@ chimera_vfs_synth_handle_free(
     LL_PREPEND(thread->free_synth_handles, handle);
 } /* chimera_vfs_synth_handle_free */
 
+/* Returns 1 if the request would mutate the filesystem and so must be rejected
+ * on a read-only mount, 0 otherwise.  For OPEN_AT / OPEN_FH / OPEN_STREAM the
+ * decision is flag-dependent: a pure read-only open is permitted, but an open
+ * that requests create, write or truncate is a mutation.  Every op not listed
+ * here (READ, READLINK, GETATTR, LOOKUP, READDIR, ACCESS, COMMIT, SEEK, LOCK,
+ * GET_XATTR, LIST_XATTRS, LIST_STREAMS, GET_LAYOUT, GETPARENT, the KV reads,
+ * etc.) is treated as non-mutating and dispatched normally. */
+static inline int
+chimera_vfs_op_is_mutating(const struct chimera_vfs_request *request)
+{
+    switch (request->opcode) {
+        case CHIMERA_VFS_OP_WRITE:
+        case CHIMERA_VFS_OP_REMOVE_AT:
+        case CHIMERA_VFS_OP_MKDIR_AT:
+        case CHIMERA_VFS_OP_SYMLINK_AT:
+        case CHIMERA_VFS_OP_RENAME_AT:
+        case CHIMERA_VFS_OP_SETATTR:
+        case CHIMERA_VFS_OP_LINK_AT:
+        case CHIMERA_VFS_OP_CREATE_UNLINKED:
+        case CHIMERA_VFS_OP_MKNOD_AT:
+        case CHIMERA_VFS_OP_ALLOCATE:
+        case CHIMERA_VFS_OP_SET_XATTR:
+        case CHIMERA_VFS_OP_REMOVE_XATTR:
+        case CHIMERA_VFS_OP_REMOVE_STREAM:
+        case CHIMERA_VFS_OP_COPY_RANGE:
+        case CHIMERA_VFS_OP_CLONE_RANGE:
+        case CHIMERA_VFS_OP_MOVE_RANGE:
+        case CHIMERA_VFS_OP_PUT_KEY:
+        case CHIMERA_VFS_OP_DELETE_KEY:
+            return 1;
+        case CHIMERA_VFS_OP_OPEN_AT:
+            return !!(request->open_at.flags &
+                      (CHIMERA_VFS_OPEN_CREATE |
+                       CHIMERA_VFS_OPEN_WRITE_ONLY |
+                       CHIMERA_VFS_OPEN_TRUNCATE));
+        case CHIMERA_VFS_OP_OPEN_FH:
+            return !!(request->open_fh.flags &
+                      (CHIMERA_VFS_OPEN_CREATE |
+                       CHIMERA_VFS_OPEN_WRITE_ONLY |
+                       CHIMERA_VFS_OPEN_TRUNCATE));
+        case CHIMERA_VFS_OP_OPEN_STREAM:
+            return !!(request->open_stream.flags &
+                      (CHIMERA_VFS_OPEN_CREATE |
+                       CHIMERA_VFS_OPEN_WRITE_ONLY |
+                       CHIMERA_VFS_OPEN_TRUNCATE));
+        default:
+            return 0;
+    } /* switch */
+} /* chimera_vfs_op_is_mutating */
+
+/* Advance the data cache generation of every file a mutating op may change.
+ * Called both when the op is dispatched and when it completes, so a read
+ * racing the op in either direction fails its fill guard (vfs_data_cache.h).
+ * request->fh is the op's target (the destination for the range ops);
+ * move_range also punches its source. */
+static inline void
+chimera_vfs_data_cache_invalidate_request(const struct chimera_vfs_request *request)
+{
+    struct chimera_vfs_data_cache *cache = request->thread->vfs->vfs_data_cache;
+
+    if (!cache) {
+        return;
+    }
+
+    chimera_vfs_data_cache_invalidate(cache, request->fh_hash);
+
+    if (request->opcode == CHIMERA_VFS_OP_MOVE_RANGE) {
+        chimera_vfs_data_cache_invalidate(cache, request->move_range.src_handle->fh_hash);
+    }
+} /* chimera_vfs_data_cache_invalidate_request */
+
 static inline void
 chimera_vfs_complete(struct chimera_vfs_request *request)
 {
@@ -576,6 +650,10 @@ chimera_vfs_complete(struct chimera_vfs_request *request)
      * the whole call compiles out when tracing is disabled. */
     chimera_vfs_trace_complete(request);
 
+    if (chimera_vfs_op_is_mutating(request)) {
+        chimera_vfs_data_cache_invalidate_request(request);
+    }
+
     /* Re-publish this op's trace parent so the proto completion callback that
      * runs next (on this thread) issues any chained sibling VFS op under the same
      * protocol span.  Consumed (cleared) at that op's alloc. */
@@ -632,70 +710,66 @@ chimera_vfs_io_resume_post(struct chimera_vfs_request *request)
     evpl_ring_doorbell(&thread->doorbell);
 } /* chimera_vfs_io_resume_post */
 
+/* Is the request free to run on any thread of the sync delegation pool? */
+static inline int
+chimera_vfs_delegation_stealable(const struct chimera_vfs_request *request)
+{
+    return !(request->module->capabilities & CHIMERA_VFS_CAP_FH_AFFINITY);
+} /* chimera_vfs_delegation_stealable */
+
+/* Find a sync-pool sibling of home with nothing queued and nothing running,
+ * scanning from home's neighbour so concurrent posters fan out. */
+static inline struct chimera_vfs_delegation_thread *
+chimera_vfs_delegation_find_idle(struct chimera_vfs_delegation_thread *home)
+{
+    struct chimera_vfs_delegation_thread *sibling;
+    int                                   i;
+
+    for (i = 1; i < home->pool_size; i++) {
+        sibling = &home->pool[(home->index + i) % home->pool_size];
+
+        if (!__atomic_load_n(&sibling->busy, __ATOMIC_RELAXED) &&
+            !__atomic_load_n(&sibling->depth, __ATOMIC_RELAXED)) {
+            return sibling;
+        }
+    }
+
+    return NULL;
+} /* chimera_vfs_delegation_find_idle */
+
 static inline void
 chimera_vfs_post_to_delegation(
     struct chimera_vfs_request           *request,
     struct chimera_vfs_delegation_thread *delegation_thread)
 {
+    struct chimera_vfs_delegation_thread *idle = NULL;
+    int                                   depth;
+
     request->complete_delegate = request->complete;
     request->complete          = chimera_vfs_complete_delegate;
 
     pthread_mutex_lock(&delegation_thread->lock);
     DL_APPEND(delegation_thread->requests, request);
+    depth = __atomic_add_fetch(&delegation_thread->depth, 1, __ATOMIC_RELAXED);
+    if (delegation_thread->queue_depth) {
+        prometheus_gauge_set(delegation_thread->queue_depth, depth);
+    }
     pthread_mutex_unlock(&delegation_thread->lock);
 
     evpl_ring_doorbell(&delegation_thread->doorbell);
-} /* chimera_vfs_post_to_delegation */
 
-/* Returns 1 if the request would mutate the filesystem and so must be rejected
- * on a read-only mount, 0 otherwise.  For OPEN_AT / OPEN_FH / OPEN_STREAM the
- * decision is flag-dependent: a pure read-only open is permitted, but an open
- * that requests create, write or truncate is a mutation.  Every op not listed
- * here (READ, READLINK, GETATTR, LOOKUP, READDIR, ACCESS, COMMIT, SEEK, LOCK,
- * GET_XATTR, LIST_XATTRS, LIST_STREAMS, GET_LAYOUT, GETPARENT, the KV reads,
- * etc.) is treated as non-mutating and dispatched normally. */
-static inline int
-chimera_vfs_op_is_mutating(const struct chimera_vfs_request *request)
-{
-    switch (request->opcode) {
-        case CHIMERA_VFS_OP_WRITE:
-        case CHIMERA_VFS_OP_REMOVE_AT:
-        case CHIMERA_VFS_OP_MKDIR_AT:
-        case CHIMERA_VFS_OP_SYMLINK_AT:
-        case CHIMERA_VFS_OP_RENAME_AT:
-        case CHIMERA_VFS_OP_SETATTR:
-        case CHIMERA_VFS_OP_LINK_AT:
-        case CHIMERA_VFS_OP_CREATE_UNLINKED:
-        case CHIMERA_VFS_OP_MKNOD_AT:
-        case CHIMERA_VFS_OP_ALLOCATE:
-        case CHIMERA_VFS_OP_SET_XATTR:
-        case CHIMERA_VFS_OP_REMOVE_XATTR:
-        case CHIMERA_VFS_OP_REMOVE_STREAM:
-        case CHIMERA_VFS_OP_COPY_RANGE:
-        case CHIMERA_VFS_OP_CLONE_RANGE:
-        case CHIMERA_VFS_OP_MOVE_RANGE:
-        case CHIMERA_VFS_OP_PUT_KEY:
-        case CHIMERA_VFS_OP_DELETE_KEY:
-            return 1;
-        case CHIMERA_VFS_OP_OPEN_AT:
-            return !!(request->open_at.flags &
-                      (CHIMERA_VFS_OPEN_CREATE |
-                       CHIMERA_VFS_OPEN_WRITE_ONLY |
-                       CHIMERA_VFS_OPEN_TRUNCATE));
-        case CHIMERA_VFS_OP_OPEN_FH:
-            return !!(request->open_fh.flags &
-                      (CHIMERA_VFS_OPEN_CREATE |
-                       CHIMERA_VFS_OPEN_WRITE_ONLY |
-                       CHIMERA_VFS_OPEN_TRUNCATE));
-        case CHIMERA_VFS_OP_OPEN_STREAM:
-            return !!(request->open_stream.flags &
-                      (CHIMERA_VFS_OPEN_CREATE |
-                       CHIMERA_VFS_OPEN_WRITE_ONLY |
-                       CHIMERA_VFS_OPEN_TRUNCATE));
-        default:
-            return 0;
-    } /* switch */
-} /* chimera_vfs_op_is_mutating */
+    /* The home thread is tied up in a blocking call; have an idle sibling
+     * take the request instead of letting it wait behind that call. */
+    if (delegation_thread->mode == CHIMERA_VFS_DELEGATION_SYNC &&
+        __atomic_load_n(&delegation_thread->busy, __ATOMIC_RELAXED) &&
+        chimera_vfs_delegation_stealable(request)) {
+        idle = chimera_vfs_delegation_find_idle(delegation_thread);
+    }
+
+    if (idle) {
+        evpl_ring_doorbell(&idle->doorbell);
+    }
+} /* chimera_vfs_post_to_delegation */
 
 /* Returns 1 if the request targets a read-only mount, 0 otherwise (including
  * when the mount cannot be resolved -- such requests fall through to normal
@@ -736,13 +810,23 @@ chimera_vfs_dispatch(struct chimera_vfs_request *request)
         return;
     }
 
+    /* Hold any op on a file with write-behind data until that data has
+     * reached the backend (vfs_write_behind.h). */
+    if (vfs->vfs_write_behind && !request->wb_flush &&
+        chimera_vfs_write_behind_intercept(request)) {
+        return;
+    }
+
     /* Read-only mount enforcement: reject mutating ops with EROFS before they
      * reach the backend (or a delegation thread). */
-    if (chimera_vfs_op_is_mutating(request) &&
-        chimera_vfs_mount_is_readonly(request)) {
-        request->status = CHIMERA_VFS_EROFS;
-        request->complete(request);
-        return;
+    if (chimera_vfs_op_is_mutating(request)) {
+        if (chimera_vfs_mount_is_readonly(request)) {
+            request->status = CHIMERA_VFS_EROFS;
+            request->complete(request);
+            return;
+        }
+
+        chimera_vfs_data_cache_invalidate_request(request);
     }
 
     if ((module->capabilities & CHIMERA_VFS_CAP_BLOCKING) &&
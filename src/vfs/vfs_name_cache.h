@@ -8,21 +8,56 @@
 #include "vfs/vfs_rcu_pool.h"
 #include <urcu/urcu-qsbr.h>
 
+/* Entries are variable length: the parent FH, child FH and name are packed
+ * back to back in data[] and the entry comes from the smallest size class
+ * that holds them (see chimera_rcu_pool_set). */
 struct chimera_vfs_name_cache_entry {
     struct chimera_rcu_node rnode; /* must be first: aliases the entry pointer */
     uint64_t                key;
+    int64_t                 score;
+    uint64_t                expiration; /* stopwatch ticks */
     uint8_t                 parent_fh_len;
     uint8_t                 child_fh_len;
     uint16_t                name_len;
-    int64_t                 score;
-    uint64_t                expiration; /* stopwatch ticks */
-    uint8_t                 parent_fh[CHIMERA_VFS_FH_SIZE];
-    uint8_t                 child_fh[CHIMERA_VFS_FH_SIZE];
-    char                    child_name[CHIMERA_VFS_NAME_MAX];
+    uint8_t                 data[];
 };
 
+static inline const uint8_t *
+chimera_vfs_name_cache_entry_parent_fh(const struct chimera_vfs_name_cache_entry *entry)
+{
+    return entry->data;
+} /* chimera_vfs_name_cache_entry_parent_fh */
+
+static inline const uint8_t *
+chimera_vfs_name_cache_entry_child_fh(const struct chimera_vfs_name_cache_entry *entry)
+{
+    return entry->data + entry->parent_fh_len;
+} /* chimera_vfs_name_cache_entry_child_fh */
+
+static inline const char *
+chimera_vfs_name_cache_entry_name(const struct chimera_vfs_name_cache_entry *entry)
+{
+    return (const char *) entry->data + entry->parent_fh_len + entry->child_fh_len;
+} /* chimera_vfs_name_cache_entry_name */
+
+/* Does entry cache (parent fh, name)? */
+static inline int
+chimera_vfs_name_cache_entry_match(
+    const struct chimera_vfs_name_cache_entry *entry,
+    const void                                *fh,
+    int                                        fh_len,
+    const char                                *name,
+    int                                        name_len)
+{
+    return chimera_memequal(chimera_vfs_name_cache_entry_parent_fh(entry),
+                            entry->parent_fh_len, fh, fh_len) &&
+           chimera_memequal(chimera_vfs_name_cache_entry_name(entry),
+                            entry->name_len, name, name_len);
+} /* chimera_vfs_name_cache_entry_match */
+
 struct chimera_vfs_name_cache_shard {
     struct chimera_vfs_name_cache_entry **entries;
+    uint8_t                              *tags; /* fingerprint per entry slot */
     pthread_mutex_t                       entry_lock;
     struct prometheus_counter_instance   *miss;
     struct prometheus_counter_instance   *hit;
@@ -40,7 +75,7 @@ struct chimera_vfs_name_cache {
     uint32_t                             num_shards_mask;
     uint32_t                             num_entries_mask;
     uint64_t                             ttl;
-    struct chimera_rcu_pool              pool;
+    struct chimera_rcu_pool_set          pools;
     struct chimera_vfs_name_cache_shard *shards;
     struct prometheus_metrics           *metrics;
     struct prometheus_counter           *name_cache;
@@ -68,8 +103,7 @@ chimera_vfs_name_cache_create(
     cache->num_entries_bits = entries_per_slot_bits;
     cache->ttl              = ttl;
 
-    chimera_rcu_pool_init(&cache->pool, CHIMERA_RCU_POOL_NAME,
-                          sizeof(struct chimera_vfs_name_cache_entry));
+    chimera_rcu_pool_set_init(&cache->pools, CHIMERA_RCU_POOL_NAME);
 
     cache->num_shards  = 1 << num_shards_bits;
     cache->num_slots   = 1 << num_slots_bits;
@@ -102,6 +136,7 @@ chimera_vfs_name_cache_create(
 
         shard          = &cache->shards[i];
         shard->entries = calloc(cache->num_slots * cache->num_entries, sizeof(struct chimera_vfs_name_cache_entry *));
+        shard->tags    = calloc(cache->num_slots * cache->num_entries + CHIMERA_RCU_TAG_PAD, 1);
 
         pthread_mutex_init(&shard->entry_lock, NULL);
 
@@ -143,11 +178,12 @@ chimera_vfs_name_cache_destroy(struct chimera_vfs_name_cache *cache)
         }
 
         free(shard->entries);
+        free(shard->tags);
 
         pthread_mutex_destroy(&shard->entry_lock);
     }
 
-    chimera_rcu_pool_destroy(&cache->pool);
+    chimera_rcu_pool_set_destroy(&cache->pools);
 
     if (cache->metrics) {
         prometheus_counter_destroy_series(cache->name_cache, cache->miss_series);
@@ -175,9 +211,11 @@ chimera_vfs_name_cache_lookup(
 {
     struct chimera_vfs_name_cache_entry  *entry;
     struct chimera_vfs_name_cache_shard  *shard;
-    struct chimera_vfs_name_cache_entry **slot, **slot_end;
+    struct chimera_vfs_name_cache_entry **slot;
     uint64_t                              key = fh_hash ^ name_hash;
-    int                                   rc;
+    uint64_t                              base;
+    uint32_t                              ways;
+    int                                   rc, way;
     uint64_t                              now = chimera_vfs_now_ticks();
 
     if (!cache) {
@@ -186,31 +224,34 @@ chimera_vfs_name_cache_lookup(
 
     shard = &cache->shards[key & cache->num_shards_mask];
 
-    slot = &shard->entries[((key >> cache->num_shards_bits) & cache->num_slots_mask) << cache->num_entries_bits];
+    base = ((key >> cache->num_shards_bits) & cache->num_slots_mask) << cache->num_entries_bits;
 
-    slot_end = slot + cache->num_entries;
+    slot = &shard->entries[base];
 
     rc = -1;
 
     urcu_qsbr_read_lock();
 
-    while (slot < slot_end) {
-        entry = rcu_dereference(*slot);
+    /* Only the ways whose fingerprint matches are dereferenced. */
+    ways = chimera_rcu_tag_match(&shard->tags[base], cache->num_entries, chimera_rcu_tag(key));
+
+    while (ways) {
+        way   = __builtin_ctz(ways);
+        ways &= ways - 1;
+
+        entry = rcu_dereference(slot[way]);
 
         if (entry && entry->key == key &&
             entry->expiration >= now &&
-            chimera_memequal(entry->parent_fh, entry->parent_fh_len, fh, fh_len) &&
-            chimera_memequal(entry->child_name, entry->name_len, name, name_len)) {
+            chimera_vfs_name_cache_entry_match(entry, fh, fh_len, name, name_len)) {
 
             *r_child_fh_len = entry->child_fh_len;
-            memcpy(r_child_fh, entry->child_fh, entry->child_fh_len);
+            memcpy(r_child_fh, chimera_vfs_name_cache_entry_child_fh(entry), entry->child_fh_len);
             entry->score++;
 
             rc = 0;
             break;
         }
-
-        slot++;
     }
 
     urcu_qsbr_read_unlock();
@@ -241,6 +282,7 @@ chimera_vfs_name_cache_insert(
     struct chimera_vfs_name_cache_shard  *shard;
     struct chimera_vfs_name_cache_entry **slot, **slot_end, **slot_best;
     uint64_t                              key = fh_hash ^ name_hash;
+    uint64_t                              base;
     uint64_t                              now = chimera_vfs_now_ticks();
 
     if (!cache) {
@@ -249,14 +291,17 @@ chimera_vfs_name_cache_insert(
 
     shard = &cache->shards[key & cache->num_shards_mask];
 
-    slot = &shard->entries[((key >> cache->num_shards_bits) & cache->num_slots_mask) << cache->num_entries_bits];
+    base = ((key >> cache->num_shards_bits) & cache->num_slots_mask) << cache->num_entries_bits;
+
+    slot = &shard->entries[base];
 
     slot_end = slot + cache->num_entries;
 
     slot_best = slot;
 
     entry = (struct chimera_vfs_name_cache_entry *)
-        chimera_rcu_pool_alloc(&thread->rcu_magazines[CHIMERA_RCU_POOL_NAME], &cache->pool);
+        chimera_rcu_pool_set_alloc(thread->rcu_magazines, &cache->pools,
+                                   sizeof(*entry) + fh_len + child_fh_len + name_len);
 
     entry->key           = key;
     entry->parent_fh_len = fh_len;
@@ -266,14 +311,14 @@ chimera_vfs_name_cache_insert(
 
     entry->expiration = now + chimera_vfs_ns_to_ticks((uint64_t) cache->ttl * 1000000000ULL);
 
-    memcpy(entry->parent_fh, fh, fh_len);
+    memcpy(entry->data, fh, fh_len);
 
     if (child_fh_len) {
-        memcpy(entry->child_fh, child_fh, child_fh_len);
+        memcpy(entry->data + fh_len, child_fh, child_fh_len);
     }
 
     if (name_len) {
-        memcpy(entry->child_name, name, name_len);
+        memcpy(entry->data + fh_len + child_fh_len, name, name_len);
     }
 
     urcu_qsbr_read_lock();
@@ -286,8 +331,7 @@ chimera_vfs_name_cache_insert(
         old_entry = *slot;
 
         if (old_entry && old_entry->key == key &&
-            chimera_memequal(old_entry->parent_fh, old_entry->parent_fh_len, fh, fh_len) &&
-            chimera_memequal(old_entry->child_name, old_entry->name_len, name, name_len)) {
+            chimera_vfs_name_cache_entry_match(old_entry, fh, fh_len, name, name_len)) {
 
             /* IF same FH/name is in cache, we must replace it */
 
@@ -331,6 +375,8 @@ chimera_vfs_name_cache_insert(
 
     rcu_assign_pointer(*slot_best, entry);
 
+    shard->tags[slot_best - shard->entries] = chimera_rcu_tag(key);
+
     prometheus_counter_increment(shard->insert);
 
     pthread_mutex_unlock(&shard->entry_lock);
@@ -377,11 +423,11 @@ chimera_vfs_name_cache_remove(
         entry = *slot;
 
         if (entry && entry->key == key &&
-            chimera_memequal(entry->parent_fh, entry->parent_fh_len, fh, fh_len) &&
-            chimera_memequal(entry->child_name, entry->name_len, name, name_len)) {
+            chimera_vfs_name_cache_entry_match(entry, fh, fh_len, name, name_len)) {
 
             removed_entry = entry;
             rcu_assign_pointer(*slot, NULL);
+            shard->tags[slot - shard->entries] = 0;
             break;
         }
 
@@ -13,9 +13,20 @@
 #include "vfs_internal.h"
 #include "prometheus-c.h"
 
+/* Initial size of a shard's inner hash table (see vfs_open_cache_shard) */
+#define CHIMERA_VFS_OPEN_CACHE_INITIAL_SLOTS 8
+
 struct vfs_open_cache_shard {
     pthread_mutex_t                     lock;
-    struct chimera_vfs_open_handle     *handles;
+    /* Inner hash table indexed by the high bits of fh_hash (the low bits
+     * select the shard).  Allocated lazily on first insert and doubled under
+     * the shard lock when count reaches nslots, so a lookup is 0-1 probes
+     * even when a shard runs past max_open_files.  Entries chain through
+     * handle->bucket_next/bucket_prev; every credential's handle for a given
+     * file lands on the same chain. */
+    uint32_t                            nslots;
+    uint32_t                            count;
+    struct chimera_vfs_open_handle    **slots;
     struct chimera_vfs_open_handle     *pending_close;
     struct chimera_vfs_open_handle     *free_handles;
     uint8_t                             cache_id;
@@ -89,19 +100,76 @@ chimera_vfs_close_ref_dispatch(
                       ref->vfs_private, ref->fh_hash, callback, private_data);
 } /* chimera_vfs_close_ref_dispatch */
 
-/* --- Shard linked-list helpers --- */
+/* --- Shard hash table helpers --- */
+
+/* Caller MUST hold shard->lock and the shard must have a slot array. */
+static inline struct chimera_vfs_open_handle **
+chimera_vfs_open_cache_slot_for(
+    struct vfs_open_cache_shard *shard,
+    uint64_t                     fh_hash)
+{
+    return &shard->slots[(fh_hash >> 32) & (shard->nslots - 1)];
+} /* chimera_vfs_open_cache_slot_for */
+
+/* Double the shard's inner table (or create it at the initial size).  Caller
+ * MUST hold shard->lock.  Allocation failure is tolerated: the shard keeps its
+ * old table and chains simply run longer. */
+static inline void
+chimera_vfs_open_cache_shard_grow(struct vfs_open_cache_shard *shard)
+{
+    struct chimera_vfs_open_handle **old_slots = shard->slots;
+    struct chimera_vfs_open_handle  *handle, *next, **slot;
+    uint32_t                         old_nslots = shard->nslots;
+    uint32_t                         nnew, s;
+
+    nnew = old_nslots ? old_nslots * 2 : CHIMERA_VFS_OPEN_CACHE_INITIAL_SLOTS;
+
+    shard->slots = calloc(nnew, sizeof(*shard->slots));
+
+    if (!shard->slots) {
+        shard->slots = old_slots;
+        return;
+    }
+
+    shard->nslots = nnew;
+
+    for (s = 0; s < old_nslots; s++) {
+        for (handle = old_slots[s]; handle; handle = next) {
+            next                = handle->bucket_next;
+            slot                = chimera_vfs_open_cache_slot_for(shard, handle->fh_hash);
+            handle->bucket_prev = NULL;
+            handle->bucket_next = *slot;
+            if (*slot) {
+                (*slot)->bucket_prev = handle;
+            }
+            *slot = handle;
+        }
+    }
+
+    free(old_slots);
+} /* chimera_vfs_open_cache_shard_grow */
 
 static inline void
 chimera_vfs_open_cache_shard_insert(
     struct vfs_open_cache_shard    *shard,
     struct chimera_vfs_open_handle *handle)
 {
+    struct chimera_vfs_open_handle **slot;
+
+    if (shard->count + 1 > shard->nslots) {
+        chimera_vfs_open_cache_shard_grow(shard);
+        chimera_vfs_abort_if(!shard->nslots, "open cache failed to allocate slots");
+    }
+
+    slot = chimera_vfs_open_cache_slot_for(shard, handle->fh_hash);
+
     handle->bucket_prev = NULL;
-    handle->bucket_next = shard->handles;
-    if (shard->handles) {
-        shard->handles->bucket_prev = handle;
+    handle->bucket_next = *slot;
+    if (*slot) {
+        (*slot)->bucket_prev = handle;
     }
-    shard->handles = handle;
+    *slot = handle;
+    shard->count++;
 } // chimera_vfs_open_cache_shard_insert
 
 static inline void
@@ -112,15 +180,25 @@ chimera_vfs_open_cache_shard_remove(
     if (handle->bucket_prev) {
         handle->bucket_prev->bucket_next = handle->bucket_next;
     } else {
-        shard->handles = handle->bucket_next;
+        *chimera_vfs_open_cache_slot_for(shard, handle->fh_hash) = handle->bucket_next;
     }
     if (handle->bucket_next) {
         handle->bucket_next->bucket_prev = handle->bucket_prev;
     }
     handle->bucket_next = NULL;
     handle->bucket_prev = NULL;
+    shard->count--;
 } // chimera_vfs_open_cache_shard_remove
 
+/* First cached handle on fh's chain, or NULL.  Caller MUST hold shard->lock. */
+static inline struct chimera_vfs_open_handle *
+chimera_vfs_open_cache_shard_chain(
+    struct vfs_open_cache_shard *shard,
+    uint64_t                     fh_hash)
+{
+    return shard->nslots ? *chimera_vfs_open_cache_slot_for(shard, fh_hash) : NULL;
+} /* chimera_vfs_open_cache_shard_chain */
+
 /*
  * Find a handle in the shard matching fh, access_mode, and credential identity.
  *
@@ -129,19 +207,23 @@ chimera_vfs_open_cache_shard_remove(
  * within a single identity.  For RW requests, only an exact RW match is
  * returned.  For RO requests, any matching handle (RW or RO) is returned, since
  * a RW handle can satisfy reads.
+ *
+ * Only fh's own chain is walked, and the full hashes are compared before the
+ * file handle itself, so a miss rarely touches more than a pointer or two.
  */
 static inline struct chimera_vfs_open_handle *
 chimera_vfs_open_cache_shard_find(
     struct vfs_open_cache_shard *shard,
     const void                  *fh,
     uint32_t                     fhlen,
+    uint64_t                     fh_hash,
     uint8_t                      access_mode,
     uint64_t                     cred_hash)
 {
     struct chimera_vfs_open_handle *h;
 
-    for (h = shard->handles; h; h = h->bucket_next) {
-        if (h->fh_len == fhlen && h->cred_hash == cred_hash &&
+    for (h = chimera_vfs_open_cache_shard_chain(shard, fh_hash); h; h = h->bucket_next) {
+        if (h->fh_hash == fh_hash && h->cred_hash == cred_hash && h->fh_len == fhlen &&
             memcmp(h->fh, fh, fhlen) == 0) {
             if (h->access_mode == CHIMERA_VFS_ACCESS_MODE_RW ||
                 access_mode == CHIMERA_VFS_ACCESS_MODE_RO) {
@@ -204,7 +286,9 @@ chimera_vfs_open_cache_init(
 
     for (unsigned int i = 0; i < cache->num_shards; i++) {
         pthread_mutex_init(&cache->shards[i].lock, NULL);
-        cache->shards[i].handles        = NULL;
+        cache->shards[i].slots          = NULL;
+        cache->shards[i].nslots         = 0;
+        cache->shards[i].count          = 0;
         cache->shards[i].free_handles   = NULL;
         cache->shards[i].pending_close  = NULL;
         cache->shards[i].max_open_files = max_per_shard;
@@ -236,6 +320,7 @@ chimera_vfs_open_cache_destroy(struct vfs_open_cache *cache)
             handle = tmp;
         }
 
+        free(shard->slots);
         pthread_mutex_destroy(&shard->lock);
     }
 
@@ -442,13 +527,16 @@ chimera_vfs_open_cache_evict(
 
     for (s = 0; s <= cache->shard_mask; s++) {
         struct vfs_open_cache_shard    *shard = &cache->shards[s];
-        struct chimera_vfs_open_handle *handle;
+        struct chimera_vfs_open_handle *handle = NULL;
+        uint32_t                        slot;
 
         pthread_mutex_lock(&shard->lock);
 
-        for (handle = shard->handles; handle; handle = handle->bucket_next) {
-            if (handle->fh_len == fhlen && memcmp(handle->fh, fh, fhlen) == 0) {
-                break;
+        for (slot = 0; slot < shard->nslots && !handle; slot++) {
+            for (handle = shard->slots[slot]; handle; handle = handle->bucket_next) {
+                if (handle->fh_len == fhlen && memcmp(handle->fh, fh, fhlen) == 0) {
+                    break;
+                }
             }
         }
 
@@ -561,7 +649,7 @@ chimera_vfs_open_cache_acquire(
 
     pthread_mutex_lock(&shard->lock);
 
-    handle = chimera_vfs_open_cache_shard_find(shard, fh, fhlen, access_mode, cred_hash);
+    handle = chimera_vfs_open_cache_shard_find(shard, fh, fhlen, fh_hash, access_mode, cred_hash);
 
     if (handle) {
 
@@ -593,6 +681,9 @@ chimera_vfs_open_cache_acquire(
         handle->fh_len              = fhlen;
         handle->cred_hash           = cred_hash;
         handle->granted_valid       = 0;
+        handle->ra_next             = 0;
+        handle->ra_issued           = 0;
+        handle->ra_window           = 0;
         handle->opencnt             = 1;
         handle->access_mode         = access_mode;
         handle->flags               = exclusive ? CHIMERA_VFS_OPEN_HANDLE_EXCLUSIVE : 0;
@@ -695,6 +786,9 @@ chimera_vfs_open_cache_insert(
     handle->fh_len              = fhlen;
     handle->cred_hash           = cred_hash;
     handle->granted_valid       = 0;
+    handle->ra_next             = 0;
+    handle->ra_issued           = 0;
+    handle->ra_window           = 0;
     handle->opencnt             = 1;
     handle->access_mode         = access_mode;
     handle->flags               = 0;
@@ -712,7 +806,7 @@ chimera_vfs_open_cache_insert(
     memcpy(handle->fh, fh, fhlen);
 
     /* Check for existing entry with same (fh, access_mode, cred) */
-    existing = chimera_vfs_open_cache_shard_find(shard, fh, fhlen, access_mode, cred_hash);
+    existing = chimera_vfs_open_cache_shard_find(shard, fh, fhlen, fh_hash, access_mode, cred_hash);
 
     if (existing) {
         if (existing->opencnt == 0) {
@@ -847,34 +941,32 @@ chimera_vfs_open_cache_purge_by_mount(
     struct vfs_open_cache_shard    *shard;
     struct chimera_vfs_open_handle *handle, *next;
     uint64_t                        referenced = 0;
+    uint32_t                        slot;
 
     for (unsigned int i = 0; i < cache->num_shards; i++) {
         shard = &cache->shards[i];
 
         pthread_mutex_lock(&shard->lock);
 
-        handle = shard->handles;
-
-        while (handle) {
-            next = handle->bucket_next;
-
-            if (memcmp(handle->fh, mount_id, CHIMERA_VFS_MOUNT_ID_SIZE) != 0) {
-                handle = next;
-                continue;
+        for (slot = 0; slot < shard->nslots; slot++) {
+            for (handle = shard->slots[slot]; handle; handle = next) {
+                next = handle->bucket_next;
+
+                if (memcmp(handle->fh, mount_id, CHIMERA_VFS_MOUNT_ID_SIZE) != 0) {
+                    continue;
+                }
+
+                if (handle->opencnt) {
+                    referenced++;
+                } else {
+                    /* Unreferenced handles sit on pending_close awaiting the
+                     * idle sweep; umount cannot wait out that timer. */
+                    DL_DELETE(shard->pending_close, handle);
+                    chimera_vfs_open_cache_shard_remove(shard, handle);
+                    shard->open_handles--;
+                    LL_PREPEND(*r_purged, handle);
+                }
             }
-
-            if (handle->opencnt) {
-                referenced++;
-            } else {
-                /* Unreferenced handles sit on pending_close awaiting the idle
-                 * sweep; umount cannot wait out that timer. */
-                DL_DELETE(shard->pending_close, handle);
-                chimera_vfs_open_cache_shard_remove(shard, handle);
-                shard->open_handles--;
-                LL_PREPEND(*r_purged, handle);
-            }
-
-            handle = next;
         }
 
         pthread_mutex_unlock(&shard->lock);
@@ -897,17 +989,20 @@ chimera_vfs_open_cache_mark_for_close_by_mount(
     struct vfs_open_cache_shard    *shard;
     struct chimera_vfs_open_handle *handle;
     uint64_t                        count = 0;
+    uint32_t                        slot;
 
     for (unsigned int i = 0; i < cache->num_shards; i++) {
         shard = &cache->shards[i];
 
         pthread_mutex_lock(&shard->lock);
 
-        for (handle = shard->handles; handle; handle = handle->bucket_next) {
-            if (memcmp(handle->fh, mount_id, CHIMERA_VFS_MOUNT_ID_SIZE) == 0) {
-                /* Set timestamp to 0 so it will be closed immediately */
-                handle->timestamp = 0;
-                count++;
+        for (slot = 0; slot < shard->nslots; slot++) {
+            for (handle = shard->slots[slot]; handle; handle = handle->bucket_next) {
+                if (memcmp(handle->fh, mount_id, CHIMERA_VFS_MOUNT_ID_SIZE) == 0) {
+                    /* Set timestamp to 0 so it will be closed immediately */
+                    handle->timestamp = 0;
+                    count++;
+                }
             }
         }
 
@@ -941,8 +1036,9 @@ chimera_vfs_open_cache_lookup_ref(
     pthread_mutex_lock(&shard->lock);
 
     /* Scan for any handle matching fh with opencnt > 0, regardless of access_mode */
-    for (handle = shard->handles; handle; handle = handle->bucket_next) {
-        if (handle->fh_len == fh_len &&
+    for (handle = chimera_vfs_open_cache_shard_chain(shard, fh_hash); handle;
+         handle = handle->bucket_next) {
+        if (handle->fh_hash == fh_hash && handle->fh_len == fh_len &&
             memcmp(handle->fh, fh, fh_len) == 0 &&
             handle->opencnt > 0 &&
             !(handle->flags & CHIMERA_VFS_OPEN_HANDLE_PENDING)) {
@@ -978,8 +1074,9 @@ chimera_vfs_open_cache_exists(
     pthread_mutex_lock(&shard->lock);
 
     /* Scan for any handle matching fh, regardless of access_mode */
-    for (handle = shard->handles; handle; handle = handle->bucket_next) {
-        if (handle->fh_len == fh_len &&
+    for (handle = chimera_vfs_open_cache_shard_chain(shard, fh_hash); handle;
+         handle = handle->bucket_next) {
+        if (handle->fh_hash == fh_hash && handle->fh_len == fh_len &&
             memcmp(handle->fh, fh, fh_len) == 0) {
             found = 1;
             break;
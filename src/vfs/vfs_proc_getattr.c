@@ -48,8 +48,11 @@ chimera_vfs_getattr(
     struct chimera_vfs_attrs       cached_attr;
     int                            rc;
 
+    /* A file with write-behind data must be dispatched (and so flushed) for
+     * its attributes to reflect those writes. */
     if (!(handle->flags & CHIMERA_VFS_OPEN_HANDLE_STREAM) &&
-        !(req_attr_mask & ~(CHIMERA_VFS_ATTR_FH | CHIMERA_VFS_ATTR_MASK_CACHEABLE))) {
+        !(req_attr_mask & ~(CHIMERA_VFS_ATTR_FH | CHIMERA_VFS_ATTR_MASK_CACHEABLE)) &&
+        !chimera_vfs_write_behind_pending(thread->vfs->vfs_write_behind, handle->fh_hash)) {
         rc = chimera_vfs_attr_cache_lookup(attr_cache,
                                            handle->fh_hash,
                                            handle->fh,
@@ -153,6 +153,7 @@ chimera_vfs_lookup_at_dispatch(
     request->lookup_at.component              = name;
     request->lookup_at.component_len          = namelen;
     request->lookup_at.component_hash         = name_hash;
+    request->lookup_at.r_namelen              = 0;
     request->lookup_at.r_attr.va_req_mask     = attr_mask | CHIMERA_VFS_ATTR_FH | CHIMERA_VFS_ATTR_MASK_CACHEABLE;
     request->lookup_at.r_attr.va_set_mask     = 0;
     request->lookup_at.r_dir_attr.va_req_mask = dir_attr_mask | CHIMERA_VFS_ATTR_MASK_CACHEABLE;
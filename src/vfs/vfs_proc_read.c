@@ -3,11 +3,14 @@
 // SPDX-License-Identifier: LGPL-2.1-only
 
 #include <stdlib.h>
+#include <sys/stat.h>
 #include "vfs/vfs_procs.h"
 #include "vfs/vfs_state.h"
 #include "vfs_internal.h"
 #include "vfs_open_cache.h"
 #include "vfs_attr_cache.h"
+#include "vfs_data_cache.h"
+#include "vfs_release.h"
 #include "vfs_access.h"
 #include "vfs_acl.h"
 #include "common/macros.h"
@@ -103,6 +106,38 @@ chimera_vfs_read_iovec_copy(
     }
 } /* chimera_vfs_read_iovec_copy */
 
+/* Populate the data cache from a completed read, provided the file did not
+ * change while the read was in flight: the post-read attrs must carry the
+ * stamp captured at dispatch, and no mutating op may have advanced the file's
+ * generation in between (see vfs_data_cache.h). */
+static void
+chimera_vfs_read_fill_cache(
+    struct chimera_vfs_request *request,
+    struct evpl_iovec          *iov,
+    int                         niov)
+{
+    struct chimera_vfs_data_cache  *cache  = request->thread->vfs->vfs_data_cache;
+    struct chimera_vfs_open_handle *handle = request->read.handle;
+
+    /* A caching lease granted while the read was in flight owns the file's
+     * data now; leave the cache to be refilled once it is gone. */
+    if (!chimera_vfs_handle_lease_free(request->thread->vfs, handle)) {
+        return;
+    }
+
+    if ((request->read.r_attr.va_set_mask & CHIMERA_VFS_ATTR_MASK_STAT) != CHIMERA_VFS_ATTR_MASK_STAT ||
+        chimera_vfs_data_cache_stamp(&request->read.r_attr) != request->read.dc_stamp ||
+        chimera_vfs_data_cache_gen(cache, handle->fh_hash) != request->read.dc_gen) {
+        return;
+    }
+
+    chimera_vfs_data_cache_insert(request->thread, cache,
+                                  handle->fh_hash, handle->fh, handle->fh_len,
+                                  request->read.dc_stamp, request->read.dc_gen,
+                                  request->read.offset, request->read.r_length,
+                                  request->read.r_eof, iov, niov);
+} /* chimera_vfs_read_fill_cache */
+
 static void
 chimera_vfs_read_complete(struct chimera_vfs_request *request)
 {
@@ -127,6 +162,16 @@ chimera_vfs_read_complete(struct chimera_vfs_request *request)
         }
     }
 
+    if (request->read.dc_valid &&
+        request->status == CHIMERA_VFS_OK &&
+        request->read.r_length) {
+        if (request->read.landed_in_dest) {
+            chimera_vfs_read_fill_cache(request, request->read.dest_iov, request->read.dest_niov);
+        } else {
+            chimera_vfs_read_fill_cache(request, request->read.iov, request->read.r_niov);
+        }
+    }
+
     /* read_into: the caller wants the data in its own destination buffers.
      * Unless a backend already landed it there (landed_in_dest), copy the
      * result out of the scratch/backend buffers into dest and release those
@@ -177,7 +222,7 @@ chimera_vfs_read_complete(struct chimera_vfs_request *request)
 } /* chimera_vfs_read_complete */
 
 static void
-chimera_vfs_read_dispatch(
+chimera_vfs_read_issue(
     struct chimera_vfs_thread            *thread,
     const struct chimera_vfs_cred        *cred,
     struct chimera_vfs_open_handle       *handle,
@@ -189,6 +234,9 @@ chimera_vfs_read_dispatch(
     int                                   dest_niov,
     uint64_t                              attr_mask,
     const struct chimera_vfs_lease_owner *io_owner,
+    int                                   dc_valid,
+    uint64_t                              dc_stamp,
+    uint64_t                              dc_gen,
     chimera_vfs_read_callback_t           callback,
     void                                 *private_data)
 {
@@ -221,9 +269,18 @@ chimera_vfs_read_dispatch(
     request->read.dest_niov          = dest_niov;
     request->read.dest_provided      = (dest_iov != NULL);
     request->read.landed_in_dest     = 0;
+    request->read.dc_valid           = dc_valid;
+    request->read.dc_stamp           = dc_stamp;
+    request->read.dc_gen             = dc_gen;
     request->proto_callback          = callback;
     request->proto_private_data      = private_data;
 
+    /* A data cache fill needs post-read attrs to confirm the file is still
+     * the version whose stamp was captured at dispatch. */
+    if (dc_valid) {
+        request->read.r_attr.va_req_mask |= CHIMERA_VFS_ATTR_MASK_CACHEABLE;
+    }
+
     /* Buffer ownership.  Backends that advertise CAP_READ_PROVIDES_BUFFERS
      * supply their own read memory (memfs returns refs to its SHARED in-memory
      * blocks; the nfs proxy returns its upstream reply buffers).  For everyone
@@ -253,6 +310,270 @@ chimera_vfs_read_dispatch(
      * lease for a leaseless actor, recalling another holder's conflicting
      * write cache), then dispatch. */
     chimera_vfs_io_lease_acquire(request, io_owner, chimera_vfs_dispatch);
+} /* chimera_vfs_read_issue */
+
+/* Whether reads through this handle may use the data cache at all.  Modules
+ * whose data is already memory resident are skipped (the cache would only
+ * duplicate it), as are named streams, which have no attr cache entry to
+ * validate against, and files with write-behind data not yet flushed.  So is
+ * any file under a caching lease: a cache hit or a read-ahead would act on it
+ * outside chimera_vfs_io_lease_acquire, and the holder may have data the
+ * backend has not seen. */
+static inline int
+chimera_vfs_read_cacheable(
+    struct chimera_vfs_thread      *thread,
+    struct chimera_vfs_open_handle *handle)
+{
+    return thread->vfs->vfs_data_cache &&
+           !(handle->vfs_module->capabilities & CHIMERA_VFS_CAP_DATA_IN_MEMORY) &&
+           !(handle->flags & CHIMERA_VFS_OPEN_HANDLE_STREAM) &&
+           !chimera_vfs_write_behind_pending(thread->vfs->vfs_write_behind, handle->fh_hash) &&
+           chimera_vfs_handle_lease_free(thread->vfs, handle);
+} /* chimera_vfs_read_cacheable */
+
+/* Try to serve a read entirely from the data cache.  attr is the file's live
+ * attr cache entry and stamp/gen its current version.  Returns 1 if the
+ * callback has been invoked, 0 if the read must go to the backend. */
+static int
+chimera_vfs_read_cache_serve(
+    struct chimera_vfs_thread      *thread,
+    struct chimera_vfs_open_handle *handle,
+    uint64_t                        offset,
+    uint32_t                        count,
+    struct evpl_iovec              *iov,
+    int                             niov,
+    struct evpl_iovec              *dest_iov,
+    int                             dest_niov,
+    struct chimera_vfs_attrs       *attr,
+    uint64_t                        stamp,
+    uint64_t                        gen,
+    chimera_vfs_read_callback_t     callback,
+    void                           *private_data)
+{
+    struct chimera_vfs_data_cache       *cache = thread->vfs->vfs_data_cache;
+    struct chimera_vfs_data_cache_entry *entries[CHIMERA_VFS_DATA_CACHE_MAX_PAGES];
+    struct evpl_iovec                   *r_iov;
+    uint32_t                             r_length;
+    int                                  r_niov, r_eof;
+
+    if (offset >= attr->va_size) {
+        r_length = 0;
+        r_eof    = 1;
+    } else if (count >= attr->va_size - offset) {
+        r_length = attr->va_size - offset;
+        r_eof    = 1;
+    } else {
+        r_length = count;
+        r_eof    = 0;
+    }
+
+    r_iov  = dest_iov ? dest_iov : iov;
+    r_niov = dest_iov ? dest_niov : 0;
+
+    if (r_length) {
+
+        urcu_qsbr_read_lock();
+
+        if (chimera_vfs_data_cache_gather(cache, handle->fh_hash, handle->fh, handle->fh_len,
+                                          stamp, gen, offset, r_length, entries) != 0) {
+            urcu_qsbr_read_unlock();
+            return 0;
+        }
+
+        if (!dest_iov) {
+            r_niov = evpl_iovec_alloc(thread->evpl, r_length, 4096, niov, 0, iov);
+            chimera_vfs_abort_if(r_niov <= 0,
+                                 "vfs read: failed to allocate %u read-buffer bytes",
+                                 r_length);
+        }
+
+        chimera_vfs_data_cache_copyout(entries, offset, r_length, r_iov, r_niov);
+
+        urcu_qsbr_read_unlock();
+    }
+
+    callback(CHIMERA_VFS_OK, r_length, r_eof, r_iov, r_niov, attr, private_data);
+
+    return 1;
+} /* chimera_vfs_read_cache_serve */
+
+static void
+chimera_vfs_readahead_complete(
+    enum chimera_vfs_error    error_code,
+    uint32_t                  count,
+    uint32_t                  eof,
+    struct evpl_iovec        *iov,
+    int                       niov,
+    struct chimera_vfs_attrs *attr,
+    void                     *private_data)
+{
+    struct chimera_vfs_readahead *ra     = private_data;
+    struct chimera_vfs_thread    *thread = ra->thread;
+
+    /* The data (if any) has already been copied into the cache by
+     * chimera_vfs_read_complete; nobody consumes the buffers. */
+    if (niov) {
+        evpl_iovecs_release(thread->evpl, iov, niov);
+    }
+
+    chimera_vfs_release(thread, ra->handle);
+
+    LL_PREPEND(thread->free_readaheads, ra);
+} /* chimera_vfs_readahead_complete */
+
+/* Track sequential access on the handle and, once a stream is established,
+ * keep a growing window of data ahead of it flowing into the data cache.  The
+ * read-ahead is issued under the requesting op's io_owner, so it is mediated
+ * exactly as that op's own read is.
+ *
+ * A cached handle is shared by every thread with the file open, so the ra_*
+ * fields are atomics.  Racing readers at worst mistake each other for a seek;
+ * the CAS on ra_issued makes sure a stretch is only read ahead once. */
+static void
+chimera_vfs_read_ahead(
+    struct chimera_vfs_thread            *thread,
+    const struct chimera_vfs_cred        *cred,
+    struct chimera_vfs_open_handle       *handle,
+    uint64_t                              offset,
+    uint32_t                              count,
+    uint64_t                              size,
+    uint64_t                              stamp,
+    uint64_t                              gen,
+    const struct chimera_vfs_lease_owner *io_owner)
+{
+    struct chimera_vfs_readahead *ra;
+    uint64_t                      next, issued, claimed, target, start, len;
+    uint32_t                      window;
+
+    /* Read-ahead pins the handle across its async reads, which only cached
+     * file handles support. */
+    if (handle->cache_id != CHIMERA_VFS_OPEN_ID_FILE) {
+        return;
+    }
+
+    next = offset + count;
+
+    if (offset != __atomic_exchange_n(&handle->ra_next, next, __ATOMIC_RELAXED)) {
+        /* Not sequential: collapse the window until it is again. */
+        __atomic_store_n(&handle->ra_issued, next, __ATOMIC_RELAXED);
+        __atomic_store_n(&handle->ra_window, 0, __ATOMIC_RELAXED);
+        return;
+    }
+
+    window = __atomic_load_n(&handle->ra_window, __ATOMIC_RELAXED);
+    window = window ? window << 1 : CHIMERA_VFS_READAHEAD_MIN_WINDOW;
+
+    if (window > CHIMERA_VFS_READAHEAD_MAX_WINDOW) {
+        window = CHIMERA_VFS_READAHEAD_MAX_WINDOW;
+    }
+
+    __atomic_store_n(&handle->ra_window, window, __ATOMIC_RELAXED);
+
+    claimed = __atomic_load_n(&handle->ra_issued, __ATOMIC_RELAXED);
+    issued  = claimed < next ? next : claimed;
+
+    target = next + window;
+
+    if (target > size) {
+        target = size;
+    }
+
+    /* Top up only once half the window has drained (or to finish the file),
+     * so read-ahead goes out in large reads rather than one per client read. */
+    if (issued >= target ||
+        (target < size && target - issued < window / 2)) {
+        return;
+    }
+
+    if (!__atomic_compare_exchange_n(&handle->ra_issued, &claimed, target, false,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* Another reader of the handle claimed this stretch. */
+        return;
+    }
+
+    start = issued & ~CHIMERA_VFS_DATA_CACHE_PAGE_MASK;
+
+    while (start < target) {
+
+        len = target - start;
+
+        if (len > CHIMERA_VFS_READAHEAD_CHUNK) {
+            len = CHIMERA_VFS_READAHEAD_CHUNK;
+        }
+
+        ra = thread->free_readaheads;
+
+        if (ra) {
+            LL_DELETE(thread->free_readaheads, ra);
+        } else {
+            ra = calloc(1, sizeof(*ra));
+        }
+
+        ra->thread = thread;
+        ra->handle = handle;
+        ra->cred   = *cred;
+
+        chimera_vfs_dup_handle(thread, handle);
+
+        chimera_vfs_data_cache_count_readahead(thread->vfs->vfs_data_cache, handle->fh_hash);
+
+        chimera_vfs_read_issue(thread, &ra->cred, handle, start, len,
+                               ra->iov, CHIMERA_VFS_READAHEAD_NIOV, NULL, 0, 0, io_owner,
+                               1, stamp, gen,
+                               chimera_vfs_readahead_complete, ra);
+
+        start += len;
+    }
+} /* chimera_vfs_read_ahead */
+
+static void
+chimera_vfs_read_dispatch(
+    struct chimera_vfs_thread            *thread,
+    const struct chimera_vfs_cred        *cred,
+    struct chimera_vfs_open_handle       *handle,
+    uint64_t                              offset,
+    uint32_t                              count,
+    struct evpl_iovec                    *iov,
+    int                                   niov,
+    struct evpl_iovec                    *dest_iov,
+    int                                   dest_niov,
+    uint64_t                              attr_mask,
+    const struct chimera_vfs_lease_owner *io_owner,
+    chimera_vfs_read_callback_t           callback,
+    void                                 *private_data)
+{
+    struct chimera_vfs_attrs attr;
+    uint64_t                 stamp = 0, gen = 0;
+    int                      dc_valid = 0;
+
+    /* The generation is sampled before the stamp so that a mutation racing
+     * this read is caught by one or the other. */
+    if (count > 0 && chimera_vfs_read_cacheable(thread, handle)) {
+
+        gen = chimera_vfs_data_cache_gen(thread->vfs->vfs_data_cache, handle->fh_hash);
+
+        if (chimera_vfs_data_cache_validate(thread->vfs->vfs_attr_cache,
+                                            handle->fh_hash, handle->fh, handle->fh_len,
+                                            &attr, &stamp) == 0 &&
+            S_ISREG(attr.va_mode)) {
+
+            dc_valid = 1;
+
+            chimera_vfs_read_ahead(thread, cred, handle, offset, count,
+                                   attr.va_size, stamp, gen, io_owner);
+
+            if (chimera_vfs_read_cache_serve(thread, handle, offset, count,
+                                             iov, niov, dest_iov, dest_niov,
+                                             &attr, stamp, gen,
+                                             callback, private_data)) {
+                return;
+            }
+        }
+    }
+
+    chimera_vfs_read_issue(thread, cred, handle, offset, count, iov, niov,
+                           dest_iov, dest_niov, attr_mask, io_owner,
+                           dc_valid, stamp, gen, callback, private_data);
 } /* chimera_vfs_read_dispatch */
 
 /* Continuation for the first gated read on a handle: a getattr+ACL computes the
@@ -16,6 +16,10 @@
  * caller's per-entry callback.  Only SMB QUERY_DIRECTORY passes a pattern;
  * every other caller passes NULL and gets the unfiltered scan.
  *
+ * The pattern is compiled once per readdir and each name is run through it as
+ * a non-backtracking NFA (chimera_vfs_match_run), so a many-star pattern costs
+ * linear time per entry rather than exponential.
+ *
  * Five metacharacters, case-insensitive (ASCII), modeled on Samba's
  * ms_fnmatch_core: '*' (zero+ of any char), '?' (exactly one), and the DOS
  * variants '<' (DOS_STAR -- zero+ but stops at the last '.'), '>' (DOS_QM --
@@ -28,96 +32,236 @@ static void
 chimera_vfs_readdir_complete(
     struct chimera_vfs_request *request);
 
-/* The remaining expression matches end-of-name iff every metacharacter left can
- * match zero characters (MS-FSA null_match). */
-static int
-chimera_vfs_match_null(const char *p)
+static void
+chimera_vfs_readdir_start(
+    struct chimera_vfs_request *request);
+
+static inline int
+chimera_vfs_match_is_meta(uint8_t c)
+{
+    return c == '*' || c == '?' || c == '<' || c == '>' || c == '"';
+} /* chimera_vfs_match_is_meta */
+
+/* Compile pattern (truncated to CHIMERA_VFS_NAME_MAX - 1 bytes, as names are)
+ * into m. */
+static void
+chimera_vfs_match_compile(
+    struct chimera_vfs_match *m,
+    const char               *pattern,
+    int                       patternlen)
+{
+    int i, null = 1;
+
+    if (patternlen >= CHIMERA_VFS_NAME_MAX) {
+        patternlen = CHIMERA_VFS_NAME_MAX - 1;
+    }
+
+    m->len        = patternlen;
+    m->prefix_len = 0;
+    m->suffix_len = 0;
+
+    for (i = 0; i < patternlen; i++) {
+        m->op[i] = toupper((unsigned char) pattern[i]);
+    }
+
+    /* null_rest[i]: every metacharacter after op[i] can match zero characters
+     * (MS-FSA null_match). */
+    for (i = patternlen - 1; i >= 0; i--) {
+        m->null_rest[i] = null;
+        null           &= m->op[i] == '?' || m->op[i] == '"' || m->op[i] == '>';
+    }
+
+    while (m->prefix_len < patternlen && !chimera_vfs_match_is_meta(m->op[m->prefix_len])) {
+        m->prefix_len++;
+    }
+    m->literal = m->prefix_len == patternlen;
+    if (!m->literal) {
+        while (!chimera_vfs_match_is_meta(m->op[patternlen - 1 - m->suffix_len])) {
+            m->suffix_len++;
+        }
+    }
+} /* chimera_vfs_match_compile */
+
+static inline int
+chimera_vfs_match_literal_eq(
+    const uint8_t *op,
+    const char    *name,
+    int            len)
 {
-    for (; *p; p++) {
-        if (*p != '?' && *p != '"' && *p != '>') {
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (op[i] != toupper((unsigned char) name[i])) {
             return 0;
         }
     }
     return 1;
-} /* chimera_vfs_match_null */
+} /* chimera_vfs_match_literal_eq */
 
-/* Recursive matcher over NUL-terminated strings; ldot points at the last '.'
- * in the name (or NULL).  Returns 0 on match, -1 otherwise. */
+/*
+ * Run a compiled pattern over a name.  Each literal consumes exactly one name
+ * byte, so a name must carry the pattern's leading and trailing literal runs
+ * at its ends -- checked first, which settles most names of a "*.txt"-style
+ * filter without touching the NFA.
+ *
+ * The NFA's states are pattern positions; at each name position the active set
+ * is first closed over the zero-width moves (any '*' or '<' may match
+ * nothing, '>' steps over a '.' without consuming it), then advanced over the
+ * next name byte.  Zero-width moves only go forward, so one ascending pass
+ * closes the set.  The semantics are those of Samba's ms_fnmatch_core:
+ *   '*'  zero or more of any byte.
+ *   '<'  zero or more, but never past the name's last '.': a '<' entered at
+ *        or before it may consume up to and including that '.', one entered
+ *        after it (or in a name with no '.') consumes freely.  dos_post marks
+ *        the latter.
+ *   '?'  exactly one byte.
+ *   '>'  one byte, except it stops at a '.', and at end-of-name (or at a final
+ *        '.') matches if the rest of the pattern can match nothing.
+ *   '"'  a '.', or end-of-name if the rest of the pattern can match nothing.
+ * Those end-of-name rules accept outright: the match is decided there.
+ */
 static int
-chimera_vfs_match_core(
-    const char *p,
-    const char *n,
-    const char *ldot)
+chimera_vfs_match_run(
+    const struct chimera_vfs_match *m,
+    const char                     *name,
+    int                             namelen)
 {
-    char c;
-
-    while ((c = *p++)) {
-        switch (c) {
-            case '*':
-                while (*n) {
-                    if (chimera_vfs_match_core(p, n, ldot) == 0) {
-                        return 0;
+    uint8_t  act[2][CHIMERA_VFS_NAME_MAX + 1];
+    uint8_t  post[2][CHIMERA_VFS_NAME_MAX + 1];
+    uint8_t *cur, *nxt, *cpost, *npost;
+    int      len = m->len, ldot = -1, k, i, sel = 0;
+
+    if (namelen >= CHIMERA_VFS_NAME_MAX) {
+        namelen = CHIMERA_VFS_NAME_MAX - 1;
+    }
+
+    if (m->literal) {
+        return namelen == len && chimera_vfs_match_literal_eq(m->op, name, len);
+    }
+    if (namelen < m->prefix_len + m->suffix_len ||
+        !chimera_vfs_match_literal_eq(m->op, name, m->prefix_len) ||
+        !chimera_vfs_match_literal_eq(m->op + len - m->suffix_len,
+                                      name + namelen - m->suffix_len,
+                                      m->suffix_len)) {
+        return 0;
+    }
+
+    for (k = namelen - 1; k >= 0; k--) {
+        if (name[k] == '.') {
+            ldot = k;
+            break;
+        }
+    }
+
+    /* The literal prefix matched: start just past it. */
+    cur   = act[0];
+    cpost = post[0];
+    memset(cur, 0, len + 1);
+    memset(cpost, 0, len + 1);
+    cur[m->prefix_len]   = 1;
+    cpost[m->prefix_len] = ldot < m->prefix_len;
+
+    for (k = m->prefix_len; ; k++) {
+        int     at_end = k == namelen;
+        int     dpost  = ldot < k;     /* a '<' entered here is past the last '.' */
+        int     npos   = ldot < k + 1; /* ... or at the next position */
+        int     live   = 0;
+        uint8_t ch;
+
+        /* Zero-width closure at position k. */
+        for (i = 0; i < len; i++) {
+            if (!cur[i]) {
+                continue;
+            }
+            live = 1;
+            switch (m->op[i]) {
+                case '*':
+                case '<':
+                    cur[i + 1]    = 1;
+                    cpost[i + 1] |= dpost;
+                    break;
+                case '>':
+                    if (at_end) {
+                        if (m->null_rest[i]) {
+                            return 1;
+                        }
+                    } else if (name[k] == '.') {
+                        if (k == namelen - 1 && m->null_rest[i]) {
+                            return 1;
+                        }
+                        cur[i + 1]    = 1;
+                        cpost[i + 1] |= dpost;
                     }
-                    n++;
-                }
-                break;
-            case '<':
-                if (!*n && !*p) {
-                    return 0;
-                }
-                while (*n) {
-                    if (chimera_vfs_match_core(p, n, ldot) == 0) {
-                        return 0;
+                    break;
+                case '"':
+                    if (at_end && m->null_rest[i]) {
+                        return 1;
                     }
-                    if (n == ldot) {
-                        if (chimera_vfs_match_core(p, n + 1, ldot) == 0) {
-                            return 0;
-                        }
-                        return -1;
+                    break;
+            } /* switch */
+        }
+
+        if (at_end) {
+            return cur[len];
+        }
+        if (!live) {
+            return 0;
+        }
+
+        /* Advance over name[k]. */
+        sel   ^= 1;
+        nxt    = act[sel];
+        npost  = post[sel];
+        memset(nxt, 0, len + 1);
+        memset(npost, 0, len + 1);
+        ch = toupper((unsigned char) name[k]);
+
+        for (i = 0; i < len; i++) {
+            if (!cur[i]) {
+                continue;
+            }
+            switch (m->op[i]) {
+                case '*':
+                    nxt[i] = 1;
+                    break;
+                case '<':
+                    if (k <= ldot || cpost[i]) {
+                        nxt[i]    = 1;
+                        npost[i] |= cpost[i];
                     }
-                    n++;
-                }
-                break;
-            case '?':
-                if (!*n) {
-                    return -1;
-                }
-                n++;
-                break;
-            case '>':
-                if (n[0] == '.') {
-                    if (!n[1] && chimera_vfs_match_null(p)) {
-                        return 0;
+                    break;
+                case '?':
+                    nxt[i + 1]    = 1;
+                    npost[i + 1] |= npos;
+                    break;
+                case '>':
+                    if (name[k] != '.') {
+                        nxt[i + 1]    = 1;
+                        npost[i + 1] |= npos;
                     }
                     break;
-                }
-                if (!*n) {
-                    return chimera_vfs_match_null(p) ? 0 : -1;
-                }
-                n++;
-                break;
-            case '"':
-                if (*n == 0 && chimera_vfs_match_null(p)) {
-                    return 0;
-                }
-                if (*n != '.') {
-                    return -1;
-                }
-                n++;
-                break;
-            default:
-                if (toupper((unsigned char) c) != toupper((unsigned char) *n)) {
-                    return -1;
-                }
-                n++;
-        } /* switch */
-    }
+                case '"':
+                    if (name[k] == '.') {
+                        nxt[i + 1]    = 1;
+                        npost[i + 1] |= npos;
+                    }
+                    break;
+                default:
+                    if (m->op[i] == ch) {
+                        nxt[i + 1]    = 1;
+                        npost[i + 1] |= npos;
+                    }
+            } /* switch */
+        }
 
-    return *n ? -1 : 0;
-} /* chimera_vfs_match_core */
+        cur   = nxt;
+        cpost = npost;
+    }
+} /* chimera_vfs_match_run */
 
 /* True iff `name` matches the SMB wildcard `pattern`.  A NULL/empty pattern or
- * the universal "*" matches everything (the common no-filter fast path). */
+ * the universal "*" matches everything (the common no-filter fast path).
+ * Compiles per call; chimera_vfs_readdir compiles once per scan instead. */
 SYMBOL_EXPORT int
 chimera_vfs_dirent_match(
     const char *name,
@@ -125,8 +269,7 @@ chimera_vfs_dirent_match(
     const char *pattern,
     int         patternlen)
 {
-    char        nbuf[256], pbuf[256];
-    const char *ldot;
+    struct chimera_vfs_match m;
 
     if (!pattern || patternlen == 0) {
         return 1;
@@ -135,21 +278,37 @@ chimera_vfs_dirent_match(
         return 1;
     }
 
-    if (namelen >= (int) sizeof(nbuf)) {
-        namelen = sizeof(nbuf) - 1;
+    chimera_vfs_match_compile(&m, pattern, patternlen);
+
+    return chimera_vfs_match_run(&m, name, namelen);
+} /* chimera_vfs_dirent_match */
+
+/* True iff the pattern has no metacharacters, so it names a single entry (up
+ * to case) -- the probe Explorer and robocopy issue for one file.  "." and
+ * ".." are left to the scan, which synthesizes them. */
+static int
+chimera_vfs_match_is_literal(
+    const char *pattern,
+    int         patternlen)
+{
+    int i;
+
+    if (!pattern || patternlen <= 0 || patternlen >= 256) {
+        return 0;
     }
-    if (patternlen >= (int) sizeof(pbuf)) {
-        patternlen = sizeof(pbuf) - 1;
+    if ((patternlen == 1 && pattern[0] == '.') ||
+        (patternlen == 2 && pattern[0] == '.' && pattern[1] == '.')) {
+        return 0;
     }
-    memcpy(nbuf, name, namelen);
-    nbuf[namelen] = '\0';
-    memcpy(pbuf, pattern, patternlen);
-    pbuf[patternlen] = '\0';
-
-    ldot = strrchr(nbuf, '.');
 
-    return chimera_vfs_match_core(pbuf, nbuf, ldot) == 0;
-} /* chimera_vfs_dirent_match */
+    for (i = 0; i < patternlen; i++) {
+        if (chimera_vfs_match_is_meta(pattern[i]) ||
+            pattern[i] == '/' || pattern[i] == '\0') {
+            return 0;
+        }
+    }
+    return 1;
+} /* chimera_vfs_match_is_literal */
 
 /* Per-entry interposer: drop entries that do not match the readdir's pattern,
  * forwarding the rest to the path's real callback. */
@@ -164,9 +323,7 @@ chimera_vfs_readdir_filter_callback(
 {
     struct chimera_vfs_request *request = arg;
 
-    if (!chimera_vfs_dirent_match(name, namelen,
-                                  request->readdir.match_pattern,
-                                  request->readdir.match_pattern_len)) {
+    if (!chimera_vfs_match_run(&request->readdir.match, name, namelen)) {
         return 0;
     }
 
@@ -281,6 +438,113 @@ chimera_vfs_bounce_complete(struct chimera_vfs_request *request)
     chimera_vfs_readdir_complete(request);
 } /* chimera_vfs_bounce_complete */
 
+/* Literal-pattern fast path: a LOOKUP_AT stands in for the whole scan.  A
+ * hit is the one entry to return, under the name the directory stores it as
+ * (a case-insensitive backend may have matched another spelling); a miss
+ * proves nothing for the case-insensitive match (the directory may hold the
+ * name in another case), so fall back to the filtered scan.  As with Samba's
+ * stat-first probe, a hit on a case-sensitive backend does not also report
+ * other-case twins. */
+static void
+chimera_vfs_readdir_literal_complete(struct chimera_vfs_request *lookup)
+{
+    struct chimera_vfs_request *request = lookup->proto_private_data;
+    const char                 *name;
+    int                         namelen;
+
+    chimera_vfs_complete(lookup);
+
+    if (lookup->status != CHIMERA_VFS_OK) {
+        chimera_vfs_request_free(lookup->thread, lookup);
+        chimera_vfs_readdir_start(request);
+        return;
+    }
+
+    if (lookup->lookup_at.r_namelen) {
+        name    = lookup->lookup_at.r_name;
+        namelen = lookup->lookup_at.r_namelen;
+    } else {
+        name    = lookup->lookup_at.component;
+        namelen = lookup->lookup_at.component_len;
+    }
+
+    request->readdir.r_dir_attr = lookup->lookup_at.r_dir_attr;
+
+    /* The entry's cookie ends the enumeration: a resume from it (SMB records
+     * the last entry's cookie as the open's position) finds nothing more.  The
+     * pattern names one entry, so the scan is over whether or not the caller
+     * took it -- a non-EOF reply here would have it re-probe from cookie 0
+     * forever. */
+    (void) request->readdir.callback(lookup->lookup_at.r_attr.va_ino,
+                                     UINT64_MAX,
+                                     name,
+                                     namelen,
+                                     &lookup->lookup_at.r_attr,
+                                     request->proto_private_data);
+
+    chimera_vfs_request_free(lookup->thread, lookup);
+
+    request->status           = CHIMERA_VFS_OK;
+    request->readdir.r_cookie = UINT64_MAX;
+    request->readdir.r_eof    = 1;
+
+    chimera_vfs_readdir_complete(request);
+} /* chimera_vfs_readdir_literal_complete */
+
+static void
+chimera_vfs_readdir_start(struct chimera_vfs_request *request)
+{
+    struct chimera_vfs_thread *thread = request->thread;
+    struct chimera_vfs_module *module = request->module;
+
+    /* If this module is blocking then we need to bounce the results into the original thread
+     * before making the caller provided result callback.  This only applies when the request
+     * will actually be dispatched to a delegation thread; if the sync delegation pool is
+     * disabled and there is no async pool, the blocking module runs inline on this thread and
+     * its result callback can safely target the original buffers directly.
+     */
+
+    if ((module->capabilities & CHIMERA_VFS_CAP_BLOCKING) &&
+        (thread->vfs->num_sync_delegation_threads > 0 ||
+         thread->vfs->num_async_delegation_threads > 0)) {
+
+        evpl_iovec_alloc(thread->evpl, 64 * 1024, 8, 1, 0, &request->readdir.bounce_iov);
+
+        request->readdir.orig_callback     = request->readdir.callback;
+        request->readdir.orig_private_data = request->proto_private_data;
+
+        request->readdir.callback   = chimera_vfs_readdir_bounce_result_callback;
+        request->proto_private_data = request;
+
+        request->complete = chimera_vfs_bounce_complete;
+
+    } else {
+        request->complete = chimera_vfs_readdir_complete;
+    }
+
+    /* When a wildcard is supplied, interpose the filter over whichever per-entry
+     * callback the path above established (the caller's directly, or the bounce
+     * collector): the backend keeps emitting every entry, and the filter drops
+     * the non-matching ones before they reach it. */
+    if (request->readdir.match_pattern) {
+        request->readdir.inner_callback = request->readdir.callback;
+        request->readdir.inner_arg      = request->proto_private_data;
+        request->readdir.callback       = chimera_vfs_readdir_filter_callback;
+        /* The blocking path already saves orig_private_data and restores it in
+         * bounce_complete; the non-blocking path's completion goes straight to
+         * chimera_vfs_readdir_complete, so wrap it to restore the caller's
+         * private_data (the completion is passed proto_private_data, which we
+         * are about to repoint at the VFS request for the filter). */
+        if (request->complete == chimera_vfs_readdir_complete) {
+            request->readdir.orig_private_data = request->proto_private_data;
+            request->complete                  = chimera_vfs_readdir_filter_complete;
+        }
+        request->proto_private_data = request;
+    }
+
+    chimera_vfs_dispatch(request);
+} /* chimera_vfs_readdir_start */
+
 
 SYMBOL_EXPORT void
 chimera_vfs_readdir(
@@ -298,8 +562,7 @@ chimera_vfs_readdir(
     chimera_vfs_readdir_complete_t  complete,
     void                           *private_data)
 {
-    struct chimera_vfs_request *request;
-    struct chimera_vfs_module  *module;
+    struct chimera_vfs_request *request, *lookup;
 
     request = chimera_vfs_request_alloc_by_handle(thread, cred, handle);
 
@@ -308,8 +571,6 @@ chimera_vfs_readdir(
         return;
     }
 
-    module = request->module;
-
     request->opcode                         = CHIMERA_VFS_OP_READDIR;
     request->readdir.handle                 = handle;
     request->readdir.attr_mask              = attr_mask;
@@ -326,55 +587,43 @@ chimera_vfs_readdir(
     request->readdir.bounce_offset = 0;
     request->readdir.orig_callback = NULL;
 
-    /* If this module is blocking then we need to bounce the results into the original thread
-     * before making the caller provided result callback.  This only applies when the request
-     * will actually be dispatched to a delegation thread; if the sync delegation pool is
-     * disabled and there is no async pool, the blocking module runs inline on this thread and
-     * its result callback can safely target the original buffers directly.
-     */
-
-    if ((module->capabilities & CHIMERA_VFS_CAP_BLOCKING) &&
-        (thread->vfs->num_sync_delegation_threads > 0 ||
-         thread->vfs->num_async_delegation_threads > 0)) {
-
-        evpl_iovec_alloc(thread->evpl, 64 * 1024, 8, 1, 0, &request->readdir.bounce_iov);
-
-        request->readdir.orig_callback     = callback;
-        request->readdir.orig_private_data = private_data;
-
-        request->readdir.callback   = chimera_vfs_readdir_bounce_result_callback;
-        request->proto_private_data = request;
-
-        request->complete = chimera_vfs_bounce_complete;
-
-    } else {
-        request->complete = chimera_vfs_readdir_complete;
-    }
-
-    /* When a wildcard is supplied, interpose the filter over whichever per-entry
-     * callback the path above established (the caller's directly, or the bounce
-     * collector): the backend keeps emitting every entry, and the filter drops
-     * the non-matching ones before they reach it.  Skip the interposition for
-     * the universal "*" (and NULL), which match everything. */
+    /* Skip filtering for the universal "*" (and NULL), which match
+     * everything. */
     request->readdir.match_pattern = NULL;
     if (match_pattern && match_pattern_len > 0 &&
         !(match_pattern_len == 1 && match_pattern[0] == '*')) {
         request->readdir.match_pattern     = match_pattern;
         request->readdir.match_pattern_len = match_pattern_len;
-        request->readdir.inner_callback    = request->readdir.callback;
-        request->readdir.inner_arg         = request->proto_private_data;
-        request->readdir.callback          = chimera_vfs_readdir_filter_callback;
-        /* The blocking path already saves orig_private_data and restores it in
-         * bounce_complete; the non-blocking path's completion goes straight to
-         * chimera_vfs_readdir_complete, so wrap it to restore the caller's
-         * private_data (the completion is passed proto_private_data, which we
-         * are about to repoint at the VFS request for the filter). */
-        if (request->complete == chimera_vfs_readdir_complete) {
-            request->readdir.orig_private_data = request->proto_private_data;
-            request->complete                  = chimera_vfs_readdir_filter_complete;
+        chimera_vfs_match_compile(&request->readdir.match,
+                                  match_pattern, match_pattern_len);
+    }
+
+    /* A literal name probed from the start of the directory is one lookup,
+     * not a scan of every entry.  It is dispatched directly rather than
+     * through chimera_vfs_lookup_at so the stored name comes back with it. */
+    if (cookie == 0 &&
+        chimera_vfs_match_is_literal(match_pattern, match_pattern_len)) {
+        lookup = chimera_vfs_request_alloc_by_handle(thread, cred, handle);
+
+        if (!CHIMERA_VFS_IS_ERR(lookup)) {
+            lookup->opcode                           = CHIMERA_VFS_OP_LOOKUP_AT;
+            lookup->complete                         = chimera_vfs_readdir_literal_complete;
+            lookup->lookup_at.handle                 = handle;
+            lookup->lookup_at.component              = match_pattern;
+            lookup->lookup_at.component_len          = match_pattern_len;
+            lookup->lookup_at.component_hash         = chimera_vfs_hash(match_pattern,
+                                                                        match_pattern_len);
+            lookup->lookup_at.r_namelen              = 0;
+            lookup->lookup_at.r_attr.va_req_mask     = attr_mask | CHIMERA_VFS_ATTR_FH;
+            lookup->lookup_at.r_attr.va_set_mask     = 0;
+            lookup->lookup_at.r_dir_attr.va_req_mask = dir_attr_mask;
+            lookup->lookup_at.r_dir_attr.va_set_mask = 0;
+            lookup->proto_private_data               = request;
+
+            chimera_vfs_dispatch(lookup);
+            return;
         }
-        request->proto_private_data = request;
     }
 
-    chimera_vfs_dispatch(request);
+    chimera_vfs_readdir_start(request);
 } /* chimera_vfs_readdir */ /* chimera_vfs_readdir */
@@ -58,6 +58,21 @@ chimera_vfs_write_dispatch(
     void                                 *private_data)
 {
     struct chimera_vfs_request *request;
+    struct chimera_vfs_attrs    pre_attr, post_attr;
+
+    /* A leaseless UNSTABLE write may be acknowledged from the write-behind
+     * buffer; its data reaches the backend before any later op on the file
+     * (vfs_write_behind.h).  No attributes are reported for it. */
+    if (thread->vfs->vfs_write_behind && sync == CHIMERA_VFS_WRITE_UNSTABLE && !io_owner &&
+        chimera_vfs_write_behind_absorb(thread, cred, handle, offset, count, iov, niov)) {
+        pre_attr.va_req_mask  = pre_attr_mask;
+        pre_attr.va_set_mask  = 0;
+        post_attr.va_req_mask = post_attr_mask;
+        post_attr.va_set_mask = 0;
+        callback(CHIMERA_VFS_OK, count, CHIMERA_VFS_WRITE_UNSTABLE,
+                 &pre_attr, &post_attr, private_data);
+        return;
+    }
 
     request = chimera_vfs_request_alloc_by_handle(thread, cred, handle);
 
@@ -220,3 +220,112 @@ chimera_rcu_pool_destroy(struct chimera_rcu_pool *pool)
 
     free(pool->depots);
 } /* chimera_rcu_pool_destroy */
+
+/*
+ * Size-classed pool for variable-length entries (the name and rpl caches,
+ * whose entries carry two file handles and a name packed after a fixed
+ * header).  Sizing every entry for the worst case (two CHIMERA_VFS_FH_SIZE
+ * handles and a CHIMERA_VFS_NAME_MAX name) made each one ~450 bytes when the
+ * typical payload is a pair of short handles and a name under 20 bytes.
+ * Instead each class is its own pool with its own magazine id (first_id +
+ * class), so recycling never mixes sizes; a retired entry returns to the
+ * class it came from via rnode.pool.  Long names simply land in the largest
+ * class, which is rarely touched.
+ */
+static const size_t chimera_rcu_size_class_bytes[CHIMERA_RCU_SIZE_CLASSES] = {
+    128, 192, 256, 512
+};
+
+struct chimera_rcu_pool_set {
+    struct chimera_rcu_pool pools[CHIMERA_RCU_SIZE_CLASSES];
+    int                     first_id;
+};
+
+static inline void
+chimera_rcu_pool_set_init(
+    struct chimera_rcu_pool_set *set,
+    int                          first_id)
+{
+    int i;
+
+    set->first_id = first_id;
+
+    for (i = 0; i < CHIMERA_RCU_SIZE_CLASSES; i++) {
+        chimera_rcu_pool_init(&set->pools[i], first_id + i, chimera_rcu_size_class_bytes[i]);
+    }
+} /* chimera_rcu_pool_set_init */
+
+/* Allocate an entry of at least `size` bytes from the smallest class that
+ * fits.  `magazines` is the calling thread's full magazine array. */
+static inline struct chimera_rcu_node *
+chimera_rcu_pool_set_alloc(
+    struct chimera_rcu_magazine *magazines,
+    struct chimera_rcu_pool_set *set,
+    size_t                       size)
+{
+    int i = 0;
+
+    while (i < CHIMERA_RCU_SIZE_CLASSES - 1 && size > chimera_rcu_size_class_bytes[i]) {
+        i++;
+    }
+
+    return chimera_rcu_pool_alloc(&magazines[set->first_id + i], &set->pools[i]);
+} /* chimera_rcu_pool_set_alloc */
+
+static inline void
+chimera_rcu_pool_set_destroy(struct chimera_rcu_pool_set *set)
+{
+    int i;
+
+    for (i = 0; i < CHIMERA_RCU_SIZE_CLASSES; i++) {
+        chimera_rcu_pool_destroy(&set->pools[i]);
+    }
+} /* chimera_rcu_pool_set_destroy */
+
+/*
+ * Slot fingerprints.  Alongside each set-associative slot's entry pointers a
+ * cache keeps one tag byte per way, derived from the top bits of the entry's
+ * key (never 0, which marks an empty way).  A probe compares all of a slot's
+ * tags in one word-wide (SWAR) operation and only dereferences the ways whose
+ * tag matches, so a miss usually touches no entry at all and a hit touches
+ * just the one entry.  Tags are written under the shard lock next to the
+ * pointer they describe; a lockless reader racing a replacement may see a
+ * stale tag, which costs at most a spurious miss since every candidate is
+ * still verified in full.  Ways per slot must not exceed 8; tag arrays are
+ * allocated with CHIMERA_RCU_TAG_PAD spare bytes so the word load of the last
+ * slot stays in bounds.
+ */
+#define CHIMERA_RCU_TAG_PAD 8
+
+static inline uint8_t
+chimera_rcu_tag(uint64_t key)
+{
+    return (uint8_t) (key >> 56) | 1;
+} /* chimera_rcu_tag */
+
+/* Bitmask of the ways among the first `ways` tags that equal `tag`. */
+static inline uint32_t
+chimera_rcu_tag_match(
+    const uint8_t *tags,
+    int            ways,
+    uint8_t        tag)
+{
+    uint64_t word, x, hits;
+    uint32_t mask = 0;
+    int      i;
+
+    memcpy(&word, tags, sizeof(word));
+
+    x    = word ^ (0x0101010101010101ULL * tag);
+    hits = (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+
+    /* The borrow trick can flag a false positive only above a true match, and
+     * every candidate is verified by the caller anyway. */
+    for (i = 0; i < ways; i++) {
+        if (hits & (0x80ULL << (i * 8))) {
+            mask |= 1U << i;
+        }
+    }
+
+    return mask;
+} /* chimera_rcu_tag_match */
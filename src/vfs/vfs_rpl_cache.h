@@ -21,22 +21,41 @@
  *   Reverse:  hash(parent_fh) ^ hash(name) -> entry  (invalidation)
  */
 
+/* Variable length like the name cache: child FH, parent FH and name are
+ * packed back to back in data[]. */
 struct chimera_vfs_rpl_cache_entry {
     struct chimera_rcu_node rnode; /* must be first: aliases the entry pointer */
     uint64_t                fwd_key; /* hash(child_fh) */
     uint64_t                rev_key; /* hash(parent_fh) ^ hash(name) */
+    int64_t                 score;
+    uint64_t                expiration; /* stopwatch ticks */
     uint16_t                child_fh_len;
     uint16_t                parent_fh_len;
     uint16_t                name_len;
-    int64_t                 score;
-    uint64_t                expiration; /* stopwatch ticks */
-    uint8_t                 child_fh[CHIMERA_VFS_FH_SIZE];
-    uint8_t                 parent_fh[CHIMERA_VFS_FH_SIZE];
-    char                    name[CHIMERA_VFS_NAME_MAX];
+    uint8_t                 data[];
 };
 
+static inline const uint8_t *
+chimera_vfs_rpl_cache_entry_child_fh(const struct chimera_vfs_rpl_cache_entry *entry)
+{
+    return entry->data;
+} /* chimera_vfs_rpl_cache_entry_child_fh */
+
+static inline const uint8_t *
+chimera_vfs_rpl_cache_entry_parent_fh(const struct chimera_vfs_rpl_cache_entry *entry)
+{
+    return entry->data + entry->child_fh_len;
+} /* chimera_vfs_rpl_cache_entry_parent_fh */
+
+static inline const char *
+chimera_vfs_rpl_cache_entry_name(const struct chimera_vfs_rpl_cache_entry *entry)
+{
+    return (const char *) entry->data + entry->child_fh_len + entry->parent_fh_len;
+} /* chimera_vfs_rpl_cache_entry_name */
+
 struct chimera_vfs_rpl_cache_shard {
     struct chimera_vfs_rpl_cache_entry **fwd_entries; /* forward index slots */
+    uint8_t                             *fwd_tags;    /* fingerprint per forward slot */
     struct chimera_vfs_rpl_cache_entry **rev_entries; /* reverse index slots */
     pthread_mutex_t                      entry_lock;
 };
@@ -52,7 +71,7 @@ struct chimera_vfs_rpl_cache {
     uint32_t                            num_shards_mask;
     uint32_t                            num_entries_mask;
     uint64_t                            ttl;
-    struct chimera_rcu_pool             pool;
+    struct chimera_rcu_pool_set         pools;
     struct chimera_vfs_rpl_cache_shard *shards;
 };
 
@@ -74,8 +93,7 @@ chimera_vfs_rpl_cache_create(
     cache->num_entries_bits = entries_per_slot_bits;
     cache->ttl              = ttl;
 
-    chimera_rcu_pool_init(&cache->pool, CHIMERA_RCU_POOL_RPL,
-                          sizeof(struct chimera_vfs_rpl_cache_entry));
+    chimera_rcu_pool_set_init(&cache->pools, CHIMERA_RCU_POOL_RPL);
 
     cache->num_shards  = 1 << num_shards_bits;
     cache->num_slots   = 1 << num_slots_bits;
@@ -95,6 +113,7 @@ chimera_vfs_rpl_cache_create(
                                     sizeof(struct chimera_vfs_rpl_cache_entry *));
         shard->rev_entries = calloc(cache->num_slots * cache->num_entries,
                                     sizeof(struct chimera_vfs_rpl_cache_entry *));
+        shard->fwd_tags = calloc(cache->num_slots * cache->num_entries + CHIMERA_RCU_TAG_PAD, 1);
 
         pthread_mutex_init(&shard->entry_lock, NULL);
     }
@@ -124,12 +143,13 @@ chimera_vfs_rpl_cache_destroy(struct chimera_vfs_rpl_cache *cache)
         }
 
         free(shard->fwd_entries);
+        free(shard->fwd_tags);
         free(shard->rev_entries);
 
         pthread_mutex_destroy(&shard->entry_lock);
     }
 
-    chimera_rcu_pool_destroy(&cache->pool);
+    chimera_rcu_pool_set_destroy(&cache->pools);
 
     free(cache->shards);
     free(cache);
@@ -181,36 +201,41 @@ chimera_vfs_rpl_cache_lookup(
 {
     struct chimera_vfs_rpl_cache_entry  *entry;
     struct chimera_vfs_rpl_cache_shard  *shard;
-    struct chimera_vfs_rpl_cache_entry **slot, **slot_end;
-    uint64_t                             key = child_fh_hash;
-    uint64_t                             now = chimera_vfs_now_ticks();
+    struct chimera_vfs_rpl_cache_entry **slot;
+    uint64_t                             key  = child_fh_hash;
+    uint64_t                             base = chimera_vfs_rpl_cache_fwd_slot(cache, key);
+    uint64_t                             now  = chimera_vfs_now_ticks();
+    uint32_t                             ways;
+    int                                  way;
 
     shard = &cache->shards[key & cache->num_shards_mask];
 
-    slot     = &shard->fwd_entries[chimera_vfs_rpl_cache_fwd_slot(cache, key)];
-    slot_end = slot + cache->num_entries;
+    slot = &shard->fwd_entries[base];
 
     urcu_qsbr_read_lock();
 
-    while (slot < slot_end) {
-        entry = rcu_dereference(*slot);
+    ways = chimera_rcu_tag_match(&shard->fwd_tags[base], cache->num_entries, chimera_rcu_tag(key));
+
+    while (ways) {
+        way   = __builtin_ctz(ways);
+        ways &= ways - 1;
+
+        entry = rcu_dereference(slot[way]);
 
         if (entry && entry->fwd_key == key &&
             entry->expiration >= now &&
-            chimera_memequal(entry->child_fh, entry->child_fh_len,
+            chimera_memequal(chimera_vfs_rpl_cache_entry_child_fh(entry), entry->child_fh_len,
                              child_fh, child_fh_len)) {
 
             *r_parent_fh_len = entry->parent_fh_len;
-            memcpy(r_parent_fh, entry->parent_fh, entry->parent_fh_len);
+            memcpy(r_parent_fh, chimera_vfs_rpl_cache_entry_parent_fh(entry), entry->parent_fh_len);
             *r_name_len = entry->name_len;
-            memcpy(r_name, entry->name, entry->name_len);
+            memcpy(r_name, chimera_vfs_rpl_cache_entry_name(entry), entry->name_len);
             entry->score++;
 
             urcu_qsbr_read_unlock();
             return 0;
         }
-
-        slot++;
     }
 
     urcu_qsbr_read_unlock();
@@ -318,7 +343,8 @@ chimera_vfs_rpl_cache_insert(
 
     /* Recycle an entry from the pool (thread magazine -> depot -> calloc) */
     entry = (struct chimera_vfs_rpl_cache_entry *)
-        chimera_rcu_pool_alloc(&thread->rcu_magazines[CHIMERA_RCU_POOL_RPL], &cache->pool);
+        chimera_rcu_pool_set_alloc(thread->rcu_magazines, &cache->pools,
+                                   sizeof(*entry) + child_fh_len + parent_fh_len + name_len);
 
     entry->fwd_key       = fwd_key;
     entry->rev_key       = rev_key;
@@ -329,9 +355,9 @@ chimera_vfs_rpl_cache_insert(
 
     entry->expiration = now + chimera_vfs_ns_to_ticks((uint64_t) cache->ttl * 1000000000ULL);
 
-    memcpy(entry->child_fh, child_fh, child_fh_len);
-    memcpy(entry->parent_fh, parent_fh, parent_fh_len);
-    memcpy(entry->name, name, name_len);
+    memcpy(entry->data, child_fh, child_fh_len);
+    memcpy(entry->data + child_fh_len, parent_fh, parent_fh_len);
+    memcpy(entry->data + child_fh_len + parent_fh_len, name, name_len);
 
     /* Insert into forward index */
     urcu_qsbr_read_lock();
@@ -348,7 +374,7 @@ chimera_vfs_rpl_cache_insert(
 
         /* Replace existing entry for same child_fh */
         if (old_entry && old_entry->fwd_key == fwd_key &&
-            chimera_memequal(old_entry->child_fh, old_entry->child_fh_len,
+            chimera_memequal(chimera_vfs_rpl_cache_entry_child_fh(old_entry), old_entry->child_fh_len,
                              child_fh, child_fh_len)) {
             best_entry = old_entry;
             slot_best  = slot;
@@ -388,6 +414,8 @@ chimera_vfs_rpl_cache_insert(
 
     rcu_assign_pointer(*slot_best, entry);
 
+    shard->fwd_tags[slot_best - shard->fwd_entries] = chimera_rcu_tag(fwd_key);
+
     /* Insert into reverse index */
     chimera_vfs_rpl_cache_rev_insert(cache, shard, entry);
 
@@ -438,9 +466,10 @@ chimera_vfs_rpl_cache_invalidate(
             entry = *slot;
 
             if (entry && entry->rev_key == rev_key &&
-                chimera_memequal(entry->parent_fh, entry->parent_fh_len,
+                chimera_memequal(chimera_vfs_rpl_cache_entry_parent_fh(entry), entry->parent_fh_len,
                                  parent_fh, parent_fh_len) &&
-                chimera_memequal(entry->name, entry->name_len, name, name_len)) {
+                chimera_memequal(chimera_vfs_rpl_cache_entry_name(entry), entry->name_len,
+                                 name, name_len)) {
 
                 removed_entry = entry;
 
@@ -459,6 +488,7 @@ chimera_vfs_rpl_cache_invalidate(
                     while (fwd_slot < fwd_end) {
                         if (*fwd_slot == entry) {
                             rcu_assign_pointer(*fwd_slot, NULL);
+                            shard->fwd_tags[fwd_slot - shard->fwd_entries] = 0;
                             break;
                         }
                         fwd_slot++;
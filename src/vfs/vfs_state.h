@@ -731,3 +731,33 @@ chimera_vfs_state_break_caching_for_namespace(
     uint64_t                              fh_hash,
     const struct chimera_vfs_lease_owner *opener,
     uint8_t                               retain_mode);
+
+/* Does no caching lease (an SMB lease/oplock or NFSv4 delegation, possibly
+ * holding dirty data) exist on the handle's file?  Lets the VFS short-circuit
+ * I/O (data cache hits, write-behind) that would otherwise go through
+ * chimera_vfs_io_lease_acquire.  Until the first I/O attaches the handle's
+ * file state we cannot tell, so the answer is no. */
+static inline int
+chimera_vfs_handle_lease_free(
+    struct chimera_vfs             *vfs,
+    struct chimera_vfs_open_handle *handle)
+{
+    struct chimera_vfs_file_state *file;
+    int                            ok;
+
+    if (!vfs->caching_enabled) {
+        return 1;
+    }
+
+    file = __atomic_load_n(&handle->file_state, __ATOMIC_ACQUIRE);
+
+    if (!file) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&file->lock);
+    ok = (file->caching_leases == NULL);
+    pthread_mutex_unlock(&file->lock);
+
+    return ok;
+} /* chimera_vfs_handle_lease_free */
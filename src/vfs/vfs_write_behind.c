@@ -0,0 +1,630 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "vfs_write_behind.h"
+#include "vfs_internal.h"
+#include "vfs_attr_cache.h"
+#include "vfs_mount_table.h"
+#include "vfs/vfs_state.h"
+#include "common/macros.h"
+
+/* A run of contiguous buffered bytes.  The buffer is allocated at extent
+ * capacity so later sequential writes append in place; only [offset, offset +
+ * length) holds data. */
+struct chimera_vfs_wb_extent {
+    uint64_t                      offset;
+    uint32_t                      length;
+    uint32_t                      capacity;
+    struct evpl_iovec             iov;
+    struct chimera_vfs_wb_file   *file;
+    struct chimera_vfs_wb_extent *prev;
+    struct chimera_vfs_wb_extent *next;
+};
+
+struct chimera_vfs_wb_file {
+    uint64_t                        fh_hash;
+    uint16_t                        fh_len;
+    uint8_t                         fh[CHIMERA_VFS_FH_SIZE];
+    /* Snapshot of the open handle the data was written through.  The flush
+     * writes are issued on it, so they remain valid after the open cache has
+     * recycled the real handle: its backend close is itself dispatched
+     * against this file and so waits for the flush. */
+    struct chimera_vfs_open_handle  handle;
+    struct chimera_vfs_cred         cred;
+    int                             num_extents;
+    int                             inflight;
+    int                             flushing;
+    enum chimera_vfs_error          error;
+    uint64_t                        dirty_since; /* stopwatch ticks */
+    struct chimera_vfs_wb_extent   *extents;
+    struct chimera_vfs_request     *waiters;
+    /* Batch detached by chimera_vfs_write_behind_flush, pending issue. */
+    struct chimera_vfs_wb_extent   *flush_extents;
+    struct chimera_vfs_wb_file     *flush_next;
+    struct chimera_vfs_wb_file     *prev;
+    struct chimera_vfs_wb_file     *next;
+};
+
+static inline struct chimera_vfs_wb_shard *
+chimera_vfs_wb_shard(
+    struct chimera_vfs_write_behind *wb,
+    uint64_t                         fh_hash)
+{
+    /* Above the filter bits so shard and bucket stay uncorrelated. */
+    return &wb->shards[(fh_hash >> CHIMERA_VFS_WB_FILTER_BITS) & (CHIMERA_VFS_WB_NUM_SHARDS - 1)];
+} /* chimera_vfs_wb_shard */
+
+static inline struct chimera_vfs_wb_file *
+chimera_vfs_wb_file_find(
+    struct chimera_vfs_wb_shard *shard,
+    uint64_t                     fh_hash,
+    const void                  *fh,
+    int                          fh_len)
+{
+    struct chimera_vfs_wb_file *file;
+
+    DL_FOREACH(shard->files, file)
+    {
+        if (file->fh_hash == fh_hash &&
+            chimera_memequal(file->fh, file->fh_len, fh, fh_len)) {
+            return file;
+        }
+    }
+
+    return NULL;
+} /* chimera_vfs_wb_file_find */
+
+/* Unlink and free a file with no extents and no flush in flight.  Caller holds
+ * the shard lock. */
+static void
+chimera_vfs_wb_file_remove(
+    struct chimera_vfs_write_behind *wb,
+    struct chimera_vfs_wb_shard     *shard,
+    struct chimera_vfs_wb_file      *file)
+{
+    DL_DELETE(shard->files, file);
+
+    __atomic_sub_fetch(&wb->filter[file->fh_hash & CHIMERA_VFS_WB_FILTER_MASK], 1,
+                       __ATOMIC_RELEASE);
+
+    free(file);
+} /* chimera_vfs_wb_file_remove */
+
+/* Hand the file's extents to the flusher.  Caller holds the shard lock and
+ * must issue the returned extents (chimera_vfs_wb_flush_issue) after dropping
+ * it; the file stays pinned (flushing) until the last of them completes. */
+static struct chimera_vfs_wb_extent *
+chimera_vfs_wb_flush_start(struct chimera_vfs_wb_file *file)
+{
+    struct chimera_vfs_wb_extent *extents = file->extents;
+
+    file->extents     = NULL;
+    file->flushing    = 1;
+    file->inflight    = file->num_extents;
+    file->num_extents = 0;
+    file->dirty_since = 0;
+
+    return extents;
+} /* chimera_vfs_wb_flush_start */
+
+static void
+chimera_vfs_wb_post(struct chimera_vfs_request *request)
+{
+    struct chimera_vfs_thread *thread = request->thread;
+
+    pthread_mutex_lock(&thread->lock);
+    DL_APPEND(thread->pending_wb_resume, request);
+    pthread_mutex_unlock(&thread->lock);
+
+    evpl_ring_doorbell(&thread->doorbell);
+} /* chimera_vfs_wb_post */
+
+static void
+chimera_vfs_wb_flush_complete(struct chimera_vfs_request *request)
+{
+    struct chimera_vfs_thread       *thread = request->thread;
+    struct chimera_vfs_write_behind *wb     = thread->vfs->vfs_write_behind;
+    struct chimera_vfs_wb_extent    *extent = request->proto_private_data;
+    struct chimera_vfs_wb_file      *file   = extent->file;
+    struct chimera_vfs_wb_shard     *shard  = chimera_vfs_wb_shard(wb, file->fh_hash);
+    struct chimera_vfs_request      *waiters, *waiter;
+
+    if (request->status == CHIMERA_VFS_OK) {
+        chimera_vfs_attr_cache_insert(thread, thread->vfs->vfs_attr_cache,
+                                      file->fh_hash, file->fh, file->fh_len,
+                                      &request->write.r_post_attr);
+    } else {
+        chimera_vfs_error("write-behind flush of %u bytes at offset %lu failed: %d",
+                          extent->length, extent->offset, request->status);
+    }
+
+    chimera_vfs_complete(request);
+
+    evpl_iovec_release(thread->evpl, &extent->iov);
+
+    __atomic_sub_fetch(&wb->bytes, extent->capacity, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&shard->lock);
+
+    if (request->status != CHIMERA_VFS_OK && file->error == CHIMERA_VFS_OK) {
+        file->error = request->status;
+    }
+
+    if (--file->inflight) {
+        pthread_mutex_unlock(&shard->lock);
+        free(extent);
+        chimera_vfs_request_free(thread, request);
+        return;
+    }
+
+    file->flushing = 0;
+    waiters        = file->waiters;
+    file->waiters  = NULL;
+
+    /* The error is owed to the next COMMIT; hand it to a parked one if any. */
+    if (file->error != CHIMERA_VFS_OK) {
+        DL_FOREACH(waiters, waiter)
+        {
+            if (waiter->opcode == CHIMERA_VFS_OP_COMMIT) {
+                waiter->status = file->error;
+                file->error    = CHIMERA_VFS_OK;
+                break;
+            }
+        }
+    }
+
+    if (file->error == CHIMERA_VFS_OK) {
+        chimera_vfs_wb_file_remove(wb, shard, file);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    free(extent);
+    chimera_vfs_request_free(thread, request);
+
+    while (waiters) {
+        waiter = waiters;
+        DL_DELETE(waiters, waiter);
+        chimera_vfs_wb_post(waiter);
+    }
+} /* chimera_vfs_wb_flush_complete */
+
+static void
+chimera_vfs_wb_flush_issue(
+    struct chimera_vfs_thread    *thread,
+    struct chimera_vfs_wb_file   *file,
+    struct chimera_vfs_wb_extent *extents)
+{
+    struct chimera_vfs_wb_extent *extent;
+    struct chimera_vfs_request   *request;
+
+    /* The file may be freed by the completion of the last extent, which can
+     * run synchronously inside dispatch, so only the detached list is walked. */
+    while (extents) {
+        extent = extents;
+        DL_DELETE(extents, extent);
+
+        request = chimera_vfs_request_alloc_with_module(thread, &file->cred,
+                                                        file->fh, file->fh_len,
+                                                        file->fh_hash,
+                                                        file->handle.vfs_module);
+
+        chimera_vfs_abort_if(CHIMERA_VFS_IS_ERR(request), "write-behind flush request alloc failed");
+
+        request->opcode                         = CHIMERA_VFS_OP_WRITE;
+        request->complete                       = chimera_vfs_wb_flush_complete;
+        request->wb_flush                       = 1;
+        request->write.handle                   = &file->handle;
+        request->write.offset                   = extent->offset;
+        request->write.length                   = extent->length;
+        request->write.sync                     = CHIMERA_VFS_WRITE_UNSTABLE;
+        request->write.r_pre_attr.va_req_mask   = 0;
+        request->write.r_pre_attr.va_set_mask   = 0;
+        request->write.r_post_attr.va_req_mask  = CHIMERA_VFS_ATTR_MASK_CACHEABLE;
+        request->write.r_post_attr.va_set_mask  = 0;
+        request->write.iov                      = &extent->iov;
+        request->write.niov                     = 1;
+        request->proto_callback                 = NULL;
+        request->proto_private_data             = extent;
+        extent->iov.length                      = extent->length;
+
+        chimera_vfs_dispatch(request);
+    }
+} /* chimera_vfs_wb_flush_issue */
+
+SYMBOL_EXPORT struct chimera_vfs_write_behind *
+chimera_vfs_write_behind_create(uint64_t max_bytes)
+{
+    struct chimera_vfs_write_behind *wb;
+    int                              i;
+
+    wb = calloc(1, sizeof(*wb));
+
+    wb->max_bytes = max_bytes;
+    wb->filter    = calloc(1 << CHIMERA_VFS_WB_FILTER_BITS, sizeof(uint32_t));
+
+    for (i = 0; i < CHIMERA_VFS_WB_NUM_SHARDS; i++) {
+        pthread_mutex_init(&wb->shards[i].lock, NULL);
+    }
+
+    return wb;
+} /* chimera_vfs_write_behind_create */
+
+SYMBOL_EXPORT void
+chimera_vfs_write_behind_destroy(struct chimera_vfs_write_behind *wb)
+{
+    struct chimera_vfs_wb_shard  *shard;
+    struct chimera_vfs_wb_file   *file;
+    struct chimera_vfs_wb_extent *extent;
+    int                           i;
+
+    if (!wb) {
+        return;
+    }
+
+    /* Every VFS thread has drained (and so flushed) by now; anything left is
+     * a sticky error nobody committed. */
+    for (i = 0; i < CHIMERA_VFS_WB_NUM_SHARDS; i++) {
+        shard = &wb->shards[i];
+
+        while (shard->files) {
+            file = shard->files;
+            DL_DELETE(shard->files, file);
+
+            if (file->extents) {
+                chimera_vfs_error("write-behind: discarding buffered data at shutdown");
+            }
+
+            while (file->extents) {
+                extent = file->extents;
+                DL_DELETE(file->extents, extent);
+                free(extent);
+            }
+
+            free(file);
+        }
+
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(wb->filter);
+    free(wb);
+} /* chimera_vfs_write_behind_destroy */
+
+SYMBOL_EXPORT int
+chimera_vfs_write_behind_absorb(
+    struct chimera_vfs_thread      *thread,
+    const struct chimera_vfs_cred  *cred,
+    struct chimera_vfs_open_handle *handle,
+    uint64_t                        offset,
+    uint32_t                        count,
+    const struct evpl_iovec        *iov,
+    int                             niov)
+{
+    struct chimera_vfs                *vfs = thread->vfs;
+    struct chimera_vfs_write_behind   *wb  = vfs->vfs_write_behind;
+    struct chimera_vfs_wb_shard       *shard;
+    struct chimera_vfs_wb_file        *file;
+    struct chimera_vfs_wb_extent      *extent, *cur;
+    struct chimera_vfs_mount_attrs     mount_attrs;
+    struct chimera_vfs_wb_extent      *flush_extents = NULL;
+    uint64_t                           end = offset + count;
+    uint32_t                           capacity, chunk, done;
+    uint8_t                           *dst;
+    int                                i, pressure = 0;
+
+    if (count == 0 || count > CHIMERA_VFS_WB_MAX_WRITE ||
+        handle->cache_id == CHIMERA_VFS_OPEN_ID_SYNTHETIC ||
+        (handle->flags & CHIMERA_VFS_OPEN_HANDLE_STREAM) ||
+        (handle->vfs_module->capabilities & CHIMERA_VFS_CAP_DATA_IN_MEMORY)) {
+        return 0;
+    }
+
+    if (!chimera_vfs_handle_lease_free(vfs, handle)) {
+        return 0;
+    }
+
+    /* Absorbed writes never reach chimera_vfs_dispatch, so apply its
+     * read-only mount check here. */
+    if (handle->fh_len >= CHIMERA_VFS_MOUNT_ID_SIZE &&
+        chimera_vfs_mount_table_lookup_attrs(vfs->mount_table, handle->fh,
+                                             &mount_attrs) == 0 &&
+        (mount_attrs.flags & CHIMERA_VFS_MOUNT_ATTR_READONLY)) {
+        return 0;
+    }
+
+    shard = chimera_vfs_wb_shard(wb, handle->fh_hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    file = chimera_vfs_wb_file_find(shard, handle->fh_hash, handle->fh, handle->fh_len);
+
+    if (file && (file->flushing || file->error != CHIMERA_VFS_OK ||
+                 file->handle.vfs_private != handle->vfs_private ||
+                 file->handle.cred_hash != handle->cred_hash)) {
+        /* Let the write go to the backend; dispatch will park it behind the
+         * flush of what is already buffered. */
+        pthread_mutex_unlock(&shard->lock);
+        return 0;
+    }
+
+    extent   = NULL;
+    capacity = CHIMERA_VFS_WB_EXTENT_SIZE;
+
+    if (file) {
+        DL_FOREACH(file->extents, cur)
+        {
+            if (offset >= cur->offset && end <= cur->offset + cur->capacity &&
+                offset <= cur->offset + cur->length) {
+                /* Overwrite or append within the extent's buffer. */
+                extent = cur;
+                break;
+            }
+
+            if (offset < cur->offset + cur->capacity && end > cur->offset) {
+                /* Overlaps buffered data it cannot merge with. */
+                pthread_mutex_unlock(&shard->lock);
+                return 0;
+            }
+
+            /* A new extent must not grow into a later one, or the two could
+             * both hold (and flush in either order) the same bytes. */
+            if (cur->offset >= end && cur->offset - offset < capacity) {
+                capacity = cur->offset - offset;
+            }
+        }
+    }
+
+    if (!extent) {
+        if (__atomic_add_fetch(&wb->bytes, capacity, __ATOMIC_RELAXED) > wb->max_bytes) {
+            __atomic_sub_fetch(&wb->bytes, capacity, __ATOMIC_RELAXED);
+            pressure = 1;
+        } else if (file && file->num_extents >= CHIMERA_VFS_WB_MAX_EXTENTS) {
+            __atomic_sub_fetch(&wb->bytes, capacity, __ATOMIC_RELAXED);
+            flush_extents = chimera_vfs_wb_flush_start(file);
+        } else {
+            if (!file) {
+                file = calloc(1, sizeof(*file));
+
+                file->fh_hash = handle->fh_hash;
+                file->fh_len  = handle->fh_len;
+                memcpy(file->fh, handle->fh, handle->fh_len);
+
+                file->handle          = *handle;
+                file->handle.cache_id = CHIMERA_VFS_OPEN_ID_SYNTHETIC;
+                file->handle.prev     = NULL;
+                file->handle.next     = NULL;
+                file->cred            = *cred;
+                file->error           = CHIMERA_VFS_OK;
+
+                DL_APPEND(shard->files, file);
+
+                __atomic_add_fetch(&wb->filter[file->fh_hash & CHIMERA_VFS_WB_FILTER_MASK], 1,
+                                   __ATOMIC_SEQ_CST);
+            }
+
+            extent = calloc(1, sizeof(*extent));
+
+            extent->offset   = offset;
+            extent->length   = 0;
+            extent->capacity = capacity;
+            extent->file     = file;
+
+            i = evpl_iovec_alloc(thread->evpl, capacity, 4096, 1,
+                                 EVPL_IOVEC_FLAG_SHARED, &extent->iov);
+
+            chimera_vfs_abort_if(i != 1, "write-behind extent alloc failed");
+
+            DL_APPEND(file->extents, extent);
+            file->num_extents++;
+        }
+    }
+
+    if (!extent) {
+        pthread_mutex_unlock(&shard->lock);
+
+        if (flush_extents) {
+            chimera_vfs_wb_flush_issue(thread, file, flush_extents);
+        } else if (pressure) {
+            chimera_vfs_write_behind_flush(thread, 0);
+        }
+
+        return 0;
+    }
+
+    dst  = (uint8_t *) extent->iov.data + (offset - extent->offset);
+    done = 0;
+
+    for (i = 0; i < niov && done < count; i++) {
+        chunk = iov[i].length;
+
+        if (chunk > count - done) {
+            chunk = count - done;
+        }
+
+        memcpy(dst + done, iov[i].data, chunk);
+        done += chunk;
+    }
+
+    if (end - extent->offset > extent->length) {
+        extent->length = end - extent->offset;
+    }
+
+    if (!file->dirty_since) {
+        file->dirty_since = chimera_vfs_now_ticks();
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    /* The backend's attributes no longer describe the file; drop them so the
+     * next getattr is dispatched (and so flushes) rather than served stale. */
+    chimera_vfs_attr_cache_remove(vfs->vfs_attr_cache, handle->fh_hash,
+                                  handle->fh, handle->fh_len);
+
+    if (vfs->vfs_data_cache) {
+        chimera_vfs_data_cache_invalidate(vfs->vfs_data_cache, handle->fh_hash);
+    }
+
+    return 1;
+} /* chimera_vfs_write_behind_absorb */
+
+static int
+chimera_vfs_wb_intercept_fh(
+    struct chimera_vfs_request *request,
+    const void                 *fh,
+    int                         fh_len,
+    uint64_t                    fh_hash)
+{
+    struct chimera_vfs_write_behind *wb    = request->thread->vfs->vfs_write_behind;
+    struct chimera_vfs_wb_shard     *shard = chimera_vfs_wb_shard(wb, fh_hash);
+    struct chimera_vfs_wb_file      *file;
+    struct chimera_vfs_wb_extent    *extents;
+
+    if (!chimera_vfs_write_behind_pending(wb, fh_hash)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+
+    file = chimera_vfs_wb_file_find(shard, fh_hash, fh, fh_len);
+
+    if (!file) {
+        pthread_mutex_unlock(&shard->lock);
+        return 0;
+    }
+
+    if (file->extents || file->flushing) {
+        extents = file->flushing ? NULL : chimera_vfs_wb_flush_start(file);
+
+        DL_APPEND(file->waiters, request);
+
+        pthread_mutex_unlock(&shard->lock);
+
+        if (extents) {
+            chimera_vfs_wb_flush_issue(request->thread, file, extents);
+        }
+
+        return 1;
+    }
+
+    /* Nothing buffered, only an unreported flush error.  It outlives a CLOSE:
+     * the client still has the unstable data to resend, and only learns that
+     * it must from the COMMIT that follows. */
+    if (request->opcode == CHIMERA_VFS_OP_COMMIT) {
+        request->status = file->error;
+        chimera_vfs_wb_file_remove(wb, shard, file);
+        pthread_mutex_unlock(&shard->lock);
+        request->complete(request);
+        return 1;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return 0;
+} /* chimera_vfs_wb_intercept_fh */
+
+SYMBOL_EXPORT int
+chimera_vfs_write_behind_intercept(struct chimera_vfs_request *request)
+{
+    struct chimera_vfs_open_handle *src;
+
+    if (chimera_vfs_wb_intercept_fh(request, request->fh, request->fh_len, request->fh_hash)) {
+        return 1;
+    }
+
+    switch (request->opcode) {
+        case CHIMERA_VFS_OP_COPY_RANGE:
+            src = request->copy_range.src_handle;
+            break;
+        case CHIMERA_VFS_OP_CLONE_RANGE:
+            src = request->clone_range.src_handle;
+            break;
+        case CHIMERA_VFS_OP_MOVE_RANGE:
+            src = request->move_range.src_handle;
+            break;
+        default:
+            return 0;
+    } /* switch */
+
+    return chimera_vfs_wb_intercept_fh(request, src->fh, src->fh_len, src->fh_hash);
+} /* chimera_vfs_write_behind_intercept */
+
+SYMBOL_EXPORT void
+chimera_vfs_write_behind_flush(
+    struct chimera_vfs_thread *thread,
+    uint64_t                   min_age_ns)
+{
+    struct chimera_vfs_write_behind *wb = thread->vfs->vfs_write_behind;
+    struct chimera_vfs_wb_shard     *shard;
+    struct chimera_vfs_wb_file      *file, *flush_files;
+    struct chimera_vfs_wb_extent    *extents;
+    uint64_t                         cutoff;
+    int                              i;
+
+    if (!wb) {
+        return;
+    }
+
+    cutoff = chimera_vfs_now_ticks() - chimera_vfs_ns_to_ticks(min_age_ns);
+
+    for (i = 0; i < CHIMERA_VFS_WB_NUM_SHARDS; i++) {
+        shard = &wb->shards[i];
+
+        if (!__atomic_load_n(&shard->files, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        /* The periodic scan must not stall behind a busy shard; an explicit
+         * flush (pressure, drain) waits for it. */
+        if (min_age_ns) {
+            if (pthread_mutex_trylock(&shard->lock) != 0) {
+                continue;
+            }
+        } else {
+            pthread_mutex_lock(&shard->lock);
+        }
+
+        flush_files = NULL;
+
+        DL_FOREACH(shard->files, file)
+        {
+            if (file->extents && !file->flushing &&
+                (!min_age_ns || file->dirty_since <= cutoff)) {
+                file->flush_next = flush_files;
+                flush_files      = file;
+            }
+        }
+
+        /* Detach every batch before issuing any: a synchronous completion
+         * may free its file. */
+        for (file = flush_files; file; file = file->flush_next) {
+            file->flush_extents = chimera_vfs_wb_flush_start(file);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        while (flush_files) {
+            file        = flush_files;
+            flush_files = file->flush_next;
+            extents     = file->flush_extents;
+
+            file->flush_extents = NULL;
+
+            chimera_vfs_wb_flush_issue(thread, file, extents);
+        }
+    }
+} /* chimera_vfs_write_behind_flush */
+
+SYMBOL_EXPORT void
+chimera_vfs_write_behind_resume(struct chimera_vfs_request *request)
+{
+    if (request->status != CHIMERA_VFS_UNSET) {
+        request->complete(request);
+    } else {
+        chimera_vfs_dispatch(request);
+    }
+} /* chimera_vfs_write_behind_resume */
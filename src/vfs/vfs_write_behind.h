@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2026 Chimera-NAS Project Contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-only
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "vfs/vfs.h"
+
+/*
+ * Write-behind buffer for UNSTABLE writes.
+ *
+ * NFSv3 clients issue their bulk data as small UNSTABLE WRITEs and make them
+ * durable with a later COMMIT, so the protocol already allows the server to
+ * acknowledge such a write before the backend has seen it.  When enabled
+ * (chimera_vfs_set_write_behind_size) the VFS copies these writes into
+ * per-file extents, coalescing adjacent ones, and replies at once; the
+ * extents are written to the backend as large writes when:
+ *
+ *   - any other op targets the file (COMMIT, CLOSE, READ, GETATTR, SETATTR,
+ *     a non-absorbable write...): chimera_vfs_dispatch parks the op until the
+ *     file's buffered data has reached the backend, so every op observes its
+ *     own and earlier writes exactly as without the buffer;
+ *   - the buffer is full (memory pressure);
+ *   - the data has aged past CHIMERA_VFS_WB_MAX_AGE_NS (checked by the
+ *     periodic chimera_vfs_watchdog);
+ *   - a VFS thread drains for shutdown.
+ *
+ * Only leaseless writers are buffered (no io_owner, no caching lease on the
+ * file), since a lease holder's writes must go through lease mediation.  A
+ * failed background write is reported by the file's next COMMIT.
+ *
+ * The filter is a lock-free count of buffered files per fh_hash bucket, so the
+ * dispatch path pays one atomic load when the file has nothing buffered.
+ */
+
+#define CHIMERA_VFS_WB_NUM_SHARDS   64
+#define CHIMERA_VFS_WB_FILTER_BITS  16
+#define CHIMERA_VFS_WB_FILTER_MASK  ((1 << CHIMERA_VFS_WB_FILTER_BITS) - 1)
+#define CHIMERA_VFS_WB_MAX_WRITE    (256 * 1024)
+#define CHIMERA_VFS_WB_EXTENT_SIZE  (1024 * 1024)
+#define CHIMERA_VFS_WB_MAX_EXTENTS  16
+#define CHIMERA_VFS_WB_MAX_AGE_NS   (1000ULL * 1000 * 1000)
+
+struct chimera_vfs_wb_file;
+
+struct chimera_vfs_wb_shard {
+    pthread_mutex_t             lock;
+    struct chimera_vfs_wb_file *files;
+} __attribute__((aligned(64)));
+
+struct chimera_vfs_write_behind {
+    uint64_t                    max_bytes;
+    uint64_t                    bytes;  /* extent capacity held, atomic */
+    uint32_t                   *filter; /* buffered files per fh_hash bucket */
+    struct chimera_vfs_wb_shard shards[CHIMERA_VFS_WB_NUM_SHARDS];
+};
+
+static inline int
+chimera_vfs_write_behind_pending(
+    struct chimera_vfs_write_behind *wb,
+    uint64_t                         fh_hash)
+{
+    return wb && __atomic_load_n(&wb->filter[fh_hash & CHIMERA_VFS_WB_FILTER_MASK],
+                                 __ATOMIC_ACQUIRE);
+} /* chimera_vfs_write_behind_pending */
+
+struct chimera_vfs_write_behind *
+chimera_vfs_write_behind_create(uint64_t max_bytes);
+
+void
+chimera_vfs_write_behind_destroy(struct chimera_vfs_write_behind *wb);
+
+/* Buffer an UNSTABLE write.  Returns 1 if the data was absorbed (the caller
+ * replies immediately), 0 if the write must be sent to the backend. */
+int
+chimera_vfs_write_behind_absorb(
+    struct chimera_vfs_thread      *thread,
+    const struct chimera_vfs_cred  *cred,
+    struct chimera_vfs_open_handle *handle,
+    uint64_t                        offset,
+    uint32_t                        count,
+    const struct evpl_iovec        *iov,
+    int                             niov);
+
+/* Called by chimera_vfs_dispatch when the filter says a file the request
+ * touches may have buffered data.  Returns 1 if the request was parked (or
+ * completed) and must not be dispatched, 0 to dispatch it now. */
+int
+chimera_vfs_write_behind_intercept(struct chimera_vfs_request *request);
+
+/* Flush every file whose buffered data is at least min_age_ns old (0 flushes
+ * everything).  Flush writes are issued from, and complete on, thread. */
+void
+chimera_vfs_write_behind_flush(
+    struct chimera_vfs_thread *thread,
+    uint64_t                   min_age_ns);
+
+/* Resume a request parked by chimera_vfs_write_behind_intercept on its owning
+ * thread (drained from thread->pending_wb_resume). */
+void
+chimera_vfs_write_behind_resume(struct chimera_vfs_request *request);